@@ -68,6 +68,11 @@ jint writeStandardEntryFromJNI(
   return loggerLike.write(entry);
 }
 
+// Names and annotation keys repeat throughout a trace, values mostly don't.
+inline bool isInternedType(EntryType type) {
+  return type == EntryType::STRING_NAME || type == EntryType::STRING_KEY;
+}
+
 template <typename LoggerLike>
 jint writeBytesEntryFromJNI(
     LoggerLike& loggerLike,
@@ -122,7 +127,11 @@ jint writeBytesEntryFromJNI(
       env->ReleaseStringChars(arg2, str);
     }
   }
-  return loggerLike.writeBytes(static_cast<EntryType>(type), arg1, bytes, len);
+  auto entry_type = static_cast<EntryType>(type);
+  if (isInternedType(entry_type)) {
+    return loggerLike.writeString(entry_type, arg1, bytes, len);
+  }
+  return loggerLike.writeBytes(entry_type, arg1, bytes, len);
 }
 
 void registerNatives();
@@ -55,6 +55,10 @@ static void clearAllProviders(JNIEnv* env, jobject cls) {
   TraceProviders::get().clearAllProviders();
 }
 
+static jboolean selectClockSource(JNIEnv* env, jobject cls, jint source) {
+  return setClockSource(static_cast<ClockSource>(source));
+}
+
 static void refreshProviderNames(
     fbjni::alias_ref<jobject> cls,
     fbjni::alias_ref<fbjni::JArrayInt> provider_ids,
@@ -86,8 +90,12 @@ JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void*) {
                 "nativeClearAllProviders", profilo::clearAllProviders),
             makeNativeMethod(
                 "nativeRefreshProviderNames", profilo::refreshProviderNames),
+            makeNativeMethod("nativeSetClockSource", profilo::selectClockSource),
         });
 
+    // Entries logged from Java carry their own timestamps.
+    profilo::setExternalTimestamps(true);
+
     profilo::writer::NativeTraceWriter::registerNatives();
     profilo::logger::JMultiBufferLogger::registerNatives();
     profilo::logger_jni::registerNatives();
@@ -96,6 +96,12 @@ enum QuickLogConstants {
 
   SESSION_ID = 8126464 | 82, // = 8126546
 
+  // Written by TraceWriter at the end of each trace, see LossCounters.
+  TRACE_BUFFER_PACKETS_WRITTEN = 8126464 | 90, // = 8126554
+  TRACE_BUFFER_PACKETS_OVERWRITTEN = 8126464 | 91, // = 8126555
+  TRACE_BUFFER_TORN_READS = 8126464 | 92, // = 8126556
+  TRACE_BUFFER_STREAMS_DROPPED = 8126464 | 93, // = 8126557
+
   MAPPING_DMABUF = 9248104,
   MAPPING_GL_DEV = 9252052,
 };
@@ -42,6 +42,7 @@
 #include <profilo/logger/BlockLogger.h>
 
 #include "Atrace.h"
+#include <profilo/atrace/SystraceLogger.h>
 
 namespace fbjni = facebook::jni;
 
@@ -57,12 +58,13 @@ std::atomic<uint64_t> original_tags(UINT64_MAX);
 std::atomic<bool> systrace_installed;
 std::atomic<uint32_t> provider_mask;
 logger::MultiBufferLogger* logger;
+// Spin budget for hooked atrace writes, set per enableSystrace().
+std::atomic<uint32_t> spin_budget(Logger::kNoSpinBudget);
 bool first_enable = true;
 bool atrace_enabled;
 
 namespace {
 
-ssize_t const kAtraceMessageLength = 1024;
 // Magic FD to simply write to tracer logger and bypassing real write
 int const kTracerMagicFd = -100;
 // Libraries which log to ATRACE reference this function symbol. This symbol is
@@ -108,55 +110,11 @@ bool allowHookingCb(char const* libname, char const* full_libname, void* data) {
 }
 
 void log_systrace(const void* buf, size_t count) {
-  const char* msg = reinterpret_cast<const char*>(buf);
-
-  EntryType type;
-  switch (msg[0]) {
-    case 'B': { // begin synchronous event. format: "B|<pid>|<name>"
-      type = EntryType::MARK_PUSH;
-      break;
-    }
-    case 'E': { // end synchronous event. format: "E"
-      type = EntryType::MARK_POP;
-      break;
-    }
-    // the following events we don't currently log.
-    case 'S': // start async event. format: "S|<pid>|<name>|<cookie>"
-    case 'F': // finish async event. format: "F|<pid>|<name>|<cookie>"
-    case 'C': // counter. format: "C|<pid>|<name>|<value>"
-    default:
-      return;
-  }
-
-  StandardEntry entry{};
-  entry.tid = threadID();
-  entry.timestamp = monotonicTime();
-  entry.type = type;
-
-  int32_t id = logger->write(entry);
-  if (type != EntryType::MARK_POP) {
-    // Format is B|<pid>|<name>.
-    // Skip "B|" trivially, find next '|' with memchr. We cannot use strchr
-    // since we can't trust the message to have a null terminator.
-    constexpr auto kPrefixLength = 2; // length of "B|";
-
-    const char* name = reinterpret_cast<const char*>(
-        memchr(msg + kPrefixLength, '|', count - kPrefixLength));
-    if (name == nullptr) {
-      return;
-    }
-    name++; // skip '|' to the next character
-    ssize_t len = msg + count - name;
-    if (len > 0) {
-      logger->writeBytes(
-          EntryType::STRING_NAME,
-          id,
-          (const uint8_t*)name,
-          std::min(len, kAtraceMessageLength));
-
-      FBLOGV("systrace event: %s", name);
-    }
-  }
+  logSystraceMessage(
+      *logger,
+      reinterpret_cast<const char*>(buf),
+      count,
+      spin_budget.load(std::memory_order_relaxed));
 }
 
 bool should_log_systrace(int fd, size_t count) {
@@ -347,13 +305,15 @@ void installSystraceSnooper(int providerMask) {
   provider_mask = providerMask;
 }
 
-void enableSystrace() {
+void enableSystrace(uint32_t budget) {
   logger::BlockLogger block(*logger, "enableSystrace");
 
   if (!systrace_installed) {
     return;
   }
 
+  spin_budget.store(budget, std::memory_order_relaxed);
+
   if (!first_enable) {
     // On every enable, except the first one, find if new libs were loaded
     // and install systrace hook for them
@@ -416,8 +376,11 @@ bool JNI_installSystraceHook(
   return installSystraceHook(logger, mask);
 }
 
-void JNI_enableSystraceNative(fbjni::alias_ref<jobject>) {
-  enableSystrace();
+void JNI_enableSystraceNative(fbjni::alias_ref<jobject>, jint spinBudget) {
+  // 0 keeps the blocking writes.
+  enableSystrace(
+      spinBudget > 0 ? static_cast<uint32_t>(spinBudget)
+                     : Logger::kNoSpinBudget);
 }
 
 void JNI_restoreSystraceNative(fbjni::alias_ref<jobject>) {
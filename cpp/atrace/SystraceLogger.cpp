@@ -0,0 +1,114 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/atrace/SystraceLogger.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fb/log.h>
+#include <profilo/LogEntry.h>
+#include <profilo/util/common.h>
+
+namespace facebook {
+namespace profilo {
+namespace atrace {
+
+namespace {
+
+ssize_t const kAtraceMessageLength = 1024;
+
+} // namespace
+
+int32_t logSystraceMessage(
+    logger::MultiBufferLogger& logger,
+    const char* msg,
+    size_t count,
+    uint32_t spin_budget) {
+  if (count == 0) {
+    return 0;
+  }
+
+  EntryType type;
+  switch (msg[0]) {
+    case 'B': { // begin synchronous event. format: "B|<pid>|<name>"
+      type = EntryType::MARK_PUSH;
+      break;
+    }
+    case 'E': { // end synchronous event. format: "E"
+      type = EntryType::MARK_POP;
+      break;
+    }
+    // the following events we don't currently log.
+    case 'S': // start async event. format: "S|<pid>|<name>|<cookie>"
+    case 'F': // finish async event. format: "F|<pid>|<name>|<cookie>"
+    case 'C': // counter. format: "C|<pid>|<name>|<value>"
+    default:
+      return 0;
+  }
+
+  StandardEntry entry{};
+  entry.tid = threadID();
+  entry.timestamp = monotonicTime();
+  entry.type = type;
+
+  bool blocking = spin_budget == Logger::kNoSpinBudget;
+  int32_t id = blocking ? logger.write(entry)
+                        : logger.tryWrite(entry, spin_budget);
+  if (id == 0) {
+    return 0;
+  }
+  if (type != EntryType::MARK_POP) {
+    // Format is B|<pid>|<name>.
+    // Skip "B|" trivially, find next '|' with memchr. We cannot use strchr
+    // since we can't trust the message to have a null terminator.
+    constexpr size_t kPrefixLength = 2; // length of "B|";
+    if (count <= kPrefixLength) {
+      return id;
+    }
+
+    const char* name = reinterpret_cast<const char*>(
+        memchr(msg + kPrefixLength, '|', count - kPrefixLength));
+    if (name == nullptr) {
+      return id;
+    }
+    name++; // skip '|' to the next character
+    ssize_t len = msg + count - name;
+    if (len > 0) {
+      // Section names repeat all the time, log each one in full only once.
+      auto name_len = std::min(len, kAtraceMessageLength);
+      if (blocking) {
+        logger.writeString(
+            EntryType::STRING_NAME, id, (const uint8_t*)name, name_len);
+      } else {
+        logger.tryWriteString(
+            EntryType::STRING_NAME,
+            id,
+            (const uint8_t*)name,
+            name_len,
+            spin_budget);
+      }
+
+      FBLOGV("systrace event: %s", name);
+    }
+  }
+  return id;
+}
+
+} // namespace atrace
+} // namespace profilo
+} // namespace facebook
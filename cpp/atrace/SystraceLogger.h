@@ -0,0 +1,47 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <profilo/MultiBufferLogger.h>
+
+namespace facebook {
+namespace profilo {
+namespace atrace {
+
+//
+// Log a message written to the atrace marker fd, e.g. "B|<pid>|<name>".
+// Only synchronous sections are logged: a MARK_PUSH with the section name
+// interned as its STRING_NAME (see Logger::writeString()), or a MARK_POP.
+// The message doesn't have to be null-terminated.
+//
+// With a spin_budget, the entries are written with tryWrite() and dropped
+// instead of waiting on a contended ring slot (see Logger::tryWrite()). A
+// dropped MARK_PUSH or MARK_POP leaves the section stack unbalanced, so
+// only opt in when stalling the traced thread is worse than that.
+//
+// Returns the ID of the MARK_PUSH or MARK_POP, or 0 if nothing was logged.
+//
+int32_t logSystraceMessage(
+    logger::MultiBufferLogger& logger,
+    const char* msg,
+    size_t count,
+    uint32_t spin_budget = Logger::kNoSpinBudget);
+
+} // namespace atrace
+} // namespace profilo
+} // namespace facebook
@@ -32,9 +32,25 @@ class Language(object, metaclass=abc.ABCMeta):
         return num in [Language.CPP, Language.JAVA]
 
 
-class MemoryDescription(namedtuple("MemoryDescription", ["fields", "typename"])):
+class MemoryDescription(
+    namedtuple(
+        "MemoryDescription", ["fields", "typename", "compact", "shared_prefix"]
+    )
+):
     TYPE_ID = 1
 
+    # Compact serialization types live in the upper half of the type byte, so
+    # that adding them doesn't shift the ids of existing formats.
+    COMPACT_TYPE_ID_FLAG = 0x80
+    # Same for shared-prefix serialization types, see shared_prefix.
+    SHARED_PREFIX_TYPE_ID_FLAG = 0x40
+
+    # shared_prefix: the last field is an array that consecutive entries
+    # mostly repeat (e.g. the frames of stack samples). Adds an encoding that
+    # stores only the values it doesn't share with an earlier entry.
+    def __new__(cls, fields=None, typename=None, compact=False, shared_prefix=False):
+        return super().__new__(cls, fields, typename, compact, shared_prefix)
+
     def __init__(self, **kwargs):
         super().__init__()
 
@@ -47,8 +63,28 @@ class MemoryDescription(namedtuple("MemoryDescription", ["fields", "typename"]))
         self.type_id = MemoryDescription.TYPE_ID
         MemoryDescription.TYPE_ID += 1
 
+        self.compact_type_id = None
+        if self.compact:
+            self.compact_type_id = self.type_id | self.COMPACT_TYPE_ID_FLAG
+
+        self.shared_prefix_type_id = None
+        if self.shared_prefix:
+            self.shared_prefix_type_id = (
+                self.type_id | self.SHARED_PREFIX_TYPE_ID_FLAG
+            )
+
+
+class EntryDescription(
+    namedtuple("EntryDescription", ["id", "name", "memory_format", "tier"])
+):
+    # Tiers select the TraceBuffer an entry is written to when the buffer has
+    # a reserved ring for high priority entries.
+    TIER_NORMAL = 0
+    TIER_HIGH = 1
+
+    def __new__(cls, id=None, name=None, memory_format=None, tier=TIER_NORMAL):
+        return super().__new__(cls, id, name, memory_format, tier)
 
-class EntryDescription(namedtuple("EntryDescription", ["id", "name", "memory_format"])):
     def __init__(self, **kwargs):
         super().__init__()
 
@@ -64,6 +100,9 @@ class EntryDescription(namedtuple("EntryDescription", ["id", "name", "memory_for
         if not isinstance(self.memory_format, MemoryDescription):
             raise ValueError("memory_format must be a MemoryDescription")
 
+        if self.tier not in (EntryDescription.TIER_NORMAL, EntryDescription.TIER_HIGH):
+            raise ValueError("tier must be TIER_NORMAL or TIER_HIGH")
+
 
 class Codegen(object, metaclass=abc.ABCMeta):
     @abc.abstractmethod
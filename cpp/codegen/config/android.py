@@ -17,7 +17,7 @@ limitations under the License.
 from __future__ import absolute_import, division, print_function, unicode_literals
 
 from ..codegen import EntryDescription, MemoryDescription
-from ..types import DynamicArrayType, EntryTypeEnum, Types
+from ..types import DynamicArrayType, EntryTypeEnum, KeyValueListType, Types
 
 NAMES = [
     "UNKNOWN_TYPE",
@@ -140,6 +140,9 @@ NAMES = [
     "MEMORY_MAPPING_FAILURE",
     "THREAD_NAMING",
     "STKERR_INVALID_MAP",
+    "ANNOTATION",
+    "STRING_DEFINE",
+    "STRING_REF",
 ]
 
 STACK_FRAME_ENTRIES = frozenset(
@@ -155,6 +158,38 @@ BYTES_ENTRIES = frozenset(
         "STRING_KEY",
         "STRING_VALUE",
         "STRING_NAME",
+        "STRING_DEFINE",
+    ]
+)
+
+# Annotations carrying their keys and values in a single entry, instead of
+# a StandardEntry followed by STRING_KEY / STRING_VALUE BytesEntries.
+# AnnotationEntry works with any type, ANNOTATION is for when no other
+# type fits.
+ANNOTATION_ENTRIES = frozenset(
+    [
+        "ANNOTATION",
+    ]
+)
+
+# Entries written to the reserved high priority ring of tiered buffers, so
+# that trace boundaries and spans survive a flood of other entries. Keep
+# these to StandardEntry types: entries linked by matchid (e.g. annotation
+# keys and values) are not guaranteed to land in the same ring.
+HIGH_PRIORITY_ENTRIES = frozenset(
+    [
+        "MARK_PUSH",
+        "MARK_POP",
+        "TRACE_ABORT",
+        "TRACE_END",
+        "TRACE_START",
+        "TRACE_BACKWARDS",
+        "TRACE_TIMEOUT",
+        "QPL_START",
+        "QPL_END",
+        "QPL_CANCEL",
+        "TRACE_PRE_END",
+        "LOGGER_PRIORITY",
     ]
 )
 
@@ -172,6 +207,7 @@ def get_frames_memory_format():
     return MemoryDescription(
         fields=fields,
         typename="FramesEntry",
+        shared_prefix=True,
     )
 
 
@@ -189,6 +225,22 @@ def get_bytes_memory_format():
     )
 
 
+def get_annotation_memory_format():
+    fields = [
+        ("id", Types.int32),
+        ("type", EntryTypeEnum()),
+        ("timestamp", Types.int64),
+        ("tid", Types.int32),
+        ("matchid", Types.int32),
+        ("pairs", KeyValueListType()),
+    ]
+
+    return MemoryDescription(
+        fields=fields,
+        typename="AnnotationEntry",
+    )
+
+
 def get_entry_descriptions():
     descriptions = []
     standard_entry = MemoryDescription(
@@ -202,24 +254,34 @@ def get_entry_descriptions():
             ("extra", Types.int64),
         ],
         typename="StandardEntry",
+        compact=True,
     )
 
     frames_entry = get_frames_memory_format()
     bytes_entry = get_bytes_memory_format()
+    annotation_entry = get_annotation_memory_format()
 
     for idx, name in enumerate(NAMES):
         if name in STACK_FRAME_ENTRIES:
             memory_format = frames_entry
         elif name in BYTES_ENTRIES:
             memory_format = bytes_entry
+        elif name in ANNOTATION_ENTRIES:
+            memory_format = annotation_entry
         else:
             memory_format = standard_entry
 
+        if name in HIGH_PRIORITY_ENTRIES:
+            tier = EntryDescription.TIER_HIGH
+        else:
+            tier = EntryDescription.TIER_NORMAL
+
         descriptions.append(
             EntryDescription(
                 id=idx,
                 name=name,
                 memory_format=memory_format,
+                tier=tier,
             ),
         )
 
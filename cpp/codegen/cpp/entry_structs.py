@@ -17,10 +17,46 @@ limitations under the License.
 from __future__ import absolute_import, division, print_function, unicode_literals
 
 from ..codegen import Codegen, SIGNED_SOURCE
-from ..types import DynamicArrayType
+from ..types import (
+    DynamicArrayType,
+    IntegerType,
+    KeyValueListType,
+    PointerType,
+    PrimitiveType,
+)
 from .type_converter import TypeConverter
 
 
+def shared_prefix_array(fmt):
+    """
+    Returns the name and type of the array a shared-prefix format leaves
+    the shared values out of.
+    """
+    name, ftype = fmt.fields[-1]
+    if not isinstance(ftype, DynamicArrayType) or not isinstance(
+        ftype.member_type, IntegerType
+    ):
+        raise ValueError(
+            "{}: shared_prefix requires a DynamicArrayType of integers "
+            "as the last member".format(fmt.typename)
+        )
+    return name, ftype
+
+
+def fixed_size(fmt):
+    """
+    Returns the serialized size of a format whose fields all have a constant
+    size, None otherwise. These get a packed wire layout that pack() copies
+    in one go instead of writing field by field.
+    """
+    if not all(
+        isinstance(ftype, PrimitiveType) and not isinstance(ftype, PointerType)
+        for _, ftype in fmt.fields
+    ):
+        return None
+    return 1 + sum(ftype.constant_size for _, ftype in fmt.fields)
+
+
 class CppEntryStructsCodegen(Codegen):
     def __init__(self, entries):
         super(CppEntryStructsCodegen, self).__init__()
@@ -37,6 +73,7 @@ class CppEntryStructsCodegen(Codegen):
 
 #include <cstdint>
 #include <cstring>
+#include <stdexcept>
 #include <type_traits>
 #include <unistd.h>
 #include <profilo/entries/EntryType.h>
@@ -46,7 +83,7 @@ class CppEntryStructsCodegen(Codegen):
 namespace facebook {
 namespace profilo {
 namespace entries {
-
+%%KEY_VALUE_DECLARATIONS%%
 %%ENTRIES_STRUCTS%%
 
 uint8_t peek_type(const void* src, size_t len);
@@ -57,10 +94,71 @@ uint8_t peek_type(const void* src, size_t len);
 """.lstrip()
 
         enum = self._generate_entries_structs()
+        template = template.replace(
+            "%%KEY_VALUE_DECLARATIONS%%", self._generate_key_value_declarations()
+        )
         template = template.replace("%%ENTRIES_STRUCTS%%", enum)
         template = template.replace("%%SIGNED_SOURCE%%", SIGNED_SOURCE)
         return template
 
+    def _generate_key_value_declarations(self):
+        if not uses_key_value_lists(self.unique_types.values()):
+            return ""
+
+        return """
+//
+// One typed pair of a key/value list. Packing doesn't copy the strings, and
+// after unpacking they point into the packed entry. Neither the key nor
+// string values are NUL-terminated.
+//
+struct KeyValue {
+  enum Kind : uint8_t {
+    INT = 0,
+    DOUBLE = 1,
+    STRING = 2,
+  };
+
+  Kind kind;
+  const char* key;
+  uint16_t keySize;
+  union {
+    int64_t intValue;
+    double doubleValue;
+    struct {
+      const char* values;
+      uint16_t size;
+    } stringValue;
+  };
+
+  // key and string values must be NUL-terminated here.
+  static KeyValue ofInt(const char* key, int64_t value);
+  static KeyValue ofDouble(const char* key, double value);
+  static KeyValue ofString(const char* key, const char* value);
+  static KeyValue ofString(const char* key, const char* value, size_t size);
+
+  // Packed size of a list of `count` pairs.
+  static size_t calculateSize(const KeyValue* pairs, size_t count);
+  // No alignment requirement.
+  static void pack(const KeyValue* pairs, size_t count, void* dst, size_t size);
+};
+
+//
+// Reads the pairs of a packed key/value list in order.
+//
+class KeyValueReader {
+ public:
+  KeyValueReader(const void* src, size_t size);
+
+  // Returns false once all pairs have been read.
+  bool next(KeyValue& pair);
+
+ private:
+  const uint8_t* src_;
+  size_t size_;
+  size_t offset_;
+};
+"""
+
     def _generate_entries_structs(self):
 
         structs = [
@@ -76,16 +174,65 @@ uint8_t peek_type(const void* src, size_t len);
 struct __attribute__((packed)) %%TYPENAME%% {
 
   static const uint8_t kSerializationType = %%TYPE_ID%%;
-
+%%LAYOUT_DECLARATIONS%%
 %%FIELDS%%
 
   static void pack(const %%TYPENAME%%& entry, void* dst, size_t size);
   static void unpack(%%TYPENAME%%& entry, const void* src, size_t size);
 
-  static size_t calculateSize(%%TYPENAME%% const& entry);
-};
+  // Writes the same bytes as pack() to a sink providing
+  // write(const void* src, size_t size) and pad(size_t size), e.g.
+  // logger::SlotWriter. The sink must accept calculateSize(entry) bytes.
+  template <class Sink>
+  static void pack(const %%TYPENAME%%& entry, Sink& sink);
+
+%%CALCULATE_SIZE_DECLARATION%%%%COMPACT_DECLARATIONS%%};
+
+%%SINK_PACK_CODE%%
 """.lstrip()
 
+        compact_declarations = ""
+        if fmt.compact:
+            compact_declarations = """
+  // Compact encoding: a presence bitmap followed by the non-zero fields as
+  // varints (zigzag for signed fields). Has no alignment requirements and
+  // consecutive entries can be packed back to back. unpack() accepts both
+  // encodings.
+  static const uint8_t kCompactSerializationType = %%COMPACT_TYPE_ID%%;
+
+  static void packCompact(const %%TYPENAME%%& entry, void* dst, size_t size);
+  // Returns the number of bytes consumed from src.
+  static size_t unpackCompact(%%TYPENAME%%& entry, const void* src, size_t size);
+
+  static size_t calculateCompactSize(%%TYPENAME%% const& entry);
+"""
+            compact_declarations = compact_declarations.replace(
+                "%%COMPACT_TYPE_ID%%", str(fmt.compact_type_id)
+            )
+        if fmt.shared_prefix:
+            compact_declarations += self._generate_shared_prefix_declarations(fmt)
+        template = template.replace("%%COMPACT_DECLARATIONS%%", compact_declarations)
+
+        size = fixed_size(fmt)
+        if size is not None:
+            calculate_size_declaration = """
+  static constexpr size_t calculateSize(%%TYPENAME%% const& /*entry*/) {
+    return kSerializedSize;
+  }
+""".lstrip("\n")
+            sink_pack_code = self._generate_layout_pack_code(fmt)
+        else:
+            calculate_size_declaration = """
+  static size_t calculateSize(%%TYPENAME%% const& entry);
+""".lstrip("\n")
+            sink_pack_code = self._generate_sink_pack_code(fmt)
+        template = template.replace(
+            "%%CALCULATE_SIZE_DECLARATION%%", calculate_size_declaration
+        )
+        template = template.replace(
+            "%%LAYOUT_DECLARATIONS%%", self._generate_layout_declarations(fmt)
+        )
+
         fields = [
             TypeConverter.get(field[1]).generate_declaration(name=field[0])
             for field in fmt.fields
@@ -93,6 +240,7 @@ struct __attribute__((packed)) %%TYPENAME%% {
         fields = "\n".join(fields)
         fields = Codegen.indent(fields)
 
+        template = template.replace("%%SINK_PACK_CODE%%", sink_pack_code)
         template = template.replace("%%TYPENAME%%", fmt.typename)
         template = template.replace("%%TYPE_ID%%", str(fmt.type_id))
         template = template.replace("%%FIELDS%%", fields)
@@ -101,6 +249,150 @@ struct __attribute__((packed)) %%TYPENAME%% {
 
         template = template.replace("%%TYPENAME%%", fmt.typename)
 
+    def _generate_shared_prefix_declarations(self, fmt):
+        array_name, array_type = shared_prefix_array(fmt)
+        template = """
+  // Shared-prefix encoding, for entries that mostly repeat the %%ARRAY%% of
+  // an earlier entry, like consecutive stack samples of a thread (whose
+  // root frames are at the end of the array). Stores the ID of the earlier
+  // entry (`base`), how many values at the end of %%ARRAY%% are the same as
+  // at the end of the base's, and the remaining values as zigzag varint
+  // deltas. The other fields are varints. Has no alignment requirements.
+  //
+  // Readers need the base to expand the entry, see
+  // EntryVisitor::visitPrefix().
+  static const uint8_t kPrefixSerializationType = %%PREFIX_TYPE_ID%%;
+
+  // Leaves out the last `shared` values of entry.%%ARRAY%%.
+  static void packPrefix(
+      const %%TYPENAME%%& entry,
+      int32_t base,
+      uint16_t shared,
+      void* dst,
+      size_t size);
+  static size_t calculatePrefixSize(
+      const %%TYPENAME%%& entry,
+      int32_t base,
+      uint16_t shared);
+
+  // Number of values unpackPrefix() decodes, at most `size`.
+  static uint16_t peekPrefixCount(const void* src, size_t size);
+  // entry.%%ARRAY%% gets the values that aren't shared with the base, decoded
+  // into `values`, which must have room for peekPrefixCount() of them.
+  static void unpackPrefix(
+      %%TYPENAME%%& entry,
+      int32_t& base,
+      uint16_t& shared,
+      %%VALUE_TYPE%%* values,
+      const void* src,
+      size_t size);
+"""
+        template = template.replace("%%ARRAY%%", array_name)
+        template = template.replace(
+            "%%VALUE_TYPE%%",
+            TypeConverter.get(array_type.member_type).map_type(),
+        )
+        template = template.replace(
+            "%%PREFIX_TYPE_ID%%", str(fmt.shared_prefix_type_id)
+        )
+        return template
+
+    def _generate_layout_declarations(self, fmt):
+        size = fixed_size(fmt)
+        if size is None:
+            return ""
+
+        template = """
+  // Every field has a fixed size, so the entry is serialized by filling in
+  // a Layout and copying it as a whole, see pack().
+  static constexpr size_t kSerializedSize = %%SIZE%%;
+
+  struct __attribute__((packed)) Layout {
+    uint8_t serialization_type;
+%%LAYOUT_FIELDS%%
+  };
+  static_assert(
+      sizeof(Layout) == kSerializedSize,
+      "Layout doesn't match the serialized format");
+
+  static void toLayout(const %%TYPENAME%%& entry, Layout& layout);
+  // Field by field version of pack(), produces the same bytes.
+  static void packFieldwise(const %%TYPENAME%%& entry, void* dst, size_t size);
+"""
+        layout_fields = [
+            TypeConverter.get(ftype).generate_layout_declaration(name=name)
+            for name, ftype in fmt.fields
+        ]
+        layout_fields = Codegen.indent(Codegen.indent("\n".join(layout_fields)))
+
+        template = template.replace("%%LAYOUT_FIELDS%%", layout_fields)
+        template = template.replace("%%SIZE%%", str(size))
+        return template
+
+    def _generate_layout_pack_code(self, fmt):
+        template = """
+inline void %%TYPENAME%%::toLayout(const %%TYPENAME%%& entry, %%TYPENAME%%::Layout& layout) {
+  layout.serialization_type = kSerializationType;
+%%ASSIGNMENTS%%
+}
+
+/* No alignment requirement. */
+inline void %%TYPENAME%%::pack(const %%TYPENAME%%& entry, void* dst, size_t size) {
+  if (size < kSerializedSize) {
+      throw std::out_of_range("Cannot fit %%TYPENAME%% in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  Layout layout;
+  toLayout(entry, layout);
+  std::memcpy(dst, &layout, sizeof(layout));
+}
+
+template <class Sink>
+void %%TYPENAME%%::pack(const %%TYPENAME%%& entry, Sink& sink) {
+  Layout layout;
+  toLayout(entry, layout);
+  sink.write(&layout, sizeof(layout));
+}
+""".lstrip()
+
+        assignments = [
+            TypeConverter.get(ftype).generate_layout_code(
+                from_expression="entry.{name}".format(name=name),
+                to_expression="layout.{name}".format(name=name),
+            )
+            for name, ftype in fmt.fields
+        ]
+        assignments = Codegen.indent("\n".join(assignments))
+
+        template = template.replace("%%TYPENAME%%", fmt.typename)
+        return template.replace("%%ASSIGNMENTS%%", assignments)
+
+    def _generate_sink_pack_code(self, fmt):
+        template = """
+template <class Sink>
+void %%TYPENAME%%::pack(const %%TYPENAME%%& entry, Sink& sink) {
+  uint8_t serialization_type = kSerializationType;
+  sink.write(&serialization_type, sizeof(serialization_type));
+  size_t offset = 1;
+%%WRITES%%
+  (void)offset;
+}
+""".lstrip()
+
+        writes = [
+            TypeConverter.get(ftype).generate_sink_pack_code(
+                from_expression="entry.{name}".format(name=name),
+                sink_expression="sink",
+                offset_expr="offset",
+            )
+            for name, ftype in fmt.fields
+        ]
+        writes = Codegen.indent("\n".join(writes))
+
+        return template.replace("%%WRITES%%", writes)
+
 
 class CppEntryStructsCppCodegen(Codegen):
     def __init__(self, entries):
@@ -123,7 +415,8 @@ class CppEntryStructsCppCodegen(Codegen):
 namespace facebook {
 namespace profilo {
 namespace entries {
-
+%%COMPACT_HELPERS%%
+%%KEY_VALUE_CODE%%
 %%ENTRIES_CODE%%
 
 uint8_t peek_type(const void* src, size_t len) {
@@ -137,6 +430,8 @@ uint8_t peek_type(const void* src, size_t len) {
 """.lstrip()
 
         code = self._generate_entries_code()
+        template = template.replace("%%COMPACT_HELPERS%%", self._generate_compact_helpers())
+        template = template.replace("%%KEY_VALUE_CODE%%", self._generate_key_value_code())
         template = template.replace("%%ENTRIES_CODE%%", code)
         template = template.replace("%%SIGNED_SOURCE%%", SIGNED_SOURCE)
         return template
@@ -151,6 +446,207 @@ uint8_t peek_type(const void* src, size_t len) {
 
         return structs
 
+    def _generate_key_value_code(self):
+        if not uses_key_value_lists(self.unique_types.values()):
+            return ""
+
+        return """
+/*
+ * Packed pair: kind (1 byte), key size (2 bytes), key, then an 8 byte
+ * INT or DOUBLE value or a STRING's size (2 bytes) and bytes. Pairs follow
+ * each other without padding.
+ */
+
+KeyValue KeyValue::ofInt(const char* key, int64_t value) {
+  KeyValue pair{};
+  pair.kind = INT;
+  pair.key = key;
+  pair.keySize = static_cast<uint16_t>(std::strlen(key));
+  pair.intValue = value;
+  return pair;
+}
+
+KeyValue KeyValue::ofDouble(const char* key, double value) {
+  KeyValue pair{};
+  pair.kind = DOUBLE;
+  pair.key = key;
+  pair.keySize = static_cast<uint16_t>(std::strlen(key));
+  pair.doubleValue = value;
+  return pair;
+}
+
+KeyValue KeyValue::ofString(const char* key, const char* value) {
+  return ofString(key, value, std::strlen(value));
+}
+
+KeyValue KeyValue::ofString(const char* key, const char* value, size_t size) {
+  if (size > UINT16_MAX) {
+    throw std::out_of_range("String value is too long");
+  }
+  KeyValue pair{};
+  pair.kind = STRING;
+  pair.key = key;
+  pair.keySize = static_cast<uint16_t>(std::strlen(key));
+  pair.stringValue.values = value;
+  pair.stringValue.size = static_cast<uint16_t>(size);
+  return pair;
+}
+
+size_t KeyValue::calculateSize(const KeyValue* pairs, size_t count) {
+  size_t size = 0;
+  for (size_t idx = 0; idx < count; ++idx) {
+    auto& pair = pairs[idx];
+    size += sizeof(uint8_t) + sizeof(pair.keySize) + pair.keySize;
+    if (pair.kind == STRING) {
+      size += sizeof(pair.stringValue.size) + pair.stringValue.size;
+    } else {
+      size += sizeof(pair.intValue);
+    }
+  }
+  return size;
+}
+
+void KeyValue::pack(const KeyValue* pairs, size_t count, void* dst, size_t size) {
+  if (size < calculateSize(pairs, count)) {
+      throw std::out_of_range("Cannot fit KeyValue list in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  size_t offset = 0;
+  for (size_t idx = 0; idx < count; ++idx) {
+    auto& pair = pairs[idx];
+    dst_byte[offset++] = pair.kind;
+    std::memcpy(dst_byte + offset, &pair.keySize, sizeof(pair.keySize));
+    offset += sizeof(pair.keySize);
+    std::memcpy(dst_byte + offset, pair.key, pair.keySize);
+    offset += pair.keySize;
+    switch (pair.kind) {
+      case INT:
+        std::memcpy(dst_byte + offset, &pair.intValue, sizeof(pair.intValue));
+        offset += sizeof(pair.intValue);
+        break;
+      case DOUBLE:
+        std::memcpy(dst_byte + offset, &pair.doubleValue, sizeof(pair.doubleValue));
+        offset += sizeof(pair.doubleValue);
+        break;
+      case STRING:
+        std::memcpy(
+          dst_byte + offset,
+          &pair.stringValue.size,
+          sizeof(pair.stringValue.size));
+        offset += sizeof(pair.stringValue.size);
+        std::memcpy(dst_byte + offset, pair.stringValue.values, pair.stringValue.size);
+        offset += pair.stringValue.size;
+        break;
+      default:
+        throw std::invalid_argument("Unknown KeyValue kind");
+    }
+  }
+}
+
+KeyValueReader::KeyValueReader(const void* src, size_t size)
+    : src_(reinterpret_cast<const uint8_t*>(src)), size_(size), offset_(0) {}
+
+bool KeyValueReader::next(KeyValue& pair) {
+  if (offset_ >= size_) {
+    return false;
+  }
+  auto require = [this](size_t bytes) {
+    if (size_ - offset_ < bytes) {
+      throw std::out_of_range("Truncated KeyValue list");
+    }
+  };
+
+  require(sizeof(uint8_t) + sizeof(pair.keySize));
+  pair.kind = static_cast<KeyValue::Kind>(src_[offset_++]);
+  std::memcpy(&pair.keySize, src_ + offset_, sizeof(pair.keySize));
+  offset_ += sizeof(pair.keySize);
+  require(pair.keySize);
+  pair.key = reinterpret_cast<const char*>(src_ + offset_);
+  offset_ += pair.keySize;
+  switch (pair.kind) {
+    case KeyValue::INT:
+      require(sizeof(pair.intValue));
+      std::memcpy(&pair.intValue, src_ + offset_, sizeof(pair.intValue));
+      offset_ += sizeof(pair.intValue);
+      break;
+    case KeyValue::DOUBLE:
+      require(sizeof(pair.doubleValue));
+      std::memcpy(&pair.doubleValue, src_ + offset_, sizeof(pair.doubleValue));
+      offset_ += sizeof(pair.doubleValue);
+      break;
+    case KeyValue::STRING:
+      require(sizeof(pair.stringValue.size));
+      std::memcpy(
+        &pair.stringValue.size,
+        src_ + offset_,
+        sizeof(pair.stringValue.size));
+      offset_ += sizeof(pair.stringValue.size);
+      require(pair.stringValue.size);
+      pair.stringValue.values = reinterpret_cast<const char*>(src_ + offset_);
+      offset_ += pair.stringValue.size;
+      break;
+    default:
+      throw std::invalid_argument("Unknown KeyValue kind");
+  }
+  return true;
+}
+"""
+
+    def _generate_compact_helpers(self):
+        if not any(
+            fmt.compact or fmt.shared_prefix for fmt in self.unique_types.values()
+        ):
+            return ""
+
+        return """
+namespace {
+
+inline uint64_t compact_zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t compact_unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline size_t compact_varint_size(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+inline void compact_write_varint(uint8_t* dst, size_t& offset, uint64_t value) {
+  while (value >= 0x80) {
+    dst[offset++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  dst[offset++] = static_cast<uint8_t>(value);
+}
+
+inline uint64_t compact_read_varint(const uint8_t* src, size_t size, size_t& offset) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (offset >= size) {
+      throw std::out_of_range("Truncated varint");
+    }
+    uint8_t byte = src[offset++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::invalid_argument("Malformed varint");
+}
+
+} // namespace
+"""
+
     def _generate_entry_struct(self, fmt):
         template = """
 %%PACKCODE%%
@@ -162,18 +658,268 @@ uint8_t peek_type(const void* src, size_t len) {
 
         pack_code = self._generate_pack_code(fmt)
         unpack_code = self._generate_unpack_code(fmt)
-        calcsize_code = self._generate_calcsize_code(fmt)
+        if fixed_size(fmt) is not None:
+            # pack() and calculateSize() are inline in the header.
+            calcsize_code = "constexpr size_t %s::kSerializedSize;\n" % fmt.typename
+        else:
+            calcsize_code = self._generate_calcsize_code(fmt)
 
         template = template.replace("%%PACKCODE%%", pack_code)
         template = template.replace("%%UNPACKCODE%%", unpack_code)
         template = template.replace("%%CALCULATESIZECODE%%", calcsize_code)
 
+        if fmt.compact:
+            template += "\n" + self._generate_compact_code(fmt)
+        if fmt.shared_prefix:
+            template += "\n" + self._generate_shared_prefix_code(fmt)
+
+        return template
+
+    @staticmethod
+    def _presence_bytes(fmt):
+        return (len(fmt.fields) + 7) // 8
+
+    def _generate_compact_code(self, fmt):
+        template = """
+/* No alignment requirement. */
+void %%TYPENAME%%::packCompact(const %%TYPENAME%%& entry, void* dst, size_t size) {
+  if (size < %%TYPENAME%%::calculateCompactSize(entry)) {
+      throw std::out_of_range("Cannot fit %%TYPENAME%% in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  *dst_byte = kCompactSerializationType;
+  uint8_t* presence = dst_byte + 1;
+  std::memset(presence, 0, %%PRESENCE_BYTES%%);
+  size_t offset = 1 + %%PRESENCE_BYTES%%;
+  uint64_t value;
+%%PACK_FIELDS%%
+}
+
+/* No alignment requirement. */
+size_t %%TYPENAME%%::unpackCompact(%%TYPENAME%%& entry, const void* src, size_t size) {
+  if (src == nullptr) {
+      throw std::invalid_argument("src == nullptr");
+  }
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (size < 1 + %%PRESENCE_BYTES%% || *src_byte != kCompactSerializationType) {
+      throw std::invalid_argument("Serialization type is incorrect");
+  }
+  const uint8_t* presence = src_byte + 1;
+  size_t offset = 1 + %%PRESENCE_BYTES%%;
+  uint64_t value;
+%%UNPACK_FIELDS%%
+  return offset;
+}
+
+size_t %%TYPENAME%%::calculateCompactSize(%%TYPENAME%% const& entry) {
+  size_t offset = 1 /*serialization format*/ + %%PRESENCE_BYTES%%;
+  uint64_t value;
+%%SIZE_FIELDS%%
+  return offset;
+}
+""".lstrip()
+
+        pack_fields = []
+        unpack_fields = []
+        size_fields = []
+        for idx, (name, ftype) in enumerate(fmt.fields):
+            converter = TypeConverter.get(ftype)
+            encode = converter.generate_compact_encode_expression(
+                "entry.{name}".format(name=name)
+            )
+            bit = "presence[{byte}] & 0x{mask:02x}".format(
+                byte=idx // 8, mask=1 << (idx % 8)
+            )
+
+            pack_fields.append(
+                """
+value = {encode};
+if (value != 0) {{
+  presence[{byte}] |= 0x{mask:02x};
+  compact_write_varint(dst_byte, offset, value);
+}}""".format(
+                    encode=encode, byte=idx // 8, mask=1 << (idx % 8)
+                )
+            )
+
+            unpack_fields.append(
+                """
+value = ({bit}) ? compact_read_varint(src_byte, size, offset) : 0;
+{decode}""".format(
+                    bit=bit,
+                    decode=converter.generate_compact_decode_code(
+                        "value", "entry.{name}".format(name=name)
+                    ),
+                )
+            )
+
+            size_fields.append(
+                """
+value = {encode};
+if (value != 0) {{
+  offset += compact_varint_size(value);
+}}""".format(
+                    encode=encode
+                )
+            )
+
+        template = template.replace("%%PACK_FIELDS%%", Codegen.indent("".join(pack_fields)))
+        template = template.replace(
+            "%%UNPACK_FIELDS%%", Codegen.indent("".join(unpack_fields))
+        )
+        template = template.replace("%%SIZE_FIELDS%%", Codegen.indent("".join(size_fields)))
+        template = template.replace("%%PRESENCE_BYTES%%", str(self._presence_bytes(fmt)))
+        template = template.replace("%%TYPENAME%%", fmt.typename)
+        return template
+
+    def _generate_shared_prefix_code(self, fmt):
+        template = """
+const uint8_t %%TYPENAME%%::kPrefixSerializationType;
+
+/* No alignment requirement. */
+void %%TYPENAME%%::packPrefix(
+    const %%TYPENAME%%& entry,
+    int32_t base,
+    uint16_t shared,
+    void* dst,
+    size_t size) {
+  if (size < %%TYPENAME%%::calculatePrefixSize(entry, base, shared)) {
+      throw std::out_of_range("Cannot fit %%TYPENAME%% in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  *dst_byte = kPrefixSerializationType;
+  size_t offset = 1;
+  uint16_t count = entry.%%ARRAY%%.size - shared;
+  compact_write_varint(dst_byte, offset, count);
+  compact_write_varint(dst_byte, offset, compact_zigzag(base));
+  compact_write_varint(dst_byte, offset, shared);
+%%PACK_FIELDS%%
+  int64_t previous = 0;
+  for (uint16_t idx = 0; idx < count; ++idx) {
+    int64_t value = entry.%%ARRAY%%.values[idx];
+    compact_write_varint(dst_byte, offset, compact_zigzag(static_cast<int64_t>(
+        static_cast<uint64_t>(value) - static_cast<uint64_t>(previous))));
+    previous = value;
+  }
+}
+
+size_t %%TYPENAME%%::calculatePrefixSize(
+    const %%TYPENAME%%& entry,
+    int32_t base,
+    uint16_t shared) {
+  if (shared > entry.%%ARRAY%%.size) {
+      throw std::out_of_range("shared > %%ARRAY%%.size");
+  }
+  uint16_t count = entry.%%ARRAY%%.size - shared;
+  size_t offset = 1 /*serialization format*/;
+  offset += compact_varint_size(count);
+  offset += compact_varint_size(compact_zigzag(base));
+  offset += compact_varint_size(shared);
+%%SIZE_FIELDS%%
+  int64_t previous = 0;
+  for (uint16_t idx = 0; idx < count; ++idx) {
+    int64_t value = entry.%%ARRAY%%.values[idx];
+    offset += compact_varint_size(compact_zigzag(static_cast<int64_t>(
+        static_cast<uint64_t>(value) - static_cast<uint64_t>(previous))));
+    previous = value;
+  }
+  return offset;
+}
+
+uint16_t %%TYPENAME%%::peekPrefixCount(const void* src, size_t size) {
+  if (src == nullptr) {
+      throw std::invalid_argument("src == nullptr");
+  }
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (size < 1 || *src_byte != kPrefixSerializationType) {
+      throw std::invalid_argument("Serialization type is incorrect");
+  }
+  size_t offset = 1;
+  uint64_t count = compact_read_varint(src_byte, size, offset);
+  // Every value takes at least a byte.
+  if (count > size - offset || count > 0xffff) {
+      throw std::out_of_range("Truncated %%TYPENAME%%");
+  }
+  return static_cast<uint16_t>(count);
+}
+
+/* No alignment requirement. */
+void %%TYPENAME%%::unpackPrefix(
+    %%TYPENAME%%& entry,
+    int32_t& base,
+    uint16_t& shared,
+    %%VALUE_TYPE%%* values,
+    const void* src,
+    size_t size) {
+  uint16_t count = peekPrefixCount(src, size);
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  size_t offset = 1;
+  compact_read_varint(src_byte, size, offset);
+  base = static_cast<int32_t>(
+      compact_unzigzag(compact_read_varint(src_byte, size, offset)));
+  shared = static_cast<uint16_t>(compact_read_varint(src_byte, size, offset));
+  uint64_t value;
+%%UNPACK_FIELDS%%
+  int64_t previous = 0;
+  for (uint16_t idx = 0; idx < count; ++idx) {
+    previous = static_cast<int64_t>(
+        static_cast<uint64_t>(previous) +
+        static_cast<uint64_t>(
+            compact_unzigzag(compact_read_varint(src_byte, size, offset))));
+    values[idx] = static_cast<%%VALUE_TYPE%%>(previous);
+  }
+  entry.%%ARRAY%%.values = values;
+  entry.%%ARRAY%%.size = count;
+}
+""".lstrip()
+
+        array_name, array_type = shared_prefix_array(fmt)
+        pack_fields = []
+        unpack_fields = []
+        size_fields = []
+        for name, ftype in fmt.fields[:-1]:
+            converter = TypeConverter.get(ftype)
+            encode = converter.generate_compact_encode_expression(
+                "entry.{name}".format(name=name)
+            )
+            pack_fields.append(
+                "compact_write_varint(dst_byte, offset, {});".format(encode)
+            )
+            size_fields.append("offset += compact_varint_size({});".format(encode))
+            unpack_fields.append(
+                "value = compact_read_varint(src_byte, size, offset);\n"
+                + converter.generate_compact_decode_code(
+                    "value", "entry.{name}".format(name=name)
+                )
+            )
+
+        template = template.replace(
+            "%%PACK_FIELDS%%", Codegen.indent("\n".join(pack_fields))
+        )
+        template = template.replace(
+            "%%SIZE_FIELDS%%", Codegen.indent("\n".join(size_fields))
+        )
+        template = template.replace(
+            "%%UNPACK_FIELDS%%", Codegen.indent("\n".join(unpack_fields))
+        )
+        template = template.replace("%%ARRAY%%", array_name)
+        template = template.replace(
+            "%%VALUE_TYPE%%",
+            TypeConverter.get(array_type.member_type).map_type(),
+        )
+        template = template.replace("%%TYPENAME%%", fmt.typename)
         return template
 
     def _generate_pack_code(self, fmt):
         template = """
 /* Alignment requirement: dst must be 4-byte aligned. */
-void %%TYPENAME%%::pack(const %%TYPENAME%%& entry, void* dst, size_t size) {
+void %%TYPENAME%%::%%PACK_NAME%%(const %%TYPENAME%%& entry, void* dst, size_t size) {
   if (size < %%TYPENAME%%::calculateSize(entry)) {
       throw std::out_of_range("Cannot fit %%TYPENAME%% in destination");
   }
@@ -207,6 +953,8 @@ void %%TYPENAME%%::pack(const %%TYPENAME%%& entry, void* dst, size_t size) {
         memcopies = "\n".join(memcopies)
         memcopies = Codegen.indent(memcopies)
 
+        pack_name = "pack" if fixed_size(fmt) is None else "packFieldwise"
+        template = template.replace("%%PACK_NAME%%", pack_name)
         template = template.replace("%%TYPENAME%%", fmt.typename)
         template = template.replace("%%MEMCOPIES%%", memcopies)
         return template
@@ -219,7 +967,7 @@ void %%TYPENAME%%::unpack(%%TYPENAME%%& entry, const void* src, size_t size) {
       throw std::invalid_argument("src == nullptr");
   }
   const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
-  if (*src_byte != kSerializationType) {
+%%COMPACT_DISPATCH%%  if (*src_byte != kSerializationType) {
       throw std::invalid_argument("Serialization type is incorrect");
   }
   size_t offset = 1;
@@ -227,6 +975,15 @@ void %%TYPENAME%%::unpack(%%TYPENAME%%& entry, const void* src, size_t size) {
 }
 """.lstrip()
 
+        compact_dispatch = ""
+        if fmt.compact:
+            compact_dispatch = """  if (*src_byte == kCompactSerializationType) {
+      unpackCompact(entry, src, size);
+      return;
+  }
+"""
+        template = template.replace("%%COMPACT_DISPATCH%%", compact_dispatch)
+
         memcopies = []
         for name, ftype in fmt.fields:
             memcpy = TypeConverter.get(ftype).generate_unpack_code(
@@ -266,3 +1023,11 @@ size_t %%TYPENAME%%::calculateSize(%%TYPENAME%% const& entry) {
         template = template.replace("%%TYPENAME%%", fmt.typename)
         template = template.replace("%%EXPRESSIONS%%", expressions)
         return template
+
+
+def uses_key_value_lists(formats):
+    return any(
+        isinstance(ftype, KeyValueListType)
+        for fmt in formats
+        for _, ftype in fmt.fields
+    )
@@ -16,7 +16,7 @@ limitations under the License.
 
 from __future__ import absolute_import, division, print_function, unicode_literals
 
-from ..codegen import Codegen, SIGNED_SOURCE
+from ..codegen import Codegen, EntryDescription, SIGNED_SOURCE
 
 
 class CppEntryTypesCodegen(Codegen):
@@ -44,6 +44,10 @@ namespace entries {
 %%ENTRIES_ENUM%%
 
 const char* to_string(EntryType type);
+
+// Whether entries of this type go to the high priority ring of tiered
+// buffers.
+bool is_high_priority(EntryType type);
 } // namespace entries
 } // namespace profilo
 } // namespace facebook
@@ -90,12 +94,16 @@ namespace profilo {
 namespace entries {
 
 %%TO_STRING%%
+%%IS_HIGH_PRIORITY%%
 } // namespace entries
 } // namespace profilo
 } // namespace facebook
 """.lstrip()
 
         template = template.replace("%%TO_STRING%%", self._generate_to_string())
+        template = template.replace(
+            "%%IS_HIGH_PRIORITY%%", self._generate_is_high_priority()
+        )
         template = template.replace("%%SIGNED_SOURCE%%", SIGNED_SOURCE)
         return template
 
@@ -120,3 +128,28 @@ const char* to_string(EntryType type) {
 
         template = template.replace("%%CASES%%", cases)
         return template
+
+    def _generate_is_high_priority(self):
+        template = """
+bool is_high_priority(EntryType type) {
+  switch(type) {
+%%CASES%%
+      return true;
+    default:
+      return false;
+  }
+}
+""".lstrip()
+
+        cases = [
+            "case EntryType::{0.name}:".format(x)
+            for x in self.entries
+            if x.tier == EntryDescription.TIER_HIGH
+        ]
+        cases = "\n".join(cases)
+
+        cases = Codegen.indent(cases)
+        cases = Codegen.indent(cases)
+
+        template = template.replace("%%CASES%%", cases)
+        return template
@@ -17,6 +17,8 @@ limitations under the License.
 from __future__ import absolute_import, division, print_function, unicode_literals
 
 from ..codegen import Codegen, SIGNED_SOURCE
+from .entry_structs import shared_prefix_array
+from .type_converter import TypeConverter
 
 
 class CppParserCodegen(Codegen):
@@ -82,6 +84,20 @@ public:
             template.replace("%%TYPE%%", x) for x in list(self.unique_types.keys())
         ]
 
+        prefix_template = """
+// A %%TYPE%% in its shared-prefix encoding (see
+// %%TYPE%%::packPrefix()), which only has the values that aren't shared
+// with entry `base`. Visitors that keep track of earlier entries expand it
+// and visit() the result. Ignored by default.
+virtual void
+visitPrefix(const %%TYPE%%& /*entry*/, int32_t /*base*/, uint16_t /*shared*/) {}
+""".rstrip()
+        methods += [
+            prefix_template.replace("%%TYPE%%", x.typename)
+            for x in list(self.unique_types.values())
+            if x.shared_prefix
+        ]
+
         return "\n".join(methods)
 
     def _generate_parse_method(self):
@@ -103,12 +119,55 @@ case %%ID%%: {
   break;
 }
 """.lstrip()
+        compact_case_template = """
+case %%ID%%: {
+  // Compact entries may be packed back to back.
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  size_t offset = 0;
+  while (offset < size) {
+    %%TYPE%% data;
+    offset += %%TYPE%%::unpackCompact(data, src_byte + offset, size - offset);
+    visitor.visit(data);
+  }
+  break;
+}
+""".lstrip()
+
         cases = [
             case_template.replace("%%ID%%", str(x.type_id)).replace(
                 "%%TYPE%%", x.typename
             )
             for x in list(self.unique_types.values())
         ]
+        cases += [
+            compact_case_template.replace("%%ID%%", str(x.compact_type_id)).replace(
+                "%%TYPE%%", x.typename
+            )
+            for x in list(self.unique_types.values())
+            if x.compact
+        ]
+        prefix_case_template = """
+case %%ID%%: {
+  %%TYPE%% data;
+  int32_t base;
+  uint16_t shared;
+  // Plus one, arrays can't be empty.
+  %%VALUE_TYPE%% values[%%TYPE%%::peekPrefixCount(src, size) + 1];
+  %%TYPE%%::unpackPrefix(data, base, shared, values, src, size);
+  visitor.visitPrefix(data, base, shared);
+  break;
+}
+""".lstrip()
+        cases += [
+            prefix_case_template.replace("%%ID%%", str(x.shared_prefix_type_id))
+            .replace("%%TYPE%%", x.typename)
+            .replace(
+                "%%VALUE_TYPE%%",
+                TypeConverter.get(shared_prefix_array(x)[1].member_type).map_type(),
+            )
+            for x in list(self.unique_types.values())
+            if x.shared_prefix
+        ]
         cases = "\n".join(cases)
         cases = Codegen.indent(cases)
         cases = Codegen.indent(cases)
@@ -25,6 +25,7 @@ from ..types import (
     DynamicArrayType,
     EntryTypeEnum,
     IntegerType,
+    KeyValueListType,
     PointerType,
 )
 
@@ -45,6 +46,31 @@ class CppTypeConverter(object, metaclass=abc.ABCMeta):
     def generate_unpack_code(self, from_expression, to_expression, offset_expression):
         pass
 
+    @abc.abstractmethod
+    def generate_sink_pack_code(self, from_expression, sink_expression, offset_expr):
+        pass
+
+    def generate_layout_declaration(self, name):
+        """
+        Returns the declaration of the field in the packed wire layout of a
+        fixed-size format, see CppEntryStructsCodegen.
+        """
+        raise RuntimeError(
+            "{} is not supported in fixed layouts".format(
+                self.abstract_type.__class__.__name__
+            )
+        )
+
+    def generate_layout_code(self, from_expression, to_expression):
+        """
+        Returns a statement copying the field into its wire layout member.
+        """
+        raise RuntimeError(
+            "{} is not supported in fixed layouts".format(
+                self.abstract_type.__class__.__name__
+            )
+        )
+
     def generate_runtime_size_code(
         self,
         entry_expression,
@@ -57,6 +83,27 @@ class CppTypeConverter(object, metaclass=abc.ABCMeta):
             offset=offset_expression,
         )
 
+    def generate_compact_encode_expression(self, from_expression):
+        """
+        Returns an expression converting the field to the uint64_t that gets
+        varint-encoded in the compact format. Zero must map to zero.
+        """
+        raise RuntimeError(
+            "{} is not supported in compact formats".format(
+                self.abstract_type.__class__.__name__
+            )
+        )
+
+    def generate_compact_decode_code(self, value_expression, to_expression):
+        """
+        Returns a statement assigning the decoded uint64_t back to the field.
+        """
+        raise RuntimeError(
+            "{} is not supported in compact formats".format(
+                self.abstract_type.__class__.__name__
+            )
+        )
+
 
 class PrimitiveTypeConverter(CppTypeConverter, metaclass=abc.ABCMeta):
     def generate_pack_code(self, from_expression, to_expression, offset_expr):
@@ -79,6 +126,25 @@ std::memcpy(&({to}), ({from_}) + {offset}, sizeof(({to})));
             offset=offset_expr,
         )
 
+    def generate_sink_pack_code(self, from_expression, sink_expression, offset_expr):
+        return """
+{sink}.write(&({from_}), sizeof(({from_})));
+{offset} += sizeof(({from_}));
+""".format(
+            from_=from_expression,
+            sink=sink_expression,
+            offset=offset_expr,
+        )
+
+    def generate_layout_declaration(self, name):
+        return self.generate_declaration(name)
+
+    def generate_layout_code(self, from_expression, to_expression):
+        return "std::memcpy(&({to}), &({from_}), sizeof(({to})));".format(
+            from_=from_expression,
+            to=to_expression,
+        )
+
 
 class IntegerTypeConverter(PrimitiveTypeConverter):
     def __init__(self, abstract_type):
@@ -105,6 +171,33 @@ class IntegerTypeConverter(PrimitiveTypeConverter):
             bits=bits,
         )
 
+    def generate_layout_code(self, from_expression, to_expression):
+        return "{to} = {from_};".format(
+            from_=from_expression,
+            to=to_expression,
+        )
+
+    def generate_compact_encode_expression(self, from_expression):
+        if self.abstract_type.signed:
+            # zigzag, so that small negative values stay short
+            return "compact_zigzag(static_cast<int64_t>({from_}))".format(
+                from_=from_expression,
+            )
+        return "static_cast<uint64_t>({from_})".format(from_=from_expression)
+
+    def generate_compact_decode_code(self, value_expression, to_expression):
+        if self.abstract_type.signed:
+            return "{to} = static_cast<{type}>(compact_unzigzag({value}));".format(
+                to=to_expression,
+                type=self.map_type(),
+                value=value_expression,
+            )
+        return "{to} = static_cast<{type}>({value});".format(
+            to=to_expression,
+            type=self.map_type(),
+            value=value_expression,
+        )
+
 
 class EntryTypeEnumConverter(IntegerTypeConverter):
     def __init__(self, abstract_type):
@@ -131,6 +224,32 @@ std::memcpy(({to}) + {offset}, &({from_tmp}), sizeof(({from_tmp})));
             offset=offset_expr,
         )
 
+    def generate_sink_pack_code(self, from_expression, sink_expression, offset_expr):
+        return """
+{int_type} {from_tmp} = static_cast<{int_type}>({from_});
+{sink}.write(&({from_tmp}), sizeof(({from_tmp})));
+{offset} += sizeof(({from_tmp}));
+""".format(
+            int_type=self.map_type(),
+            from_tmp=from_expression.replace(".", "_") + "_tmp",
+            from_=from_expression,
+            sink=sink_expression,
+            offset=offset_expr,
+        )
+
+    def generate_layout_declaration(self, name):
+        return "{type} {name};".format(
+            type=self.map_type(),
+            name=name,
+        )
+
+    def generate_layout_code(self, from_expression, to_expression):
+        return "{to} = static_cast<{int_type}>({from_});".format(
+            int_type=self.map_type(),
+            from_=from_expression,
+            to=to_expression,
+        )
+
     def generate_unpack_code(self, from_expression, to_expression, offset_expr):
         return """
 {int_type} {to_tmp};
@@ -145,6 +264,18 @@ std::memcpy(&({to_tmp}), ({from_}) + {offset}, sizeof(({to_tmp})));
             offset=offset_expr,
         )
 
+    def generate_compact_encode_expression(self, from_expression):
+        return "static_cast<uint64_t>(static_cast<{int_type}>({from_}))".format(
+            int_type=self.map_type(),
+            from_=from_expression,
+        )
+
+    def generate_compact_decode_code(self, value_expression, to_expression):
+        return "{to} = static_cast<EntryType>({value});".format(
+            to=to_expression,
+            value=value_expression,
+        )
+
 
 class ArrayTypeConverter(PrimitiveTypeConverter):
     def __init__(self, abstract_type):
@@ -198,6 +329,11 @@ class PointerTypeConverter(CppTypeConverter):
             "Cannot generate unpacking code for PointerType, use in DynamicArrayType"
         )
 
+    def generate_sink_pack_code(self, *args):
+        raise RuntimeError(
+            "Cannot generate packing code for PointerType, use in DynamicArrayType"
+        )
+
     def generate_runtime_size_code(self, *args):
         raise RuntimeError(
             "Cannot generate runtime size code for PointerType, use in DynamicArrayType"
@@ -239,6 +375,10 @@ class CompoundTypeConverter(CppTypeConverter):
     def generate_unpack_code(self, from_expression, to_expression, offset_expr):
         pass
 
+    @abc.abstractmethod
+    def generate_sink_pack_code(self, from_expression, sink_expression, offset_expr):
+        pass
+
 
 class DynamicArrayTypeConverter(CompoundTypeConverter):
     def __init__(self, abstract_type):
@@ -269,6 +409,28 @@ std::memcpy(
             size_field=DynamicArrayType.MEMBER_SIZE,
         )
 
+    def generate_sink_pack_code(self, from_expression, sink_expression, offset_expr):
+        template = """
+{sink}.write(&({from_}.{size_field}), sizeof({from_}.{size_field}));
+{offset} += sizeof({from_}.{size_field});
+
+auto _{values_field}_size = ({from_}.{size_field}) *
+    sizeof(*{from_}.{values_field});
+// Must align target on a 4-byte boundary, like pack() does.
+auto _{values_field}_offset = ({offset} + 0x03) & ~0x03;
+{sink}.pad(_{values_field}_offset - {offset});
+{offset} = _{values_field}_offset;
+{sink}.write({from_}.{values_field}, _{values_field}_size);
+{offset} += _{values_field}_size;
+"""
+        return template.format(
+            from_=from_expression,
+            sink=sink_expression,
+            offset=offset_expr,
+            values_field=DynamicArrayType.MEMBER_VALUES,
+            size_field=DynamicArrayType.MEMBER_SIZE,
+        )
+
     def generate_unpack_code(self, from_expression, to_expression, offset_expr):
         template = """
 auto _{size_field}_size = sizeof({to}.{size_field});
@@ -319,6 +481,7 @@ std::memcpy(&({to}).{size_field}, ({from_} + {offset}), (_{size_field}_size));
 CONVERTERS = {
     ArrayType: ArrayTypeConverter,
     DynamicArrayType: DynamicArrayTypeConverter,
+    KeyValueListType: DynamicArrayTypeConverter,
     IntegerType: IntegerTypeConverter,
     PointerType: PointerTypeConverter,
     EntryTypeEnum: EntryTypeEnumConverter,
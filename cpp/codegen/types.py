@@ -92,6 +92,16 @@ class DynamicArrayType(CompoundType):
         self.member_type = member_type
 
 
+class KeyValueListType(DynamicArrayType):
+    """
+    Typed key/value pairs. Carried in their packed form (see the generated
+    KeyValue and KeyValueReader), so in memory this is a byte array.
+    """
+
+    def __init__(self):
+        super(KeyValueListType, self).__init__(Types.uint8)
+
+
 class Types(object, metaclass=abc.ABCMeta):
     int8 = IntegerType(size=1, signed=True)
     int16 = IntegerType(size=2, signed=True)
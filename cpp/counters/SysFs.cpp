@@ -32,19 +32,6 @@ namespace {
 
 static constexpr int kMaxSysPathLength = 64;
 
-std::string getCpuStatFilePath(int cpu, std::string path_format) {
-  char freqStatPath[kMaxSysPathLength]{0};
-  int bytesWritten =
-      snprintf(freqStatPath, kMaxSysPathLength, path_format.c_str(), cpu);
-
-  if (bytesWritten < 0 || bytesWritten >= kMaxSysPathLength) {
-    throw std::system_error(
-        errno, std::system_category(), "Could not format file path");
-  }
-
-  return std::string(freqStatPath);
-}
-
 std::string getScalingCurrentCpuFrequencyPath(int cpu) {
   return getCpuStatFilePath(
       cpu, "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq");
@@ -66,23 +53,44 @@ long readScalingCurrentFrequency(int fd) {
 }
 
 long readMaxCpuFrequency(int cpu) {
-  int fd = open(getMaxCpuFrequencyPath(cpu).c_str(), O_RDONLY);
+  auto frequency = readSysFsValue(getMaxCpuFrequencyPath(cpu));
+  if (frequency < 0) {
+    throw std::runtime_error("Cannot read max frequency");
+  }
+  return frequency;
+}
+
+} // namespace
+
+std::string getCpuStatFilePath(int cpu, std::string path_format) {
+  char freqStatPath[kMaxSysPathLength]{0};
+  int bytesWritten =
+      snprintf(freqStatPath, kMaxSysPathLength, path_format.c_str(), cpu);
+
+  if (bytesWritten < 0 || bytesWritten >= kMaxSysPathLength) {
+    throw std::system_error(
+        errno, std::system_category(), "Could not format file path");
+  }
+
+  return std::string(freqStatPath);
+}
+
+long readSysFsValue(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
   if (fd == -1) {
-    throw std::runtime_error("Cannot open max frequency stat file");
+    return -1;
   }
 
   char buffer[16]{};
   int bytes_read = read(fd, buffer, (sizeof(buffer) - 1));
   close(fd);
-  if (bytes_read < 0) {
-    throw std::runtime_error("Cannot read max frequency");
+  if (bytes_read <= 0) {
+    return -1;
   }
 
   return strtol(buffer, nullptr, 10);
 }
 
-} // namespace
-
 CpuCurrentFrequencyStatFile::CpuCurrentFrequencyStatFile(int cpu)
     : BaseStatFile(getScalingCurrentCpuFrequencyPath(cpu)) {}
 
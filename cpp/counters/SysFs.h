@@ -20,6 +20,7 @@
 
 #include <map>
 #include <memory>
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -29,6 +30,12 @@ namespace counters {
 
 typedef int64_t CpuFrequency;
 
+// Formats a per-CPU sysfs path, `path_format` takes the CPU as a %d.
+std::string getCpuStatFilePath(int cpu, std::string path_format);
+
+// Reads a small non-negative integer from a sysfs file, -1 on failure.
+long readSysFsValue(const std::string& path);
+
 class CpuCurrentFrequencyStatFile : public BaseStatFile<CpuFrequency> {
  public:
   explicit CpuCurrentFrequencyStatFile(int cpu);
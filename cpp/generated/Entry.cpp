@@ -1,4 +1,4 @@
-// @generated SignedSource<<dac133554c4c93a6470de853350a032e>>
+// @generated SignedSource<<73a24ad997870987599afbc7f27872c9>>
 
 #include <cstring>
 #include <stdexcept>
@@ -8,8 +8,196 @@ namespace facebook {
 namespace profilo {
 namespace entries {
 
+namespace {
+
+inline uint64_t compact_zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t compact_unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline size_t compact_varint_size(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+inline void compact_write_varint(uint8_t* dst, size_t& offset, uint64_t value) {
+  while (value >= 0x80) {
+    dst[offset++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  dst[offset++] = static_cast<uint8_t>(value);
+}
+
+inline uint64_t compact_read_varint(const uint8_t* src, size_t size, size_t& offset) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (offset >= size) {
+      throw std::out_of_range("Truncated varint");
+    }
+    uint8_t byte = src[offset++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::invalid_argument("Malformed varint");
+}
+
+} // namespace
+
+
+/*
+ * Packed pair: kind (1 byte), key size (2 bytes), key, then an 8 byte
+ * INT or DOUBLE value or a STRING's size (2 bytes) and bytes. Pairs follow
+ * each other without padding.
+ */
+
+KeyValue KeyValue::ofInt(const char* key, int64_t value) {
+  KeyValue pair{};
+  pair.kind = INT;
+  pair.key = key;
+  pair.keySize = static_cast<uint16_t>(std::strlen(key));
+  pair.intValue = value;
+  return pair;
+}
+
+KeyValue KeyValue::ofDouble(const char* key, double value) {
+  KeyValue pair{};
+  pair.kind = DOUBLE;
+  pair.key = key;
+  pair.keySize = static_cast<uint16_t>(std::strlen(key));
+  pair.doubleValue = value;
+  return pair;
+}
+
+KeyValue KeyValue::ofString(const char* key, const char* value) {
+  return ofString(key, value, std::strlen(value));
+}
+
+KeyValue KeyValue::ofString(const char* key, const char* value, size_t size) {
+  if (size > UINT16_MAX) {
+    throw std::out_of_range("String value is too long");
+  }
+  KeyValue pair{};
+  pair.kind = STRING;
+  pair.key = key;
+  pair.keySize = static_cast<uint16_t>(std::strlen(key));
+  pair.stringValue.values = value;
+  pair.stringValue.size = static_cast<uint16_t>(size);
+  return pair;
+}
+
+size_t KeyValue::calculateSize(const KeyValue* pairs, size_t count) {
+  size_t size = 0;
+  for (size_t idx = 0; idx < count; ++idx) {
+    auto& pair = pairs[idx];
+    size += sizeof(uint8_t) + sizeof(pair.keySize) + pair.keySize;
+    if (pair.kind == STRING) {
+      size += sizeof(pair.stringValue.size) + pair.stringValue.size;
+    } else {
+      size += sizeof(pair.intValue);
+    }
+  }
+  return size;
+}
+
+void KeyValue::pack(const KeyValue* pairs, size_t count, void* dst, size_t size) {
+  if (size < calculateSize(pairs, count)) {
+      throw std::out_of_range("Cannot fit KeyValue list in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  size_t offset = 0;
+  for (size_t idx = 0; idx < count; ++idx) {
+    auto& pair = pairs[idx];
+    dst_byte[offset++] = pair.kind;
+    std::memcpy(dst_byte + offset, &pair.keySize, sizeof(pair.keySize));
+    offset += sizeof(pair.keySize);
+    std::memcpy(dst_byte + offset, pair.key, pair.keySize);
+    offset += pair.keySize;
+    switch (pair.kind) {
+      case INT:
+        std::memcpy(dst_byte + offset, &pair.intValue, sizeof(pair.intValue));
+        offset += sizeof(pair.intValue);
+        break;
+      case DOUBLE:
+        std::memcpy(dst_byte + offset, &pair.doubleValue, sizeof(pair.doubleValue));
+        offset += sizeof(pair.doubleValue);
+        break;
+      case STRING:
+        std::memcpy(
+          dst_byte + offset,
+          &pair.stringValue.size,
+          sizeof(pair.stringValue.size));
+        offset += sizeof(pair.stringValue.size);
+        std::memcpy(dst_byte + offset, pair.stringValue.values, pair.stringValue.size);
+        offset += pair.stringValue.size;
+        break;
+      default:
+        throw std::invalid_argument("Unknown KeyValue kind");
+    }
+  }
+}
+
+KeyValueReader::KeyValueReader(const void* src, size_t size)
+    : src_(reinterpret_cast<const uint8_t*>(src)), size_(size), offset_(0) {}
+
+bool KeyValueReader::next(KeyValue& pair) {
+  if (offset_ >= size_) {
+    return false;
+  }
+  auto require = [this](size_t bytes) {
+    if (size_ - offset_ < bytes) {
+      throw std::out_of_range("Truncated KeyValue list");
+    }
+  };
+
+  require(sizeof(uint8_t) + sizeof(pair.keySize));
+  pair.kind = static_cast<KeyValue::Kind>(src_[offset_++]);
+  std::memcpy(&pair.keySize, src_ + offset_, sizeof(pair.keySize));
+  offset_ += sizeof(pair.keySize);
+  require(pair.keySize);
+  pair.key = reinterpret_cast<const char*>(src_ + offset_);
+  offset_ += pair.keySize;
+  switch (pair.kind) {
+    case KeyValue::INT:
+      require(sizeof(pair.intValue));
+      std::memcpy(&pair.intValue, src_ + offset_, sizeof(pair.intValue));
+      offset_ += sizeof(pair.intValue);
+      break;
+    case KeyValue::DOUBLE:
+      require(sizeof(pair.doubleValue));
+      std::memcpy(&pair.doubleValue, src_ + offset_, sizeof(pair.doubleValue));
+      offset_ += sizeof(pair.doubleValue);
+      break;
+    case KeyValue::STRING:
+      require(sizeof(pair.stringValue.size));
+      std::memcpy(
+        &pair.stringValue.size,
+        src_ + offset_,
+        sizeof(pair.stringValue.size));
+      offset_ += sizeof(pair.stringValue.size);
+      require(pair.stringValue.size);
+      pair.stringValue.values = reinterpret_cast<const char*>(src_ + offset_);
+      offset_ += pair.stringValue.size;
+      break;
+    default:
+      throw std::invalid_argument("Unknown KeyValue kind");
+  }
+  return true;
+}
+
 /* Alignment requirement: dst must be 4-byte aligned. */
-void StandardEntry::pack(const StandardEntry& entry, void* dst, size_t size) {
+void StandardEntry::packFieldwise(const StandardEntry& entry, void* dst, size_t size) {
   if (size < StandardEntry::calculateSize(entry)) {
       throw std::out_of_range("Cannot fit StandardEntry in destination");
   }
@@ -58,6 +246,10 @@ void StandardEntry::unpack(StandardEntry& entry, const void* src, size_t size) {
       throw std::invalid_argument("src == nullptr");
   }
   const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (*src_byte == kCompactSerializationType) {
+      unpackCompact(entry, src, size);
+      return;
+  }
   if (*src_byte != kSerializationType) {
       throw std::invalid_argument("Serialization type is incorrect");
   }
@@ -95,18 +287,125 @@ void StandardEntry::unpack(StandardEntry& entry, const void* src, size_t size) {
 }
 
 
-size_t StandardEntry::calculateSize(StandardEntry const& entry) {
-  size_t offset = 1 /*serialization format*/;
-  (offset) += sizeof(entry.id);
-  (offset) += sizeof(entry.type);
-  (offset) += sizeof(entry.timestamp);
-  (offset) += sizeof(entry.tid);
-  (offset) += sizeof(entry.callid);
-  (offset) += sizeof(entry.matchid);
-  (offset) += sizeof(entry.extra);
+constexpr size_t StandardEntry::kSerializedSize;
+
+
+/* No alignment requirement. */
+void StandardEntry::packCompact(const StandardEntry& entry, void* dst, size_t size) {
+  if (size < StandardEntry::calculateCompactSize(entry)) {
+      throw std::out_of_range("Cannot fit StandardEntry in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  *dst_byte = kCompactSerializationType;
+  uint8_t* presence = dst_byte + 1;
+  std::memset(presence, 0, 1);
+  size_t offset = 1 + 1;
+  uint64_t value;
+  
+  value = compact_zigzag(static_cast<int64_t>(entry.id));
+  if (value != 0) {
+    presence[0] |= 0x01;
+    compact_write_varint(dst_byte, offset, value);
+  }
+  value = static_cast<uint64_t>(static_cast<uint8_t>(entry.type));
+  if (value != 0) {
+    presence[0] |= 0x02;
+    compact_write_varint(dst_byte, offset, value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.timestamp));
+  if (value != 0) {
+    presence[0] |= 0x04;
+    compact_write_varint(dst_byte, offset, value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.tid));
+  if (value != 0) {
+    presence[0] |= 0x08;
+    compact_write_varint(dst_byte, offset, value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.callid));
+  if (value != 0) {
+    presence[0] |= 0x10;
+    compact_write_varint(dst_byte, offset, value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.matchid));
+  if (value != 0) {
+    presence[0] |= 0x20;
+    compact_write_varint(dst_byte, offset, value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.extra));
+  if (value != 0) {
+    presence[0] |= 0x40;
+    compact_write_varint(dst_byte, offset, value);
+  }
+}
+
+/* No alignment requirement. */
+size_t StandardEntry::unpackCompact(StandardEntry& entry, const void* src, size_t size) {
+  if (src == nullptr) {
+      throw std::invalid_argument("src == nullptr");
+  }
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (size < 1 + 1 || *src_byte != kCompactSerializationType) {
+      throw std::invalid_argument("Serialization type is incorrect");
+  }
+  const uint8_t* presence = src_byte + 1;
+  size_t offset = 1 + 1;
+  uint64_t value;
+  
+  value = (presence[0] & 0x01) ? compact_read_varint(src_byte, size, offset) : 0;
+  entry.id = static_cast<int32_t>(compact_unzigzag(value));
+  value = (presence[0] & 0x02) ? compact_read_varint(src_byte, size, offset) : 0;
+  entry.type = static_cast<EntryType>(value);
+  value = (presence[0] & 0x04) ? compact_read_varint(src_byte, size, offset) : 0;
+  entry.timestamp = static_cast<int64_t>(compact_unzigzag(value));
+  value = (presence[0] & 0x08) ? compact_read_varint(src_byte, size, offset) : 0;
+  entry.tid = static_cast<int32_t>(compact_unzigzag(value));
+  value = (presence[0] & 0x10) ? compact_read_varint(src_byte, size, offset) : 0;
+  entry.callid = static_cast<int32_t>(compact_unzigzag(value));
+  value = (presence[0] & 0x20) ? compact_read_varint(src_byte, size, offset) : 0;
+  entry.matchid = static_cast<int32_t>(compact_unzigzag(value));
+  value = (presence[0] & 0x40) ? compact_read_varint(src_byte, size, offset) : 0;
+  entry.extra = static_cast<int64_t>(compact_unzigzag(value));
   return offset;
 }
 
+size_t StandardEntry::calculateCompactSize(StandardEntry const& entry) {
+  size_t offset = 1 /*serialization format*/ + 1;
+  uint64_t value;
+  
+  value = compact_zigzag(static_cast<int64_t>(entry.id));
+  if (value != 0) {
+    offset += compact_varint_size(value);
+  }
+  value = static_cast<uint64_t>(static_cast<uint8_t>(entry.type));
+  if (value != 0) {
+    offset += compact_varint_size(value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.timestamp));
+  if (value != 0) {
+    offset += compact_varint_size(value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.tid));
+  if (value != 0) {
+    offset += compact_varint_size(value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.callid));
+  if (value != 0) {
+    offset += compact_varint_size(value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.matchid));
+  if (value != 0) {
+    offset += compact_varint_size(value);
+  }
+  value = compact_zigzag(static_cast<int64_t>(entry.extra));
+  if (value != 0) {
+    offset += compact_varint_size(value);
+  }
+  return offset;
+}
 
 /* Alignment requirement: dst must be 4-byte aligned. */
 void FramesEntry::pack(const FramesEntry& entry, void* dst, size_t size) {
@@ -225,6 +524,124 @@ size_t FramesEntry::calculateSize(FramesEntry const& entry) {
 }
 
 
+const uint8_t FramesEntry::kPrefixSerializationType;
+
+/* No alignment requirement. */
+void FramesEntry::packPrefix(
+    const FramesEntry& entry,
+    int32_t base,
+    uint16_t shared,
+    void* dst,
+    size_t size) {
+  if (size < FramesEntry::calculatePrefixSize(entry, base, shared)) {
+      throw std::out_of_range("Cannot fit FramesEntry in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  *dst_byte = kPrefixSerializationType;
+  size_t offset = 1;
+  uint16_t count = entry.frames.size - shared;
+  compact_write_varint(dst_byte, offset, count);
+  compact_write_varint(dst_byte, offset, compact_zigzag(base));
+  compact_write_varint(dst_byte, offset, shared);
+  compact_write_varint(dst_byte, offset, compact_zigzag(static_cast<int64_t>(entry.id)));
+  compact_write_varint(dst_byte, offset, static_cast<uint64_t>(static_cast<uint8_t>(entry.type)));
+  compact_write_varint(dst_byte, offset, compact_zigzag(static_cast<int64_t>(entry.timestamp)));
+  compact_write_varint(dst_byte, offset, compact_zigzag(static_cast<int64_t>(entry.tid)));
+  compact_write_varint(dst_byte, offset, compact_zigzag(static_cast<int64_t>(entry.matchid)));
+  int64_t previous = 0;
+  for (uint16_t idx = 0; idx < count; ++idx) {
+    int64_t value = entry.frames.values[idx];
+    compact_write_varint(dst_byte, offset, compact_zigzag(static_cast<int64_t>(
+        static_cast<uint64_t>(value) - static_cast<uint64_t>(previous))));
+    previous = value;
+  }
+}
+
+size_t FramesEntry::calculatePrefixSize(
+    const FramesEntry& entry,
+    int32_t base,
+    uint16_t shared) {
+  if (shared > entry.frames.size) {
+      throw std::out_of_range("shared > frames.size");
+  }
+  uint16_t count = entry.frames.size - shared;
+  size_t offset = 1 /*serialization format*/;
+  offset += compact_varint_size(count);
+  offset += compact_varint_size(compact_zigzag(base));
+  offset += compact_varint_size(shared);
+  offset += compact_varint_size(compact_zigzag(static_cast<int64_t>(entry.id)));
+  offset += compact_varint_size(static_cast<uint64_t>(static_cast<uint8_t>(entry.type)));
+  offset += compact_varint_size(compact_zigzag(static_cast<int64_t>(entry.timestamp)));
+  offset += compact_varint_size(compact_zigzag(static_cast<int64_t>(entry.tid)));
+  offset += compact_varint_size(compact_zigzag(static_cast<int64_t>(entry.matchid)));
+  int64_t previous = 0;
+  for (uint16_t idx = 0; idx < count; ++idx) {
+    int64_t value = entry.frames.values[idx];
+    offset += compact_varint_size(compact_zigzag(static_cast<int64_t>(
+        static_cast<uint64_t>(value) - static_cast<uint64_t>(previous))));
+    previous = value;
+  }
+  return offset;
+}
+
+uint16_t FramesEntry::peekPrefixCount(const void* src, size_t size) {
+  if (src == nullptr) {
+      throw std::invalid_argument("src == nullptr");
+  }
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (size < 1 || *src_byte != kPrefixSerializationType) {
+      throw std::invalid_argument("Serialization type is incorrect");
+  }
+  size_t offset = 1;
+  uint64_t count = compact_read_varint(src_byte, size, offset);
+  // Every value takes at least a byte.
+  if (count > size - offset || count > 0xffff) {
+      throw std::out_of_range("Truncated FramesEntry");
+  }
+  return static_cast<uint16_t>(count);
+}
+
+/* No alignment requirement. */
+void FramesEntry::unpackPrefix(
+    FramesEntry& entry,
+    int32_t& base,
+    uint16_t& shared,
+    int64_t* values,
+    const void* src,
+    size_t size) {
+  uint16_t count = peekPrefixCount(src, size);
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  size_t offset = 1;
+  compact_read_varint(src_byte, size, offset);
+  base = static_cast<int32_t>(
+      compact_unzigzag(compact_read_varint(src_byte, size, offset)));
+  shared = static_cast<uint16_t>(compact_read_varint(src_byte, size, offset));
+  uint64_t value;
+  value = compact_read_varint(src_byte, size, offset);
+  entry.id = static_cast<int32_t>(compact_unzigzag(value));
+  value = compact_read_varint(src_byte, size, offset);
+  entry.type = static_cast<EntryType>(value);
+  value = compact_read_varint(src_byte, size, offset);
+  entry.timestamp = static_cast<int64_t>(compact_unzigzag(value));
+  value = compact_read_varint(src_byte, size, offset);
+  entry.tid = static_cast<int32_t>(compact_unzigzag(value));
+  value = compact_read_varint(src_byte, size, offset);
+  entry.matchid = static_cast<int32_t>(compact_unzigzag(value));
+  int64_t previous = 0;
+  for (uint16_t idx = 0; idx < count; ++idx) {
+    previous = static_cast<int64_t>(
+        static_cast<uint64_t>(previous) +
+        static_cast<uint64_t>(
+            compact_unzigzag(compact_read_varint(src_byte, size, offset))));
+    values[idx] = static_cast<int64_t>(previous);
+  }
+  entry.frames.values = values;
+  entry.frames.size = count;
+}
+
 /* Alignment requirement: dst must be 4-byte aligned. */
 void BytesEntry::pack(const BytesEntry& entry, void* dst, size_t size) {
   if (size < BytesEntry::calculateSize(entry)) {
@@ -324,6 +741,123 @@ size_t BytesEntry::calculateSize(BytesEntry const& entry) {
 }
 
 
+/* Alignment requirement: dst must be 4-byte aligned. */
+void AnnotationEntry::pack(const AnnotationEntry& entry, void* dst, size_t size) {
+  if (size < AnnotationEntry::calculateSize(entry)) {
+      throw std::out_of_range("Cannot fit AnnotationEntry in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  *dst_byte = kSerializationType;
+  size_t offset = 1;
+
+  
+  std::memcpy((dst_byte) + offset, &(entry.id), sizeof((entry.id)));
+  offset += sizeof((entry.id));
+  
+  
+  uint8_t entry_type_tmp = static_cast<uint8_t>(entry.type);
+  std::memcpy((dst_byte) + offset, &(entry_type_tmp), sizeof((entry_type_tmp)));
+  offset += sizeof((entry_type_tmp));
+  
+  
+  std::memcpy((dst_byte) + offset, &(entry.timestamp), sizeof((entry.timestamp)));
+  offset += sizeof((entry.timestamp));
+  
+  
+  std::memcpy((dst_byte) + offset, &(entry.tid), sizeof((entry.tid)));
+  offset += sizeof((entry.tid));
+  
+  
+  std::memcpy((dst_byte) + offset, &(entry.matchid), sizeof((entry.matchid)));
+  offset += sizeof((entry.matchid));
+  
+  
+  auto _size_size = sizeof(entry.pairs.size);
+  std::memcpy((dst_byte + offset), &(entry.pairs.size), (_size_size));
+  offset += _size_size;
+  
+  auto _values_size = (entry.pairs.size) *
+      sizeof(*entry.pairs.values);
+  // Must align target on a 4-byte boundary. Assuming dst_byte is aligned.
+  offset = (offset + 0x03) & ~0x03;
+  std::memcpy(
+    (dst_byte + offset),
+    (entry.pairs.values),
+    _values_size
+  );
+  offset += _values_size;
+  
+}
+
+
+/* Alignment requirement: src must be 4-byte aligned. */
+void AnnotationEntry::unpack(AnnotationEntry& entry, const void* src, size_t size) {
+  if (src == nullptr) {
+      throw std::invalid_argument("src == nullptr");
+  }
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (*src_byte != kSerializationType) {
+      throw std::invalid_argument("Serialization type is incorrect");
+  }
+  size_t offset = 1;
+  
+  std::memcpy(&(entry.id), (src_byte) + offset, sizeof((entry.id)));
+  offset += sizeof((entry.id));
+  
+  
+  uint8_t entry_type_tmp;
+  std::memcpy(&(entry_type_tmp), (src_byte) + offset, sizeof((entry_type_tmp)));
+  offset += sizeof((entry_type_tmp));
+  entry.type = static_cast<EntryType>(entry_type_tmp);
+  
+  
+  std::memcpy(&(entry.timestamp), (src_byte) + offset, sizeof((entry.timestamp)));
+  offset += sizeof((entry.timestamp));
+  
+  
+  std::memcpy(&(entry.tid), (src_byte) + offset, sizeof((entry.tid)));
+  offset += sizeof((entry.tid));
+  
+  
+  std::memcpy(&(entry.matchid), (src_byte) + offset, sizeof((entry.matchid)));
+  offset += sizeof((entry.matchid));
+  
+  
+  auto _size_size = sizeof(entry.pairs.size);
+  std::memcpy(&(entry.pairs).size, (src_byte + offset), (_size_size));
+  offset += _size_size;
+  
+  // Must align values on a 4-byte boundary. Assuming src_byte is aligned.
+  offset = (offset + 0x03) & ~0x03;
+  
+  // Retains pointer to incoming data!
+  (entry.pairs).values = reinterpret_cast<decltype((entry.pairs).values)>(
+    (src_byte + offset)
+  );
+  offset += (entry.pairs).size * sizeof(*(entry.pairs).values);
+  
+}
+
+
+size_t AnnotationEntry::calculateSize(AnnotationEntry const& entry) {
+  size_t offset = 1 /*serialization format*/;
+  (offset) += sizeof(entry.id);
+  (offset) += sizeof(entry.type);
+  (offset) += sizeof(entry.timestamp);
+  (offset) += sizeof(entry.tid);
+  (offset) += sizeof(entry.matchid);
+  // Must align entry.pairs on a 4-byte boundary.
+  offset = (offset + 0x03) & ~0x03;
+  
+  offset += sizeof(entry.pairs.size) +
+    entry.pairs.size * sizeof(*entry.pairs.values);
+  return offset;
+}
+
+
 
 uint8_t peek_type(const void* src, size_t len) {
   const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
@@ -1,7 +1,8 @@
-// @generated SignedSource<<92e7f010a9d663922326eefa54f7b0e0>>
+// @generated SignedSource<<cc2054c4902f76f552b4a6417caaf5f5>>
 
 #include <cstdint>
 #include <cstring>
+#include <stdexcept>
 #include <type_traits>
 #include <unistd.h>
 #include <profilo/entries/EntryType.h>
@@ -12,10 +13,84 @@ namespace facebook {
 namespace profilo {
 namespace entries {
 
+//
+// One typed pair of a key/value list. Packing doesn't copy the strings, and
+// after unpacking they point into the packed entry. Neither the key nor
+// string values are NUL-terminated.
+//
+struct KeyValue {
+  enum Kind : uint8_t {
+    INT = 0,
+    DOUBLE = 1,
+    STRING = 2,
+  };
+
+  Kind kind;
+  const char* key;
+  uint16_t keySize;
+  union {
+    int64_t intValue;
+    double doubleValue;
+    struct {
+      const char* values;
+      uint16_t size;
+    } stringValue;
+  };
+
+  // key and string values must be NUL-terminated here.
+  static KeyValue ofInt(const char* key, int64_t value);
+  static KeyValue ofDouble(const char* key, double value);
+  static KeyValue ofString(const char* key, const char* value);
+  static KeyValue ofString(const char* key, const char* value, size_t size);
+
+  // Packed size of a list of `count` pairs.
+  static size_t calculateSize(const KeyValue* pairs, size_t count);
+  // No alignment requirement.
+  static void pack(const KeyValue* pairs, size_t count, void* dst, size_t size);
+};
+
+//
+// Reads the pairs of a packed key/value list in order.
+//
+class KeyValueReader {
+ public:
+  KeyValueReader(const void* src, size_t size);
+
+  // Returns false once all pairs have been read.
+  bool next(KeyValue& pair);
+
+ private:
+  const uint8_t* src_;
+  size_t size_;
+  size_t offset_;
+};
+
 struct __attribute__((packed)) StandardEntry {
 
   static const uint8_t kSerializationType = 1;
 
+  // Every field has a fixed size, so the entry is serialized by filling in
+  // a Layout and copying it as a whole, see pack().
+  static constexpr size_t kSerializedSize = 34;
+
+  struct __attribute__((packed)) Layout {
+    uint8_t serialization_type;
+    int32_t id;
+    uint8_t type;
+    int64_t timestamp;
+    int32_t tid;
+    int32_t callid;
+    int32_t matchid;
+    int64_t extra;
+  };
+  static_assert(
+      sizeof(Layout) == kSerializedSize,
+      "Layout doesn't match the serialized format");
+
+  static void toLayout(const StandardEntry& entry, Layout& layout);
+  // Field by field version of pack(), produces the same bytes.
+  static void packFieldwise(const StandardEntry& entry, void* dst, size_t size);
+
   int32_t id;
   EntryType type;
   int64_t timestamp;
@@ -27,9 +102,61 @@ struct __attribute__((packed)) StandardEntry {
   static void pack(const StandardEntry& entry, void* dst, size_t size);
   static void unpack(StandardEntry& entry, const void* src, size_t size);
 
-  static size_t calculateSize(StandardEntry const& entry);
+  // Writes the same bytes as pack() to a sink providing
+  // write(const void* src, size_t size) and pad(size_t size), e.g.
+  // logger::SlotWriter. The sink must accept calculateSize(entry) bytes.
+  template <class Sink>
+  static void pack(const StandardEntry& entry, Sink& sink);
+
+  static constexpr size_t calculateSize(StandardEntry const& /*entry*/) {
+    return kSerializedSize;
+  }
+
+  // Compact encoding: a presence bitmap followed by the non-zero fields as
+  // varints (zigzag for signed fields). Has no alignment requirements and
+  // consecutive entries can be packed back to back. unpack() accepts both
+  // encodings.
+  static const uint8_t kCompactSerializationType = 129;
+
+  static void packCompact(const StandardEntry& entry, void* dst, size_t size);
+  // Returns the number of bytes consumed from src.
+  static size_t unpackCompact(StandardEntry& entry, const void* src, size_t size);
+
+  static size_t calculateCompactSize(StandardEntry const& entry);
 };
 
+inline void StandardEntry::toLayout(const StandardEntry& entry, StandardEntry::Layout& layout) {
+  layout.serialization_type = kSerializationType;
+  layout.id = entry.id;
+  layout.type = static_cast<uint8_t>(entry.type);
+  layout.timestamp = entry.timestamp;
+  layout.tid = entry.tid;
+  layout.callid = entry.callid;
+  layout.matchid = entry.matchid;
+  layout.extra = entry.extra;
+}
+
+/* No alignment requirement. */
+inline void StandardEntry::pack(const StandardEntry& entry, void* dst, size_t size) {
+  if (size < kSerializedSize) {
+      throw std::out_of_range("Cannot fit StandardEntry in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  Layout layout;
+  toLayout(entry, layout);
+  std::memcpy(dst, &layout, sizeof(layout));
+}
+
+template <class Sink>
+void StandardEntry::pack(const StandardEntry& entry, Sink& sink) {
+  Layout layout;
+  toLayout(entry, layout);
+  sink.write(&layout, sizeof(layout));
+}
+
+
 struct __attribute__((packed)) FramesEntry {
 
   static const uint8_t kSerializationType = 2;
@@ -47,9 +174,93 @@ struct __attribute__((packed)) FramesEntry {
   static void pack(const FramesEntry& entry, void* dst, size_t size);
   static void unpack(FramesEntry& entry, const void* src, size_t size);
 
+  // Writes the same bytes as pack() to a sink providing
+  // write(const void* src, size_t size) and pad(size_t size), e.g.
+  // logger::SlotWriter. The sink must accept calculateSize(entry) bytes.
+  template <class Sink>
+  static void pack(const FramesEntry& entry, Sink& sink);
+
   static size_t calculateSize(FramesEntry const& entry);
+
+  // Shared-prefix encoding, for entries that mostly repeat the frames of
+  // an earlier entry, like consecutive stack samples of a thread (whose
+  // root frames are at the end of the array). Stores the ID of the earlier
+  // entry (`base`), how many values at the end of frames are the same as
+  // at the end of the base's, and the remaining values as zigzag varint
+  // deltas. The other fields are varints. Has no alignment requirements.
+  //
+  // Readers need the base to expand the entry, see
+  // EntryVisitor::visitPrefix().
+  static const uint8_t kPrefixSerializationType = 66;
+
+  // Leaves out the last `shared` values of entry.frames.
+  static void packPrefix(
+      const FramesEntry& entry,
+      int32_t base,
+      uint16_t shared,
+      void* dst,
+      size_t size);
+  static size_t calculatePrefixSize(
+      const FramesEntry& entry,
+      int32_t base,
+      uint16_t shared);
+
+  // Number of values unpackPrefix() decodes, at most `size`.
+  static uint16_t peekPrefixCount(const void* src, size_t size);
+  // entry.frames gets the values that aren't shared with the base, decoded
+  // into `values`, which must have room for peekPrefixCount() of them.
+  static void unpackPrefix(
+      FramesEntry& entry,
+      int32_t& base,
+      uint16_t& shared,
+      int64_t* values,
+      const void* src,
+      size_t size);
 };
 
+template <class Sink>
+void FramesEntry::pack(const FramesEntry& entry, Sink& sink) {
+  uint8_t serialization_type = kSerializationType;
+  sink.write(&serialization_type, sizeof(serialization_type));
+  size_t offset = 1;
+  
+  sink.write(&(entry.id), sizeof((entry.id)));
+  offset += sizeof((entry.id));
+  
+  
+  uint8_t entry_type_tmp = static_cast<uint8_t>(entry.type);
+  sink.write(&(entry_type_tmp), sizeof((entry_type_tmp)));
+  offset += sizeof((entry_type_tmp));
+  
+  
+  sink.write(&(entry.timestamp), sizeof((entry.timestamp)));
+  offset += sizeof((entry.timestamp));
+  
+  
+  sink.write(&(entry.tid), sizeof((entry.tid)));
+  offset += sizeof((entry.tid));
+  
+  
+  sink.write(&(entry.matchid), sizeof((entry.matchid)));
+  offset += sizeof((entry.matchid));
+  
+  
+  sink.write(&(entry.frames.size), sizeof(entry.frames.size));
+  offset += sizeof(entry.frames.size);
+  
+  auto _values_size = (entry.frames.size) *
+      sizeof(*entry.frames.values);
+  // Must align target on a 4-byte boundary, like pack() does.
+  auto _values_offset = (offset + 0x03) & ~0x03;
+  sink.pad(_values_offset - offset);
+  offset = _values_offset;
+  sink.write(entry.frames.values, _values_size);
+  offset += _values_size;
+  
+  (void)offset;
+}
+
+
 struct __attribute__((packed)) BytesEntry {
 
   static const uint8_t kSerializationType = 3;
@@ -65,9 +276,119 @@ struct __attribute__((packed)) BytesEntry {
   static void pack(const BytesEntry& entry, void* dst, size_t size);
   static void unpack(BytesEntry& entry, const void* src, size_t size);
 
+  // Writes the same bytes as pack() to a sink providing
+  // write(const void* src, size_t size) and pad(size_t size), e.g.
+  // logger::SlotWriter. The sink must accept calculateSize(entry) bytes.
+  template <class Sink>
+  static void pack(const BytesEntry& entry, Sink& sink);
+
   static size_t calculateSize(BytesEntry const& entry);
 };
 
+template <class Sink>
+void BytesEntry::pack(const BytesEntry& entry, Sink& sink) {
+  uint8_t serialization_type = kSerializationType;
+  sink.write(&serialization_type, sizeof(serialization_type));
+  size_t offset = 1;
+  
+  sink.write(&(entry.id), sizeof((entry.id)));
+  offset += sizeof((entry.id));
+  
+  
+  uint8_t entry_type_tmp = static_cast<uint8_t>(entry.type);
+  sink.write(&(entry_type_tmp), sizeof((entry_type_tmp)));
+  offset += sizeof((entry_type_tmp));
+  
+  
+  sink.write(&(entry.matchid), sizeof((entry.matchid)));
+  offset += sizeof((entry.matchid));
+  
+  
+  sink.write(&(entry.bytes.size), sizeof(entry.bytes.size));
+  offset += sizeof(entry.bytes.size);
+  
+  auto _values_size = (entry.bytes.size) *
+      sizeof(*entry.bytes.values);
+  // Must align target on a 4-byte boundary, like pack() does.
+  auto _values_offset = (offset + 0x03) & ~0x03;
+  sink.pad(_values_offset - offset);
+  offset = _values_offset;
+  sink.write(entry.bytes.values, _values_size);
+  offset += _values_size;
+  
+  (void)offset;
+}
+
+
+struct __attribute__((packed)) AnnotationEntry {
+
+  static const uint8_t kSerializationType = 4;
+
+  int32_t id;
+  EntryType type;
+  int64_t timestamp;
+  int32_t tid;
+  int32_t matchid;
+  struct {
+    const uint8_t* values;
+    uint16_t size;
+  } pairs;
+
+  static void pack(const AnnotationEntry& entry, void* dst, size_t size);
+  static void unpack(AnnotationEntry& entry, const void* src, size_t size);
+
+  // Writes the same bytes as pack() to a sink providing
+  // write(const void* src, size_t size) and pad(size_t size), e.g.
+  // logger::SlotWriter. The sink must accept calculateSize(entry) bytes.
+  template <class Sink>
+  static void pack(const AnnotationEntry& entry, Sink& sink);
+
+  static size_t calculateSize(AnnotationEntry const& entry);
+};
+
+template <class Sink>
+void AnnotationEntry::pack(const AnnotationEntry& entry, Sink& sink) {
+  uint8_t serialization_type = kSerializationType;
+  sink.write(&serialization_type, sizeof(serialization_type));
+  size_t offset = 1;
+  
+  sink.write(&(entry.id), sizeof((entry.id)));
+  offset += sizeof((entry.id));
+  
+  
+  uint8_t entry_type_tmp = static_cast<uint8_t>(entry.type);
+  sink.write(&(entry_type_tmp), sizeof((entry_type_tmp)));
+  offset += sizeof((entry_type_tmp));
+  
+  
+  sink.write(&(entry.timestamp), sizeof((entry.timestamp)));
+  offset += sizeof((entry.timestamp));
+  
+  
+  sink.write(&(entry.tid), sizeof((entry.tid)));
+  offset += sizeof((entry.tid));
+  
+  
+  sink.write(&(entry.matchid), sizeof((entry.matchid)));
+  offset += sizeof((entry.matchid));
+  
+  
+  sink.write(&(entry.pairs.size), sizeof(entry.pairs.size));
+  offset += sizeof(entry.pairs.size);
+  
+  auto _values_size = (entry.pairs.size) *
+      sizeof(*entry.pairs.values);
+  // Must align target on a 4-byte boundary, like pack() does.
+  auto _values_offset = (offset + 0x03) & ~0x03;
+  sink.pad(_values_offset - offset);
+  offset = _values_offset;
+  sink.write(entry.pairs.values, _values_size);
+  offset += _values_size;
+  
+  (void)offset;
+}
+
+
 
 uint8_t peek_type(const void* src, size_t len);
 
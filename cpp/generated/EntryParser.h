@@ -1,4 +1,4 @@
-// @generated SignedSource<<d642034c7e1830efd4a46871d51c5ac6>>
+// @generated SignedSource<<a803221faed64ff905abf05fbfb08f45>>
 
 #pragma once
 
@@ -22,6 +22,14 @@ public:
   virtual void visit(const StandardEntry& entry) = 0;
   virtual void visit(const FramesEntry& entry) = 0;
   virtual void visit(const BytesEntry& entry) = 0;
+  virtual void visit(const AnnotationEntry& entry) = 0;
+  
+  // A FramesEntry in its shared-prefix encoding (see
+  // FramesEntry::packPrefix()), which only has the values that aren't shared
+  // with entry `base`. Visitors that keep track of earlier entries expand it
+  // and visit() the result. Ignored by default.
+  virtual void
+  visitPrefix(const FramesEntry& /*entry*/, int32_t /*base*/, uint16_t /*shared*/) {}
 };
 
 class EntryParser {
@@ -51,6 +59,36 @@ public:
         break;
       }
       
+      case 4: {
+        AnnotationEntry data;
+        AnnotationEntry::unpack(data, src, size);
+        visitor.visit(data);
+        break;
+      }
+      
+      case 129: {
+        // Compact entries may be packed back to back.
+        const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+        size_t offset = 0;
+        while (offset < size) {
+          StandardEntry data;
+          offset += StandardEntry::unpackCompact(data, src_byte + offset, size - offset);
+          visitor.visit(data);
+        }
+        break;
+      }
+      
+      case 66: {
+        FramesEntry data;
+        int32_t base;
+        uint16_t shared;
+        // Plus one, arrays can't be empty.
+        int64_t values[FramesEntry::peekPrefixCount(src, size) + 1];
+        FramesEntry::unpackPrefix(data, base, shared, values, src, size);
+        visitor.visitPrefix(data, base, shared);
+        break;
+      }
+      
       default: throw std::invalid_argument("Unknown type in to_stream");
     }
   }
@@ -1,4 +1,4 @@
-// @generated SignedSource<<ddb15ac11ce4c74eb08b3ee312829017>>
+// @generated SignedSource<<09e9f02b1d0e2f11622f3c5d31ee1693>>
 
 #include <stdexcept>
 #include <profilo/entries/EntryType.h>
@@ -128,10 +128,33 @@ const char* to_string(EntryType type) {
     case EntryType::MEMORY_MAPPING_FAILURE: return "MEMORY_MAPPING_FAILURE";
     case EntryType::THREAD_NAMING: return "THREAD_NAMING";
     case EntryType::STKERR_INVALID_MAP: return "STKERR_INVALID_MAP";
+    case EntryType::ANNOTATION: return "ANNOTATION";
+    case EntryType::STRING_DEFINE: return "STRING_DEFINE";
+    case EntryType::STRING_REF: return "STRING_REF";
     default: throw std::invalid_argument("Unknown entry type");
   }
 }
 
+bool is_high_priority(EntryType type) {
+  switch(type) {
+    case EntryType::MARK_PUSH:
+    case EntryType::MARK_POP:
+    case EntryType::TRACE_ABORT:
+    case EntryType::TRACE_END:
+    case EntryType::TRACE_START:
+    case EntryType::TRACE_BACKWARDS:
+    case EntryType::TRACE_TIMEOUT:
+    case EntryType::QPL_START:
+    case EntryType::QPL_END:
+    case EntryType::QPL_CANCEL:
+    case EntryType::TRACE_PRE_END:
+    case EntryType::LOGGER_PRIORITY:
+      return true;
+    default:
+      return false;
+  }
+}
+
 } // namespace entries
 } // namespace profilo
 } // namespace facebook
@@ -1,4 +1,4 @@
-// @generated SignedSource<<1959b2ffeb1868d427c23292272a02c5>>
+// @generated SignedSource<<e9dd39311451846aa1266a987fee8a5b>>
 
 #pragma once
 
@@ -125,10 +125,17 @@ enum class EntryType {
   MEMORY_MAPPING_FAILURE = 116,
   THREAD_NAMING = 117,
   STKERR_INVALID_MAP = 118,
+  ANNOTATION = 119,
+  STRING_DEFINE = 120,
+  STRING_REF = 121,
 };
 
 
 const char* to_string(EntryType type);
+
+// Whether entries of this type go to the high priority ring of tiered
+// buffers.
+bool is_high_priority(EntryType type);
 } // namespace entries
 } // namespace profilo
 } // namespace facebook
@@ -1,4 +1,4 @@
-// @generated SignedSource<<b59ea2208f5b4fdce3e6fcdb16da08a4>>
+// @generated SignedSource<<0eeb270f6626a6ba9a27c3e0a329d47c>>
 
 package com.facebook.profilo.entries;
 
@@ -123,6 +123,9 @@ public class EntryType {
   public static final int MEMORY_MAPPING_FAILURE = 116;
   public static final int THREAD_NAMING = 117;
   public static final int STKERR_INVALID_MAP = 118;
+  public static final int ANNOTATION = 119;
+  public static final int STRING_DEFINE = 120;
+  public static final int STRING_REF = 121;
 
   public static final String[] NAMES = {
     "UNKNOWN_TYPE",
@@ -244,5 +247,8 @@ public class EntryType {
     "MEMORY_MAPPING_FAILURE",
     "THREAD_NAMING",
     "STKERR_INVALID_MAP",
+    "ANNOTATION",
+    "STRING_DEFINE",
+    "STRING_REF",
   };
 }
@@ -16,10 +16,13 @@
 
 #include "NativeTraceWriter.h"
 
+#include <fb/log.h>
+#include <profilo/writer/ZstdCompressor.h>
 #include <profilo/writer/trace_backwards.h>
 #include <profilo/writer/trace_headers.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <exception>
 
 using facebook::jni::alias_ref;
 using facebook::jni::local_ref;
@@ -34,7 +37,10 @@ NativeTraceWriter::NativeTraceWriter(
     std::shared_ptr<Buffer> buffer,
     std::string trace_folder,
     std::string trace_prefix,
-    fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks)
+    fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks,
+    std::chrono::microseconds reader_latency_budget,
+    bool pipelined,
+    std::shared_ptr<TraceCompressor> compressor)
     : callbacks_(std::make_shared<NativeTraceWriterCallbacksProxy>(callbacks)),
       writer_(
           std::move(trace_folder),
@@ -42,7 +48,10 @@ NativeTraceWriter::NativeTraceWriter(
           std::move(buffer),
           callbacks_,
           calculateHeaders(),
-          traceBackwards) {}
+          traceBackwards,
+          reader_latency_budget,
+          std::move(compressor),
+          pipelined) {}
 
 void NativeTraceWriter::loop() {
   writer_.loop();
@@ -61,8 +70,53 @@ local_ref<NativeTraceWriter::jhybriddata> NativeTraceWriter::initHybrid(
     JBuffer* buffer,
     std::string trace_folder,
     std::string trace_prefix,
-    fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks) {
-  return makeCxxInstance(buffer->get(), trace_folder, trace_prefix, callbacks);
+    fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks,
+    int32_t reader_latency_budget_us,
+    bool pipelined,
+    std::string compression,
+    int32_t compression_level,
+    std::string compression_dictionary) {
+  return makeCxxInstance(
+      buffer->get(),
+      trace_folder,
+      trace_prefix,
+      callbacks,
+      std::chrono::microseconds(reader_latency_budget_us),
+      pipelined,
+      makeCompressor(compression, compression_level, compression_dictionary));
+}
+
+std::shared_ptr<TraceCompressor> NativeTraceWriter::makeCompressor(
+    const std::string& type,
+    int32_t level,
+    const std::string& dictionary_path) {
+  if (type.empty() || type == "zlib") {
+    if (level <= 0) {
+      return nullptr;
+    }
+    return std::make_shared<ZlibCompressor>(level);
+  }
+  if (type != "zstd") {
+    FBLOGW("Unknown trace compression %s, using the default", type.c_str());
+    return nullptr;
+  }
+
+  if (level <= 0) {
+    level = ZstdCompressor::kDefaultLevel;
+  }
+  if (dictionary_path.empty()) {
+    return std::make_shared<ZstdCompressor>(level);
+  }
+  try {
+    return ZstdCompressor::fromDictionaryFile(dictionary_path, level);
+  } catch (const std::exception& e) {
+    // Fall back rather than fail the trace.
+    FBLOGW(
+        "Could not load zstd dictionary %s: %s, using the default",
+        dictionary_path.c_str(),
+        e.what());
+    return nullptr;
+  }
 }
 
 void NativeTraceWriter::registerNatives() {
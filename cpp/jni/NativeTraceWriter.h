@@ -22,6 +22,7 @@
 #include <profilo/mmapbuf/Buffer.h>
 #include <profilo/mmapbuf/JBuffer.h>
 #include <profilo/writer/TraceWriter.h>
+#include <chrono>
 
 namespace fbjni = facebook::jni;
 namespace facebook {
@@ -40,7 +41,23 @@ class NativeTraceWriter : public fbjni::HybridClass<NativeTraceWriter> {
       JBuffer* buffer,
       std::string trace_folder,
       std::string trace_prefix,
-      fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks);
+      fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks,
+      int32_t reader_latency_budget_us,
+      bool pipelined,
+      std::string compression,
+      int32_t compression_level,
+      std::string compression_dictionary);
+
+  //
+  // The compressor for a "zlib" or "zstd" `type` (zlib if empty), at
+  // `level` (the compressor's default if 0), with the trained zstd
+  // dictionary at `dictionary_path`, if any. Returns nullptr, i.e. the
+  // default compressor, if the spec can't be honored.
+  //
+  static std::shared_ptr<TraceCompressor> makeCompressor(
+      const std::string& type,
+      int32_t level,
+      const std::string& dictionary_path);
 
   static void registerNatives();
 
@@ -57,7 +74,10 @@ class NativeTraceWriter : public fbjni::HybridClass<NativeTraceWriter> {
       std::shared_ptr<Buffer> buffer,
       std::string trace_folder,
       std::string trace_prefix,
-      fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks);
+      fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks,
+      std::chrono::microseconds reader_latency_budget,
+      bool pipelined,
+      std::shared_ptr<TraceCompressor> compressor);
 
   std::shared_ptr<TraceCallbacks> callbacks_;
   writer::TraceWriter writer_;
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <new>
 #include <stdexcept>
 
 #include <profilo/util/common.h>
@@ -28,13 +29,123 @@ namespace profilo {
 
 using namespace entries;
 
+constexpr size_t Logger::kMaxCompactSize;
+
+namespace {
+
+// Counts the calling thread in Logger::strings_users_ while in scope. Its
+// loads of strings_ come after the increment, so a thread replacing the
+// table that then sees no users knows nobody holds the old one.
+class StringsUse {
+ public:
+  explicit StringsUse(std::atomic<uint32_t>& users) : users_(users) {
+    users_.fetch_add(1);
+  }
+  ~StringsUse() {
+    users_.fetch_sub(1, std::memory_order_release);
+  }
+
+ private:
+  std::atomic<uint32_t>& users_;
+};
+
+} // namespace
+
+Logger::EntryIDCounter::EntryIDCounter(int32_t initialValue, int32_t blockSize)
+    : id_(initialValue),
+      blockSize_(blockSize),
+      blockKeyOnce_(),
+      hasBlockKey_(false),
+      blockKey_() {}
+
+Logger::EntryIDCounter::~EntryIDCounter() {
+  // Blocks of threads that are still alive are leaked. They're only ever
+  // allocated in block mode, which is meant for long-lived counters.
+  if (hasBlockKey_) {
+    pthread_key_delete(blockKey_);
+  }
+}
+
+void Logger::EntryIDCounter::setBlockSize(int32_t blockSize) {
+  blockSize_.store(blockSize, std::memory_order_relaxed);
+}
+
+int32_t Logger::EntryIDCounter::claimBlock(int32_t count) {
+  int32_t value, start;
+
+  do {
+    value = id_.load();
+    start = value;
+    if (start <= 0 || start > std::numeric_limits<int32_t>::max() - count) {
+      // explicitly handle overflow and skip negative IDs.
+      start = 1;
+    }
+  } while (!id_.compare_exchange_weak(value, start + count));
+
+  return start;
+}
+
+int32_t Logger::EntryIDCounter::nextFromBlock() {
+  std::call_once(blockKeyOnce_, [this] {
+    int ret = pthread_key_create(
+        &blockKey_, [](void* block) { delete static_cast<Block*>(block); });
+    hasBlockKey_ = ret == 0;
+  });
+  if (!hasBlockKey_) {
+    // Out of pthread keys, hand out IDs one at a time.
+    return claimBlock(1);
+  }
+
+  auto block = static_cast<Block*>(pthread_getspecific(blockKey_));
+  if (block == nullptr) {
+    block = new (std::nothrow) Block{.next = 0, .end = 0};
+    if (block == nullptr || pthread_setspecific(blockKey_, block) != 0) {
+      delete block;
+      return claimBlock(1);
+    }
+  }
+
+  if (block->next == block->end) {
+    auto size = std::max(1, blockSize_.load(std::memory_order_relaxed));
+    block->next = claimBlock(size);
+    block->end = block->next + size;
+  }
+  return block->next++;
+}
+
 Logger::EntryIDCounter& Logger::getGlobalEntryID() {
   static EntryIDCounter global_instance{kDefaultInitialID};
   return global_instance;
 }
 
-Logger::Logger(logger::TraceBufferProvider provider, EntryIDCounter& counter)
-    : entryID_(counter), logger_(provider) {}
+Logger::Logger(
+    logger::TraceBufferProvider provider,
+    EntryIDCounter& counter,
+    bool write_combining,
+    bool compact_entries,
+    logger::TraceBufferProvider priority_provider,
+    bool intern_strings)
+    : entryID_(counter),
+      logger_(provider, write_combining),
+      priority_logger_(
+          priority_provider
+              ? std::make_unique<logger::PacketLogger>(priority_provider)
+              : nullptr),
+      compact_entries_(compact_entries),
+      intern_strings_(intern_strings),
+      strings_(nullptr),
+      strings_ring_(nullptr),
+      strings_logged_at_(0),
+      strings_users_(0),
+      strings_mutex_(),
+      retired_strings_() {}
+
+Logger::~Logger() {
+  delete strings_.load();
+  for (auto table : retired_strings_) {
+    delete table;
+  }
+}
 
 int32_t Logger::writeBytes(
     EntryType type,
@@ -57,5 +168,233 @@ int32_t Logger::writeBytes(
           .size = static_cast<uint16_t>(len)}});
 }
 
+int32_t Logger::writeString(
+    EntryType type,
+    int32_t arg1,
+    const uint8_t* arg2,
+    size_t len) {
+  if (len > kMaxVariableLengthEntry) {
+    throw std::overflow_error("len is bigger than kMaxVariableLengthEntry");
+  }
+  return writeString(BytesEntry{
+      .id = 0,
+      .type = type,
+      .matchid = arg1,
+      .bytes = {
+          .values = const_cast<uint8_t*>(arg2),
+          .size = static_cast<uint16_t>(len)}});
+}
+
+int32_t Logger::writeString(BytesEntry entry, uint32_t spin_budget) {
+  if (entry.bytes.size > kMaxVariableLengthEntry) {
+    throw std::overflow_error("len is bigger than kMaxVariableLengthEntry");
+  }
+  if (entry.bytes.values == nullptr) {
+    throw std::invalid_argument("arg2 is null");
+  }
+
+  StringsUse use(strings_users_);
+  auto strings = stringTable();
+  if (strings == nullptr) {
+    return writeOrDrop(entry, spin_budget);
+  }
+
+  bool inserted = false;
+  auto string_id =
+      strings->intern(entry.bytes.values, entry.bytes.size, inserted);
+  if (string_id == 0) {
+    return writeOrDrop(entry, spin_budget);
+  }
+
+  if (inserted) {
+    auto defined = writeOrDrop(
+        BytesEntry{
+            .id = 0,
+            .type = EntryType::STRING_DEFINE,
+            .matchid = static_cast<int32_t>(string_id),
+            .bytes = entry.bytes},
+        spin_budget);
+    // If the definition got dropped, the next dictionary dump has it.
+    strings->publish(string_id);
+    if (defined == 0) {
+      return writeOrDrop(entry, spin_budget);
+    }
+  } else {
+    // Until its inserter publishes the string, its STRING_DEFINE may not
+    // be in the ring yet and a STRING_REF could get ahead of it, so log
+    // the string in full.
+    const char* str;
+    size_t size;
+    if (!strings->lookup(string_id, str, size)) {
+      return writeOrDrop(entry, spin_budget);
+    }
+  }
+
+  return writeOrDrop(
+      StandardEntry{
+          .id = entry.id,
+          .type = EntryType::STRING_REF,
+          .timestamp = 0,
+          .tid = 0,
+          .callid = static_cast<int32_t>(entry.type),
+          .matchid = entry.matchid,
+          .extra = string_id,
+      },
+      spin_budget);
+}
+
+logger::StringTable* Logger::stringTable() {
+  auto strings = strings_.load();
+  if (strings != nullptr || !intern_strings_) {
+    return strings;
+  }
+
+  auto table = newStringTable(1);
+  if (table == nullptr) {
+    return nullptr;
+  }
+  if (!strings_.compare_exchange_strong(strings, table)) {
+    delete table;
+  } else {
+    strings = table;
+  }
+  return strings;
+}
+
+logger::StringTable* Logger::newStringTable(uint32_t first_id) {
+  //
+  // Every dictionary dump must fit comfortably in the ring, so bound it to
+  // a quarter of the ring's packets. A STRING_DEFINE of `size` bytes takes
+  // at most (header + size) / kDataSize + 1 packets, so `max_strings`
+  // strings with `arena_size` bytes between them take at most
+  // (max_strings * (header + kDataSize) + arena_size) / kDataSize.
+  //
+  constexpr size_t kDataSize = sizeof(logger::Packet::data);
+  size_t budget = logger_.capacity() / 4;
+  uint32_t max_strings = logger::StringTable::kDefaultMaxStrings;
+  max_strings = std::min<size_t>(max_strings, budget / 4);
+  if (max_strings == 0) {
+    return nullptr;
+  }
+  auto header = BytesEntry::calculateSize(BytesEntry{
+      .id = 0,
+      .type = EntryType::STRING_DEFINE,
+      .matchid = 0,
+      .bytes = {.values = nullptr, .size = 0}});
+  // Can't underflow: header < kDataSize and max_strings <= budget / 4.
+  auto arena_size = std::min(
+      logger::StringTable::kDefaultArenaSize,
+      budget * kDataSize - max_strings * (header + kDataSize));
+  return new (std::nothrow)
+      logger::StringTable(max_strings, arena_size, first_id);
+}
+
+void Logger::startStrings(bool rotate) {
+  if (rotate) {
+    // Only threads holding the lock free tables, so `strings` stays valid.
+    std::lock_guard<std::mutex> lock(strings_mutex_);
+    auto strings = strings_.load();
+    if (strings != nullptr && strings->full()) {
+      // IDs go in matchid, keep them positive int32s.
+      uint32_t span = strings->lastID() - strings->firstID();
+      uint32_t first_id = strings->lastID() + 1;
+      if (first_id > std::numeric_limits<int32_t>::max() - span) {
+        first_id = 1;
+      }
+      auto table = newStringTable(first_id);
+      if (table != nullptr) {
+        strings_.store(table);
+        retired_strings_.push_back(strings);
+      }
+    }
+    if (!retired_strings_.empty() && strings_users_.load() == 0) {
+      for (auto retired : retired_strings_) {
+        delete retired;
+      }
+      retired_strings_.clear();
+    }
+  }
+  logStrings(kNoSpinBudget);
+}
+
+void Logger::takeStrings(Logger& other) {
+  std::lock_guard<std::mutex> lock(other.strings_mutex_);
+  delete strings_.exchange(other.strings_.exchange(nullptr));
+  strings_ring_.store(other.strings_ring_.exchange(nullptr));
+  strings_logged_at_.store(other.strings_logged_at_.load());
+  for (auto table : other.retired_strings_) {
+    delete table;
+  }
+  other.retired_strings_.clear();
+}
+
+bool Logger::lookupString(uint32_t id, const char*& str, size_t& size)
+    const {
+  StringsUse use(strings_users_);
+  auto strings = strings_.load();
+  return strings != nullptr && strings->lookup(id, str, size);
+}
+
+void Logger::refreshStrings() {
+  if (strings_.load(std::memory_order_acquire) == nullptr) {
+    return;
+  }
+
+  // Before the first dump, the only definitions are the ones writeString()
+  // logged, to the rings of their threads. Go by ours.
+  auto ring = strings_ring_.load(std::memory_order_acquire);
+  if (ring == nullptr) {
+    ring = &logger_.currentBuffer();
+  }
+  auto logged_at = strings_logged_at_.load(std::memory_order_acquire);
+  if (ring->writeCount() - logged_at >= ring->capacity()) {
+    logStrings(kNoSpinBudget);
+  }
+}
+
+void Logger::logStrings(uint32_t spin_budget) {
+  StringsUse use(strings_users_);
+  auto strings = strings_.load();
+  if (strings == nullptr) {
+    return;
+  }
+
+  auto& ring = logger_.currentBuffer();
+  strings_logged_at_.store(ring.writeCount(), std::memory_order_release);
+  strings_ring_.store(&ring, std::memory_order_release);
+  strings->forEach([&](uint32_t id, const char* str, size_t size) {
+    BytesEntry entry{
+        .id = 0,
+        .type = EntryType::STRING_DEFINE,
+        .matchid = static_cast<int32_t>(id),
+        .bytes = {
+            .values = reinterpret_cast<const uint8_t*>(str),
+            .size = static_cast<uint16_t>(size)}};
+    writeOrDrop(entry, spin_budget);
+  });
+}
+
+int32_t Logger::writeAnnotation(
+    EntryType type,
+    int64_t timestamp,
+    int32_t tid,
+    int32_t matchid,
+    std::initializer_list<KeyValue> pairs) {
+  auto len = KeyValue::calculateSize(pairs.begin(), pairs.size());
+  if (len > kMaxVariableLengthEntry) {
+    throw std::overflow_error("len is bigger than kMaxVariableLengthEntry");
+  }
+  uint8_t packed[len];
+  KeyValue::pack(pairs.begin(), pairs.size(), packed, len);
+
+  return write(AnnotationEntry{
+      .id = 0,
+      .type = type,
+      .timestamp = timestamp,
+      .tid = tid,
+      .matchid = matchid,
+      .pairs = {.values = packed, .size = static_cast<uint16_t>(len)}});
+}
+
 } // namespace profilo
 } // namespace facebook
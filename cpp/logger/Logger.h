@@ -19,9 +19,16 @@
 #include <profilo/LogEntry.h>
 #include <profilo/entries/Entry.h>
 #include <profilo/entries/EntryType.h>
+#include <pthread.h>
 #include <atomic>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include "PacketLogger.h"
+#include "StringTable.h"
 
 #define PROFILOEXPORT __attribute__((visibility("default")))
 
@@ -32,11 +39,36 @@ using namespace entries;
 
 class Logger {
  public:
+  //
+  // Hands out entry IDs.
+  //
+  // By default every ID is claimed from a single shared atomic. With a block
+  // size greater than one, each thread instead claims blockSize consecutive
+  // IDs at a time and hands them out locally, so the shared atomic is touched
+  // once per block instead of once per entry.
+  //
+  // IDs stay unique in both modes. In block mode, IDs are increasing within a
+  // thread but only roughly increasing across threads: a thread still working
+  // through an older block returns IDs lower than ones already handed out by
+  // other threads. IDs left in a block when its thread exits are skipped.
+  //
+  // Block mode is not reentrant: a signal handler that writes entries must
+  // not interrupt a write on the same thread.
+  //
+  // The thread-local key that holds the blocks is only created the first
+  // time block mode is used, so counters that never enable it don't use up
+  // one of the process's pthread keys.
+  //
   struct EntryIDCounter {
-    EntryIDCounter(int32_t initialValue) : id_(initialValue) {}
+    EntryIDCounter(int32_t initialValue, int32_t blockSize = 1);
     EntryIDCounter(EntryIDCounter& copy) = delete;
+    ~EntryIDCounter();
 
     int32_t next() {
+      if (blockSize_.load(std::memory_order_relaxed) > 1) {
+        return nextFromBlock();
+      }
+
       int32_t value, newValue;
 
       do {
@@ -52,8 +84,28 @@ class Logger {
       return value;
     }
 
+    //
+    // Change the block size. Threads pick up the new size when they claim
+    // their next block. A size of 1 (or less) disables block mode.
+    //
+    PROFILOEXPORT void setBlockSize(int32_t blockSize);
+
    private:
+    struct Block {
+      int32_t next;
+      int32_t end;
+    };
+
     std::atomic<int32_t> id_;
+    std::atomic<int32_t> blockSize_;
+    std::once_flag blockKeyOnce_;
+    bool hasBlockKey_;
+    pthread_key_t blockKey_;
+
+    PROFILOEXPORT int32_t nextFromBlock();
+
+    // Claims [start, start + count) from the shared counter, returns start.
+    int32_t claimBlock(int32_t count);
   };
 
   static constexpr size_t kMaxVariableLengthEntry = 1024;
@@ -63,45 +115,431 @@ class Logger {
 
   static EntryIDCounter& getGlobalEntryID();
 
+  // spin_budget to wait for ring slots as long as needed.
+  static constexpr uint32_t kNoSpinBudget =
+      std::numeric_limits<uint32_t>::max();
+
   template <class T>
   int32_t write(T&& entry) {
+    auto id = writeEntry(std::forward<T>(entry));
+    if (startsTrace(entry)) {
+      startStrings(entry.type == EntryType::TRACE_START);
+    }
+    return id;
+  }
+
+  //
+  // `cursor` points into the ring the calling thread writes its regular
+  // entries to (see logger::PacketLogger::currentBuffer()). That's the main
+  // ring, or for a sharded Buffer, the shard of the CPU the thread is on.
+  // For entries that go to the high priority ring, it's where the next
+  // write to that regular ring will land, so a reader starting there sees
+  // everything logged to it after `entry`.
+  //
+  // TraceWriter only starts reading at `cursor` for an unsharded main ring.
+  // It reads every shard of a sharded Buffer, and the high priority ring,
+  // from their tails.
+  //
+  template <class T>
+  int32_t writeAndGetCursor(T&& entry, TraceBuffer::Cursor& cursor) {
     if (entry.id == 0) {
       entry.id = entryID_.next();
     }
 
+    if (isTraceControlEntry(entry)) {
+      logger_.flushAll();
+    }
+
     using U = std::decay_t<T>;
-    auto size = U::calculateSize(entry);
-    char payload[size];
-    U::pack(entry, payload, size);
+    if (isHighPriority(entry)) {
+      cursor = logger_.currentHead();
+      auto writer = priority_logger_->startWrite(U::calculateSize(entry));
+      U::pack(entry, writer);
+    } else {
+      auto writer = logger_.startWrite(U::calculateSize(entry));
+      U::pack(entry, writer);
+      cursor = writer.cursor();
+    }
 
-    logger_.write(payload, size);
+    if (startsTrace(entry)) {
+      startStrings(entry.type == EntryType::TRACE_START);
+    }
     return entry.id;
   }
 
+  //
+  // Write `entry`, already packed and split into `count` packets by
+  // PacketLogger::fragment(). Lets callers writing the same entry to several
+  // Loggers serialize it only once. The entry must already have its ID.
+  //
+  // appendable: the packet holds a single compact entry (see packCompact())
+  // and may share its slot with other compact entries.
+  //
   template <class T>
-  int32_t writeAndGetCursor(T&& entry, TraceBuffer::Cursor& cursor) {
+  void writePackets(
+      const T& entry,
+      logger::Packet* packets,
+      uint32_t count,
+      bool appendable = false) {
+    writeEntryPackets(entry, packets, count, appendable);
+    if (startsTrace(entry)) {
+      startStrings(entry.type == EntryType::TRACE_START);
+    }
+  }
+
+  //
+  // Equivalent to write(), but for latency-critical threads: never waits
+  // for a ring slot. If it can't claim free slots within `spin_budget`
+  // retries (see PacketLogger::tryWrite()), the entry is dropped and counted
+  // in PacketLogger::droppedWrites().
+  // Returns the entry ID, or 0 if the entry was dropped.
+  //
+  // Trace control entries are never dropped, they go through write().
+  //
+  template <class T>
+  int32_t tryWrite(T&& entry, uint32_t spin_budget) {
+    if (isTraceControlEntry(entry)) {
+      return write(std::forward<T>(entry));
+    }
     if (entry.id == 0) {
       entry.id = entryID_.next();
     }
 
+    logger::Packet compact;
+    if (compact_entries_ && !isHighPriority(entry) &&
+        packCompact(entry, compact)) {
+      return tryWritePackets(entry, &compact, 1, spin_budget) ? entry.id : 0;
+    }
+
     using U = std::decay_t<T>;
     auto size = U::calculateSize(entry);
     char payload[size];
     U::pack(entry, payload, size);
 
-    cursor = logger_.writeAndGetCursor(payload, size);
-    return entry.id;
+    auto count = logger::PacketLogger::packetCount(size);
+    logger::Packet packets[count];
+    logger::PacketLogger::fragment(payload, size, packets);
+    return tryWritePackets(entry, packets, count, spin_budget) ? entry.id : 0;
+  }
+
+  //
+  // writePackets() counterpart of tryWrite(). Returns false if the entry was
+  // dropped.
+  //
+  template <class T>
+  bool tryWritePackets(
+      const T& entry,
+      logger::Packet* packets,
+      uint32_t count,
+      uint32_t spin_budget) {
+    if (isTraceControlEntry(entry)) {
+      writePackets(entry, packets, count);
+      return true;
+    }
+    auto& logger = isHighPriority(entry) ? *priority_logger_ : logger_;
+    return logger.tryWritePackets(packets, count, spin_budget);
   }
 
   PROFILOEXPORT int32_t
   writeBytes(EntryType type, int32_t arg1, const uint8_t* arg2, size_t len);
 
+  //
+  // Like writeBytes(), but interns the string: the first time a string is
+  // written, it's logged once as a STRING_DEFINE BytesEntry with its ID in
+  // matchid. After that, writes only log a STRING_REF StandardEntry with
+  // the type in callid, arg1 in matchid and the string ID in extra, which
+  // readers turn back into the BytesEntry (see StringResolvingVisitor).
+  //
+  // The dictionary is logged again after every TRACE_START and
+  // TRACE_BACKWARDS entry, and by refreshStrings(), so traces can resolve
+  // strings defined before they started.
+  //
+  // Falls back to writeBytes() once the dictionary is full, or if this
+  // Logger doesn't intern strings (see the constructor). A full dictionary
+  // is replaced by an empty one at the next TRACE_START, with IDs following
+  // the old ones.
+  //
+  PROFILOEXPORT int32_t
+  writeString(EntryType type, int32_t arg1, const uint8_t* arg2, size_t len);
+
+  //
+  // Log the dictionary again if the ring its last dump went to has wrapped
+  // around since. Never called by writers: the trace writer calls it while
+  // it waits for entries.
+  //
+  PROFILOEXPORT void refreshStrings();
+
+  //
+  // Look up a string logged by writeString() in this Logger's dictionary.
+  // Lets an in-process reader resolve STRING_REFs whose STRING_DEFINE it
+  // hasn't seen, e.g. when reading backwards.
+  //
+  PROFILOEXPORT bool
+  lookupString(uint32_t id, const char*& str, size_t& size) const;
+
+  //
+  // writeString() for an entry that may already have its ID (see
+  // writePackets()). With a spin_budget, never waits for ring slots, like
+  // tryWrite(). Returns the entry ID, or 0 if the entry was dropped.
+  //
+  PROFILOEXPORT int32_t
+  writeString(BytesEntry entry, uint32_t spin_budget = kNoSpinBudget);
+
+  //
+  // Write an AnnotationEntry carrying `pairs`, in place of a StandardEntry
+  // followed by a STRING_KEY/STRING_VALUE entry for each pair.
+  //
+  PROFILOEXPORT int32_t writeAnnotation(
+      EntryType type,
+      int64_t timestamp,
+      int32_t tid,
+      int32_t matchid,
+      std::initializer_list<KeyValue> pairs);
+
+  //
+  // Publish entries that are still held in per-thread staging areas.
+  // No-op unless the Logger was created with write combining enabled.
+  //
+  void flushStaged() {
+    logger_.flushAll();
+  }
+
+  bool writeCombining() const {
+    return logger_.writeCombining();
+  }
+
+  bool compactEntries() const {
+    return compact_entries_;
+  }
+
+  bool internStrings() const {
+    return intern_strings_;
+  }
+
+  //
+  // Whether high priority entry types (see entries::is_high_priority()) are
+  // written to a ring of their own.
+  //
+  bool tiered() const {
+    return priority_logger_ != nullptr;
+  }
+
+  //
+  // Pack `entry` in its compact encoding into a single packet. Only
+  // StandardEntry has a compact encoding, for which this always succeeds
+  // (see kMaxCompactSize). For every other entry class it returns false and
+  // leaves `packet` alone.
+  //
+  static bool packCompact(const StandardEntry& entry, logger::Packet& packet) {
+    auto size = StandardEntry::calculateCompactSize(entry);
+    packet = logger::Packet{
+        .stream = logger::Packet::kPacketIdNone,
+        .start = true,
+        .next = false,
+        .size = static_cast<uint16_t>(size),
+        .data = {}};
+    StandardEntry::packCompact(entry, packet.data, sizeof(packet.data));
+    return true;
+  }
+
+  template <class T>
+  static bool packCompact(const T&, logger::Packet&) {
+    return false;
+  }
+
+  // Largest compact StandardEntry: format and field mask bytes, then
+  // varints of up to 5 bytes for the 32-bit fields, 10 for the 64-bit ones
+  // and 2 for the type.
+  static constexpr size_t kMaxCompactSize = 2 + 4 * 5 + 2 * 10 + 2;
+  static_assert(
+      kMaxCompactSize <= sizeof(logger::Packet::data),
+      "Compact StandardEntries must fit in a single packet");
+
+  //
+  // Take over other's string dictionary, e.g. when moving the Buffer that
+  // owns both. Nothing may write to other meanwhile.
+  //
+  PROFILOEXPORT void takeStrings(Logger& other);
+
   // This constructor is for internal framework use.
-  Logger(logger::TraceBufferProvider provider, EntryIDCounter& counter);
+  //
+  // write_combining: let small StandardEntry writes go through per-thread
+  // staging areas (see logger::WriteCombiner). Trace control entries and
+  // multi-packet entries are always written directly.
+  //
+  // compact_entries: write StandardEntries in their compact encoding. With
+  // write combining, consecutive compact entries from one thread are packed
+  // into the same buffer slot, so the buffer holds more history.
+  //
+  // priority_provider: if set, high priority entries are written to this
+  // ring instead, where the rest of the entries can't overwrite them. They
+  // are never staged or compacted.
+  //
+  // intern_strings: let writeString() log STRING_REFs. Buffers that may be
+  // read after a crash, without this Logger's dictionary and without a
+  // trace writer refreshing it in the ring, must log strings in full.
+  Logger(
+      logger::TraceBufferProvider provider,
+      EntryIDCounter& counter,
+      bool write_combining = false,
+      bool compact_entries = false,
+      logger::TraceBufferProvider priority_provider = nullptr,
+      bool intern_strings = true);
+  ~Logger();
 
  private:
   EntryIDCounter& entryID_;
   logger::PacketLogger logger_;
+  std::unique_ptr<logger::PacketLogger> priority_logger_;
+  bool compact_entries_;
+  bool intern_strings_;
+  // Allocated by the first writeString(), replaced once full.
+  std::atomic<logger::StringTable*> strings_;
+  // Ring the dictionary was last logged to, and its writeCount() then.
+  std::atomic<TraceBuffer*> strings_ring_;
+  std::atomic<uint64_t> strings_logged_at_;
+  // Threads currently using a table loaded from strings_. Replaced tables
+  // are only freed once there are none.
+  mutable std::atomic<uint32_t> strings_users_;
+  std::mutex strings_mutex_;
+  // Guarded by strings_mutex_.
+  std::vector<logger::StringTable*> retired_strings_;
+
+  logger::StringTable* stringTable();
+
+  logger::StringTable* newStringTable(uint32_t first_id);
+
+  // Replace the dictionary if it's full and log it, for a trace starting.
+  PROFILOEXPORT void startStrings(bool rotate);
+
+  // Log every published string as a STRING_DEFINE.
+  PROFILOEXPORT void logStrings(uint32_t spin_budget);
+
+  template <class T>
+  int32_t writeEntry(T&& entry) {
+    if (entry.id == 0) {
+      entry.id = entryID_.next();
+    }
+
+    if (isHighPriority(entry)) {
+      if (isTraceControlEntry(entry)) {
+        logger_.flushAll();
+      }
+      using U = std::decay_t<T>;
+      auto writer = priority_logger_->startWrite(U::calculateSize(entry));
+      U::pack(entry, writer);
+      return entry.id;
+    }
+
+    if (compact_entries_) {
+      logger::Packet packet;
+      if (packCompact(entry, packet)) {
+        writeEntryPackets(entry, &packet, 1, true);
+        return entry.id;
+      }
+    }
+
+    using U = std::decay_t<T>;
+    auto size = U::calculateSize(entry);
+
+    if (isTraceControlEntry(entry)) {
+      // Staged entries from all threads must make it in before the trace
+      // is started or finished.
+      logger_.flushAll();
+    } else if (
+        canStage(entry) && logger_.writeCombining() &&
+        logger::PacketLogger::packetCount(size) == 1) {
+      // Staging copies the packet anyway, so pack straight into it.
+      logger::Packet packet{
+          .stream = logger::Packet::kPacketIdNone,
+          .start = true,
+          .next = false,
+          .size = static_cast<uint16_t>(size),
+          .data = {}};
+      U::pack(entry, packet.data, sizeof(packet.data));
+      logger_.writePacketsCombined(&packet, 1);
+      return entry.id;
+    }
+
+    // Serialize straight into the reserved ring slots.
+    auto writer = logger_.startWrite(size);
+    U::pack(entry, writer);
+    return entry.id;
+  }
+
+  template <class T>
+  void writeEntryPackets(
+      const T& entry,
+      logger::Packet* packets,
+      uint32_t count,
+      bool appendable) {
+    if (isHighPriority(entry)) {
+      if (isTraceControlEntry(entry)) {
+        logger_.flushAll();
+      }
+      priority_logger_->writePackets(packets, count);
+    } else if (isTraceControlEntry(entry)) {
+      // Staged entries from all threads must make it in before the trace
+      // is started or finished.
+      logger_.flushAll();
+      logger_.writePackets(packets, count);
+    } else if (canStage(entry)) {
+      logger_.writePacketsCombined(packets, count, appendable);
+    } else {
+      logger_.writePackets(packets, count);
+    }
+  }
+
+  template <class T>
+  int32_t writeOrDrop(T&& entry, uint32_t spin_budget) {
+    if (spin_budget == kNoSpinBudget) {
+      return write(std::forward<T>(entry));
+    }
+    return tryWrite(std::forward<T>(entry), spin_budget);
+  }
+
+  template <class T>
+  bool isHighPriority(const T& entry) const {
+    return priority_logger_ != nullptr && is_high_priority(entry.type);
+  }
+
+  static bool isTraceControlEntry(const StandardEntry& entry) {
+    switch (entry.type) {
+      case EntryType::TRACE_START:
+      case EntryType::TRACE_BACKWARDS:
+      case EntryType::TRACE_END:
+      case EntryType::TRACE_ABORT:
+      case EntryType::TRACE_TIMEOUT:
+      case EntryType::LOGGER_PRIORITY:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  template <class T>
+  static bool isTraceControlEntry(const T&) {
+    return false;
+  }
+
+  static bool startsTrace(const StandardEntry& entry) {
+    return entry.type == EntryType::TRACE_START ||
+        entry.type == EntryType::TRACE_BACKWARDS;
+  }
+
+  template <class T>
+  static bool startsTrace(const T&) {
+    return false;
+  }
+
+  static bool canStage(const StandardEntry&) {
+    return true;
+  }
+
+  template <class T>
+  static bool canStage(const T&) {
+    return false;
+  }
 
   Logger(const Logger& other) = delete;
 };
@@ -16,25 +16,138 @@
 
 #include "MultiBufferLogger.h"
 
+#include <sched.h>
+#include <algorithm>
+#include <new>
+#include <system_error>
+
 namespace facebook {
 namespace profilo {
 namespace logger {
 
 MultiBufferLogger::MultiBufferLogger(MultiBufferLogger::EntryIDCounter& counter)
-    : entryID_(counter) {}
+    : buffers_(new BufferSet()),
+      readers_(nullptr),
+      reader_key_(),
+      update_mutex_(),
+      entryID_(counter) {
+  int ret = pthread_key_create(&reader_key_, [](void* reader) {
+    static_cast<Reader*>(reader)->in_use.store(false);
+  });
+  if (ret != 0) {
+    delete buffers_.load();
+    throw std::system_error(
+        ret, std::system_category(), "Could not create reader key");
+  }
+}
+
+MultiBufferLogger::~MultiBufferLogger() {
+  pthread_key_delete(reader_key_);
+  delete buffers_.load();
+
+  auto reader = readers_.exchange(nullptr);
+  while (reader != nullptr) {
+    auto next = reader->next;
+    delete reader;
+    reader = next;
+  }
+}
+
+MultiBufferLogger::Reader* MultiBufferLogger::currentReader() {
+  auto reader = static_cast<Reader*>(pthread_getspecific(reader_key_));
+  if (reader != nullptr) {
+    return reader;
+  }
+
+  // Try to reuse a record left behind by an exited thread.
+  for (auto it = readers_.load(); it != nullptr; it = it->next) {
+    bool expected = false;
+    if (it->in_use.compare_exchange_strong(expected, true)) {
+      reader = it;
+      break;
+    }
+  }
+
+  if (reader == nullptr) {
+    reader = new (std::nothrow) Reader();
+    if (reader == nullptr) {
+      return nullptr;
+    }
+    reader->hazard.store(nullptr);
+    reader->in_use.store(true);
+    auto head = readers_.load();
+    do {
+      reader->next = head;
+    } while (!readers_.compare_exchange_weak(head, reader));
+  }
+
+  if (pthread_setspecific(reader_key_, reader) != 0) {
+    reader->in_use.store(false);
+    return nullptr;
+  }
+  return reader;
+}
+
+MultiBufferLogger::BufferSetGuard::BufferSetGuard(MultiBufferLogger& logger)
+    : reader_(logger.currentReader()), set_(nullptr), fallback_lock_() {
+  if (reader_ == nullptr) {
+    // No hazard slot, keep updates out for the duration of the write.
+    fallback_lock_ = std::unique_lock<std::mutex>(logger.update_mutex_);
+    set_ = logger.buffers_.load();
+    return;
+  }
+
+  // Publish the set we're about to use, then make sure it's still current.
+  // If it is, any update that replaces it after this point will see our
+  // hazard and wait for us.
+  auto set = logger.buffers_.load(std::memory_order_acquire);
+  while (true) {
+    reader_->hazard.store(set);
+    auto current = logger.buffers_.load();
+    if (current == set) {
+      break;
+    }
+    set = current;
+  }
+  set_ = set;
+}
+
+MultiBufferLogger::BufferSetGuard::~BufferSetGuard() {
+  if (reader_ != nullptr) {
+    reader_->hazard.store(nullptr, std::memory_order_release);
+  }
+}
+
+void MultiBufferLogger::replaceBuffers(std::unique_ptr<BufferSet> set) {
+  auto old = buffers_.exchange(set.release());
+
+  // Grace period: wait for every writer that may have picked up the old set.
+  for (auto reader = readers_.load(); reader != nullptr;
+       reader = reader->next) {
+    while (reader->hazard.load() == old) {
+      sched_yield();
+    }
+  }
+  delete old;
+}
 
 void MultiBufferLogger::addBuffer(std::shared_ptr<Buffer> buffer) {
-  WriterLock lock(&lock_);
-  buffers_.push_back(buffer);
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  auto set = std::make_unique<BufferSet>(*buffers_.load());
+  set->push_back(std::move(buffer));
+  replaceBuffers(std::move(set));
 }
 
 void MultiBufferLogger::removeBuffer(std::shared_ptr<Buffer> buffer) {
-  WriterLock lock(&lock_);
-  auto iter = std::find(buffers_.begin(), buffers_.end(), buffer);
-  if (iter == buffers_.end()) {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  auto& current = *buffers_.load();
+  auto iter = std::find(current.begin(), current.end(), buffer);
+  if (iter == current.end()) {
     return;
   }
-  buffers_.erase(iter);
+  auto set = std::make_unique<BufferSet>(current);
+  set->erase(set->begin() + (iter - current.begin()));
+  replaceBuffers(std::move(set));
 }
 
 int32_t MultiBufferLogger::writeBytes(
@@ -42,6 +155,15 @@ int32_t MultiBufferLogger::writeBytes(
     int32_t arg1,
     const uint8_t* arg2,
     size_t len) {
+  return tryWriteBytes(type, arg1, arg2, len, kNoSpinBudget);
+}
+
+int32_t MultiBufferLogger::tryWriteBytes(
+    EntryType type,
+    int32_t arg1,
+    const uint8_t* arg2,
+    size_t len,
+    uint32_t spin_budget) {
   if (len > Logger::kMaxVariableLengthEntry) {
     throw std::overflow_error("len is bigger than kMaxVariableLengthEntry");
   }
@@ -63,12 +185,75 @@ int32_t MultiBufferLogger::writeBytes(
           },
   };
 
-  ReaderLock lock(&lock_);
-  for (auto& buf : buffers_) {
-    buf->logger().write(entry);
+  return writeToAll(entry, spin_budget) ? id : 0;
+}
+
+int32_t MultiBufferLogger::writeString(
+    EntryType type,
+    int32_t arg1,
+    const uint8_t* arg2,
+    size_t len) {
+  return tryWriteString(type, arg1, arg2, len, kNoSpinBudget);
+}
+
+int32_t MultiBufferLogger::tryWriteString(
+    EntryType type,
+    int32_t arg1,
+    const uint8_t* arg2,
+    size_t len,
+    uint32_t spin_budget) {
+  if (len > Logger::kMaxVariableLengthEntry) {
+    throw std::overflow_error("len is bigger than kMaxVariableLengthEntry");
+  }
+  if (arg2 == nullptr) {
+    throw std::invalid_argument("arg2 is null");
   }
-  return entry.id;
+
+  // String IDs differ between buffers, so unlike writeToAll() this can't
+  // share the serialized entry. The entry ID is still the same everywhere.
+  BytesEntry entry{
+      .id = entryID_.next(),
+      .type = type,
+      .matchid = arg1,
+      .bytes =
+          {
+              .values = arg2,
+              .size = static_cast<uint16_t>(len),
+          },
+  };
+
+  BufferSetGuard guard(*this);
+  bool written = guard.buffers().empty();
+  for (auto& buf : guard.buffers()) {
+    if (buf->logger().writeString(entry, spin_budget) != 0) {
+      written = true;
+    }
+  }
+  return written ? entry.id : 0;
 }
+
+int32_t MultiBufferLogger::writeAnnotation(
+    EntryType type,
+    int64_t timestamp,
+    int32_t tid,
+    int32_t matchid,
+    std::initializer_list<KeyValue> pairs) {
+  auto len = KeyValue::calculateSize(pairs.begin(), pairs.size());
+  if (len > Logger::kMaxVariableLengthEntry) {
+    throw std::overflow_error("len is bigger than kMaxVariableLengthEntry");
+  }
+  uint8_t packed[len];
+  KeyValue::pack(pairs.begin(), pairs.size(), packed, len);
+
+  return write(AnnotationEntry{
+      .id = 0,
+      .type = type,
+      .timestamp = timestamp,
+      .tid = tid,
+      .matchid = matchid,
+      .pairs = {.values = packed, .size = static_cast<uint16_t>(len)}});
+}
+
 } // namespace logger
 } // namespace profilo
 } // namespace facebook
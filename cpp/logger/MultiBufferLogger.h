@@ -17,11 +17,13 @@
 #pragma once
 
 #include <pthread.h>
+#include <atomic>
 #include <functional>
+#include <initializer_list>
 #include <memory>
+#include <mutex>
 #include <vector>
 
-#include <linker/locks.h>
 #include <profilo/mmapbuf/Buffer.h>
 
 using namespace facebook::profilo::mmapbuf;
@@ -30,11 +32,28 @@ namespace facebook {
 namespace profilo {
 namespace logger {
 
+//
+// Writes every entry to all of its buffers.
+//
+// The set of buffers is an immutable snapshot that writers pick up with a
+// single acquire load, so the write path doesn't touch any shared cache line
+// other than the buffers themselves. Each writing thread publishes the
+// snapshot it's using in its own hazard slot; addBuffer() and removeBuffer()
+// install a new snapshot and wait until no thread is using the old one before
+// freeing it. In particular, once removeBuffer() returns no thread is writing
+// to the removed buffer.
+//
+// Writing from a signal handler that interrupted a write on the same thread
+// is not supported.
+//
 class MultiBufferLogger {
  public:
   using EntryIDCounter = Logger::EntryIDCounter;
   explicit MultiBufferLogger(
       EntryIDCounter& counter = Logger::getGlobalEntryID());
+  MultiBufferLogger(const MultiBufferLogger&) = delete;
+  MultiBufferLogger& operator=(const MultiBufferLogger&) = delete;
+  ~MultiBufferLogger();
 
   void addBuffer(std::shared_ptr<Buffer> buffer);
   void removeBuffer(std::shared_ptr<Buffer> buffer);
@@ -45,20 +64,146 @@ class MultiBufferLogger {
     auto id = entryID_.next();
     entry.id = id;
 
-    ReaderLock lock(&lock_);
-    for (auto& buf : buffers_) {
-      buf->logger().write(entry);
-    }
+    writeToAll(entry);
     return entry.id;
   }
 
   int32_t
   writeBytes(EntryType type, int32_t arg1, const uint8_t* arg2, size_t len);
 
+  // See Logger::writeString(). Every buffer interns the string on its own.
+  int32_t
+  writeString(EntryType type, int32_t arg1, const uint8_t* arg2, size_t len);
+
+  int32_t tryWriteString(
+      EntryType type,
+      int32_t arg1,
+      const uint8_t* arg2,
+      size_t len,
+      uint32_t spin_budget);
+
+  // See Logger::writeAnnotation().
+  int32_t writeAnnotation(
+      EntryType type,
+      int64_t timestamp,
+      int32_t tid,
+      int32_t matchid,
+      std::initializer_list<KeyValue> pairs);
+
+  //
+  // Equivalent to write() / writeBytes(), but never wait for a ring slot,
+  // see Logger::tryWrite(). Return 0 if the entry was dropped from every
+  // buffer, the entry ID otherwise.
+  //
+  template <class T>
+  int32_t tryWrite(T&& entry, uint32_t spin_budget) {
+    auto id = entryID_.next();
+    entry.id = id;
+
+    return writeToAll(entry, spin_budget) ? id : 0;
+  }
+
+  int32_t tryWriteBytes(
+      EntryType type,
+      int32_t arg1,
+      const uint8_t* arg2,
+      size_t len,
+      uint32_t spin_budget);
+
  private:
-  pthread_rwlock_t lock_ = PTHREAD_RWLOCK_INITIALIZER;
-  std::vector<std::shared_ptr<Buffer>> buffers_{};
+  using BufferSet = std::vector<std::shared_ptr<Buffer>>;
+
+  // Per-thread hazard slot. Records are never freed while the logger is
+  // alive; the ones left behind by exited threads get reused.
+  struct Reader {
+    std::atomic<const BufferSet*> hazard;
+    std::atomic<bool> in_use;
+    Reader* next;
+  };
+
+  // Keeps the current buffer set alive for the duration of a write.
+  class BufferSetGuard {
+   public:
+    explicit BufferSetGuard(MultiBufferLogger& logger);
+    BufferSetGuard(const BufferSetGuard&) = delete;
+    BufferSetGuard& operator=(const BufferSetGuard&) = delete;
+    ~BufferSetGuard();
+
+    const BufferSet& buffers() const {
+      return *set_;
+    }
+
+   private:
+    Reader* reader_;
+    const BufferSet* set_;
+    // Only used if we couldn't get a Reader for this thread.
+    std::unique_lock<std::mutex> fallback_lock_;
+  };
+
+  std::atomic<const BufferSet*> buffers_;
+  std::atomic<Reader*> readers_;
+  pthread_key_t reader_key_;
+  // Serializes updates to buffers_.
+  std::mutex update_mutex_;
   EntryIDCounter& entryID_;
+
+  Reader* currentReader();
+
+  // spin_budget for writeToAll() to wait for ring slots as long as needed.
+  static constexpr uint32_t kNoSpinBudget = Logger::kNoSpinBudget;
+
+  // Serializes `entry` once per encoding and writes the same packets to
+  // every buffer. Returns false if every buffer dropped it.
+  template <class T>
+  bool writeToAll(const T& entry, uint32_t spin_budget = kNoSpinBudget) {
+    auto size = T::calculateSize(entry);
+    char payload[size];
+    T::pack(entry, payload, size);
+
+    auto count = PacketLogger::packetCount(size);
+    Packet packets[count];
+    PacketLogger::fragment(payload, size, packets);
+
+    // Only packed if some buffer wants compact entries.
+    Packet compact;
+    bool compact_packed = false;
+    bool has_compact = false;
+    // Tiered buffers never compact these, see Logger's constructor.
+    bool high_priority = is_high_priority(entry.type);
+
+    BufferSetGuard guard(*this);
+    bool written = guard.buffers().empty();
+    for (auto& buf : guard.buffers()) {
+      auto& logger = buf->logger();
+      Packet* buffer_packets = packets;
+      uint32_t buffer_count = count;
+      bool appendable = false;
+      if (logger.compactEntries() && !(high_priority && logger.tiered())) {
+        if (!compact_packed) {
+          has_compact = Logger::packCompact(entry, compact);
+          compact_packed = true;
+        }
+        if (has_compact) {
+          buffer_packets = &compact;
+          buffer_count = 1;
+          appendable = true;
+        }
+      }
+
+      if (spin_budget == kNoSpinBudget) {
+        logger.writePackets(entry, buffer_packets, buffer_count, appendable);
+        written = true;
+      } else if (logger.tryWritePackets(
+                     entry, buffer_packets, buffer_count, spin_budget)) {
+        written = true;
+      }
+    }
+    return written;
+  }
+
+  // Installs `set` and frees the previous one once no reader uses it.
+  // Requires update_mutex_.
+  void replaceBuffers(std::unique_ptr<BufferSet> set);
 };
 
 } // namespace logger
@@ -16,14 +16,39 @@
 
 #include "PacketLogger.h"
 
+#include <pthread.h>
 #include <stdexcept>
 
 namespace facebook {
 namespace profilo {
 namespace logger {
 
-PacketLogger::PacketLogger(TraceBufferProvider provider)
-    : streamID_(0), provider_(provider) {}
+namespace {
+
+// Per-thread count of dropped writes, stored in the key's value itself so
+// that counting never allocates.
+pthread_key_t dropped_writes_key;
+pthread_once_t dropped_writes_once = PTHREAD_ONCE_INIT;
+
+void createDroppedWritesKey() {
+  pthread_key_create(&dropped_writes_key, nullptr);
+}
+
+void countDroppedWrite() {
+  pthread_once(&dropped_writes_once, createDroppedWritesKey);
+  auto count =
+      reinterpret_cast<uintptr_t>(pthread_getspecific(dropped_writes_key));
+  pthread_setspecific(dropped_writes_key, reinterpret_cast<void*>(count + 1));
+}
+
+} // namespace
+
+PacketLogger::PacketLogger(TraceBufferProvider provider, bool write_combining)
+    : streamID_(Packet::kPacketIdNone + 1),
+      provider_(provider),
+      combiner_(
+          write_combining ? std::make_unique<WriteCombiner>(provider)
+                          : nullptr) {}
 
 void PacketLogger::write(void* payload, size_t size) {
   writeAndGetCursor(payload, size);
@@ -40,40 +65,176 @@ TraceBuffer::Cursor PacketLogger::writeAndGetCursor(
     throw std::invalid_argument("payload is null");
   }
 
-  auto& buffer = provider_();
+  auto writer = startWrite(size);
+  writer.write(payload, size);
+  return writer.cursor();
+}
 
-  TraceBuffer::Cursor cursor = buffer.currentTail();
-  bool cursor_set = false;
+void PacketLogger::writeCombined(void* payload, size_t size) {
+  if (size == 0) {
+    throw std::invalid_argument("size is 0");
+  }
 
-  StreamID stream_id = streamID_.fetch_add(1, std::memory_order_relaxed);
+  if (payload == nullptr) {
+    throw std::invalid_argument("payload is null");
+  }
 
-  size_t offset = 0;
-  while (offset < size) {
-    const auto kOnePacketSize = sizeof(Packet::data);
+  auto packet_count = packetCount(size);
+  Packet packets[packet_count];
+  fragment(payload, size, packets);
+  writePacketsCombined(packets, packet_count);
+}
+
+void PacketLogger::fragment(const void* payload, size_t size, Packet* packets) {
+  const auto kOnePacketSize = sizeof(Packet::data);
 
+  size_t offset = 0;
+  for (Packet* packet = packets; offset < size; ++packet) {
     auto remaining = size - offset;
     bool has_next = remaining > kOnePacketSize;
     uint8_t write_size = std::min(kOnePacketSize, remaining);
 
-    Packet packet{
-        .stream = stream_id,
+    *packet = Packet{
+        .stream = Packet::kPacketIdNone,
         .start = offset == 0,
         .next = has_next,
         .size = write_size,
         .data = {}};
 
-    std::memcpy(packet.data, static_cast<char*>(payload) + offset, write_size);
-
-    if (!cursor_set) {
-      cursor = buffer.writeAndGetCursor(packet);
-      cursor_set = true;
-    } else {
-      buffer.write(packet);
-    }
+    std::memcpy(
+        packet->data, static_cast<const char*>(payload) + offset, write_size);
     offset += write_size;
   }
+}
+
+TraceBuffer::Cursor PacketLogger::writePackets(
+    Packet* packets,
+    uint32_t count) {
+  if (combiner_) {
+    // Keep this thread's writes in order.
+    combiner_->flushCurrentThread();
+  }
+
+  auto& buffer = provider_();
+
+  // Single-packet payloads are never reassembled, so they don't need a
+  // stream ID.
+  StreamID stream_id = Packet::kPacketIdNone;
+  if (count > 1) {
+    stream_id = nextStreamID();
+  }
+
+  // Claim all slots for this payload at once. This keeps the stream contiguous
+  // in the buffer and costs one ticket increment instead of one per packet.
+  TraceBuffer::Cursor start_cursor = buffer.reserve(count);
+  TraceBuffer::Cursor cursor = start_cursor;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    packets[i].stream = stream_id;
+    buffer.writeReserved(cursor, packets[i]);
+    cursor.moveForward();
+  }
+
+  return start_cursor;
+}
+
+bool PacketLogger::tryWrite(void* payload, size_t size, uint32_t spin_budget) {
+  if (size == 0) {
+    throw std::invalid_argument("size is 0");
+  }
 
-  return cursor;
+  if (payload == nullptr) {
+    throw std::invalid_argument("payload is null");
+  }
+
+  auto packet_count = packetCount(size);
+  Packet packets[packet_count];
+  fragment(payload, size, packets);
+  return tryWritePackets(packets, packet_count, spin_budget);
+}
+
+bool PacketLogger::tryWritePackets(
+    Packet* packets,
+    uint32_t count,
+    uint32_t spin_budget) {
+  // Keep this thread's writes in order. If the staged packets can't be
+  // published without waiting, this payload can't go ahead of them.
+  if (combiner_ && !combiner_->tryFlushCurrentThread(spin_budget)) {
+    countDroppedWrite();
+    return false;
+  }
+
+  auto& buffer = provider_();
+  TraceBuffer::Cursor cursor = buffer.currentHead();
+  if (!buffer.tryReserve(count, spin_budget, cursor)) {
+    countDroppedWrite();
+    return false;
+  }
+
+  StreamID stream_id = Packet::kPacketIdNone;
+  if (count > 1) {
+    stream_id = nextStreamID();
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    packets[i].stream = stream_id;
+    buffer.writeReserved(cursor, packets[i]);
+    cursor.moveForward();
+  }
+  return true;
+}
+
+StreamID PacketLogger::nextStreamID() {
+  // kPacketIdNone marks single-packet entries, so a multi-packet stream must
+  // never be handed it when the counter wraps.
+  StreamID stream_id;
+  do {
+    stream_id = streamID_.fetch_add(1, std::memory_order_relaxed);
+  } while (stream_id == Packet::kPacketIdNone);
+  return stream_id;
+}
+
+uint64_t PacketLogger::droppedWrites() {
+  pthread_once(&dropped_writes_once, createDroppedWritesKey);
+  return reinterpret_cast<uintptr_t>(pthread_getspecific(dropped_writes_key));
+}
+
+SlotWriter PacketLogger::startWrite(size_t size) {
+  if (size == 0) {
+    throw std::invalid_argument("size is 0");
+  }
+
+  if (combiner_) {
+    // Keep this thread's writes in order.
+    combiner_->flushCurrentThread();
+  }
+
+  StreamID stream_id = Packet::kPacketIdNone;
+  if (packetCount(size) > 1) {
+    stream_id = nextStreamID();
+  }
+  return SlotWriter(provider_(), stream_id, size);
+}
+
+void PacketLogger::writePacketsCombined(
+    Packet* packets,
+    uint32_t count,
+    bool appendable) {
+  if (combiner_ && count == 1 && combiner_->stage(packets[0], appendable)) {
+    return;
+  }
+  writePackets(packets, count);
+}
+
+void PacketLogger::flushCurrentThread() {
+  if (combiner_) {
+    combiner_->flushCurrentThread();
+  }
+}
+
+void PacketLogger::flushAll() {
+  if (combiner_) {
+    combiner_->flushAll();
+  }
 }
 
 } // namespace logger
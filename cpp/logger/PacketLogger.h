@@ -20,6 +20,10 @@
 #include <profilo/logger/buffer/TraceBuffer.h>
 #include <profilo/logger/lfrb/LockFreeRingBuffer.h>
 #include <functional>
+#include <memory>
+
+#include "SlotWriter.h"
+#include "WriteCombiner.h"
 
 #define PROFILOEXPORT __attribute__((visibility("default")))
 
@@ -29,11 +33,13 @@ class Logger;
 
 namespace logger {
 
-using TraceBufferProvider = std::function<TraceBuffer&()>;
-
 class PacketLogger {
  public:
-  PacketLogger(TraceBufferProvider provider);
+  //
+  // write_combining: stage single-packet writeCombined() calls in a
+  // per-thread WriteCombiner instead of writing them to the ring directly.
+  //
+  PacketLogger(TraceBufferProvider provider, bool write_combining = false);
   PacketLogger(const PacketLogger& other) = delete;
 
   PROFILOEXPORT void write(void* payload, size_t size);
@@ -41,9 +47,110 @@ class PacketLogger {
       void* payload,
       size_t size);
 
+  //
+  // Equivalent to write() but, if write combining is enabled, a payload that
+  // fits in one packet may be held back in the calling thread's staging area.
+  // See WriteCombiner for the ordering guarantees.
+  //
+  PROFILOEXPORT void writeCombined(void* payload, size_t size);
+
+  //
+  // Number of packets a payload of `size` bytes is split into.
+  //
+  static uint32_t packetCount(size_t size) {
+    return SlotWriter::packetCount(size);
+  }
+
+  //
+  // Split a payload into packetCount(size) packets, without assigning a
+  // stream. The result can be passed to writePackets() of any number of
+  // PacketLoggers, so that a payload going to several buffers is only
+  // serialized and split once.
+  //
+  PROFILOEXPORT static void
+  fragment(const void* payload, size_t size, Packet* packets);
+
+  //
+  // Write packets produced by fragment() as one contiguous stream.
+  // Assigns this logger's next stream ID to multi-packet payloads.
+  //
+  PROFILOEXPORT TraceBuffer::Cursor writePackets(
+      Packet* packets,
+      uint32_t count);
+
+  //
+  // Equivalent to write() / writePackets(), but never waits: slots are only
+  // claimed once they're free, see LockFreeRingBuffer::tryReserve(). If
+  // that doesn't happen within `spin_budget` retries, the payload is
+  // dropped, counted in droppedWrites() and false is returned. Retries are
+  // used up by slots still being written from the previous wrap-around and
+  // by other writers claiming the slots first.
+  //
+  // With write combining, the calling thread's staged packets are published
+  // first the same way (see WriteCombiner::tryFlushCurrentThread()). If they
+  // can't be, the payload is dropped too, and they stay staged.
+  //
+  PROFILOEXPORT bool tryWrite(void* payload, size_t size, uint32_t spin_budget);
+  PROFILOEXPORT bool
+  tryWritePackets(Packet* packets, uint32_t count, uint32_t spin_budget);
+
+  //
+  // Number of payloads the calling thread dropped in tryWrite() /
+  // tryWritePackets(), across all PacketLoggers.
+  //
+  PROFILOEXPORT static uint64_t droppedWrites();
+
+  //
+  // Equivalent to writePackets() with the staging behavior of
+  // writeCombined(). See WriteCombiner::stage() for `appendable`.
+  //
+  PROFILOEXPORT void writePacketsCombined(
+      Packet* packets,
+      uint32_t count,
+      bool appendable = false);
+
+  //
+  // Reserve slots for a `size` byte payload and return a writer that
+  // serializes it into them in place, as one contiguous stream. Equivalent
+  // to writeAndGetCursor() without the intermediate copies.
+  //
+  PROFILOEXPORT SlotWriter startWrite(size_t size);
+
+  bool writeCombining() const {
+    return combiner_ != nullptr;
+  }
+
+  //
+  // Cursor of the ring slot the next write will start at.
+  //
+  TraceBuffer::Cursor currentHead() {
+    return provider_().currentHead();
+  }
+
+  //
+  // Ring the calling thread writes to.
+  //
+  TraceBuffer& currentBuffer() {
+    return provider_();
+  }
+
+  uint32_t capacity() {
+    return provider_().capacity();
+  }
+
+  //
+  // Publish packets staged by the calling thread / by all threads.
+  // No-ops if write combining is disabled.
+  //
+  PROFILOEXPORT void flushCurrentThread();
+  PROFILOEXPORT void flushAll();
+
  private:
+  StreamID nextStreamID();
+
   std::atomic<uint32_t> streamID_;
   TraceBufferProvider provider_;
+  std::unique_ptr<WriteCombiner> combiner_;
 };
 
 } // namespace logger
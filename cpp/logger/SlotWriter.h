@@ -0,0 +1,160 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include <profilo/logger/buffer/Packet.h>
+#include <profilo/logger/buffer/TraceBuffer.h>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+//
+// Byte sink that writes a payload straight into reserved TraceBuffer slots,
+// splitting it into packets on the way.
+//
+// The constructor reserves enough slots for `size` bytes; write() and pad()
+// fill them in order and publish each slot as soon as its packet is full.
+// This is what the sink overload of the generated Entry::pack() writes to,
+// so an entry goes from its struct to the ring without intermediate copies.
+//
+// Every reserved slot must be published, otherwise writers block on it after
+// the next wrap-around. The destructor zero-fills and publishes whatever the
+// caller didn't write.
+//
+// Templated on the packet type so it works with any slot size; SlotWriter
+// writes to a TraceBuffer.
+//
+template <class PacketT>
+class BasicSlotWriter {
+ public:
+  using Buffer = lfrb::LockFreeRingBuffer<PacketT>;
+  using Cursor = typename Buffer::Cursor;
+
+  BasicSlotWriter(Buffer& buffer, StreamID stream, size_t size) noexcept
+      : buffer_(&buffer),
+        start_(buffer.reserve(packetCount(size))),
+        cursor_(start_),
+        stream_(stream),
+        remaining_(size),
+        first_(true),
+        packet_(nullptr),
+        offset_(0) {}
+
+  BasicSlotWriter(const BasicSlotWriter&) = delete;
+  BasicSlotWriter& operator=(const BasicSlotWriter&) = delete;
+
+  BasicSlotWriter(BasicSlotWriter&& other) noexcept
+      : buffer_(other.buffer_),
+        start_(other.start_),
+        cursor_(other.cursor_),
+        stream_(other.stream_),
+        remaining_(other.remaining_),
+        first_(other.first_),
+        packet_(other.packet_),
+        offset_(other.offset_) {
+    other.remaining_ = 0;
+    other.packet_ = nullptr;
+  }
+
+  ~BasicSlotWriter() {
+    if (remaining_ > 0 || packet_ != nullptr) {
+      pad(remaining_ + (packet_ != nullptr ? packet_->size - offset_ : 0));
+    }
+  }
+
+  static uint32_t packetCount(size_t size) {
+    constexpr auto kOnePacketSize = sizeof(PacketT::data);
+    return (size + kOnePacketSize - 1) / kOnePacketSize;
+  }
+
+  // Cursor of the first packet.
+  Cursor cursor() const {
+    return start_;
+  }
+
+  // Callers must not write more than the size passed to the constructor.
+  void write(const void* src, size_t size) noexcept {
+    auto src_byte = static_cast<const char*>(src);
+    while (size > 0) {
+      auto chunk = std::min(size, available());
+      std::memcpy(packet_->data + offset_, src_byte, chunk);
+      advance(chunk);
+      src_byte += chunk;
+      size -= chunk;
+    }
+  }
+
+  // Writes `size` zero bytes.
+  void pad(size_t size) noexcept {
+    while (size > 0) {
+      auto chunk = std::min(size, available());
+      std::memset(packet_->data + offset_, 0, chunk);
+      advance(chunk);
+      size -= chunk;
+    }
+  }
+
+ private:
+  Buffer* buffer_;
+  Cursor start_;
+  Cursor cursor_;
+  StreamID stream_;
+  // Bytes not yet assigned to a packet.
+  size_t remaining_;
+  bool first_;
+  // Slot currently being written, if any.
+  PacketT* packet_;
+  size_t offset_;
+
+  // Room left in the current packet, opening the next slot if needed.
+  size_t available() noexcept {
+    if (packet_ == nullptr) {
+      constexpr auto kOnePacketSize = sizeof(PacketT::data);
+      auto size = std::min(kOnePacketSize, remaining_);
+      remaining_ -= size;
+
+      packet_ = &buffer_->beginWriteReserved(cursor_);
+      packet_->stream = stream_;
+      packet_->start = first_;
+      packet_->next = remaining_ > 0;
+      packet_->size = size;
+      first_ = false;
+      offset_ = 0;
+    }
+    return packet_->size - offset_;
+  }
+
+  void advance(size_t size) noexcept {
+    offset_ += size;
+    if (offset_ == packet_->size) {
+      buffer_->endWriteReserved(cursor_);
+      cursor_.moveForward();
+      packet_ = nullptr;
+    }
+  }
+};
+
+using SlotWriter = BasicSlotWriter<Packet>;
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,154 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "StringTable.h"
+
+#include <cstring>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+constexpr uint32_t StringTable::kDefaultMaxStrings;
+constexpr size_t StringTable::kDefaultArenaSize;
+
+namespace {
+
+uint32_t slotCount(uint32_t max_strings) {
+  // Keep the load factor under 1/2 so probe sequences stay short.
+  uint32_t count = 1;
+  while (count < max_strings * 2) {
+    count <<= 1;
+  }
+  return count;
+}
+
+// FNV-1a. 0 marks empty slots, so it's never returned.
+uint64_t hashOf(const void* str, size_t size) {
+  auto bytes = static_cast<const uint8_t*>(str);
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash == 0 ? 1 : hash;
+}
+
+} // namespace
+
+StringTable::StringTable(
+    uint32_t max_strings,
+    size_t arena_size,
+    uint32_t first_id)
+    : max_strings_(max_strings),
+      mask_(slotCount(max_strings) - 1),
+      first_id_(first_id),
+      arena_size_(arena_size),
+      slots_(new Slot[mask_ + 1]),
+      arena_(new char[arena_size]),
+      count_(0),
+      arena_used_(0),
+      arena_full_(false) {
+  for (uint32_t i = 0; i <= mask_; ++i) {
+    slots_[i].hash.store(0, std::memory_order_relaxed);
+    slots_[i].state.store(EMPTY, std::memory_order_relaxed);
+    slots_[i].offset = 0;
+    slots_[i].size = 0;
+  }
+}
+
+uint32_t StringTable::intern(const void* str, size_t size, bool& inserted) {
+  inserted = false;
+  auto hash = hashOf(str, size);
+
+  for (uint32_t probe = 0; probe <= mask_; ++probe) {
+    auto index = (hash + probe) & mask_;
+    auto& slot = slots_[index];
+    auto slot_hash = slot.hash.load(std::memory_order_acquire);
+
+    if (slot_hash == 0) {
+      if (count_.load(std::memory_order_relaxed) >= max_strings_) {
+        return 0;
+      }
+      if (slot.hash.compare_exchange_strong(slot_hash, hash)) {
+        count_.fetch_add(1, std::memory_order_relaxed);
+        auto offset = arena_used_.load(std::memory_order_relaxed);
+        do {
+          if (offset + size > arena_size_) {
+            arena_full_.store(true, std::memory_order_relaxed);
+            slot.state.store(FAILED, std::memory_order_release);
+            return 0;
+          }
+        } while (!arena_used_.compare_exchange_weak(offset, offset + size));
+        std::memcpy(&arena_[offset], str, size);
+        slot.offset = offset;
+        slot.size = size;
+        slot.state.store(PENDING, std::memory_order_release);
+        inserted = true;
+        return first_id_ + index;
+      }
+      // Lost the race for this slot, slot_hash now holds the winner's hash.
+    }
+
+    if (slot_hash != hash) {
+      continue;
+    }
+
+    if (slot.state.load(std::memory_order_acquire) != PUBLISHED) {
+      // Still being inserted, or failed to. Barring a 64-bit hash
+      // collision, that's our string.
+      return 0;
+    }
+    if (slot.size == size &&
+        std::memcmp(&arena_[slot.offset], str, size) == 0) {
+      return first_id_ + index;
+    }
+  }
+  return 0;
+}
+
+void StringTable::publish(uint32_t id) {
+  slots_[id - first_id_].state.store(PUBLISHED, std::memory_order_release);
+}
+
+bool StringTable::lookup(uint32_t id, const char*& str, size_t& size) const {
+  if (id < first_id_ || id - first_id_ > mask_) {
+    return false;
+  }
+  auto& slot = slots_[id - first_id_];
+  if (slot.state.load(std::memory_order_acquire) != PUBLISHED) {
+    return false;
+  }
+  str = &arena_[slot.offset];
+  size = slot.size;
+  return true;
+}
+
+void StringTable::forEach(
+    const std::function<void(uint32_t id, const char* str, size_t size)>& fn)
+    const {
+  for (uint32_t i = 0; i <= mask_; ++i) {
+    auto& slot = slots_[i];
+    if (slot.state.load(std::memory_order_acquire) == PUBLISHED) {
+      fn(first_id_ + i, &arena_[slot.offset], slot.size);
+    }
+  }
+}
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
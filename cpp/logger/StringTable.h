@@ -0,0 +1,121 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+//
+// Fixed-size, lock-free string -> ID dictionary backing interned string
+// entries (see Logger::writeString()).
+//
+// Strings are never removed. IDs are stable for the lifetime of the table
+// and start at `first_id`, which is never 0, so 0 can mean "not interned".
+// Giving a table's replacement the IDs after lastID() keeps references to
+// both apart.
+//
+// A string inserted by intern() is pending until its inserter calls
+// publish(). In the meantime, lookups of the same string return 0, which
+// lets the inserter log the string's definition before anybody logs a
+// reference to it.
+//
+class StringTable {
+ public:
+  static constexpr uint32_t kDefaultMaxStrings = 1024;
+  static constexpr size_t kDefaultArenaSize = 64 * 1024;
+
+  StringTable(
+      uint32_t max_strings = kDefaultMaxStrings,
+      size_t arena_size = kDefaultArenaSize,
+      uint32_t first_id = 1);
+  StringTable(const StringTable&) = delete;
+  StringTable& operator=(const StringTable&) = delete;
+
+  //
+  // Returns the ID of `str`, inserting it if needed. `inserted` is set if
+  // this call inserted it, in which case the caller must publish() it.
+  // Returns 0 if `str` is pending, or the table or its arena is full.
+  //
+  uint32_t intern(const void* str, size_t size, bool& inserted);
+
+  void publish(uint32_t id);
+
+  // Returns false unless `id` is a published string.
+  bool lookup(uint32_t id, const char*& str, size_t& size) const;
+
+  // Calls `fn` for every published string.
+  void forEach(
+      const std::function<void(uint32_t id, const char* str, size_t size)>&
+          fn) const;
+
+  uint32_t size() const {
+    return std::min(count_.load(std::memory_order_relaxed), max_strings_);
+  }
+
+  // Whether intern() has turned a string away for lack of room.
+  bool full() const {
+    return count_.load(std::memory_order_relaxed) >= max_strings_ ||
+        arena_full_.load(std::memory_order_relaxed);
+  }
+
+  uint32_t firstID() const {
+    return first_id_;
+  }
+
+  uint32_t lastID() const {
+    return first_id_ + mask_;
+  }
+
+ private:
+  enum State : uint32_t {
+    EMPTY = 0,
+    PENDING = 1,
+    PUBLISHED = 2,
+    // Arena ran out while inserting, the string is never interned.
+    FAILED = 3,
+  };
+
+  struct Slot {
+    std::atomic<uint64_t> hash;
+    std::atomic<uint32_t> state;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  const uint32_t max_strings_;
+  const uint32_t mask_;
+  const uint32_t first_id_;
+  const size_t arena_size_;
+  std::unique_ptr<Slot[]> slots_;
+  std::unique_ptr<char[]> arena_;
+  std::atomic<uint32_t> count_;
+  std::atomic<size_t> arena_used_;
+  std::atomic<bool> arena_full_;
+};
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,277 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WriteCombiner.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <new>
+#include <system_error>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+constexpr uint8_t WriteCombiner::kNoHolder;
+constexpr uint8_t WriteCombiner::kThreadHolder;
+constexpr uint8_t WriteCombiner::kFlushHolder;
+
+std::atomic<WriteCombiner::StagingArea*> WriteCombiner::areas_{nullptr};
+
+WriteCombiner::WriteCombiner(TraceBufferProvider provider)
+    : provider_(std::move(provider)), key_() {
+  int ret = pthread_key_create(&key_, &WriteCombiner::onThreadExit);
+  if (ret != 0) {
+    throw std::system_error(
+        ret, std::system_category(), "Could not create staging area key");
+  }
+}
+
+WriteCombiner::~WriteCombiner() {
+  // Deleting the key doesn't run destructors, but threads that are exiting
+  // right now may still be in onThreadExit(). Once we've released an area
+  // under its lock, those leave it alone.
+  pthread_key_delete(key_);
+
+  for (auto area = areas_.load(std::memory_order_acquire); area != nullptr;
+       area = area->next) {
+    if (area->combiner.load(std::memory_order_acquire) != this) {
+      continue;
+    }
+    lock(*area, kFlushHolder);
+    if (area->combiner.load(std::memory_order_relaxed) == this) {
+      publish(*area);
+      release(*area);
+    }
+    unlock(*area);
+  }
+}
+
+WriteCombiner::StagingArea* WriteCombiner::currentArea() noexcept {
+  auto area = static_cast<StagingArea*>(pthread_getspecific(key_));
+  if (area != nullptr) {
+    return area;
+  }
+  area = acquireArea();
+  if (area != nullptr) {
+    pthread_setspecific(key_, area);
+  }
+  return area;
+}
+
+WriteCombiner::StagingArea* WriteCombiner::acquireArea() noexcept {
+  // Try to recycle an area left behind by an exited thread.
+  for (auto area = areas_.load(std::memory_order_acquire); area != nullptr;
+       area = area->next) {
+    bool expected = false;
+    if (area->in_use.compare_exchange_strong(expected, true)) {
+      // Released areas are empty.
+      area->owner.store(pthread_self(), std::memory_order_relaxed);
+      area->combiner.store(this, std::memory_order_release);
+      return area;
+    }
+  }
+
+  // mmap instead of new, so that a signal handler interrupting malloc can't
+  // deadlock here.
+  void* mem = mmap(
+      nullptr,
+      sizeof(StagingArea),
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  if (mem == MAP_FAILED) {
+    return nullptr;
+  }
+
+  auto area = new (mem) StagingArea();
+  area->in_use.store(true);
+  area->owner.store(pthread_self());
+  area->combiner.store(this);
+  area->holder.store(kNoHolder);
+  area->count.store(0);
+  area->tail_appendable = false;
+
+  auto head = areas_.load();
+  do {
+    area->next = head;
+  } while (!areas_.compare_exchange_weak(head, area));
+  return area;
+}
+
+void WriteCombiner::lock(StagingArea& area, uint8_t holder) noexcept {
+  auto expected = kNoHolder;
+  while (!area.holder.compare_exchange_weak(
+      expected, holder, std::memory_order_acquire)) {
+    expected = kNoHolder;
+    sched_yield();
+  }
+}
+
+void WriteCombiner::unlock(StagingArea& area) noexcept {
+  area.holder.store(kNoHolder, std::memory_order_release);
+}
+
+void WriteCombiner::release(StagingArea& area) noexcept {
+  // Release, so that a combiner that skips the area without locking it
+  // sees the last publish() as done.
+  area.combiner.store(nullptr, std::memory_order_release);
+  area.in_use.store(false, std::memory_order_release);
+}
+
+void WriteCombiner::publish(StagingArea& area) noexcept {
+  auto count = area.count.load(std::memory_order_relaxed);
+  if (count == 0) {
+    return;
+  }
+
+  auto& buffer = provider_();
+  auto cursor = buffer.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    buffer.writeReserved(cursor, area.packets[i]);
+    cursor.moveForward();
+  }
+  area.count.store(0, std::memory_order_release);
+  area.tail_appendable = false;
+}
+
+bool WriteCombiner::stage(Packet const& packet, bool appendable) noexcept {
+  auto area = currentArea();
+  if (area == nullptr) {
+    return false;
+  }
+
+  auto expected = kNoHolder;
+  if (!area->holder.compare_exchange_strong(
+          expected, kThreadHolder, std::memory_order_acquire)) {
+    // Either we interrupted ourselves from a signal handler or flushAll() is
+    // draining our area right now. Don't wait here: the direct write this
+    // falls back to waits for flushAll() in flushCurrentThread().
+    return false;
+  }
+
+  auto count = area->count.load(std::memory_order_relaxed);
+  if (appendable && area->tail_appendable) {
+    auto& tail = area->packets[count - 1];
+    if (static_cast<size_t>(tail.size + packet.size) <= sizeof(tail.data)) {
+      std::memcpy(tail.data + tail.size, packet.data, packet.size);
+      tail.size += packet.size;
+      unlock(*area);
+      return true;
+    }
+  }
+
+  area->packets[count] = packet;
+  area->tail_appendable = appendable;
+  area->count.store(count + 1, std::memory_order_relaxed);
+  if (count + 1 == kStagedPackets) {
+    publish(*area);
+  }
+
+  unlock(*area);
+  return true;
+}
+
+void WriteCombiner::flushCurrentThread() noexcept {
+  auto area = static_cast<StagingArea*>(pthread_getspecific(key_));
+  if (area == nullptr || area->count.load(std::memory_order_acquire) == 0) {
+    return;
+  }
+
+  auto expected = kNoHolder;
+  while (!area->holder.compare_exchange_weak(
+      expected, kThreadHolder, std::memory_order_acquire)) {
+    if (expected == kThreadHolder) {
+      // We interrupted ourselves from a signal handler while staging.
+      return;
+    }
+    // flushAll() is publishing our packets, our next write has to wait for
+    // it to keep program order.
+    expected = kNoHolder;
+    sched_yield();
+  }
+  publish(*area);
+  unlock(*area);
+}
+
+bool WriteCombiner::tryFlushCurrentThread(uint32_t spins) noexcept {
+  auto area = static_cast<StagingArea*>(pthread_getspecific(key_));
+  if (area == nullptr || area->count.load(std::memory_order_acquire) == 0) {
+    return true;
+  }
+
+  auto expected = kNoHolder;
+  if (!area->holder.compare_exchange_strong(
+          expected, kThreadHolder, std::memory_order_acquire)) {
+    // Same as flushCurrentThread(), except that we can't wait for
+    // flushAll().
+    return expected == kThreadHolder;
+  }
+
+  auto count = area->count.load(std::memory_order_relaxed);
+  auto& buffer = provider_();
+  TraceBuffer::Cursor cursor = buffer.currentHead();
+  if (!buffer.tryReserve(count, spins, cursor)) {
+    unlock(*area);
+    return false;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    buffer.writeReserved(cursor, area->packets[i]);
+    cursor.moveForward();
+  }
+  area->count.store(0, std::memory_order_release);
+  area->tail_appendable = false;
+  unlock(*area);
+  return true;
+}
+
+void WriteCombiner::flushAll() noexcept {
+  for (auto area = areas_.load(std::memory_order_acquire); area != nullptr;
+       area = area->next) {
+    // Areas of other combiners, or free ones.
+    if (area->combiner.load(std::memory_order_acquire) != this) {
+      continue;
+    }
+    lock(*area, kFlushHolder);
+    if (area->combiner.load(std::memory_order_relaxed) == this) {
+      publish(*area);
+    }
+    unlock(*area);
+  }
+}
+
+void WriteCombiner::onThreadExit(void* ptr) {
+  auto area = static_cast<StagingArea*>(ptr);
+  lock(*area, kThreadHolder);
+  // The combiner may have released the area since, and someone else may
+  // have claimed it. If it's still ours, the combiner is alive: its
+  // destructor waits for the lock. Claims store the owner before the
+  // combiner.
+  auto combiner = area->combiner.load(std::memory_order_acquire);
+  if (combiner != nullptr &&
+      pthread_equal(
+          area->owner.load(std::memory_order_relaxed), pthread_self())) {
+    combiner->publish(*area);
+    release(*area);
+  }
+  unlock(*area);
+}
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,164 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <atomic>
+#include <functional>
+
+#include <profilo/logger/buffer/Packet.h>
+#include <profilo/logger/buffer/TraceBuffer.h>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+using TraceBufferProvider = std::function<TraceBuffer&()>;
+
+//
+// Per-thread front buffer for a TraceBuffer.
+//
+// Every writing thread gets a small staging area that collects single-packet
+// writes. A full area is published to the ring with a single reservation, so
+// most writes never touch the shared ticket.
+//
+// Staged packets are published when:
+//  - the calling thread's area is full;
+//  - the calling thread exits;
+//  - the calling thread calls flushCurrentThread() (PacketLogger does this
+//    before every write it doesn't stage);
+//  - anybody calls flushAll() (e.g. TraceWriter before it blocks waiting for
+//    new data, or Logger before it writes a trace control entry).
+//
+// Nothing publishes the area of a thread that goes idle. Up to
+// kStagedPackets of its last packets stay outside the ring until one of the
+// above happens, and are lost if the process dies first. This matters for
+// buffers that are only read after a crash (e.g. mmap-backed buffers with no
+// running TraceWriter): enable write combining on them only if losing each
+// thread's most recent packets is acceptable.
+//
+// Ordering guarantees:
+//  - Packets written by one thread reach the ring in program order. The only
+//    exception is a write made from a signal handler that interrupted the
+//    same thread while it was staging: that write bypasses the area and lands
+//    before the packets that were staged at the time.
+//  - Packets written by different threads are not ordered with respect to
+//    each other. A staged packet may land after packets that another thread
+//    wrote later, so readers must order across threads by timestamp.
+//  - When flushAll() returns, every packet staged before the call started is
+//    in the ring.
+//
+class WriteCombiner {
+ public:
+  static constexpr uint32_t kStagedPackets = 32;
+
+  explicit WriteCombiner(TraceBufferProvider provider);
+  WriteCombiner(const WriteCombiner&) = delete;
+  WriteCombiner& operator=(const WriteCombiner&) = delete;
+
+  // Publishes all staged packets and gives the areas back to the pool. No
+  // thread may write through this instance during or after destruction, but
+  // threads may exit at any time.
+  ~WriteCombiner();
+
+  //
+  // Stages a packet in the calling thread's area.
+  // Returns false if the packet could not be staged and must be written to
+  // the ring directly.
+  //
+  // Appendable packets hold payloads that readers can parse when
+  // concatenated (e.g. compact entries). If the previously staged packet is
+  // also appendable and has room left, the payload is appended to it instead
+  // of taking another slot.
+  //
+  bool stage(Packet const& packet, bool appendable = false) noexcept;
+
+  //
+  // Publishes the calling thread's staged packets.
+  //
+  // stage() and flushCurrentThread() never block on the calling thread's own
+  // area, so a signal handler that interrupts them falls back to a direct
+  // write instead of deadlocking. They do look the area up through
+  // pthread_getspecific()/pthread_setspecific(), which POSIX does not
+  // guarantee to be async-signal-safe.
+  //
+  void flushCurrentThread() noexcept;
+
+  //
+  // Like flushCurrentThread(), but never waits: not for flushAll() to
+  // release the area, nor for ring slots (see
+  // LockFreeRingBuffer::tryReserve()). Returns false if the staged packets
+  // couldn't be published, in which case they stay staged.
+  //
+  bool tryFlushCurrentThread(uint32_t spins) noexcept;
+
+  //
+  // Publishes every thread's staged packets. Must not be called from a
+  // signal handler, as it waits for threads that are in the middle of
+  // staging.
+  //
+  void flushAll() noexcept;
+
+ private:
+  static constexpr uint8_t kNoHolder = 0;
+  // The area's own thread (or a signal handler running on it).
+  static constexpr uint8_t kThreadHolder = 1;
+  // flushAll(), from any thread.
+  static constexpr uint8_t kFlushHolder = 2;
+
+  struct StagingArea {
+    StagingArea* next;
+    // Claimed by a live thread. Only released by a holder of the area.
+    std::atomic<bool> in_use;
+    // Who claimed the area. The combiner is null while the area is free.
+    std::atomic<WriteCombiner*> combiner;
+    std::atomic<pthread_t> owner;
+    // Who holds the area while it's being modified, one of the k*Holder
+    // values below.
+    std::atomic<uint8_t> holder;
+    std::atomic<uint32_t> count;
+    // The last staged packet accepts appended payloads.
+    bool tail_appendable;
+    Packet packets[kStagedPackets];
+  };
+
+  TraceBufferProvider provider_;
+  pthread_key_t key_;
+  // Push-only list of all areas ever created, shared by all combiners.
+  // Areas are recycled once their thread exits or their combiner is
+  // destroyed, and never unmapped: pthread_key_delete() doesn't wait for
+  // threads that are already exiting, so onThreadExit() may still get an
+  // area after its combiner is gone.
+  static std::atomic<StagingArea*> areas_;
+
+  StagingArea* currentArea() noexcept;
+  StagingArea* acquireArea() noexcept;
+
+  // Waits until `holder` holds the area.
+  static void lock(StagingArea& area, uint8_t holder) noexcept;
+  static void unlock(StagingArea& area) noexcept;
+
+  // Requires the caller to hold the area.
+  void publish(StagingArea& area) noexcept;
+  static void release(StagingArea& area) noexcept;
+
+  static void onThreadExit(void* area);
+};
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -24,30 +24,64 @@ namespace logger {
 
 using StreamID = uint32_t;
 
-struct __attribute__((packed)) Packet {
+//
+// Size in bytes of one TraceBuffer slot: a packet plus the slot's turn
+// sequencer. Must be a multiple of the cache line size; 64, 128 and 256 are
+// supported.
+//
+// Larger slots split big entries (e.g. deep stack traces) into fewer packets,
+// at the cost of wasting more memory on small entries. The size is fixed for
+// the whole build (see trace_slot_size in logger/buffer/BUCK) and recorded in
+// the header of file-backed buffers, so dumps written by a build with a
+// different slot size can still be read.
+//
+#ifndef PROFILO_TRACE_SLOT_SIZE
+#define PROFILO_TRACE_SLOT_SIZE 64
+#endif
+
+constexpr size_t kTraceSlotSize = PROFILO_TRACE_SLOT_SIZE;
+
+template <size_t SlotSize>
+struct __attribute__((packed)) BasicPacket {
   constexpr static auto kPacketIdNone = 0;
   constexpr static auto kVersion = 2;
+  constexpr static size_t kSlotSize = SlotSize;
+  // The turn sequencer and the header below take 12 bytes of the slot.
+  constexpr static size_t kDataSize = SlotSize - 12;
 
   StreamID stream;
   bool start : 1;
   bool next : 1;
   uint16_t size : 14;
 
-  alignas(4) char data[52];
+  alignas(4) char data[kDataSize];
 };
 
+using Packet = BasicPacket<kTraceSlotSize>;
+
 //
 // We go through the template indirection in order to have meaningful failure
 // messages that show the actual size.
 //
-template <typename ToCheck, std::size_t RealSize = sizeof(ToCheck)>
+template <
+    typename ToCheck,
+    std::size_t SlotSize,
+    std::size_t RealSize = sizeof(ToCheck)>
 struct check_size {
   static_assert(
       RealSize % 64 == 0,
       "Size must be a multiple of the cache line size");
+  static_assert(RealSize == SlotSize, "Slot must be exactly SlotSize bytes");
 };
 struct check_size_0 {
-  check_size<lfrb::detail::RingBufferSlot<Packet, std::atomic>> check;
+  check_size<lfrb::detail::RingBufferSlot<BasicPacket<64>, std::atomic>, 64>
+      check_64;
+  check_size<lfrb::detail::RingBufferSlot<BasicPacket<128>, std::atomic>, 128>
+      check_128;
+  check_size<lfrb::detail::RingBufferSlot<BasicPacket<256>, std::atomic>, 256>
+      check_256;
+  check_size<lfrb::detail::RingBufferSlot<Packet, std::atomic>, kTraceSlotSize>
+      check;
 };
 
 } // namespace logger
@@ -0,0 +1,75 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include <profilo/logger/buffer/Packet.h>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+//
+// Converts `packet`, taken from a buffer with one slot size, into packets for
+// a buffer with another slot size and passes them to `sink` in order.
+//
+// Payload streams are kept intact: PacketReassembler produces the same
+// payloads from the output as from the input. A packet that doesn't fit in
+// one output packet is split; if it wasn't part of a stream, it's assigned
+// `next_stream`, which is then incremented. Callers should start
+// `next_stream` outside the range of IDs used in the input.
+//
+template <class To, class From, class Sink>
+void resizePacket(const From& packet, StreamID& next_stream, Sink&& sink) {
+  constexpr size_t kOutputSize = sizeof(To::data);
+
+  size_t size = packet.size;
+  if (size <= kOutputSize) {
+    To out{};
+    out.stream = packet.stream;
+    out.start = packet.start;
+    out.next = packet.next;
+    out.size = size;
+    std::memcpy(out.data, packet.data, size);
+    sink(out);
+    return;
+  }
+
+  StreamID stream = packet.stream;
+  if (stream == From::kPacketIdNone) {
+    stream = next_stream++;
+  }
+
+  for (size_t offset = 0; offset < size;) {
+    auto chunk = std::min(kOutputSize, size - offset);
+    To out{};
+    out.stream = stream;
+    out.start = packet.start && offset == 0;
+    out.next = packet.next || offset + chunk < size;
+    out.size = chunk;
+    std::memcpy(out.data, packet.data + offset, chunk);
+    sink(out);
+    offset += chunk;
+  }
+}
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -22,7 +22,11 @@
 namespace facebook {
 namespace profilo {
 
-using TraceBuffer = logger::lfrb::LockFreeRingBuffer<logger::Packet>;
+template <size_t SlotSize>
+using BasicTraceBuffer =
+    logger::lfrb::LockFreeRingBuffer<logger::BasicPacket<SlotSize>>;
+
+using TraceBuffer = BasicTraceBuffer<logger::kTraceSlotSize>;
 using TraceBufferSlot = logger::lfrb::detail::RingBufferSlot<logger::Packet>;
 
 } // namespace profilo
@@ -17,7 +17,9 @@
 #pragma once
 
 #include <unistd.h>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <memory>
@@ -66,6 +68,14 @@ ForwardIt _destroy_n(ForwardIt first, Size n) {
 namespace detail {
 template <typename T, template <typename> class Atom = std::atomic>
 class RingBufferSlot;
+
+enum class SlotReadResult {
+  SUCCESS,
+  // Not written yet or already overwritten.
+  NOT_READABLE,
+  // Overwritten while being copied.
+  TORN,
+};
 } // namespace detail
 
 /// LockFreeRingBuffer<T> is a fixed-size, concurrent ring buffer with the
@@ -103,6 +113,17 @@ class LockFreeRingBuffer {
         entryCount * sizeof(detail::RingBufferSlot<T, Atom>);
   }
 
+  /// Returns the smallest power of two that is >= entryCount.
+  /// Buffers with power-of-two capacities map tickets to slots with a
+  /// mask and a shift instead of a 64-bit division.
+  static constexpr uint32_t roundUpCapacity(uint32_t entryCount) {
+    uint32_t capacity = 1;
+    while (capacity < entryCount && capacity < (1u << 31)) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
   /// Opaque pointer to a past or future write.
   /// Can be moved relative to its current location but not in absolute terms.
   struct Cursor {
@@ -128,6 +149,12 @@ class LockFreeRingBuffer {
       return prevTicket != ticket;
     }
 
+    /// Returns the number of writes from this cursor up to, but not
+    /// including, `other`. Returns 0 if `other` is not ahead of this cursor.
+    uint64_t distanceTo(const Cursor& other) const noexcept {
+      return other.ticket > ticket ? other.ticket - ticket : 0;
+    }
+
    protected: // for test visibility reasons
     uint64_t ticket;
     friend class LockFreeRingBuffer;
@@ -159,20 +186,190 @@ class LockFreeRingBuffer {
     return Cursor(ticket);
   }
 
+  /// Reserve `count` consecutive slots with a single ticket increment.
+  /// Returns a Cursor pointing to the first reserved slot. Each reserved slot
+  /// must subsequently be published exactly once via writeReserved(), in
+  /// reservation order. Until then, readers treat the slot as not yet written.
+  Cursor reserve(uint32_t count) noexcept {
+    uint64_t ticket = ticket_.fetch_add(count);
+    return Cursor(ticket);
+  }
+
+  /// Like reserve(), but never waits. The slots at the head are only
+  /// claimed once they've been checked to be writable, i.e. their writes
+  /// from the previous wrap-around have completed, so writeReserved() and
+  /// beginWriteReserved() on them return right away.
+  ///
+  /// Makes at most `spins` + 1 attempts. An attempt fails if a checked slot
+  /// is still busy or if another writer claimed the checked slots first.
+  /// Returns false once they're used up. On success, `cursor` points to the
+  /// first reserved slot.
+  bool tryReserve(uint32_t count, uint32_t spins, Cursor& cursor) noexcept {
+    uint64_t ticket = ticket_.load(std::memory_order_relaxed);
+    for (uint32_t tries = 0;; ++tries) {
+      if (slotsWritable(ticket, count)) {
+        // On failure, `ticket` is reloaded with the current head.
+        if (ticket_.compare_exchange_strong(ticket, ticket + count)) {
+          cursor = Cursor(ticket);
+          return true;
+        }
+      } else {
+        ticket = ticket_.load(std::memory_order_relaxed);
+      }
+      if (tries == spins) {
+        return false;
+      }
+    }
+  }
+
+  /// Perform a single write of an object of type T into a slot previously
+  /// obtained from reserve().
+  /// Writes can block iff a previous writer has not yet completed a write
+  /// for the same slot (before the most recent wrap-around).
+  void writeReserved(const Cursor& cursor, T& value) noexcept {
+    slots_[idx(cursor.ticket)].write(turn(cursor.ticket), value);
+  }
+
+  /// Start an in-place write into a slot previously obtained from reserve().
+  /// Returns the slot's storage, which the caller fills in before calling
+  /// endWriteReserved() with the same cursor. The storage holds stale data
+  /// from a previous write, callers must overwrite every field they rely on.
+  /// Blocks like writeReserved(). Readers treat the slot as not yet written
+  /// until endWriteReserved(), so keep the time in between short.
+  T& beginWriteReserved(const Cursor& cursor) noexcept {
+    return slots_[idx(cursor.ticket)].beginWrite(turn(cursor.ticket));
+  }
+
+  /// Publish a slot started with beginWriteReserved().
+  void endWriteReserved(const Cursor& cursor) noexcept {
+    slots_[idx(cursor.ticket)].endWrite(turn(cursor.ticket));
+  }
+
   /// Read the value at the cursor.
   /// Returns true if the read succeeded, false otherwise. If the return
   /// value is false, dest is to be considered partially read and in an
   /// inconsistent state. Readers are advised to discard it.
-  bool tryRead(T& dest, const Cursor& cursor) noexcept {
-    return slots_[idx(cursor.ticket)].tryRead(dest, turn(cursor.ticket));
+  ///
+  /// If `tornReads` is not null, it's incremented when the read fails
+  /// because the write was overwritten while being copied. The same goes for
+  /// the other read functions below.
+  bool tryRead(
+      T& dest,
+      const Cursor& cursor,
+      uint64_t* tornReads = nullptr) noexcept {
+    return countRead(
+        slots_[idx(cursor.ticket)].tryRead(dest, turn(cursor.ticket)),
+        tornReads);
   }
 
   /// Read the value at the cursor or block if the write has not occurred yet.
   /// Returns true if the read succeeded, false otherwise. If the return
   /// value is false, dest is to be considered partially read and in an
   /// inconsistent state. Readers are advised to discard it.
-  bool waitAndTryRead(T& dest, const Cursor& cursor) noexcept {
-    return slots_[idx(cursor.ticket)].waitAndTryRead(dest, turn(cursor.ticket));
+  bool waitAndTryRead(
+      T& dest,
+      const Cursor& cursor,
+      uint64_t* tornReads = nullptr) noexcept {
+    return countRead(
+        slots_[idx(cursor.ticket)].waitAndTryRead(dest, turn(cursor.ticket)),
+        tornReads);
+  }
+
+  /// Like waitAndTryRead(), but gives up once `deadline` has passed.
+  bool waitAndTryRead(
+      T& dest,
+      const Cursor& cursor,
+      std::chrono::steady_clock::time_point deadline,
+      uint64_t* tornReads = nullptr) noexcept {
+    return countRead(
+        slots_[idx(cursor.ticket)].waitAndTryRead(
+            dest, turn(cursor.ticket), &deadline),
+        tornReads);
+  }
+
+  /// Like waitAndTryRead(), but polls with `backoff` instead of blocking on
+  /// a futex. Writers never make a syscall to wake up a polling reader.
+  bool pollAndTryRead(
+      T& dest,
+      const Cursor& cursor,
+      const PollBackoff& backoff,
+      uint64_t* tornReads = nullptr) noexcept {
+    return countRead(
+        slots_[idx(cursor.ticket)].pollAndTryRead(
+            dest, turn(cursor.ticket), backoff),
+        tornReads);
+  }
+
+  /// Total number of writes so far, including ones still in progress.
+  uint64_t writeCount() noexcept {
+    return ticket_.load();
+  }
+
+  /// Number of uint64_t words needed for the `valid` bitmap of a snapshot()
+  /// of `count` writes.
+  static constexpr size_t snapshotBitmapWords(size_t count) {
+    return (count + 63) / 64;
+  }
+
+  /// Copy `count` consecutive writes, starting at `from`, into dest[0, count).
+  /// Never blocks.
+  ///
+  /// Bit i of `valid` (valid[i / 64] & (1 << i % 64)) is set iff dest[i] is a
+  /// complete copy of write `from + i`. Writes that haven't occurred yet, that
+  /// were overwritten, or that changed while being copied get a cleared bit,
+  /// and the contents of their dest[i] are unspecified. `valid` must hold
+  /// snapshotBitmapWords(count) words. Copies that changed while being
+  /// copied are added to `tornReads`, if not null.
+  ///
+  /// This performs the same checks as tryRead() but in two passes over the
+  /// range, one copying and one validating, so the copy streams through the
+  /// slots instead of stalling on each one.
+  /// Returns the number of valid copies.
+  size_t snapshot(
+      const Cursor& from,
+      size_t count,
+      T* dest,
+      uint64_t* valid,
+      uint64_t* tornReads = nullptr) noexcept {
+    constexpr size_t kPrefetchDistance = 4;
+
+    std::fill(valid, valid + snapshotBitmapWords(count), 0);
+
+    for (size_t i = 0; i < count; ++i) {
+      uint64_t ticket = from.ticket + i;
+      if (i + kPrefetchDistance < count) {
+        __builtin_prefetch(&slots_[idx(ticket + kPrefetchDistance)]);
+      }
+      auto& slot = slots_[idx(ticket)];
+      if (slot.isReadable(turn(ticket))) {
+        slot.copyTo(dest[i]);
+        valid[i / 64] |= uint64_t{1} << (i % 64);
+      }
+    }
+
+    // Order the copies above before the checks below, a slot that is still
+    // on the same turn was not written to while we copied it.
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    size_t validCount = 0;
+    size_t tornCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+      uint64_t bit = uint64_t{1} << (i % 64);
+      if ((valid[i / 64] & bit) == 0) {
+        continue;
+      }
+      uint64_t ticket = from.ticket + i;
+      if (slots_[idx(ticket)].isReadable(turn(ticket))) {
+        ++validCount;
+      } else {
+        valid[i / 64] &= ~bit;
+        ++tornCount;
+      }
+    }
+    if (tornReads != nullptr) {
+      *tornReads += tornCount;
+    }
+    return validCount;
   }
 
   /// Returns a Cursor pointing to the first write that has not occurred yet.
@@ -204,6 +401,15 @@ class LockFreeRingBuffer {
   Atom<uint64_t> ticket_;
   detail::RingBufferSlot<T, Atom> slots_[];
 
+  static bool countRead(
+      detail::SlotReadResult result,
+      uint64_t* tornReads) noexcept {
+    if (result == detail::SlotReadResult::TORN && tornReads != nullptr) {
+      ++*tornReads;
+    }
+    return result == detail::SlotReadResult::SUCCESS;
+  }
+
   static LockFreeRingBuffer<T, Atom>* allocateAt(uint32_t capacity, void* ptr) {
     LockFreeRingBuffer<T, Atom>* buffer =
         new (ptr) LockFreeRingBuffer<T, Atom>(capacity);
@@ -219,11 +425,37 @@ class LockFreeRingBuffer {
     _destroy_n(slots_, capacity_);
   }
 
+  // Capacities are only rounded up to a power of two when the allocator asks
+  // for it (see roundUpCapacity()), so any capacity must keep working. The
+  // check runs on every call instead of being stored next to capacity_ to
+  // keep the ring's layout, which is shared with buffer files, unchanged.
+  // capacity_ never changes, so the branch is always predicted. A ring must
+  // not have a capacity of 0; if it does, don't mask every index with ~0
+  // and take __builtin_ctz(0).
+  bool hasPowerOfTwoCapacity() noexcept {
+    return capacity_ != 0 && (capacity_ & (capacity_ - 1)) == 0;
+  }
+
   uint32_t idx(uint64_t ticket) noexcept {
+    if (hasPowerOfTwoCapacity()) {
+      return (uint32_t)ticket & (capacity_ - 1);
+    }
     return ticket % capacity_;
   }
 
+  bool slotsWritable(uint64_t ticket, uint32_t count) noexcept {
+    for (uint32_t i = 0; i < count; ++i) {
+      if (!slots_[idx(ticket + i)].isWritable(turn(ticket + i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   uint32_t turn(uint64_t ticket) noexcept {
+    if (hasPowerOfTwoCapacity()) {
+      return (uint32_t)(ticket >> __builtin_ctz(capacity_));
+    }
     return (uint32_t)(ticket / capacity_);
   }
 
@@ -238,39 +470,80 @@ class RingBufferSlot {
   explicit RingBufferSlot() noexcept : sequencer_(), data() {}
 
   void write(const uint32_t turn, T& value) noexcept {
+    beginWrite(turn) = std::move(value);
+    endWrite(turn);
+  }
+
+  T& beginWrite(const uint32_t turn) noexcept {
     Atom<uint32_t> cutoff(0);
     sequencer_.waitForTurn(turn * 2, cutoff, false);
 
     // Change to an odd-numbered turn to indicate write in process
     sequencer_.completeTurn(turn * 2);
+    return data;
+  }
 
-    data = std::move(value);
+  void endWrite(const uint32_t turn) noexcept {
     sequencer_.completeTurn(turn * 2 + 1);
     // At (turn + 1) * 2
   }
 
-  bool waitAndTryRead(T& dest, uint32_t turn) noexcept {
+  SlotReadResult waitAndTryRead(
+      T& dest,
+      uint32_t turn,
+      const std::chrono::steady_clock::time_point* deadline =
+          nullptr) noexcept {
     uint32_t desired_turn = (turn + 1) * 2;
     Atom<uint32_t> cutoff(0);
-    if (sequencer_.tryWaitForTurn(desired_turn, cutoff, false) !=
+    if (sequencer_.tryWaitForTurn(desired_turn, cutoff, false, deadline) !=
         TurnSequencer<Atom>::TryWaitResult::SUCCESS) {
-      return false;
+      return SlotReadResult::NOT_READABLE;
     }
     memcpy(&dest, &data, sizeof(T));
 
     // if it's still the same turn, we read the value successfully
-    return sequencer_.isTurn(desired_turn);
+    return sequencer_.isTurn(desired_turn) ? SlotReadResult::SUCCESS
+                                           : SlotReadResult::TORN;
+  }
+
+  SlotReadResult
+  pollAndTryRead(T& dest, uint32_t turn, const PollBackoff& backoff) noexcept {
+    uint32_t desired_turn = (turn + 1) * 2;
+    if (sequencer_.tryPollForTurn(desired_turn, backoff) !=
+        TurnSequencer<Atom>::TryWaitResult::SUCCESS) {
+      return SlotReadResult::NOT_READABLE;
+    }
+    memcpy(&dest, &data, sizeof(T));
+
+    return sequencer_.isTurn(desired_turn) ? SlotReadResult::SUCCESS
+                                           : SlotReadResult::TORN;
   }
 
-  bool tryRead(T& dest, uint32_t turn) noexcept {
+  // True if a write for this turn wouldn't block.
+  bool isWritable(uint32_t turn) noexcept {
+    return sequencer_.isTurn(turn * 2);
+  }
+
+  // True if the write for this turn has completed and not been overwritten.
+  bool isReadable(uint32_t turn) noexcept {
+    return sequencer_.isTurn((turn + 1) * 2);
+  }
+
+  // Unsynchronized copy, callers must validate with isReadable() around it.
+  void copyTo(T& dest) noexcept {
+    memcpy(&dest, &data, sizeof(T));
+  }
+
+  SlotReadResult tryRead(T& dest, uint32_t turn) noexcept {
     // The write that started at turn 0 ended at turn 2
     if (!sequencer_.isTurn((turn + 1) * 2)) {
-      return false;
+      return SlotReadResult::NOT_READABLE;
     }
     memcpy(&dest, &data, sizeof(T));
 
     // if it's still the same turn, we read the value successfully
-    return sequencer_.isTurn((turn + 1) * 2);
+    return sequencer_.isTurn((turn + 1) * 2) ? SlotReadResult::SUCCESS
+                                             : SlotReadResult::TORN;
   }
 
  private:
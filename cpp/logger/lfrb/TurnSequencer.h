@@ -17,8 +17,10 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <limits>
+#include <thread>
 
 #include <profilo/logger/lfrb/Futex.h>
 
@@ -36,6 +38,14 @@ namespace logger {
 
 namespace lfrb {
 
+/// How TurnSequencer::tryPollForTurn() waits: `spins` polls in a tight
+/// loop, then sleeps starting at 1us and doubling up to `latencyBudget`.
+/// A turn is noticed at most about `latencyBudget` after it arrives.
+struct PollBackoff {
+  uint32_t spins;
+  std::chrono::microseconds latencyBudget;
+};
+
 /// A TurnSequencer allows threads to order their execution according to
 /// a monotonically increasing (with wraparound) "turn" value.  The two
 /// operations provided are to wait for turn T, and to move to the next
@@ -197,6 +207,38 @@ struct TurnSequencer {
     return TryWaitResult::SUCCESS;
   }
 
+  /// Like tryWaitForTurn(), but never records the caller as a waiter and
+  /// polls with `backoff` instead. completeTurn() then never has to make a
+  /// futex syscall on the caller's behalf.
+  /// Returns SUCCESS if the turn arrived or PAST if it is in the past.
+  TryWaitResult tryPollForTurn(
+      const uint32_t turn,
+      const PollBackoff& backoff) noexcept {
+    const uint32_t sturn = turn << kTurnShift;
+    auto sleep = std::chrono::microseconds(1);
+    for (uint32_t tries = 0;; ++tries) {
+      uint32_t current_sturn =
+          decodeCurrentSturn(state_.load(std::memory_order_acquire));
+      if (current_sturn == sturn) {
+        return TryWaitResult::SUCCESS;
+      }
+
+      // wrap-safe version of (current_sturn >= sturn)
+      if (sturn - current_sturn >= std::numeric_limits<uint32_t>::max() / 2) {
+        return TryWaitResult::PAST;
+      }
+
+      if (tries < backoff.spins) {
+        continue;
+      }
+      std::this_thread::sleep_for(sleep);
+      // Never drop to a zero sleep, that would spin on sleep_for() syscalls.
+      sleep = std::max(
+          std::chrono::microseconds(1),
+          std::min(sleep * 2, backoff.latencyBudget));
+    }
+  }
+
   /// Unblocks a thread running waitForTurn(turn + 1)
   void completeTurn(const uint32_t turn) noexcept {
     uint32_t state = state_.load(std::memory_order_acquire);
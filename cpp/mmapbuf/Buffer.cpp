@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <cstring>
 #include <memory>
+#include <utility>
 
 #include <errno.h>
 
@@ -36,21 +37,54 @@ namespace mmapbuf {
 
 namespace {
 
-static size_t calculateBufferSize(size_t entryCount) {
-  return sizeof(MmapBufferPrefix) +
-      TraceBuffer::calculateAllocationSize(entryCount);
+static size_t calculateBufferSize(
+    size_t entryCount,
+    size_t priorityEntryCount,
+    size_t shardCount) {
+  size_t size = sizeof(MmapBufferPrefix) +
+      shardCount * TraceBuffer::calculateAllocationSize(entryCount);
+  if (priorityEntryCount > 0) {
+    size += TraceBuffer::calculateAllocationSize(priorityEntryCount);
+  }
+  return size;
+}
+
+static logger::TraceBufferProvider priorityProvider(
+    Buffer* buffer,
+    size_t priorityEntryCount) {
+  if (priorityEntryCount == 0) {
+    return nullptr;
+  }
+  return [buffer]() -> TraceBuffer& { return *buffer->priorityRingBuffer(); };
 }
 
 } // namespace
 
-Buffer::Buffer(std::string const& path, size_t entryCount) {
+Buffer::Buffer(
+    std::string const& path,
+    size_t entryCount,
+    bool writeCombining,
+    bool compactEntries,
+    size_t priorityEntryCount,
+    ShardLayout shardLayout)
+    : shard_layout_(std::move(shardLayout)),
+      // The file is read back after a crash, when nothing refreshes the
+      // dictionary in the ring. Its STRING_DEFINEs would be overwritten.
+      logger_(
+          {[this]() -> TraceBuffer& { return this->currentRingBuffer(); }},
+          Logger::getGlobalEntryID(),
+          writeCombining,
+          compactEntries,
+          priorityProvider(this, priorityEntryCount),
+          false) {
   int fd = open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
   if (fd == -1) {
     throw std::system_error(
         errno, std::system_category(), "Cannot open file " + path);
   }
 
-  size_t totalSize = calculateBufferSize(entryCount);
+  size_t totalSize = calculateBufferSize(
+      entryCount, priorityEntryCount, shard_layout_.shardCount);
 
   // In order to allocate file size of N bytes we seek to (N-1)th position and
   // just write single byte at the end. This allows us to avoid filling the
@@ -89,51 +123,100 @@ Buffer::Buffer(std::string const& path, size_t entryCount) {
   buffer = map_chr + sizeof(MmapBufferPrefix);
   this->path = path;
   this->entryCount = entryCount;
+  this->priorityEntryCount = priorityEntryCount;
+  this->shardCount = shard_layout_.shardCount;
   this->totalByteSize = totalSize;
   this->file_backed_ = true;
-  lfrb_ = TraceBuffer::allocateAt(entryCount, (void*)buffer);
+  allocateRings();
 }
 
-Buffer::Buffer(size_t entryCount) {
-  size_t totalSize = calculateBufferSize(entryCount);
+Buffer::Buffer(
+    size_t entryCount,
+    bool writeCombining,
+    bool compactEntries,
+    size_t priorityEntryCount,
+    ShardLayout shardLayout)
+    : shard_layout_(std::move(shardLayout)),
+      logger_(
+          {[this]() -> TraceBuffer& { return this->currentRingBuffer(); }},
+          Logger::getGlobalEntryID(),
+          writeCombining,
+          compactEntries,
+          priorityProvider(this, priorityEntryCount)) {
+  size_t totalSize = calculateBufferSize(
+      entryCount, priorityEntryCount, shard_layout_.shardCount);
 
   auto mem = new char[totalSize];
   prefix = new (mem) MmapBufferPrefix();
   buffer = mem + sizeof(MmapBufferPrefix);
   this->totalByteSize = totalSize;
   this->entryCount = entryCount;
+  this->priorityEntryCount = priorityEntryCount;
+  this->shardCount = shard_layout_.shardCount;
   this->file_backed_ = false;
-  lfrb_ = TraceBuffer::allocateAt(entryCount, (void*)buffer);
+  allocateRings();
+}
+
+void Buffer::allocateRings() {
+  // The shards are laid out back to back, the high priority ring sits right
+  // after them.
+  auto mem = reinterpret_cast<char*>(buffer);
+  for (size_t shard = 0; shard < shardCount; ++shard) {
+    shards_.push_back(TraceBuffer::allocateAt(entryCount, mem));
+    mem += TraceBuffer::calculateAllocationSize(entryCount);
+  }
+  lfrb_ = shards_.front();
+  if (priorityEntryCount > 0) {
+    priority_lfrb_ = TraceBuffer::allocateAt(priorityEntryCount, mem);
+  }
+}
+
+std::vector<TraceBuffer*> Buffer::flushAndTakeShards(Buffer& other) {
+  // The flush goes through other's provider, which needs its shards.
+  other.logger_.flushStaged();
+  return std::move(other.shards_);
 }
 
 Buffer::Buffer(Buffer&& other)
     : path(std::move(other.path)),
       entryCount(other.entryCount),
+      priorityEntryCount(other.priorityEntryCount),
+      shardCount(other.shardCount),
       totalByteSize(other.totalByteSize),
       prefix(other.prefix),
       buffer(other.buffer),
       file_backed_(other.file_backed_),
-      lfrb_(std::move(other.lfrb_)) {
+      lfrb_(other.lfrb_),
+      shards_(flushAndTakeShards(other)),
+      shard_layout_(std::move(other.shard_layout_)),
+      priority_lfrb_(other.priority_lfrb_),
+      logger_(
+          {[this]() -> TraceBuffer& { return this->currentRingBuffer(); }},
+          Logger::getGlobalEntryID(),
+          other.logger_.writeCombining(),
+          other.logger_.compactEntries(),
+          priorityProvider(this, other.priorityEntryCount),
+          other.logger_.internStrings()) {
+  // STRING_REFs in the moved rings still point into other's dictionary.
+  logger_.takeStrings(other.logger_);
   other.entryCount = 0;
+  other.priorityEntryCount = 0;
+  other.shardCount = 0;
   other.totalByteSize = 0;
   other.prefix = nullptr;
   other.buffer = nullptr;
   other.file_backed_ = false;
+  other.lfrb_ = nullptr;
+  other.priority_lfrb_ = nullptr;
 }
 
 Buffer& Buffer::operator=(Buffer&& other) {
+  if (this == &other) {
+    return *this;
+  }
+  // The Logger can't be reassigned, build it anew with other's options.
   this->~Buffer();
-
-  path = std::move(other.path);
-  entryCount = other.entryCount;
-  totalByteSize = other.totalByteSize;
-  prefix = other.prefix;
-  buffer = other.buffer;
-  lfrb_ = std::move(other.lfrb_);
-
-  other.buffer = other.prefix = nullptr;
-  other.entryCount = other.totalByteSize = 0;
-  other.file_backed_ = false;
+  new (this) Buffer(std::move(other));
   return *this;
 }
 
@@ -142,6 +225,7 @@ Buffer::~Buffer() {
     return;
   }
 
+  logger_.flushStaged();
   prefix->~MmapBufferPrefix();
 
   if (file_backed_) {
@@ -18,9 +18,11 @@
 
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include <profilo/Logger.h>
 #include <profilo/logger/buffer/TraceBuffer.h>
+#include <profilo/mmapbuf/ShardLayout.h>
 #include <profilo/mmapbuf/header/MmapBufferHeader.h>
 
 namespace facebook {
@@ -38,9 +40,25 @@ using MmapBufferPrefix = header::MmapBufferPrefix;
 ///
 struct Buffer {
   // Construct a Buffer from an mmapped file.
-  Buffer(std::string const& path, size_t entryCount);
+  // writeCombining, compactEntries: see Logger's constructor.
+  // priorityEntryCount: if non-zero, place a second TraceBuffer of this many
+  // entries after the main one and log high priority entries to it.
+  // shardLayout: split the main TraceBuffer into one of `entryCount` entries
+  // per shard, and log to the calling CPU's one.
+  Buffer(
+      std::string const& path,
+      size_t entryCount,
+      bool writeCombining = false,
+      bool compactEntries = false,
+      size_t priorityEntryCount = 0,
+      ShardLayout shardLayout = ShardLayout());
   // Construct a Buffer from anonymous memory.
-  explicit Buffer(size_t entryCount);
+  explicit Buffer(
+      size_t entryCount,
+      bool writeCombining = false,
+      bool compactEntries = false,
+      size_t priorityEntryCount = 0,
+      ShardLayout shardLayout = ShardLayout());
 
   Buffer(Buffer const&) = delete;
   Buffer(Buffer&&);
@@ -51,25 +69,60 @@ struct Buffer {
 
   void rename(std::string const& path);
 
+  // The main ring. For a sharded Buffer, that's shard 0.
   TraceBuffer& ringBuffer() {
     return *lfrb_;
   }
 
+  TraceBuffer& shardRingBuffer(size_t shard) {
+    return *shards_[shard];
+  }
+
+  header::ShardMode shardMode() const {
+    return shard_layout_.mode;
+  }
+
+  // The main ring the calling thread logs to.
+  TraceBuffer& currentRingBuffer() {
+    if (shards_.size() == 1) {
+      return *lfrb_;
+    }
+    return *shards_[shard_layout_.currentShard()];
+  }
+
+  // The ring high priority entries are logged to, or nullptr if this Buffer
+  // has a single ring.
+  TraceBuffer* priorityRingBuffer() {
+    return priority_lfrb_;
+  }
+
   Logger& logger() {
     return logger_;
   }
 
   std::string path = "";
+  // Entries of each main ring.
   size_t entryCount = 0;
+  size_t priorityEntryCount = 0;
+  size_t shardCount = 0;
   size_t totalByteSize = 0;
   MmapBufferPrefix* prefix = nullptr;
   void* buffer = nullptr;
 
  private:
+  void allocateRings();
+
+  // Publish entries staged against other's rings, then take its shards.
+  // Called by the move constructor before any ring state changes hands.
+  static std::vector<TraceBuffer*> flushAndTakeShards(Buffer& other);
+
   bool file_backed_ = false;
   TraceBuffer* lfrb_ = nullptr;
+  std::vector<TraceBuffer*> shards_;
+  ShardLayout shard_layout_;
+  TraceBuffer* priority_lfrb_ = nullptr;
   Logger logger_{
-      {[this]() -> TraceBuffer& { return this->ringBuffer(); }},
+      {[this]() -> TraceBuffer& { return this->currentRingBuffer(); }},
       Logger::getGlobalEntryID()};
 };
 
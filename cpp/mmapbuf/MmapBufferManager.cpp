@@ -21,6 +21,7 @@
 #include <memory>
 #include <stdexcept>
 #include <system_error>
+#include <utility>
 
 #include <fb/log.h>
 #include <profilo/logger/buffer/RingBuffer.h>
@@ -30,16 +31,82 @@ namespace facebook {
 namespace profilo {
 namespace mmapbuf {
 
+namespace {
+
+size_t slotCount(int32_t buffer_size, bool round_up_capacity) {
+  if (round_up_capacity && buffer_size > 0) {
+    return TraceBuffer::roundUpCapacity((uint32_t)buffer_size);
+  }
+  return (size_t)buffer_size;
+}
+
+// Layout for `shard_mode`, falling back to a single ring if there aren't
+// enough slots to give every shard one.
+ShardLayout shardLayout(int32_t buffer_size, header::ShardMode shard_mode) {
+  auto layout = ShardLayout::forMode(shard_mode);
+  if (layout.shardCount > 1 && buffer_size < (int32_t)layout.shardCount) {
+    FBLOGW(
+        "Buffer of %d slots is too small for %u shards, not sharding",
+        buffer_size,
+        layout.shardCount);
+    return ShardLayout();
+  }
+  return layout;
+}
+
+// Slots of each shard. Rounds up, so that shards never hold less than
+// `buffer_size` slots in total.
+int32_t shardSlots(int32_t buffer_size, const ShardLayout& layout) {
+  auto shards = (int32_t)layout.shardCount;
+  return (buffer_size + shards - 1) / shards;
+}
+
+header::ShardMode shardModeFromJava(int32_t shard_mode) {
+  switch (static_cast<header::ShardMode>(shard_mode)) {
+    case header::ShardMode::NONE:
+    case header::ShardMode::PER_CPU:
+    case header::ShardMode::PER_CLUSTER:
+      return static_cast<header::ShardMode>(shard_mode);
+    default:
+      throw std::invalid_argument("Unknown buffer shard mode");
+  }
+}
+
+} // namespace
+
 fbjni::local_ref<JBuffer::javaobject>
-MmapBufferManager::allocateBufferAnonymousForJava(int32_t buffer_size) {
-  return JBuffer::makeJBuffer(allocateBufferAnonymous(buffer_size));
+MmapBufferManager::allocateBufferAnonymousForJava(
+    int32_t buffer_size,
+    bool write_combining,
+    bool compact_entries,
+    bool round_up_capacity,
+    int32_t priority_size,
+    int32_t shard_mode) {
+  return JBuffer::makeJBuffer(allocateBufferAnonymous(
+      buffer_size,
+      write_combining,
+      compact_entries,
+      round_up_capacity,
+      priority_size,
+      shardModeFromJava(shard_mode)));
 }
 
 std::shared_ptr<Buffer> MmapBufferManager::allocateBufferAnonymous(
-    int32_t buffer_size) {
+    int32_t buffer_size,
+    bool write_combining,
+    bool compact_entries,
+    bool round_up_capacity,
+    int32_t priority_size,
+    header::ShardMode shard_mode) {
   std::shared_ptr<Buffer> buffer = nullptr;
   try {
-    buffer = std::make_shared<Buffer>((size_t)buffer_size);
+    auto layout = shardLayout(buffer_size, shard_mode);
+    buffer = std::make_shared<Buffer>(
+        slotCount(shardSlots(buffer_size, layout), round_up_capacity),
+        write_combining,
+        compact_entries,
+        slotCount(priority_size, round_up_capacity),
+        std::move(layout));
   } catch (std::exception& ex) {
     FBLOGE("%s", ex.what());
     return nullptr;
@@ -51,8 +118,20 @@ std::shared_ptr<Buffer> MmapBufferManager::allocateBufferAnonymous(
 fbjni::local_ref<JBuffer::javaobject>
 MmapBufferManager::allocateBufferFileForJava(
     int32_t buffer_size,
-    const std::string& path) {
-  auto buffer = allocateBufferFile(buffer_size, path);
+    const std::string& path,
+    bool write_combining,
+    bool compact_entries,
+    bool round_up_capacity,
+    int32_t priority_size,
+    int32_t shard_mode) {
+  auto buffer = allocateBufferFile(
+      buffer_size,
+      path,
+      write_combining,
+      compact_entries,
+      round_up_capacity,
+      priority_size,
+      shardModeFromJava(shard_mode));
   if (buffer == nullptr) {
     throw std::invalid_argument("Could not allocate file-backed buffer");
   }
@@ -61,10 +140,22 @@ MmapBufferManager::allocateBufferFileForJava(
 
 std::shared_ptr<Buffer> MmapBufferManager::allocateBufferFile(
     int32_t buffer_size,
-    const std::string& path) {
+    const std::string& path,
+    bool write_combining,
+    bool compact_entries,
+    bool round_up_capacity,
+    int32_t priority_size,
+    header::ShardMode shard_mode) {
   std::shared_ptr<Buffer> buffer = nullptr;
   try {
-    buffer = std::make_shared<Buffer>(path, (size_t)buffer_size);
+    auto layout = shardLayout(buffer_size, shard_mode);
+    buffer = std::make_shared<Buffer>(
+        path,
+        slotCount(shardSlots(buffer_size, layout), round_up_capacity),
+        write_combining,
+        compact_entries,
+        slotCount(priority_size, round_up_capacity),
+        std::move(layout));
   } catch (std::system_error& ex) {
     FBLOGE("%s", ex.what());
     return nullptr;
@@ -76,7 +167,11 @@ std::shared_ptr<Buffer> MmapBufferManager::allocateBufferFile(
 
 void MmapBufferManager::registerBuffer(std::shared_ptr<Buffer> buffer) {
   buffer->prefix->header.bufferVersion = RingBuffer::kVersion;
+  buffer->prefix->header.slotSize = logger::kTraceSlotSize;
   buffer->prefix->header.size = buffer->entryCount;
+  buffer->prefix->header.prioritySize = buffer->priorityEntryCount;
+  buffer->prefix->header.shardCount = buffer->shardCount;
+  buffer->prefix->header.shardMode = buffer->shardMode();
   buffer->prefix->header.pid = getpid();
   {
     WriterLock lock(&buffers_lock_);
@@ -43,25 +43,66 @@ class MmapBufferManager : public fbjni::HybridClass<MmapBufferManager> {
   static fbjni::local_ref<MmapBufferManager::jhybriddata> initHybrid(
       fbjni::alias_ref<jclass>);
   //
-  // Allocates TraceBuffer according to the passed parameters in a file.
-  // Returns a non-null reference if successful, nullptr if not.
+  // Allocates TraceBuffer according to the passed parameters in anonymous
+  // memory. Returns a non-null reference if successful, nullptr if not.
+  //
+  // write_combining, compact_entries: options of the buffer's Logger, see
+  // its constructor.
+  //
+  // round_up_capacity: round buffer_slots_size up to the next power of two,
+  // which makes slot index math cheaper on every read and write.
+  //
+  // priority_slots_size: size of the ring reserved for high priority
+  // entries, see Buffer. 0 disables it.
+  //
+  // shard_mode: split buffer_slots_size evenly over one ring per CPU or per
+  // CPU cluster, see ShardLayout. Each ring gets the quotient rounded up.
+  // Buffers with fewer slots than shards get a single ring.
   //
-  std::shared_ptr<Buffer> allocateBufferAnonymous(int32_t buffer_slots_size);
+  std::shared_ptr<Buffer> allocateBufferAnonymous(
+      int32_t buffer_slots_size,
+      bool write_combining = false,
+      bool compact_entries = false,
+      bool round_up_capacity = false,
+      int32_t priority_slots_size = 0,
+      header::ShardMode shard_mode = header::ShardMode::NONE);
 
+  //
+  // Same parameters as allocateBufferAnonymous(). shard_mode is a
+  // header::ShardMode value, other values throw.
+  //
   fbjni::local_ref<JBuffer::javaobject> allocateBufferAnonymousForJava(
-      int32_t buffer_slots_size);
+      int32_t buffer_slots_size,
+      bool write_combining,
+      bool compact_entries,
+      bool round_up_capacity,
+      int32_t priority_slots_size,
+      int32_t shard_mode);
 
   //
   // Allocates TraceBuffer according to the passed parameters in a file.
   // Returns a non-null reference if successful, nullptr if not.
   //
+  // write_combining, compact_entries, round_up_capacity,
+  // priority_slots_size, shard_mode: see allocateBufferAnonymous.
+  //
   std::shared_ptr<Buffer> allocateBufferFile(
       int32_t buffer_slots_size,
-      const std::string& path);
+      const std::string& path,
+      bool write_combining = false,
+      bool compact_entries = false,
+      bool round_up_capacity = false,
+      int32_t priority_slots_size = 0,
+      header::ShardMode shard_mode = header::ShardMode::NONE);
 
   fbjni::local_ref<JBuffer::javaobject> allocateBufferFileForJava(
       int32_t buffer_slots_size,
-      const std::string& path);
+      const std::string& path,
+      bool write_combining,
+      bool compact_entries,
+      bool round_up_capacity,
+      int32_t priority_slots_size,
+      int32_t shard_mode);
 
   bool deallocateBufferForJava(JBuffer* buffer);
   bool deallocateBuffer(std::shared_ptr<Buffer> buffer);
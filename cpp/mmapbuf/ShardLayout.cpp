@@ -0,0 +1,119 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShardLayout.h"
+
+#include <sched.h>
+#include <unistd.h>
+#include <algorithm>
+#include <utility>
+
+#include <profilo/counters/SysFs.h>
+
+namespace facebook {
+namespace profilo {
+namespace mmapbuf {
+
+namespace {
+
+int configuredCpus() {
+  auto cpus = sysconf(_SC_NPROCESSORS_CONF);
+  return cpus > 0 ? cpus : 1;
+}
+
+// Cluster of `cpu`. Older kernels don't have cluster_id, but on big.LITTLE
+// SoCs they report each cluster as a physical package.
+long readCpuCluster(int cpu) {
+  for (auto path_format :
+       {"/sys/devices/system/cpu/cpu%d/topology/cluster_id",
+        "/sys/devices/system/cpu/cpu%d/topology/physical_package_id"}) {
+    auto cluster = counters::readSysFsValue(
+        counters::getCpuStatFilePath(cpu, path_format));
+    if (cluster >= 0) {
+      return cluster;
+    }
+  }
+  return 0;
+}
+
+uint32_t countShards(const std::vector<uint16_t>& cpuShards) {
+  if (cpuShards.empty()) {
+    return 1;
+  }
+  return *std::max_element(cpuShards.begin(), cpuShards.end()) + 1;
+}
+
+} // namespace
+
+ShardLayout::ShardLayout()
+    : mode(header::ShardMode::NONE), cpuShards(), shardCount(1) {}
+
+ShardLayout::ShardLayout(
+    header::ShardMode mode,
+    std::vector<uint16_t> cpuShards)
+    : mode(mode),
+      cpuShards(std::move(cpuShards)),
+      shardCount(countShards(this->cpuShards)) {}
+
+ShardLayout ShardLayout::perCpu() {
+  std::vector<uint16_t> shards(configuredCpus());
+  for (size_t cpu = 0; cpu < shards.size(); ++cpu) {
+    shards[cpu] = cpu;
+  }
+  return ShardLayout(header::ShardMode::PER_CPU, std::move(shards));
+}
+
+ShardLayout ShardLayout::perCluster() {
+  // Number clusters in order of their first CPU.
+  std::vector<long> clusters;
+  std::vector<uint16_t> shards(configuredCpus());
+  for (size_t cpu = 0; cpu < shards.size(); ++cpu) {
+    auto cluster = readCpuCluster(cpu);
+    auto it = std::find(clusters.begin(), clusters.end(), cluster);
+    if (it == clusters.end()) {
+      it = clusters.insert(clusters.end(), cluster);
+    }
+    shards[cpu] = it - clusters.begin();
+  }
+  return ShardLayout(header::ShardMode::PER_CLUSTER, std::move(shards));
+}
+
+ShardLayout ShardLayout::forMode(header::ShardMode mode) {
+  switch (mode) {
+    case header::ShardMode::PER_CPU:
+      return perCpu();
+    case header::ShardMode::PER_CLUSTER:
+      return perCluster();
+    default:
+      return ShardLayout();
+  }
+}
+
+uint32_t ShardLayout::currentShard() const {
+  if (shardCount == 1) {
+    return 0;
+  }
+  auto cpu = sched_getcpu();
+  if (cpu < 0 || (size_t)cpu >= cpuShards.size()) {
+    // Hotplugged CPUs or no getcpu support.
+    return 0;
+  }
+  return cpuShards[cpu];
+}
+
+} // namespace mmapbuf
+} // namespace profilo
+} // namespace facebook
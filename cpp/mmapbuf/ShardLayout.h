@@ -0,0 +1,55 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <profilo/mmapbuf/header/MmapBufferHeader.h>
+
+namespace facebook {
+namespace profilo {
+namespace mmapbuf {
+
+//
+// Maps CPUs to the main rings ("shards") of a sharded Buffer. Writers log to
+// the shard of the CPU they're running on, so writers on different CPUs (or
+// clusters) don't bounce a single ring's ticket between them.
+//
+struct ShardLayout {
+  // A single shard.
+  ShardLayout();
+  // cpuShards[cpu] is the shard of `cpu`, shards are numbered from 0.
+  ShardLayout(header::ShardMode mode, std::vector<uint16_t> cpuShards);
+
+  // One shard per configured CPU.
+  static ShardLayout perCpu();
+  // One shard per CPU cluster, as reported by the sysfs CPU topology.
+  static ShardLayout perCluster();
+  static ShardLayout forMode(header::ShardMode mode);
+
+  // Shard for a write from the calling thread.
+  uint32_t currentShard() const;
+
+  header::ShardMode mode;
+  std::vector<uint16_t> cpuShards;
+  uint32_t shardCount;
+};
+
+} // namespace mmapbuf
+} // namespace profilo
+} // namespace facebook
@@ -26,7 +26,16 @@ namespace mmapbuf {
 namespace header {
 
 constexpr static uint64_t kMagic = 0x306c3166307270; // pr0f1l0
-constexpr static uint64_t kVersion = 8;
+constexpr static uint64_t kVersion = 11;
+
+//
+// How writes are spread over the main rings of a sharded buffer.
+//
+enum class ShardMode : uint32_t {
+  NONE = 0,
+  PER_CPU = 1,
+  PER_CLUSTER = 2,
+};
 
 //
 // Static header for primary buffer verification.
@@ -49,9 +58,18 @@ struct __attribute__((packed)) alignas(8) MmapBufferHeader {
   constexpr static auto kSessionIdLength = 40;
   constexpr static auto kMemoryMapsFilePathLength = 512;
   uint16_t bufferVersion;
+  // Size in bytes of one TraceBuffer slot, see logger::kTraceSlotSize.
+  uint16_t slotSize;
   int64_t configId;
   int32_t versionCode;
   uint32_t size;
+  // Entry count of the high priority TraceBuffer following the main one,
+  // 0 if there is none.
+  uint32_t prioritySize;
+  // Number of main TraceBuffers of `size` entries each, laid out back to
+  // back before the high priority one. 0 is the same as 1.
+  uint32_t shardCount;
+  ShardMode shardMode;
   // Currently turned on set of providers.
   int32_t providers;
   int64_t longContext;
@@ -23,17 +23,22 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <cstring>
+#include <algorithm>
 #include <fstream>
 #include <memory>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 
+#include <profilo/entries/EntryParser.h>
 #include <profilo/entries/EntryType.h>
+#include <profilo/logger/buffer/PacketResizer.h>
 #include <profilo/logger/buffer/RingBuffer.h>
 #include <profilo/mmapbuf/Buffer.h>
 #include <profilo/mmapbuf/header/MmapBufferHeader.h>
 #include <profilo/util/common.h>
+#include <profilo/writer/PacketReassembler.h>
+#include <profilo/writer/TimestampVisitor.h>
 #include <profilo/writer/TraceWriter.h>
 #include <profilo/writer/trace_headers.h>
 
@@ -128,26 +133,151 @@ void loggerWriteQplTriggerAnnotation(
       timestamp);
 }
 
+// Stream IDs for packets that have to be split when copying from a buffer
+// with larger slots. Far out of the range PacketLogger hands out.
+constexpr StreamID kResizedStreamBase = 0x80000000;
+
+//
+// An entry recovered from one of the rings of the dump file.
 //
-// Process entries from source buffer and write to the destination.
-// It's okay if not all entries were successfully copied.
-// Returns false if were able to copy less than 50% of source buffer entries.
+struct RecoveredEntry {
+  int64_t timestamp;
+  std::vector<char> data;
+};
+
 //
-bool copyBufferEntries(TraceBuffer& source, TraceBuffer& dest) {
-  TraceBuffer::Cursor cursor = source.currentTail(0);
-  alignas(4) Packet packet;
+// Reassemble the entries of `source`, oldest first. Entries without a
+// timestamp keep the one of the entry before them, as in TraceWriter.
+// It's okay if not all entries were successfully read.
+// Returns false if no packet could be read.
+//
+template <size_t SlotSize>
+bool readBufferEntries(
+    BasicTraceBuffer<SlotSize>& source,
+    StreamID& next_stream,
+    std::vector<RecoveredEntry>& entries) {
+  constexpr size_t kChunkSize = 1024;
+  using SourceBuffer = BasicTraceBuffer<SlotSize>;
+
+  int64_t last_timestamp = 0;
+  auto onPayload = [&](const void* data, size_t size) {
+    profilo::writer::TimestampVisitor timestamp;
+    EntryParser::parse(data, size, timestamp);
+    if (timestamp.found) {
+      last_timestamp = timestamp.timestamp;
+    }
+    auto bytes = static_cast<const char*>(data);
+    entries.push_back(RecoveredEntry{
+        .timestamp = last_timestamp,
+        .data = std::vector<char>(bytes, bytes + size),
+    });
+  };
+  profilo::writer::PacketReassembler reassembler(onPayload);
+
+  typename SourceBuffer::Cursor cursor = source.currentTail(0);
+  typename SourceBuffer::Cursor end = source.currentHead();
+  std::vector<BasicPacket<SlotSize>> packets(kChunkSize);
+  std::vector<uint64_t> valid(SourceBuffer::snapshotBitmapWords(kChunkSize));
   uint32_t processed_count = 0;
-  while (source.tryRead(packet, cursor)) {
-    Packet writePacket = packet; // copy
-    dest.write(writePacket);
-    ++processed_count;
-    if (!cursor.moveForward()) {
+
+  for (;;) {
+    size_t count = std::min<uint64_t>(kChunkSize, cursor.distanceTo(end));
+    if (count == 0) {
       break;
     }
+    source.snapshot(cursor, count, packets.data(), valid.data());
+    for (size_t i = 0; i < count; ++i) {
+      if ((valid[i / 64] & (uint64_t{1} << (i % 64))) == 0) {
+        // Stop at the first entry we failed to read.
+        return processed_count > 0;
+      }
+      resizePacket<Packet>(packets[i], next_stream, [&](Packet& out) {
+        reassembler.process(out);
+      });
+      ++processed_count;
+    }
+    cursor.moveForward(count);
   }
   return processed_count > 0;
 }
 
+//
+// The buffer in a dump file has the slot size of the build that wrote it,
+// which may differ from ours.
+//
+bool isSupportedSlotSize(uint16_t slot_size) {
+  return slot_size == 64 || slot_size == 128 || slot_size == 256;
+}
+
+bool readBufferEntries(
+    void* source,
+    uint16_t slot_size,
+    StreamID& next_stream,
+    std::vector<RecoveredEntry>& entries) {
+  switch (slot_size) {
+    case 64:
+      return readBufferEntries(
+          *static_cast<BasicTraceBuffer<64>*>(source), next_stream, entries);
+    case 128:
+      return readBufferEntries(
+          *static_cast<BasicTraceBuffer<128>*>(source), next_stream, entries);
+    case 256:
+      return readBufferEntries(
+          *static_cast<BasicTraceBuffer<256>*>(source), next_stream, entries);
+    default:
+      return false;
+  }
+}
+
+//
+// Write the entries of all `rings` to `dest`, oldest first. Ties go to the
+// main rings, like in TraceWriter::processMergedTrace().
+//
+void mergeBufferEntries(
+    std::vector<std::vector<RecoveredEntry>>& rings,
+    TraceBuffer& dest) {
+  PacketLogger packetLogger([&dest]() -> TraceBuffer& { return dest; });
+  std::vector<size_t> next(rings.size(), 0);
+  for (;;) {
+    auto oldest = rings.size();
+    for (size_t ring = 0; ring < rings.size(); ++ring) {
+      if (next[ring] < rings[ring].size() &&
+          (oldest == rings.size() ||
+           rings[ring][next[ring]].timestamp <
+               rings[oldest][next[oldest]].timestamp)) {
+        oldest = ring;
+      }
+    }
+    if (oldest == rings.size()) {
+      break;
+    }
+    auto& entry = rings[oldest][next[oldest]++];
+    packetLogger.write(entry.data.data(), entry.data.size());
+  }
+}
+
+// Size of a ring of `entries` slots of `slot_size` bytes in the dump file.
+size_t ringAllocationSize(uint16_t slot_size, size_t entries) {
+  switch (slot_size) {
+    case 64:
+      return BasicTraceBuffer<64>::calculateAllocationSize(entries);
+    case 128:
+      return BasicTraceBuffer<128>::calculateAllocationSize(entries);
+    case 256:
+      return BasicTraceBuffer<256>::calculateAllocationSize(entries);
+    default:
+      return 0;
+  }
+}
+
+// Upper bound of the number of our packets one packet from a buffer with
+// `slot_size` slots turns into.
+size_t packetsPerSourceSlot(uint16_t slot_size) {
+  constexpr size_t kSlotOverhead = kTraceSlotSize - sizeof(Packet::data);
+  constexpr size_t kDataSize = sizeof(Packet::data);
+  return (slot_size - kSlotOverhead + kDataSize - 1) / kDataSize;
+}
+
 void processMemoryMappingsFile(
     Logger& logger,
     const char* file_path,
@@ -199,6 +329,10 @@ int64_t MmapBufferTraceWriter::nativeInitAndVerify(
     return 0;
   }
 
+  if (!isSupportedSlotSize(mapBufferPrefix->header.slotSize)) {
+    return 0;
+  }
+
   int64_t trace_id = mapBufferPrefix->header.traceId;
   trace_id_ = trace_id;
   return trace_id;
@@ -254,7 +388,11 @@ void MmapBufferTraceWriter::writeTrace(
   int32_t qpl_marker_id =
       static_cast<int32_t>(mapBufferPrefix->header.longContext);
 
-  auto entriesCount = mapBufferPrefix->header.size;
+  auto slotSize = mapBufferPrefix->header.slotSize;
+  auto shardCount = std::max<uint32_t>(mapBufferPrefix->header.shardCount, 1);
+  auto entriesCount = (mapBufferPrefix->header.size * shardCount +
+                       mapBufferPrefix->header.prioritySize) *
+      packetsPerSourceSlot(slotSize);
   // Number of additional records we need to log in addition to entries from the
   // buffer file + memory mappings file records + some buffer for long string
   // entries.
@@ -274,13 +412,38 @@ void MmapBufferTraceWriter::writeTrace(
 
   {
     // Copying entries from the saved buffer to the new one.
-    TraceBuffer* historicBuffer = reinterpret_cast<TraceBuffer*>(
+    char* historicBuffer =
         reinterpret_cast<char*>(bufferMapHolder_->map_ptr) +
-        sizeof(MmapBufferPrefix));
-    bool ok = copyBufferEntries(*historicBuffer, ringBuffer);
+        sizeof(MmapBufferPrefix);
+    StreamID nextStream = kResizedStreamBase;
+    auto shardSize = ringAllocationSize(slotSize, mapBufferPrefix->header.size);
+    std::vector<std::vector<RecoveredEntry>> rings(shardCount);
+
+    // The shards are laid out back to back. Some of them may be empty, but
+    // not all of them.
+    bool ok = false;
+    for (uint32_t shard = 0; shard < shardCount; ++shard) {
+      ok |= readBufferEntries(
+          historicBuffer + shard * shardSize,
+          slotSize,
+          nextStream,
+          rings[shard]);
+    }
     if (!ok) {
       throw std::runtime_error("Unable to read the file-backed buffer.");
     }
+
+    // The high priority ring follows the main ones. It's fine for it to be
+    // empty.
+    if (mapBufferPrefix->header.prioritySize > 0) {
+      void* priorityBuffer = historicBuffer + shardCount * shardSize;
+      rings.emplace_back();
+      readBufferEntries(priorityBuffer, slotSize, nextStream, rings.back());
+    }
+
+    // Written back in timestamp order, as TraceWriter::dump() merges the
+    // rings of a live Buffer.
+    mergeBufferEntries(rings, ringBuffer);
   }
 
   loggerWrite(
@@ -68,6 +68,16 @@ class BaseTracer {
       int tid,
       int64_t time_) = 0;
 
+  //
+  // Type of the FramesEntry that flushStack() logs, if that's all it does.
+  // The profiler then logs the samples itself instead, storing only the
+  // frames that differ from the thread's previous sample (see
+  // StackFramesWriter). UNKNOWN_TYPE to always go through flushStack().
+  //
+  virtual EntryType framesEntryType() const {
+    return EntryType::UNKNOWN_TYPE;
+  }
+
   virtual void startTracing() = 0;
 
   virtual void stopTracing() = 0;
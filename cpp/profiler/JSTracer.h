@@ -43,6 +43,10 @@ class JSTracer : public ExternalTracer {
       int tid,
       int64_t time_) override;
 
+  EntryType framesEntryType() const override {
+    return EntryType::JAVASCRIPT_STACK_FRAME;
+  }
+
   void prepare() override;
 
   void startTracing() override;
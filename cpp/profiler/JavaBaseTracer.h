@@ -40,6 +40,10 @@ class JavaBaseTracer : public BaseTracer {
       uint16_t& depth,
       uint16_t max_depth) = 0;
 
+  EntryType framesEntryType() const override {
+    return EntryType::STACK_FRAME;
+  }
+
   static bool isFramework(char const* name) {
     static constexpr framework_prefix prefixes[]{
         {"Ljava", 5},
@@ -308,6 +308,12 @@ void SamplingProfiler::flushStackTraces(
     std::unordered_set<uint64_t>& loggedFramesSet) {
   int processedCount = 0;
   auto& logger = *state_.logger;
+  bool expectedResetFrames = true;
+  if (state_.resetStackFrames.compare_exchange_strong(
+          expectedResetFrames, false)) {
+    state_.framesWriter->reset();
+  }
+
   for (size_t i = 0; i < MAX_STACKS_COUNT; i++) {
     auto& slot = state_.stacks[i];
 
@@ -326,7 +332,17 @@ void SamplingProfiler::flushStackTraces(
 
       logTimerType(slot, tid, logger);
 
-      if (StackCollectionRetcode::SUCCESS == slotState) {
+      auto framesType = tracer->framesEntryType();
+      if (StackCollectionRetcode::SUCCESS == slotState &&
+          framesType != EntryType::UNKNOWN_TYPE) {
+        state_.framesWriter->write(FramesEntry{
+            .id = 0,
+            .type = framesType,
+            .timestamp = slot.time,
+            .tid = static_cast<int32_t>(tid),
+            .matchid = 0,
+            .frames = {.values = slot.frames, .size = slot.depth}});
+      } else if (StackCollectionRetcode::SUCCESS == slotState) {
         tracer->flushStack(logger, slot.frames, slot.depth, tid, slot.time);
       } else {
         StackCollectionEntryConverter::logRetcode(
@@ -405,6 +421,7 @@ bool SamplingProfiler::initialize(
     std::unordered_map<int32_t, std::shared_ptr<BaseTracer>> tracers) {
   state_.processId = getpid();
   state_.logger = &logger;
+  state_.framesWriter = std::make_unique<StackFramesWriter>(logger);
   state_.availableTracers = available_tracers;
   state_.tracersMap = std::move(tracers);
   state_.timerManager.reset();
@@ -475,6 +492,7 @@ bool SamplingProfiler::startProfiling(
   registerSignalHandlers();
 
   state_.profileStartTime = monotonicTime();
+  state_.resetStackFrames.store(true);
   state_.currentTracers = state_.availableTracers & requested_tracers;
 
   if (state_.currentTracers == 0) {
@@ -576,6 +594,7 @@ void SamplingProfiler::removeFromWhitelist(int targetThread) {
 void SamplingProfiler::resetFrameworkNamesSet() {
   // Let the logger loop know we should reset our cache of frames
   state_.resetFrameworkSymbols.store(true);
+  state_.resetStackFrames.store(true);
 }
 
 } // namespace profiler
@@ -35,6 +35,7 @@
 #include <profilo/profiler/BaseTracer.h>
 #include <profilo/profiler/Constants.h>
 #include <profilo/profiler/SignalHandler.h>
+#include <profilo/profiler/StackFramesWriter.h>
 
 namespace fbjni = facebook::jni;
 
@@ -121,6 +122,13 @@ struct ProfileState {
   // If a secondary trace starts, we need to tell the logger loop to clear
   // its cache of logged frames, so that the new trace won't miss any symbols
   std::atomic_bool resetFrameworkSymbols;
+
+  // Writes the stacks of tracers that have a framesEntryType(). Only used
+  // by the logger loop.
+  std::unique_ptr<StackFramesWriter> framesWriter;
+  // Same as resetFrameworkSymbols, but for framesWriter: a new trace can
+  // only expand samples whose base it has seen.
+  std::atomic_bool resetStackFrames;
 };
 
 /**
@@ -0,0 +1,109 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <profilo/profiler/StackFramesWriter.h>
+
+#include <algorithm>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+namespace {
+
+//
+// A FramesEntry in its shared-prefix encoding, in the shape
+// MultiBufferLogger::write() expects.
+//
+struct PrefixFramesEntry {
+  int32_t id;
+  EntryType type;
+  FramesEntry entry;
+  int32_t base;
+  uint16_t shared;
+
+  static size_t calculateSize(const PrefixFramesEntry& prefix) {
+    // The ID is varint encoded, so it's part of the size.
+    return FramesEntry::calculatePrefixSize(
+        prefix.withID(), prefix.base, prefix.shared);
+  }
+
+  static void pack(const PrefixFramesEntry& prefix, void* dst, size_t size) {
+    FramesEntry::packPrefix(
+        prefix.withID(), prefix.base, prefix.shared, dst, size);
+  }
+
+  // The logger assigns the ID to `id`.
+  FramesEntry withID() const {
+    auto copy = entry;
+    copy.id = id;
+    return copy;
+  }
+};
+
+// Number of frames at the root end of both stacks that are the same.
+uint16_t sharedFrames(
+    const FramesEntry& entry,
+    const std::vector<int64_t>& previous) {
+  auto frames = entry.frames.values + entry.frames.size;
+  auto mismatch = std::mismatch(
+      std::reverse_iterator<const int64_t*>(frames),
+      std::reverse_iterator<const int64_t*>(entry.frames.values),
+      previous.rbegin(),
+      previous.rend());
+  return static_cast<uint16_t>(mismatch.second - previous.rbegin());
+}
+
+} // namespace
+
+StackFramesWriter::StackFramesWriter(MultiBufferLogger& logger)
+    : logger_(logger), threads_() {}
+
+int32_t StackFramesWriter::write(FramesEntry entry) {
+  auto it = threads_.find(entry.tid);
+  uint16_t shared = 0;
+  if (it != threads_.end() && it->second.prefixed + 1 < kKeyframeInterval) {
+    shared = sharedFrames(entry, it->second.frames);
+  }
+
+  int32_t id;
+  if (shared == 0) {
+    id = logger_.write(entry);
+  } else {
+    id = logger_.write(PrefixFramesEntry{
+        .id = 0,
+        .type = entry.type,
+        .entry = entry,
+        .base = it->second.id,
+        .shared = shared,
+    });
+  }
+
+  auto& thread = it != threads_.end() ? it->second : threads_[entry.tid];
+  thread.id = id;
+  thread.prefixed = shared == 0 ? 0 : thread.prefixed + 1;
+  thread.frames.assign(
+      entry.frames.values, entry.frames.values + entry.frames.size);
+  return id;
+}
+
+void StackFramesWriter::reset() {
+  threads_.clear();
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
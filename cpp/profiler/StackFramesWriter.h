@@ -0,0 +1,73 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <profilo/MultiBufferLogger.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+using logger::MultiBufferLogger;
+
+//
+// Writes stack samples, storing only the frames that differ from the
+// previous sample of the same thread (see FramesEntry::packPrefix()).
+// Consecutive samples usually share most of their frames from the root, so
+// a sample takes far fewer ring slots this way.
+//
+// Readers can only expand a sample if they've seen the one it's based on
+// (see writer::StackTraceInvertingVisitor), so every kKeyframeInterval-th
+// sample of a thread is written in full. That bounds what's lost when a
+// reader starts in the middle of a thread's samples, or some of them were
+// overwritten.
+//
+// Not thread-safe, meant for the profiler's logger thread.
+//
+class StackFramesWriter {
+ public:
+  static constexpr uint32_t kKeyframeInterval = 16;
+
+  explicit StackFramesWriter(MultiBufferLogger& logger);
+
+  // Returns the entry ID.
+  int32_t write(FramesEntry entry);
+
+  // Forget the previous samples, so that the next sample of every thread is
+  // written in full. Call when a trace starts.
+  void reset();
+
+ private:
+  struct ThreadState {
+    // Entry ID of the previous sample.
+    int32_t id;
+    // Samples written against a base since the last full one.
+    uint32_t prefixed;
+    std::vector<int64_t> frames;
+  };
+
+  MultiBufferLogger& logger_;
+  std::unordered_map<int32_t, ThreadState> threads_;
+};
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
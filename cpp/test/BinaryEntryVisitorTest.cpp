@@ -0,0 +1,208 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <profilo/writer/BinaryEntryVisitor.h>
+#include <profilo/writer/DeltaEncodingVisitor.h>
+#include <profilo/writer/PrintEntryVisitor.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+std::string bytes(std::initializer_list<uint8_t> values) {
+  return std::string(values.begin(), values.end());
+}
+
+} // namespace
+
+TEST(BinaryEntryVisitorTest, testStandardEntryBlock) {
+  std::stringstream stream;
+  BinaryEntryVisitor visitor(stream);
+
+  visitor.visit(StandardEntry{
+      .id = 10,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = 100,
+      .tid = 5,
+      .callid = 0,
+      .matchid = -1,
+      .extra = 3,
+  });
+  EXPECT_EQ(stream.str(), "");
+  visitor.flush();
+
+  EXPECT_EQ(
+      stream.str(),
+      // Rows, types.
+      bytes({1, 1, 21, 9}) + "MARK_PUSH" +
+          // Strings, kinds.
+          bytes({0, 0}) +
+          // id, type, timestamp, tid, callid, matchid, extra.
+          bytes({20, 21, 200, 1, 10, 0, 1, 6}));
+}
+
+TEST(BinaryEntryVisitorTest, testColumnsAreDeltaEncoded) {
+  std::stringstream stream;
+  BinaryEntryVisitor visitor(stream);
+
+  for (int32_t idx = 0; idx < 2; ++idx) {
+    visitor.visit(StandardEntry{
+        .id = 10 + idx,
+        .type = EntryType::MARK_PUSH,
+        .timestamp = 100 + 2 * idx,
+        .tid = 5,
+        .callid = 0,
+        .matchid = 0,
+        .extra = 0,
+    });
+    visitor.flush();
+  }
+
+  // The second block carries the deltas over and doesn't define the type
+  // again.
+  auto second = stream.str().substr(23);
+  EXPECT_EQ(second, bytes({1, 0, 0, 0, 2, 21, 4, 0, 0, 0, 0}));
+}
+
+TEST(BinaryEntryVisitorTest, testFramesAreRawInt64s) {
+  std::stringstream stream;
+  BinaryEntryVisitor visitor(stream);
+
+  int64_t frames[] = {0x0102030405060708, -1};
+  visitor.visit(FramesEntry{
+      .id = 1,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 1,
+      .tid = 1,
+      .matchid = 0,
+      .frames = {.values = frames, .size = 2},
+  });
+  visitor.flush();
+
+  EXPECT_EQ(
+      stream.str(),
+      bytes({1, 1, 45, 11}) + "STACK_FRAME" + bytes({0, 1}) +
+          // id, type, timestamp, tid, matchid, count.
+          bytes({2, 45, 2, 2, 0, 2}) +
+          bytes({8, 7, 6, 5, 4, 3, 2, 1}) +
+          bytes({0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}));
+}
+
+TEST(BinaryEntryVisitorTest, testStringsAreDefinedOnce) {
+  std::stringstream stream;
+  BinaryEntryVisitor visitor(stream);
+
+  auto visitString = [&](int32_t id, const char* string) {
+    visitor.visit(BytesEntry{
+        .id = id,
+        .type = EntryType::STRING_NAME,
+        .matchid = 1,
+        .bytes =
+            {.values = reinterpret_cast<const uint8_t*>(string),
+             .size = static_cast<uint16_t>(strlen(string))},
+    });
+  };
+  visitString(1, "main");
+  visitString(2, "render");
+  visitor.flush();
+  auto first = stream.str().size();
+  visitString(3, "main");
+  visitor.flush();
+
+  EXPECT_EQ(
+      stream.str().substr(0, first),
+      bytes({2, 1, 83, 11}) + "STRING_NAME" + bytes({2, 4}) + "main" +
+          bytes({6}) + "render" + bytes({2, 2}) +
+          // id, type, matchid, string columns.
+          bytes({2, 2, 83, 83, 2, 0, 0, 1}));
+  EXPECT_EQ(stream.str().substr(first), bytes({1, 0, 0, 2, 2, 83, 0, 0}));
+}
+
+TEST(BinaryEntryVisitorTest, testBlocksAreWrittenWhenFullOrOnTraceEnd) {
+  std::stringstream stream;
+  BinaryEntryVisitor visitor(stream, 2);
+
+  StandardEntry entry{
+      .id = 1,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = 1,
+      .tid = 1,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 0,
+  };
+  visitor.visit(entry);
+  EXPECT_EQ(stream.str().size(), 0);
+  visitor.visit(entry);
+  auto full = stream.str().size();
+  EXPECT_GT(full, 0);
+
+  entry.type = EntryType::TRACE_END;
+  visitor.visit(entry);
+  EXPECT_GT(stream.str().size(), full);
+}
+
+TEST(BinaryEntryVisitorTest, testSmallerThanText) {
+  std::stringstream binary_stream;
+  BinaryEntryVisitor binary(binary_stream);
+  std::stringstream text_stream;
+  PrintEntryVisitor print(text_stream);
+  DeltaEncodingVisitor text(print);
+
+  int64_t frames[20];
+  for (int32_t idx = 0; idx < 1000; ++idx) {
+    StandardEntry entry{
+        .id = 1000 + 2 * idx,
+        .type = idx % 2 ? EntryType::MARK_POP : EntryType::MARK_PUSH,
+        .timestamp = 1000000 + 1000 * idx,
+        .tid = 1000 + idx % 4,
+        .callid = 0,
+        .matchid = 0,
+        .extra = 0,
+    };
+    binary.visit(entry);
+    text.visit(entry);
+
+    for (int64_t frame = 0; frame < 20; ++frame) {
+      frames[frame] = 0x70000000 + 0x40 * frame + idx % 3;
+    }
+    FramesEntry sample{
+        .id = entry.id + 1,
+        .type = EntryType::STACK_FRAME,
+        .timestamp = entry.timestamp + 500,
+        .tid = entry.tid,
+        .matchid = 0,
+        .frames = {.values = frames, .size = 20},
+    };
+    binary.visit(sample);
+    text.visit(sample);
+  }
+  binary.flush();
+
+  EXPECT_LT(binary_stream.str().size() * 3, text_stream.str().size());
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,148 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <profilo/writer/BlockPipeline.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+void write(BlockPipeline& pipeline, const std::string& data) {
+  std::memcpy(pipeline.reserve(data.size()), data.data(), data.size());
+}
+
+} // namespace
+
+TEST(BlockPipelineTest, testBlocksAreConsumedInOrderOnAnotherThread) {
+  std::string consumed;
+  std::thread::id consumer;
+  BlockPipeline pipeline(
+      [&](const char* data, size_t size) {
+        consumed.append(data, size);
+        consumer = std::this_thread::get_id();
+      },
+      16,
+      2);
+
+  std::string expected;
+  for (int i = 0; i < 100; i++) {
+    auto record = std::to_string(i) + ",";
+    write(pipeline, record);
+    expected += record;
+  }
+  pipeline.drain();
+
+  EXPECT_EQ(consumed, expected);
+  EXPECT_NE(consumer, std::this_thread::get_id());
+}
+
+TEST(BlockPipelineTest, testReservationsAreNotSplit) {
+  std::vector<std::string> blocks;
+  BlockPipeline pipeline(
+      [&](const char* data, size_t size) { blocks.emplace_back(data, size); },
+      16,
+      2);
+
+  write(pipeline, "0123456789");
+  write(pipeline, "abcdefghij");
+  write(pipeline, "klmnop");
+  pipeline.drain();
+
+  std::vector<std::string> expected{"0123456789", "abcdefghijklmnop"};
+  EXPECT_EQ(blocks, expected);
+  EXPECT_THROW(pipeline.reserve(17), std::invalid_argument);
+}
+
+TEST(BlockPipelineTest, testProducerWaitsForConsumer) {
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::atomic<int> consumed(0);
+  BlockPipeline pipeline(
+      [&](const char*, size_t) {
+        released.wait();
+        consumed++;
+      },
+      4,
+      2);
+
+  std::atomic<bool> done(false);
+  std::thread producer([&] {
+    // The consumer holds on to the first block, so handing over the second
+    // has to wait for it to give a block back.
+    for (int i = 0; i < 2; i++) {
+      write(pipeline, "abcd");
+      pipeline.flush();
+    }
+    done = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(done);
+  release.set_value();
+  producer.join();
+  pipeline.drain();
+  EXPECT_EQ(consumed, 2);
+}
+
+TEST(BlockPipelineTest, testConsumerErrorsAreRethrown) {
+  int calls = 0;
+  BlockPipeline pipeline(
+      [&](const char*, size_t) {
+        calls++;
+        throw std::runtime_error("consumer");
+      },
+      4,
+      2);
+
+  write(pipeline, "abcd");
+  EXPECT_THROW(pipeline.drain(), std::runtime_error);
+
+  // Later blocks are dropped.
+  write(pipeline, "efgh");
+  EXPECT_THROW(pipeline.drain(), std::runtime_error);
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(BlockPipelineTest, testDestructorConsumesRemainingBlocks) {
+  std::string consumed;
+  {
+    BlockPipeline pipeline(
+        [&](const char* data, size_t size) { consumed.append(data, size); },
+        4,
+        2);
+    write(pipeline, "abcd");
+    write(pipeline, "ef");
+  }
+  EXPECT_EQ(consumed, "abcdef");
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
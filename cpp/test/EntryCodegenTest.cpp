@@ -16,12 +16,18 @@
 
 #include <limits>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include <profilo/Logger.h>
 #include <profilo/entries/Entry.h>
 #include <profilo/entries/EntryParser.h>
+#include <profilo/SlotWriter.h>
 #include <profilo/entries/EntryType.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/writer/PacketReassembler.h>
 #include <profilo/writer/PrintEntryVisitor.h>
 
 namespace facebook {
@@ -35,6 +41,10 @@ class TestVisitor : public EntryVisitor {
   StandardEntry standardEntry;
   FramesEntry framesEntry;
   BytesEntry bytesEntry;
+  AnnotationEntry annotationEntry;
+  FramesEntry prefixEntry;
+  int32_t prefixBase = 0;
+  uint16_t prefixShared = 0;
 
   virtual void visit(const StandardEntry& entry) {
     standardEntry = entry;
@@ -45,6 +55,15 @@ class TestVisitor : public EntryVisitor {
   virtual void visit(const BytesEntry& entry) {
     bytesEntry = entry;
   }
+  virtual void visit(const AnnotationEntry& entry) {
+    annotationEntry = entry;
+  }
+  virtual void
+  visitPrefix(const FramesEntry& entry, int32_t base, uint16_t shared) {
+    prefixEntry = entry;
+    prefixBase = base;
+    prefixShared = shared;
+  }
 };
 
 TEST(EntryCodegen, testPackUnpackStandardEntry) {
@@ -93,6 +112,111 @@ TEST(EntryCodegen, testPrintStandardEntry) {
   EXPECT_EQ(stream.str(), "10|TRACE_START|123|0|1|2|3\n");
 }
 
+TEST(EntryCodegen, testPackUnpackCompactStandardEntry) {
+  StandardEntry input{
+      .id = 10,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = std::numeric_limits<int64_t>::max(),
+      .tid = 1234,
+      .callid = -1,
+      .matchid = 0,
+      .extra = std::numeric_limits<int64_t>::min()};
+
+  char buffer[sizeof(input) * 2]{};
+  auto size = StandardEntry::calculateCompactSize(input);
+  StandardEntry::packCompact(input, buffer, sizeof(buffer));
+
+  StandardEntry entry{};
+  EXPECT_EQ(StandardEntry::unpackCompact(entry, buffer, size), size);
+  EXPECT_EQ(input.id, entry.id);
+  EXPECT_EQ(input.type, entry.type);
+  EXPECT_EQ(input.timestamp, entry.timestamp);
+  EXPECT_EQ(input.tid, entry.tid);
+  EXPECT_EQ(input.callid, entry.callid);
+  EXPECT_EQ(input.matchid, entry.matchid);
+  EXPECT_EQ(input.extra, entry.extra);
+
+  // unpack() accepts both encodings.
+  StandardEntry unpacked{};
+  StandardEntry::unpack(unpacked, buffer, size);
+  EXPECT_EQ(input.timestamp, unpacked.timestamp);
+  EXPECT_EQ(input.extra, unpacked.extra);
+}
+
+TEST(EntryCodegen, testCompactStandardEntrySize) {
+  StandardEntry input{
+      .id = 100000,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = 123456789012345,
+      .tid = 12345,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 42};
+
+  // Serialization type, presence bitmap and 3 + 1 + 7 + 3 + 1 bytes of fields.
+  EXPECT_EQ(StandardEntry::calculateCompactSize(input), 17);
+  EXPECT_LT(
+      StandardEntry::calculateCompactSize(input),
+      StandardEntry::calculateSize(input));
+
+  StandardEntry worst{
+      .id = std::numeric_limits<int32_t>::min(),
+      .type = EntryType::MARK_PUSH,
+      .timestamp = std::numeric_limits<int64_t>::min(),
+      .tid = std::numeric_limits<int32_t>::min(),
+      .callid = std::numeric_limits<int32_t>::min(),
+      .matchid = std::numeric_limits<int32_t>::min(),
+      .extra = std::numeric_limits<int64_t>::min()};
+  EXPECT_LE(
+      StandardEntry::calculateCompactSize(worst), Logger::kMaxCompactSize);
+}
+
+TEST(EntryCodegen, testParseConcatenatedCompactEntries) {
+  char buffer[128]{};
+  size_t size = 0;
+  for (int i = 0; i < 3; ++i) {
+    StandardEntry input{
+        .id = 10 + i,
+        .type = EntryType::MARK_PUSH,
+        .timestamp = 100 * i,
+        .tid = 1,
+        .callid = 0,
+        .matchid = 0,
+        .extra = i};
+    StandardEntry::packCompact(input, buffer + size, sizeof(buffer) - size);
+    size += StandardEntry::calculateCompactSize(input);
+  }
+
+  std::stringstream stream;
+  PrintEntryVisitor visitor(stream);
+  EntryParser::parse(buffer, size, visitor);
+
+  EXPECT_EQ(
+      stream.str(),
+      "10|MARK_PUSH|0|1|0|0|0\n"
+      "11|MARK_PUSH|100|1|0|0|1\n"
+      "12|MARK_PUSH|200|1|0|0|2\n");
+}
+
+TEST(EntryCodegen, testUnpackTruncatedCompactEntryThrows) {
+  StandardEntry input{
+      .id = 10,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = 123456789,
+      .tid = 1,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 0};
+
+  char buffer[sizeof(input)]{};
+  StandardEntry::packCompact(input, buffer, sizeof(buffer));
+
+  StandardEntry entry{};
+  auto size = StandardEntry::calculateCompactSize(input);
+  EXPECT_THROW(
+      StandardEntry::unpackCompact(entry, buffer, size - 1), std::out_of_range);
+}
+
 TEST(EntryCodegen, testPackUnpackBytesEntry) {
   uint8_t bytes[] = {'h', 'i', '!'};
   BytesEntry input{
@@ -190,6 +314,177 @@ TEST(EntryCodegen, testPrintFramesEntry) {
       "10|STACK_FRAME|123|1|0|0|300\n");
 }
 
+TEST(EntryCodegen, testPackUnpackPrefixFramesEntry) {
+  // Leaf first, the last two frames are shared with the base.
+  int64_t frames[] = {-5, 1000000, 100, 200};
+  FramesEntry input{
+      .id = 11,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 123,
+      .tid = 1,
+      .matchid = 7,
+      .frames = {.values = frames, .size = 4},
+  };
+
+  auto size = FramesEntry::calculatePrefixSize(input, 10, 2);
+  char buffer[size];
+  FramesEntry::packPrefix(input, 10, 2, buffer, size);
+  EXPECT_EQ(buffer[0], FramesEntry::kPrefixSerializationType);
+  EXPECT_EQ(FramesEntry::peekPrefixCount(buffer, size), 2);
+
+  TestVisitor visitor;
+  EntryParser::parse(buffer, size, visitor);
+
+  auto& entry = visitor.prefixEntry;
+  EXPECT_EQ(visitor.prefixBase, 10);
+  EXPECT_EQ(visitor.prefixShared, 2);
+  EXPECT_EQ(input.id, entry.id);
+  EXPECT_EQ(input.type, entry.type);
+  EXPECT_EQ(input.timestamp, entry.timestamp);
+  EXPECT_EQ(input.tid, entry.tid);
+  EXPECT_EQ(input.matchid, entry.matchid);
+  ASSERT_EQ(entry.frames.size, 2);
+  EXPECT_EQ(entry.frames.values[0], -5);
+  EXPECT_EQ(entry.frames.values[1], 1000000);
+}
+
+TEST(EntryCodegen, testPrefixFramesEntryIsSmaller) {
+  int64_t frames[20];
+  for (int64_t i = 0; i < 20; ++i) {
+    frames[i] = 0x7f0000001000 + i * 0x40;
+  }
+  FramesEntry input{
+      .id = 11,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 123,
+      .tid = 1,
+      .frames = {.values = frames, .size = 20},
+  };
+
+  EXPECT_LT(
+      FramesEntry::calculatePrefixSize(input, 10, 0),
+      FramesEntry::calculateSize(input));
+  EXPECT_LT(
+      FramesEntry::calculatePrefixSize(input, 10, 18),
+      FramesEntry::calculatePrefixSize(input, 10, 0));
+}
+
+TEST(EntryCodegen, testUnpackTruncatedPrefixFramesEntryThrows) {
+  int64_t frames[] = {100, 200, 300};
+  FramesEntry input{
+      .id = 11,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 123,
+      .tid = 1,
+      .frames = {.values = frames, .size = 3},
+  };
+
+  auto size = FramesEntry::calculatePrefixSize(input, 10, 0);
+  char buffer[size];
+  FramesEntry::packPrefix(input, 10, 0, buffer, size);
+
+  TestVisitor visitor;
+  EXPECT_THROW(
+      EntryParser::parse(buffer, size - 1, visitor), std::out_of_range);
+  EXPECT_THROW(
+      FramesEntry::calculatePrefixSize(input, 10, 4), std::out_of_range);
+}
+
+TEST(EntryCodegen, testPackUnpackAnnotationEntry) {
+  KeyValue pairs[] = {
+      KeyValue::ofInt("start", 4096),
+      KeyValue::ofDouble("ratio", 0.5),
+      KeyValue::ofString("file", "libc.so"),
+  };
+  auto size = KeyValue::calculateSize(pairs, 3);
+  uint8_t packed[size];
+  KeyValue::pack(pairs, 3, packed, size);
+
+  AnnotationEntry input{
+      .id = 10,
+      .type = EntryType::MAPPING,
+      .timestamp = 123,
+      .tid = 1,
+      .matchid = 2,
+      .pairs = {.values = packed, .size = static_cast<uint16_t>(size)},
+  };
+
+  char buffer[AnnotationEntry::calculateSize(input)];
+  AnnotationEntry::pack(input, buffer, sizeof(buffer));
+
+  TestVisitor visitor;
+  EntryParser::parse(buffer, sizeof(buffer), visitor);
+
+  auto& entry = visitor.annotationEntry;
+  EXPECT_EQ(input.id, entry.id);
+  EXPECT_EQ(input.type, entry.type);
+  EXPECT_EQ(input.timestamp, entry.timestamp);
+  EXPECT_EQ(input.tid, entry.tid);
+  EXPECT_EQ(input.matchid, entry.matchid);
+
+  KeyValueReader reader(entry.pairs.values, entry.pairs.size);
+  KeyValue pair;
+  ASSERT_TRUE(reader.next(pair));
+  EXPECT_EQ(pair.kind, KeyValue::INT);
+  EXPECT_EQ(std::string(pair.key, pair.keySize), "start");
+  EXPECT_EQ(pair.intValue, 4096);
+
+  ASSERT_TRUE(reader.next(pair));
+  EXPECT_EQ(pair.kind, KeyValue::DOUBLE);
+  EXPECT_EQ(std::string(pair.key, pair.keySize), "ratio");
+  EXPECT_EQ(pair.doubleValue, 0.5);
+
+  ASSERT_TRUE(reader.next(pair));
+  EXPECT_EQ(pair.kind, KeyValue::STRING);
+  EXPECT_EQ(std::string(pair.key, pair.keySize), "file");
+  EXPECT_EQ(
+      std::string(pair.stringValue.values, pair.stringValue.size), "libc.so");
+
+  EXPECT_FALSE(reader.next(pair));
+}
+
+TEST(EntryCodegen, testReadTruncatedKeyValueListThrows) {
+  KeyValue pairs[] = {KeyValue::ofString("file", "libc.so")};
+  auto size = KeyValue::calculateSize(pairs, 1);
+  uint8_t packed[size];
+  KeyValue::pack(pairs, 1, packed, size);
+
+  KeyValueReader reader(packed, size - 1);
+  KeyValue pair;
+  EXPECT_THROW(reader.next(pair), std::out_of_range);
+}
+
+TEST(EntryCodegen, testPrintAnnotationEntry) {
+  KeyValue pairs[] = {
+      KeyValue::ofInt("start", 4096),
+      KeyValue::ofDouble("ratio", 0.5),
+      KeyValue::ofString("file", "libc.so"),
+  };
+  auto size = KeyValue::calculateSize(pairs, 3);
+  uint8_t packed[size];
+  KeyValue::pack(pairs, 3, packed, size);
+
+  AnnotationEntry input{
+      .id = 10,
+      .type = EntryType::MAPPING,
+      .timestamp = 123,
+      .tid = 1,
+      .matchid = 0,
+      .pairs = {.values = packed, .size = static_cast<uint16_t>(size)},
+  };
+
+  char buffer[AnnotationEntry::calculateSize(input)];
+  AnnotationEntry::pack(input, buffer, sizeof(buffer));
+
+  std::stringstream stream;
+  PrintEntryVisitor visitor(stream);
+  EntryParser::parse(buffer, sizeof(buffer), visitor);
+
+  EXPECT_EQ(
+      stream.str(),
+      "10|MAPPING|123|1|0|i:start=4096|d:ratio=0.5|s:file=libc.so\n");
+}
+
 TEST(EntryCodegen, testPackNullptrThrows) {
   StandardEntry standard{};
   BytesEntry bytes{};
@@ -273,7 +568,7 @@ TEST(EntryCodegen, testPackTooSmallThrows) {
   }
 
   try {
-    char standard_buffer[sizeof(StandardEntry)]; // should be off by one
+    char standard_buffer[StandardEntry::kSerializedSize - 1];
     StandardEntry::pack(standard, standard_buffer, sizeof(standard_buffer));
     FAIL() << "Expected std::out_of_range";
   } catch (const std::out_of_range& ex) {
@@ -301,6 +596,138 @@ TEST(EntryCodegen, testPackTooSmallThrows) {
   }
 }
 
+namespace {
+
+// Packs `entry` in place into ring slots through a SlotWriter and returns
+// the reassembled payload.
+template <class T>
+std::vector<char> packThroughSlots(const T& entry) {
+  auto size = T::calculateSize(entry);
+  mmapbuf::Buffer buffer(16);
+  auto& ring = buffer.ringBuffer();
+  auto start = ring.currentHead();
+
+  auto packets = logger::SlotWriter::packetCount(size);
+  {
+    logger::SlotWriter writer(
+        ring, packets > 1 ? 1 : logger::Packet::kPacketIdNone, size);
+    T::pack(entry, writer);
+  }
+  EXPECT_EQ(start.distanceTo(ring.currentHead()), packets);
+
+  std::vector<char> payload;
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    auto bytes = static_cast<const char*>(data);
+    payload.assign(bytes, bytes + size);
+  });
+  for (auto cursor = start; cursor.distanceTo(ring.currentHead()) > 0;
+       cursor.moveForward()) {
+    logger::Packet packet{};
+    EXPECT_TRUE(ring.tryRead(packet, cursor));
+    reassembler.process(packet);
+  }
+  return payload;
+}
+
+template <class T>
+std::vector<char> packToMemory(const T& entry) {
+  auto size = T::calculateSize(entry);
+  // Zero-filled, like the padding SlotWriter writes.
+  std::vector<int32_t> buffer((size + 3) / 4);
+  T::pack(entry, buffer.data(), size);
+  auto bytes = reinterpret_cast<const char*>(buffer.data());
+  return std::vector<char>(bytes, bytes + size);
+}
+
+} // namespace
+
+TEST(EntryCodegen, testSlotWriterPackStandardEntry) {
+  StandardEntry input{
+      .id = 10,
+      .type = EntryType::TRACE_START,
+      .timestamp = 123,
+      .tid = 0,
+      .callid = 1,
+      .matchid = 2,
+      .extra = 3};
+
+  EXPECT_EQ(packThroughSlots(input), packToMemory(input));
+}
+
+TEST(EntryCodegen, testLayoutPackMatchesFieldwisePack) {
+  static_assert(
+      StandardEntry::calculateSize(StandardEntry{}) ==
+          StandardEntry::kSerializedSize,
+      "calculateSize() must be usable at compile time");
+
+  StandardEntry inputs[] = {
+      {.id = 10,
+       .type = EntryType::TRACE_START,
+       .timestamp = 123,
+       .tid = 0,
+       .callid = 1,
+       .matchid = 2,
+       .extra = 3},
+      {.id = std::numeric_limits<int32_t>::min(),
+       .type = EntryType::MARK_PUSH,
+       .timestamp = std::numeric_limits<int64_t>::min(),
+       .tid = std::numeric_limits<int32_t>::max(),
+       .callid = -1,
+       .matchid = std::numeric_limits<int32_t>::min(),
+       .extra = std::numeric_limits<int64_t>::max()},
+      {},
+  };
+
+  for (auto& input : inputs) {
+    char layout[StandardEntry::kSerializedSize];
+    char fieldwise[StandardEntry::kSerializedSize];
+    StandardEntry::pack(input, layout, sizeof(layout));
+    StandardEntry::packFieldwise(input, fieldwise, sizeof(fieldwise));
+    EXPECT_EQ(
+        std::string(layout, sizeof(layout)),
+        std::string(fieldwise, sizeof(fieldwise)));
+
+    // The sink overload goes through the same Layout.
+    auto slots = packThroughSlots(input);
+    EXPECT_EQ(
+        std::string(slots.begin(), slots.end()),
+        std::string(fieldwise, sizeof(fieldwise)));
+  }
+}
+
+TEST(EntryCodegen, testSlotWriterPackFramesEntry) {
+  // Spans several packets.
+  std::vector<int64_t> frames(50);
+  for (size_t i = 0; i < frames.size(); ++i) {
+    frames[i] = 1000 + i;
+  }
+  FramesEntry input{
+      .id = 10,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 123,
+      .tid = 1,
+      .frames = {.values = frames.data(), .size = (uint16_t)frames.size()},
+  };
+
+  EXPECT_EQ(packThroughSlots(input), packToMemory(input));
+}
+
+TEST(EntryCodegen, testSlotWriterPackBytesEntry) {
+  // Odd size, with alignment padding before the values.
+  std::vector<uint8_t> bytes(123);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = i;
+  }
+  BytesEntry input{
+      .id = 10,
+      .type = EntryType::STRING_VALUE,
+      .matchid = 1,
+      .bytes = {.values = bytes.data(), .size = (uint16_t)bytes.size()},
+  };
+
+  EXPECT_EQ(packThroughSlots(input), packToMemory(input));
+}
+
 } // namespace entries
 } // namespace profilo
 } // namespace facebook
@@ -19,8 +19,12 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <atomic>
 #include <climits>
+#include <chrono>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <profilo/logger/lfrb/LockFreeRingBuffer.h>
 #include <profilo/util/common.h>
@@ -57,6 +61,16 @@ class LockFreeRingBufferTestAccessor {
     return TestBuffer::allocateAt(count, ptr);
   }
 
+  static uint32_t idx(TestBuffer& buf, uint64_t ticket) {
+    return buf.idx(ticket);
+  }
+  static uint32_t turn(TestBuffer& buf, uint64_t ticket) {
+    return buf.turn(ticket);
+  }
+  static bool hasPowerOfTwoCapacity(TestBuffer& buf) {
+    return buf.hasPowerOfTwoCapacity();
+  }
+
   static void destroy(TestBuffer* buf) {
     buf->~LockFreeRingBuffer();
     delete[](char*) buf;
@@ -114,6 +128,329 @@ TEST(LockFreeRingBufferTest, testAllocationCorrectness) {
   EXPECT_EQ(crc, crc_after);
 }
 
+TEST(LockFreeRingBufferTest, testReserveIsContiguous) {
+  constexpr auto kBufferSize = 10;
+  TestBuffer* ringBuffer =
+      LockFreeRingBufferTestAccessor::allocate(kBufferSize);
+
+  TestPacket first{.payload = {}};
+  first.payload[0] = 1;
+  ringBuffer->write(first);
+
+  auto reserved = ringBuffer->reserve(3);
+
+  TestPacket other{.payload = {}};
+  other.payload[0] = 5;
+  ringBuffer->write(other);
+
+  TestPacket result{};
+  for (int i = 0; i < 3; ++i) {
+    auto slot = reserved;
+    slot.moveForward(i);
+    EXPECT_FALSE(ringBuffer->tryRead(result, slot))
+        << "unpublished reserved slot must not be readable";
+  }
+
+  auto cursor = reserved;
+  for (int i = 0; i < 3; ++i) {
+    TestPacket packet{.payload = {}};
+    packet.payload[0] = 2 + i;
+    ringBuffer->writeReserved(cursor, packet);
+    cursor.moveForward();
+  }
+
+  // The write that raced with the reservation lands after the reserved range.
+  auto readCursor = ringBuffer->currentTail();
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_TRUE(ringBuffer->tryRead(result, readCursor));
+    EXPECT_EQ(result.payload[0], i + 1);
+    readCursor.moveForward();
+  }
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+TEST(LockFreeRingBufferTest, testRoundUpCapacity) {
+  EXPECT_EQ(TestBuffer::roundUpCapacity(0), 1);
+  EXPECT_EQ(TestBuffer::roundUpCapacity(1), 1);
+  EXPECT_EQ(TestBuffer::roundUpCapacity(3), 4);
+  EXPECT_EQ(TestBuffer::roundUpCapacity(1024), 1024);
+  EXPECT_EQ(TestBuffer::roundUpCapacity(1025), 2048);
+  EXPECT_EQ(TestBuffer::roundUpCapacity(UINT32_MAX), 1u << 31);
+}
+
+TEST(LockFreeRingBufferTest, testIndexMathMatchesDivision) {
+  const uint64_t kTickets[] = {
+      0, 1, 9, 10, 15, 16, 17, 1023, 1024, 1ull << 33, (1ull << 40) + 7};
+
+  for (uint32_t capacity : {1u, 10u, 16u, 1000u, 1024u}) {
+    TestBuffer* ringBuffer = LockFreeRingBufferTestAccessor::allocate(capacity);
+    for (auto ticket : kTickets) {
+      EXPECT_EQ(
+          LockFreeRingBufferTestAccessor::idx(*ringBuffer, ticket),
+          ticket % capacity)
+          << "capacity " << capacity << " ticket " << ticket;
+      EXPECT_EQ(
+          LockFreeRingBufferTestAccessor::turn(*ringBuffer, ticket),
+          (uint32_t)(ticket / capacity))
+          << "capacity " << capacity << " ticket " << ticket;
+    }
+    LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+  }
+}
+
+TEST(LockFreeRingBufferTest, testPowerOfTwoCapacityWrapAround) {
+  constexpr auto kBufferSize = 16;
+  TestBuffer* ringBuffer =
+      LockFreeRingBufferTestAccessor::allocate(kBufferSize);
+
+  // Write three times around the buffer, the last kBufferSize writes must be
+  // readable and the ones before them must not.
+  for (int i = 0; i < kBufferSize * 3; ++i) {
+    TestPacket packet{.payload = {}};
+    packet.payload[0] = i;
+    ringBuffer->write(packet);
+  }
+
+  auto cursor = ringBuffer->currentTail();
+  TestPacket result{};
+  for (int i = 0; i < kBufferSize; ++i) {
+    ASSERT_TRUE(ringBuffer->tryRead(result, cursor));
+    EXPECT_EQ(result.payload[0], kBufferSize * 2 + i);
+    cursor.moveForward();
+  }
+
+  cursor = ringBuffer->currentTail();
+  cursor.moveBackward();
+  EXPECT_FALSE(ringBuffer->tryRead(result, cursor));
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+TEST(LockFreeRingBufferTest, testZeroCapacityIsNotPowerOfTwo) {
+  TestBuffer* ringBuffer = LockFreeRingBufferTestAccessor::allocate(0);
+  EXPECT_FALSE(
+      LockFreeRingBufferTestAccessor::hasPowerOfTwoCapacity(*ringBuffer));
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+
+  ringBuffer = LockFreeRingBufferTestAccessor::allocate(16);
+  EXPECT_TRUE(
+      LockFreeRingBufferTestAccessor::hasPowerOfTwoCapacity(*ringBuffer));
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+bool isValid(const std::vector<uint64_t>& valid, size_t i) {
+  return (valid[i / 64] & (uint64_t{1} << (i % 64))) != 0;
+}
+
+TEST(LockFreeRingBufferTest, testSnapshotReportsInvalidSlots) {
+  constexpr auto kBufferSize = 16;
+  constexpr auto kWrites = 20;
+  constexpr auto kSnapshotSize = 24;
+  TestBuffer* ringBuffer =
+      LockFreeRingBufferTestAccessor::allocate(kBufferSize);
+
+  auto start = ringBuffer->currentHead();
+  for (int i = 0; i < kWrites; ++i) {
+    TestPacket packet{.payload = {}};
+    packet.payload[0] = i;
+    ringBuffer->write(packet);
+  }
+
+  // [0, 4) were overwritten, [4, 20) are readable, [20, 24) don't exist yet.
+  std::vector<TestPacket> packets(kSnapshotSize);
+  std::vector<uint64_t> valid(TestBuffer::snapshotBitmapWords(kSnapshotSize));
+  EXPECT_EQ(
+      ringBuffer->snapshot(start, kSnapshotSize, packets.data(), valid.data()),
+      kBufferSize);
+
+  for (int i = 0; i < kSnapshotSize; ++i) {
+    bool expectValid = i >= kWrites - kBufferSize && i < kWrites;
+    EXPECT_EQ(isValid(valid, i), expectValid) << "slot " << i;
+    if (expectValid) {
+      EXPECT_EQ(packets[i].payload[0], i);
+    }
+  }
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+TEST(LockFreeRingBufferTest, testSnapshotMatchesTryRead) {
+  constexpr auto kBufferSize = 100000;
+  TestBuffer* ringBuffer =
+      LockFreeRingBufferTestAccessor::allocate(kBufferSize);
+  writeRandomEntries(*ringBuffer, kBufferSize + kBufferSize / 2, kBufferSize);
+
+  auto tail = ringBuffer->currentTail();
+  std::vector<TestPacket> packets(kBufferSize);
+  std::vector<uint64_t> valid(TestBuffer::snapshotBitmapWords(kBufferSize));
+  EXPECT_EQ(
+      ringBuffer->snapshot(tail, kBufferSize, packets.data(), valid.data()),
+      kBufferSize);
+
+  auto cursor = tail;
+  for (int i = 0; i < kBufferSize; ++i) {
+    TestPacket packet{};
+    ASSERT_TRUE(ringBuffer->tryRead(packet, cursor));
+    ASSERT_TRUE(isValid(valid, i));
+    ASSERT_EQ(0, memcmp(&packet, &packets[i], sizeof(TestPacket)));
+    cursor.moveForward();
+  }
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+TEST(LockFreeRingBufferTest, testOverwrittenReadsAreNotTorn) {
+  constexpr auto kBufferSize = 16;
+  constexpr auto kWrites = 20;
+  TestBuffer* ringBuffer =
+      LockFreeRingBufferTestAccessor::allocate(kBufferSize);
+
+  auto start = ringBuffer->currentHead();
+  TestPacket written{.payload = {}};
+  for (int i = 0; i < kWrites; ++i) {
+    ringBuffer->write(written);
+  }
+  EXPECT_EQ(ringBuffer->writeCount(), kWrites);
+
+  // A slot that was overwritten before the copy started fails the read but
+  // wasn't torn.
+  TestPacket packet{};
+  uint64_t tornReads = 0;
+  EXPECT_FALSE(ringBuffer->tryRead(packet, start, &tornReads));
+  EXPECT_EQ(tornReads, 0);
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+TEST(LockFreeRingBufferTest, testPollAndTryReadWaitsForWrite) {
+  constexpr auto kBufferSize = 16;
+  TestBuffer* ringBuffer =
+      LockFreeRingBufferTestAccessor::allocate(kBufferSize);
+  PollBackoff backoff{
+      .spins = 10,
+      .latencyBudget = std::chrono::microseconds(100),
+  };
+
+  auto cursor = ringBuffer->currentHead();
+  std::thread writer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    TestPacket packet{.payload = {}};
+    packet.payload[0] = 42;
+    ringBuffer->write(packet);
+  });
+
+  TestPacket packet{};
+  EXPECT_TRUE(ringBuffer->pollAndTryRead(packet, cursor, backoff));
+  EXPECT_EQ(packet.payload[0], 42);
+  writer.join();
+
+  // Overwritten writes fail right away.
+  TestPacket filler{.payload = {}};
+  for (int i = 0; i < kBufferSize; ++i) {
+    ringBuffer->write(filler);
+  }
+  EXPECT_FALSE(ringBuffer->pollAndTryRead(packet, cursor, backoff));
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+TEST(LockFreeRingBufferTest, testWaitAndTryReadUntilDeadline) {
+  constexpr auto kBufferSize = 16;
+  TestBuffer* ringBuffer =
+      LockFreeRingBufferTestAccessor::allocate(kBufferSize);
+
+  auto cursor = ringBuffer->currentHead();
+  TestPacket packet{};
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(ringBuffer->waitAndTryRead(
+      packet, cursor, start + std::chrono::milliseconds(10)));
+  EXPECT_GE(
+      std::chrono::steady_clock::now() - start, std::chrono::milliseconds(10));
+
+  std::thread writer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    TestPacket packet{.payload = {}};
+    packet.payload[0] = 42;
+    ringBuffer->write(packet);
+  });
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::hours(1);
+  EXPECT_TRUE(ringBuffer->waitAndTryRead(packet, cursor, deadline));
+  EXPECT_EQ(packet.payload[0], 42);
+  writer.join();
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+TEST(LockFreeRingBufferTest, testTryReserveSkipsBusySlots) {
+  constexpr auto kBufferSize = 4;
+  TestBuffer* ringBuffer =
+      LockFreeRingBufferTestAccessor::allocate(kBufferSize);
+
+  // A writer stalls in the middle of writing slot 0...
+  auto stalled = ringBuffer->reserve(1);
+  ringBuffer->beginWriteReserved(stalled);
+  TestPacket packet{.payload = {}};
+  for (int i = 1; i < kBufferSize; ++i) {
+    ringBuffer->write(packet);
+  }
+
+  // ... so the next lap can't claim it.
+  auto cursor = ringBuffer->currentHead();
+  EXPECT_FALSE(ringBuffer->tryReserve(1, 10, cursor));
+  EXPECT_EQ(ringBuffer->writeCount(), kBufferSize);
+
+  ringBuffer->endWriteReserved(stalled);
+  ASSERT_TRUE(ringBuffer->tryReserve(2, 10, cursor));
+  EXPECT_EQ(cursor.distanceTo(ringBuffer->currentHead()), 2);
+
+  packet.payload[0] = 42;
+  ringBuffer->writeReserved(cursor, packet);
+  TestPacket result{};
+  EXPECT_TRUE(ringBuffer->tryRead(result, cursor));
+  EXPECT_EQ(result.payload[0], 42);
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
+TEST(LockFreeRingBufferTest, testTryReserveClaimsDistinctSlots) {
+  constexpr auto kThreads = 4;
+  constexpr auto kWritesPerThread = 10000;
+  // Never wraps around, so no slot is ever busy.
+  TestBuffer* ringBuffer = LockFreeRingBufferTestAccessor::allocate(
+      kThreads * kWritesPerThread);
+
+  std::atomic<int> written(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&] {
+      TestPacket packet{.payload = {}};
+      for (int write = 0; write < kWritesPerThread; ++write) {
+        auto cursor = ringBuffer->currentHead();
+        // Losing the race to other writers uses up the budget too.
+        if (ringBuffer->tryReserve(1, 100, cursor)) {
+          ringBuffer->writeReserved(cursor, packet);
+          ++written;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Every claimed slot was written exactly once.
+  EXPECT_EQ(ringBuffer->writeCount(), static_cast<uint64_t>(written.load()));
+  auto cursor = ringBuffer->currentTail();
+  TestPacket result{};
+  for (int i = 0; i < written.load(); ++i) {
+    EXPECT_TRUE(ringBuffer->tryRead(result, cursor));
+    cursor.moveForward();
+  }
+
+  LockFreeRingBufferTestAccessor::destroy(ringBuffer);
+}
+
 } // namespace lfrb
 } // namespace logger
 } // namespace profilo
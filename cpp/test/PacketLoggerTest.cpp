@@ -14,9 +14,13 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
 #include <vector>
 
 #include <profilo/PacketLogger.h>
+#include <profilo/logger/buffer/PacketResizer.h>
 #include <profilo/logger/lfrb/LockFreeRingBuffer.h>
 #include <profilo/mmapbuf/Buffer.h>
 #include <profilo/writer/PacketReassembler.h>
@@ -116,5 +120,251 @@ TEST(Logger, testPacketizedWriteBackwards) {
   }
 }
 
+TEST(Logger, testMultiPacketWritesStayContiguous) {
+  constexpr size_t kThreads = 4;
+  constexpr size_t kWritesPerThread = 100;
+  constexpr size_t kPayloadItems = 100; // 200 bytes, 4 packets
+
+  Buffer buffer(kThreads * kWritesPerThread * 4);
+  PacketLogger logger([&]() -> TraceBuffer& { return buffer.ringBuffer(); });
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&logger, t] {
+      std::vector<uint16_t> data(kPayloadItems, t);
+      for (size_t i = 0; i < kWritesPerThread; ++i) {
+        logger.write(data.data(), data.size() * kItemSize);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  size_t calls = 0;
+  PacketReassembler reassembler([&](const void* read_data, size_t size) {
+    EXPECT_EQ(size, kPayloadItems * kItemSize);
+    const uint16_t* idata = reinterpret_cast<const uint16_t*>(read_data);
+    for (size_t j = 1; j < kPayloadItems; ++j) {
+      EXPECT_EQ(idata[0], idata[j]) << "payload must not be mixed";
+    }
+    ++calls;
+  });
+
+  auto cursor = buffer.ringBuffer().currentTail();
+  Packet packet;
+  StreamID prev_stream = Packet::kPacketIdNone;
+  bool in_stream = false;
+  while (buffer.ringBuffer().tryRead(packet, cursor)) {
+    if (in_stream) {
+      EXPECT_EQ(packet.stream, prev_stream)
+          << "packets of one stream must be adjacent";
+      EXPECT_FALSE(packet.start);
+    }
+    prev_stream = packet.stream;
+    in_stream = packet.next;
+    reassembler.process(packet);
+    cursor.moveForward();
+  }
+
+  EXPECT_EQ(calls, kThreads * kWritesPerThread);
+}
+
+TEST(Logger, testResizedPacketsReassemble) {
+  using LargePacket = BasicPacket<256>;
+  constexpr size_t kLargeSize = sizeof(LargePacket::data);
+
+  std::vector<uint16_t> data(kItems);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i;
+  }
+  auto bytes = reinterpret_cast<const char*>(data.data());
+
+  StreamID next_stream = 1000;
+  for (size_t i = 1; i <= data.size(); ++i) {
+    size_t size = i * kItemSize;
+
+    size_t calls = 0;
+    PacketReassembler reassembler([&](const void* read_data, size_t read_size) {
+      EXPECT_EQ(read_size, size) << "read must be the same size as write";
+      EXPECT_EQ(0, memcmp(read_data, bytes, size)) << "data must be the same";
+      ++calls;
+    });
+
+    // Split the payload like a build with 256 byte slots would.
+    bool multi_packet = size > kLargeSize;
+    for (size_t offset = 0; offset < size; offset += kLargeSize) {
+      LargePacket large{};
+      large.stream = multi_packet ? 1 : Packet::kPacketIdNone;
+      large.start = offset == 0;
+      large.next = offset + kLargeSize < size;
+      large.size = std::min(kLargeSize, size - offset);
+      memcpy(large.data, bytes + offset, large.size);
+
+      resizePacket<Packet>(large, next_stream, [&](Packet& packet) {
+        EXPECT_LE(packet.size, sizeof(Packet::data));
+        reassembler.process(packet);
+      });
+    }
+
+    EXPECT_EQ(calls, 1) << "must read exactly one payload";
+  }
+}
+
+TEST(Logger, testReassemblerCountsDroppedStreams) {
+  size_t calls = 0;
+  PacketReassembler reassembler([&](const void*, size_t) { ++calls; });
+
+  auto makePacket = [](StreamID stream, bool start, bool next) {
+    Packet packet{};
+    packet.stream = stream;
+    packet.start = start;
+    packet.next = next;
+    packet.size = 1;
+    return packet;
+  };
+
+  // The start of stream 1 was lost.
+  reassembler.process(makePacket(1, false, true));
+  reassembler.process(makePacket(1, false, false));
+  // Stream 2 is complete.
+  reassembler.process(makePacket(2, true, true));
+  reassembler.process(makePacket(2, false, false));
+  // Stream 3 never ends.
+  reassembler.process(makePacket(3, true, true));
+
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(reassembler.droppedStreams(), 1);
+  EXPECT_EQ(reassembler.activeStreams(), 1);
+}
+
+//
+// Splits each payload into packets of `chunk` bytes and interleaves the
+// streams round-robin, like many threads writing at once.
+//
+std::vector<Packet> interleavePackets(
+    const std::vector<std::vector<char>>& payloads,
+    size_t chunk) {
+  std::vector<Packet> packets;
+  for (size_t offset = 0;; offset += chunk) {
+    bool any = false;
+    for (size_t i = 0; i < payloads.size(); ++i) {
+      auto& payload = payloads[i];
+      if (offset >= payload.size()) {
+        continue;
+      }
+      any = true;
+      Packet packet{};
+      packet.stream = i + 1;
+      packet.start = offset == 0;
+      packet.next = offset + chunk < payload.size();
+      packet.size = std::min(chunk, payload.size() - offset);
+      std::memcpy(packet.data, payload.data() + offset, packet.size);
+      packets.push_back(packet);
+    }
+    if (!any) {
+      return packets;
+    }
+  }
+}
+
+std::vector<std::vector<char>> makePayloads(size_t count) {
+  std::vector<std::vector<char>> payloads(count);
+  for (size_t i = 0; i < count; ++i) {
+    // Some payloads outgrow their slab buffer.
+    auto size = i % 5 == 0 ? PacketReassembler::kSlabBufferSize + 100 * i
+                           : 100 + 37 * i;
+    for (size_t j = 0; j < size; ++j) {
+      payloads[i].push_back(static_cast<char>(i * 31 + j));
+    }
+  }
+  return payloads;
+}
+
+TEST(Logger, testReassemblerInterleavedStreams) {
+  // More concurrent streams than slab buffers, and enough to grow the table.
+  auto payloads = makePayloads(4 * PacketReassembler::kSlabBuffers + 3);
+  auto packets = interleavePackets(payloads, sizeof(Packet::data));
+
+  std::vector<std::vector<char>> read;
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    auto bytes = static_cast<const char*>(data);
+    read.emplace_back(bytes, bytes + size);
+  });
+  for (auto& packet : packets) {
+    reassembler.process(packet);
+  }
+
+  std::sort(read.begin(), read.end());
+  auto expected = payloads;
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(read, expected);
+  EXPECT_EQ(reassembler.activeStreams(), 0);
+  EXPECT_EQ(reassembler.droppedStreams(), 0);
+}
+
+TEST(Logger, testReassemblerInterleavedStreamsBackwards) {
+  auto payloads = makePayloads(4 * PacketReassembler::kSlabBuffers + 3);
+  auto packets = interleavePackets(payloads, sizeof(Packet::data));
+
+  std::vector<std::vector<char>> read;
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    auto bytes = static_cast<const char*>(data);
+    read.emplace_back(bytes, bytes + size);
+  });
+  for (auto it = packets.rbegin(); it != packets.rend(); ++it) {
+    reassembler.processBackwards(*it);
+  }
+
+  std::sort(read.begin(), read.end());
+  auto expected = payloads;
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(read, expected);
+  EXPECT_EQ(reassembler.activeStreams(), 0);
+}
+
+TEST(Logger, testReassemblerPassesSinglePacketsThrough) {
+  Packet packet{};
+  packet.start = true;
+  packet.next = false;
+  packet.size = 3;
+
+  const void* seen = nullptr;
+  PacketReassembler reassembler(
+      [&](const void* data, size_t) { seen = data; });
+  reassembler.process(packet);
+  EXPECT_EQ(seen, packet.data);
+  reassembler.processBackwards(packet);
+  EXPECT_EQ(seen, packet.data);
+}
+
+TEST(Logger, testTryWriteDropsInsteadOfWaiting) {
+  constexpr size_t kBufferSize = 4;
+  Buffer buffer(kBufferSize);
+  auto& ring = buffer.ringBuffer();
+  PacketLogger logger([&]() -> TraceBuffer& { return ring; });
+  uint16_t data = 7;
+
+  // Another writer stalls in the middle of writing slot 0.
+  auto stalled = ring.reserve(1);
+  ring.beginWriteReserved(stalled);
+  for (size_t i = 1; i < kBufferSize; ++i) {
+    ASSERT_TRUE(logger.tryWrite(&data, sizeof(data), 10));
+  }
+
+  auto dropped = PacketLogger::droppedWrites();
+  EXPECT_FALSE(logger.tryWrite(&data, sizeof(data), 10));
+  EXPECT_EQ(PacketLogger::droppedWrites(), dropped + 1);
+
+  // The count is per thread.
+  std::thread([&] {
+    EXPECT_EQ(PacketLogger::droppedWrites(), 0);
+  }).join();
+
+  ring.endWriteReserved(stalled);
+  EXPECT_TRUE(logger.tryWrite(&data, sizeof(data), 10));
+  EXPECT_EQ(PacketLogger::droppedWrites(), dropped + 1);
+}
+
 } // namespace profilo
 } // namespace facebook
@@ -0,0 +1,213 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <profilo/MultiBufferLogger.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/profiler/StackFramesWriter.h>
+#include <profilo/writer/PacketReassembler.h>
+#include <profilo/writer/StackTraceInvertingVisitor.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+using mmapbuf::Buffer;
+using writer::PacketReassembler;
+using writer::StackTraceInvertingVisitor;
+
+namespace {
+
+//
+// Counts the entries as logged and, through a StackTraceInvertingVisitor,
+// collects the stacks they expand to.
+//
+class SampleVisitor : public EntryVisitor {
+ public:
+  struct Stacks : public EntryVisitor {
+    // Root first.
+    std::vector<std::vector<int64_t>> frames;
+    std::vector<int32_t> tids;
+
+    void visit(const StandardEntry&) override {}
+    void visit(const FramesEntry& entry) override {
+      frames.emplace_back(
+          entry.frames.values, entry.frames.values + entry.frames.size);
+      tids.push_back(entry.tid);
+    }
+    void visit(const BytesEntry&) override {}
+    void visit(const AnnotationEntry&) override {}
+  };
+
+  Stacks stacks;
+  size_t full = 0;
+  size_t prefixed = 0;
+
+  SampleVisitor() : stacks(), inverting_(stacks) {}
+
+  void visit(const StandardEntry&) override {}
+  void visit(const FramesEntry& entry) override {
+    ++full;
+    inverting_.visit(entry);
+  }
+  void visit(const BytesEntry&) override {}
+  void visit(const AnnotationEntry&) override {}
+  void visitPrefix(const FramesEntry& entry, int32_t base, uint16_t shared)
+      override {
+    ++prefixed;
+    inverting_.visitPrefix(entry, base, shared);
+  }
+
+ private:
+  StackTraceInvertingVisitor inverting_;
+};
+
+void readAll(Buffer& buffer, EntryVisitor& visitor) {
+  PacketReassembler reassembler([&visitor](const void* data, size_t size) {
+    EntryParser::parse(data, size, visitor);
+  });
+  auto& ring = buffer.ringBuffer();
+  auto cursor = ring.currentTail();
+  Packet packet{};
+  while (ring.tryRead(packet, cursor)) {
+    reassembler.process(packet);
+    cursor.moveForward();
+  }
+}
+
+int32_t writeSample(
+    StackFramesWriter& writer,
+    int32_t tid,
+    std::vector<int64_t> frames) {
+  return writer.write(FramesEntry{
+      .id = 0,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 1,
+      .tid = tid,
+      .matchid = 0,
+      .frames =
+          {
+              .values = frames.data(),
+              .size = static_cast<uint16_t>(frames.size()),
+          },
+  });
+}
+
+} // namespace
+
+TEST(StackFramesWriterTest, testSamplesRoundTrip) {
+  MultiBufferLogger logger{};
+  auto buffer = std::make_shared<Buffer>(100);
+  logger.addBuffer(buffer);
+  StackFramesWriter writer(logger);
+
+  // Leaf first, as unwound.
+  writeSample(writer, 1, {30, 20, 10});
+  writeSample(writer, 2, {300, 200, 100});
+  writeSample(writer, 1, {40, 20, 10});
+  writeSample(writer, 1, {40, 20, 10});
+  writeSample(writer, 2, {400});
+  writeSample(writer, 1, {60, 50, 40, 20, 10});
+  writeSample(writer, 1, {70});
+
+  SampleVisitor visitor;
+  readAll(*buffer, visitor);
+
+  // Thread 2's second sample and thread 1's last one share no frames.
+  EXPECT_EQ(visitor.full, 4);
+  EXPECT_EQ(visitor.prefixed, 3);
+  EXPECT_EQ(
+      visitor.stacks.frames,
+      (std::vector<std::vector<int64_t>>{
+          {10, 20, 30},
+          {100, 200, 300},
+          {10, 20, 40},
+          {10, 20, 40},
+          {400},
+          {10, 20, 40, 50, 60},
+          {70},
+      }));
+  EXPECT_EQ(visitor.stacks.tids, (std::vector<int32_t>{1, 2, 1, 1, 2, 1, 1}));
+}
+
+TEST(StackFramesWriterTest, testKeyframeInterval) {
+  MultiBufferLogger logger{};
+  auto buffer = std::make_shared<Buffer>(100);
+  logger.addBuffer(buffer);
+  StackFramesWriter writer(logger);
+
+  for (uint32_t i = 0; i < 2 * StackFramesWriter::kKeyframeInterval; ++i) {
+    writeSample(writer, 1, {30, 20, 10});
+  }
+
+  SampleVisitor visitor;
+  readAll(*buffer, visitor);
+
+  EXPECT_EQ(visitor.full, 2);
+  EXPECT_EQ(visitor.prefixed, 2 * StackFramesWriter::kKeyframeInterval - 2);
+  EXPECT_EQ(
+      visitor.stacks.frames.size(), 2 * StackFramesWriter::kKeyframeInterval);
+}
+
+TEST(StackFramesWriterTest, testResetWritesFullSamples) {
+  MultiBufferLogger logger{};
+  auto buffer = std::make_shared<Buffer>(100);
+  logger.addBuffer(buffer);
+  StackFramesWriter writer(logger);
+
+  writeSample(writer, 1, {30, 20, 10});
+  writer.reset();
+  writeSample(writer, 1, {30, 20, 10});
+
+  SampleVisitor visitor;
+  readAll(*buffer, visitor);
+
+  EXPECT_EQ(visitor.full, 2);
+  EXPECT_EQ(visitor.prefixed, 0);
+}
+
+TEST(StackFramesWriterTest, testSamplesBeforeKeyframeAreDroppedMidway) {
+  MultiBufferLogger logger{};
+  auto first = std::make_shared<Buffer>(100);
+  logger.addBuffer(first);
+  StackFramesWriter writer(logger);
+
+  writeSample(writer, 1, {30, 20, 10});
+  // A buffer added now misses the base of the next samples.
+  auto second = std::make_shared<Buffer>(100);
+  logger.addBuffer(second);
+  for (uint32_t i = 1; i <= StackFramesWriter::kKeyframeInterval; ++i) {
+    writeSample(writer, 1, {30, 20, 10});
+  }
+
+  SampleVisitor visitor;
+  readAll(*second, visitor);
+
+  EXPECT_EQ(visitor.full, 1);
+  EXPECT_EQ(visitor.prefixed, StackFramesWriter::kKeyframeInterval - 1);
+  // Only the keyframe could be expanded.
+  EXPECT_EQ(visitor.stacks.frames.size(), 1);
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -72,5 +72,193 @@ TEST(StackInvertingVisitorTest, testStacksAreInverted) {
       "2|STACK_FRAME|2|2|0|10|3000\n");
 }
 
+TEST(StackInvertingVisitorTest, testPrefixStacksAreExpanded) {
+  std::stringstream stream;
+  PrintEntryVisitor print(stream);
+  StackTraceInvertingVisitor stack(print);
+
+  int64_t frames[] = {300, 200, 100};
+  stack.visit(FramesEntry{
+      .id = 1,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 1,
+      .tid = 1,
+      .matchid = 10,
+      .frames =
+          {
+              .values = frames,
+              .size = 3,
+          },
+  });
+
+  // {400, 200, 100}, based on entry 1.
+  int64_t prefixframes[] = {400};
+  stack.visitPrefix(
+      FramesEntry{
+          .id = 2,
+          .type = EntryType::STACK_FRAME,
+          .timestamp = 2,
+          .tid = 1,
+          .matchid = 10,
+          .frames =
+              {
+                  .values = prefixframes,
+                  .size = 1,
+              },
+      },
+      1,
+      2);
+
+  // {500, 400, 200, 100}, based on entry 2.
+  int64_t moreframes[] = {500, 400};
+  stack.visitPrefix(
+      FramesEntry{
+          .id = 3,
+          .type = EntryType::STACK_FRAME,
+          .timestamp = 3,
+          .tid = 1,
+          .matchid = 10,
+          .frames =
+              {
+                  .values = moreframes,
+                  .size = 2,
+              },
+      },
+      2,
+      2);
+
+  EXPECT_EQ(
+      stream.str(),
+      "1|STACK_FRAME|1|1|0|10|100\n"
+      "1|STACK_FRAME|1|1|0|10|200\n"
+      "1|STACK_FRAME|1|1|0|10|300\n"
+      "2|STACK_FRAME|2|1|0|10|100\n"
+      "2|STACK_FRAME|2|1|0|10|200\n"
+      "2|STACK_FRAME|2|1|0|10|400\n"
+      "3|STACK_FRAME|3|1|0|10|100\n"
+      "3|STACK_FRAME|3|1|0|10|200\n"
+      "3|STACK_FRAME|3|1|0|10|400\n"
+      "3|STACK_FRAME|3|1|0|10|500\n");
+}
+
+TEST(StackInvertingVisitorTest, testPrefixStacksReadBackwardsAreExpanded) {
+  std::stringstream stream;
+  PrintEntryVisitor print(stream);
+  StackTraceInvertingVisitor stack(print);
+
+  // Newest first, as in dumps: {500, 400, 200, 100} based on entry 2,
+  // {400, 200, 100} based on entry 1, then entry 1 itself.
+  int64_t moreframes[] = {500, 400};
+  stack.visitPrefix(
+      FramesEntry{
+          .id = 3,
+          .type = EntryType::STACK_FRAME,
+          .timestamp = 3,
+          .tid = 1,
+          .matchid = 10,
+          .frames =
+              {
+                  .values = moreframes,
+                  .size = 2,
+              },
+      },
+      2,
+      2);
+
+  int64_t prefixframes[] = {400};
+  stack.visitPrefix(
+      FramesEntry{
+          .id = 2,
+          .type = EntryType::STACK_FRAME,
+          .timestamp = 2,
+          .tid = 1,
+          .matchid = 10,
+          .frames =
+              {
+                  .values = prefixframes,
+                  .size = 1,
+              },
+      },
+      1,
+      2);
+
+  EXPECT_EQ(stream.str(), "");
+
+  int64_t frames[] = {300, 200, 100};
+  stack.visit(FramesEntry{
+      .id = 1,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 1,
+      .tid = 1,
+      .matchid = 10,
+      .frames =
+          {
+              .values = frames,
+              .size = 3,
+          },
+  });
+
+  EXPECT_EQ(
+      stream.str(),
+      "1|STACK_FRAME|1|1|0|10|100\n"
+      "1|STACK_FRAME|1|1|0|10|200\n"
+      "1|STACK_FRAME|1|1|0|10|300\n"
+      "2|STACK_FRAME|2|1|0|10|100\n"
+      "2|STACK_FRAME|2|1|0|10|200\n"
+      "2|STACK_FRAME|2|1|0|10|400\n"
+      "3|STACK_FRAME|3|1|0|10|100\n"
+      "3|STACK_FRAME|3|1|0|10|200\n"
+      "3|STACK_FRAME|3|1|0|10|400\n"
+      "3|STACK_FRAME|3|1|0|10|500\n");
+}
+
+TEST(StackInvertingVisitorTest, testPrefixStacksWithUnknownBaseAreDropped) {
+  std::stringstream stream;
+  PrintEntryVisitor print(stream);
+  StackTraceInvertingVisitor stack(print);
+
+  int64_t frames[] = {300, 200, 100};
+  stack.visit(FramesEntry{
+      .id = 1,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 1,
+      .tid = 1,
+      .matchid = 10,
+      .frames =
+          {
+              .values = frames,
+              .size = 3,
+          },
+  });
+
+  int64_t prefixframes[] = {400};
+  auto prefix = FramesEntry{
+      .id = 3,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 3,
+      .tid = 1,
+      .matchid = 10,
+      .frames =
+          {
+              .values = prefixframes,
+              .size = 1,
+          },
+  };
+  // Entry 2 was never seen.
+  stack.visitPrefix(prefix, 2, 2);
+  // The base is another thread's.
+  prefix.tid = 2;
+  stack.visitPrefix(prefix, 1, 2);
+  // More frames shared than the base has.
+  prefix.tid = 1;
+  stack.visitPrefix(prefix, 1, 4);
+
+  EXPECT_EQ(
+      stream.str(),
+      "1|STACK_FRAME|1|1|0|10|100\n"
+      "1|STACK_FRAME|1|1|0|10|200\n"
+      "1|STACK_FRAME|1|1|0|10|300\n");
+}
+
 } // namespace profilo
 } // namespace facebook
@@ -0,0 +1,284 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/writer/PacketReassembler.h>
+#include <profilo/writer/PrintEntryVisitor.h>
+#include <profilo/writer/StringResolvingVisitor.h>
+
+using namespace facebook::profilo::entries;
+using namespace facebook::profilo::writer;
+
+namespace facebook {
+namespace profilo {
+
+namespace {
+
+BytesEntry makeDefine(int32_t id, const char* str) {
+  return BytesEntry{
+      .id = 1,
+      .type = EntryType::STRING_DEFINE,
+      .matchid = id,
+      .bytes = {
+          .values = reinterpret_cast<const uint8_t*>(str),
+          .size = static_cast<uint16_t>(strlen(str))}};
+}
+
+StandardEntry makeRef(int32_t id, EntryType type, int32_t arg1) {
+  return StandardEntry{
+      .id = 2,
+      .type = EntryType::STRING_REF,
+      .timestamp = 0,
+      .tid = 0,
+      .callid = static_cast<int32_t>(type),
+      .matchid = arg1,
+      .extra = id,
+  };
+}
+
+// Prints the entries logged to `buffer` since `cursor`, with their strings
+// resolved from the STRING_DEFINEs in there and `logger`.
+std::string printSince(
+    mmapbuf::Buffer& buffer,
+    TraceBuffer::Cursor cursor,
+    const Logger* logger = nullptr) {
+  std::stringstream stream;
+  PrintEntryVisitor print(stream);
+  StringResolvingVisitor strings(print, logger);
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    EntryParser::parse(data, size, strings);
+  });
+
+  auto& ring = buffer.ringBuffer();
+  for (; cursor.distanceTo(ring.currentHead()) > 0; cursor.moveForward()) {
+    Packet packet{};
+    if (ring.tryRead(packet, cursor)) {
+      reassembler.process(packet);
+    }
+  }
+  return stream.str();
+}
+
+StandardEntry makeTraceStart(EntryType type = EntryType::TRACE_START) {
+  return StandardEntry{
+      .id = 0,
+      .type = type,
+      .timestamp = 100,
+      .tid = 0,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 0,
+  };
+}
+
+} // namespace
+
+TEST(StringResolvingVisitorTest, testReferencesBecomeBytesEntries) {
+  std::stringstream stream;
+  PrintEntryVisitor print(stream);
+  StringResolvingVisitor strings(print);
+
+  strings.visit(makeDefine(1, "Choreographer#doFrame"));
+  strings.visit(makeRef(1, EntryType::STRING_NAME, 10));
+
+  EXPECT_EQ(stream.str(), "2|STRING_NAME|10|Choreographer#doFrame\n");
+}
+
+TEST(StringResolvingVisitorTest, testUnresolvedReferencesPassThrough) {
+  std::stringstream stream;
+  PrintEntryVisitor print(stream);
+  StringResolvingVisitor strings(print);
+
+  strings.visit(makeRef(1, EntryType::STRING_NAME, 10));
+
+  EXPECT_EQ(stream.str(), "2|STRING_REF|0|0|83|10|1\n");
+}
+
+TEST(StringResolvingVisitorTest, testReferencesResolveFromLogger) {
+  mmapbuf::Buffer buffer(64);
+  auto& logger = buffer.logger();
+  const char name[] = "inflate";
+  auto bytes = reinterpret_cast<const uint8_t*>(name);
+
+  logger.writeString(EntryType::STRING_NAME, 10, bytes, strlen(name));
+  // Only the reference, the definition comes before the cursor.
+  auto cursor = buffer.ringBuffer().currentHead();
+  auto ref_id =
+      logger.writeString(EntryType::STRING_NAME, 11, bytes, strlen(name));
+
+  std::stringstream expected;
+  expected << ref_id << "|STRING_NAME|11|inflate\n";
+  EXPECT_EQ(printSince(buffer, cursor, &logger), expected.str());
+  EXPECT_NE(printSince(buffer, cursor), expected.str());
+}
+
+TEST(StringResolvingVisitorTest, testTraceStartLogsDictionary) {
+  mmapbuf::Buffer buffer(64);
+  auto& logger = buffer.logger();
+  const char name[] = "measure";
+  auto bytes = reinterpret_cast<const uint8_t*>(name);
+
+  logger.writeString(EntryType::STRING_NAME, 10, bytes, strlen(name));
+  auto cursor = buffer.ringBuffer().currentHead();
+  auto start_id = logger.write(makeTraceStart());
+  auto ref_id =
+      logger.writeString(EntryType::STRING_NAME, 11, bytes, strlen(name));
+
+  std::stringstream expected;
+  expected << start_id << "|TRACE_START|100|0|0|0|0\n"
+           << ref_id << "|STRING_NAME|11|measure\n";
+  EXPECT_EQ(printSince(buffer, cursor), expected.str());
+}
+
+TEST(StringResolvingVisitorTest, testPendingStringIsLoggedInFull) {
+  mmapbuf::Buffer buffer(64);
+  auto& ring = buffer.ringBuffer();
+  const char name[] = "dispatch";
+  auto bytes = reinterpret_cast<const uint8_t*>(name);
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool inserting = false;
+  bool written = false;
+  static thread_local bool is_inserter = false;
+
+  Logger logger(
+      [&]() -> TraceBuffer& {
+        if (is_inserter) {
+          // The string is pending while its definition is being written.
+          std::unique_lock<std::mutex> lock(mutex);
+          inserting = true;
+          cv.notify_all();
+          cv.wait_for(
+              lock, std::chrono::milliseconds(200), [&] { return written; });
+        }
+        return ring;
+      },
+      Logger::getGlobalEntryID());
+  // Set up the dictionary.
+  const char other[] = "other";
+  logger.writeString(
+      EntryType::STRING_NAME,
+      1,
+      reinterpret_cast<const uint8_t*>(other),
+      strlen(other));
+
+  auto cursor = ring.currentHead();
+  int32_t inserter_id = 0;
+  std::thread inserter([&] {
+    is_inserter = true;
+    inserter_id =
+        logger.writeString(EntryType::STRING_NAME, 10, bytes, strlen(name));
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return inserting; });
+  }
+  auto id = logger.writeString(EntryType::STRING_NAME, 11, bytes, strlen(name));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    written = true;
+    cv.notify_all();
+  }
+  inserter.join();
+
+  std::stringstream expected;
+  expected << id << "|STRING_NAME|11|dispatch\n"
+           << inserter_id << "|STRING_NAME|10|dispatch\n";
+  EXPECT_EQ(printSince(buffer, cursor), expected.str());
+}
+
+TEST(StringResolvingVisitorTest, testDictionaryDumpFitsInRing) {
+  constexpr size_t kEntries = 256;
+  mmapbuf::Buffer buffer(kEntries);
+  auto& logger = buffer.logger();
+
+  // Long strings, up to 20 packets each, until the dictionary is full.
+  std::string name(Logger::kMaxVariableLengthEntry, 'a');
+  for (int i = 0; i < 64; ++i) {
+    name[0] = static_cast<char>('a' + i);
+    logger.writeString(
+        EntryType::STRING_NAME,
+        10,
+        reinterpret_cast<const uint8_t*>(name.data()),
+        name.size());
+  }
+
+  // A TRACE_START would replace the full dictionary, a backwards trace
+  // still dumps it.
+  auto write_count = buffer.ringBuffer().writeCount();
+  logger.write(makeTraceStart(EntryType::TRACE_BACKWARDS));
+  auto dump_slots = buffer.ringBuffer().writeCount() - write_count - 1;
+  EXPECT_GT(dump_slots, 0);
+  EXPECT_LE(dump_slots, kEntries / 4);
+}
+
+TEST(StringResolvingVisitorTest, testWraparoundLogsDictionary) {
+  constexpr size_t kEntries = 16;
+  mmapbuf::Buffer buffer(kEntries);
+  auto& logger = buffer.logger();
+  const char name[] = "layout";
+  auto bytes = reinterpret_cast<const uint8_t*>(name);
+
+  logger.writeString(EntryType::STRING_NAME, 10, bytes, strlen(name));
+  for (size_t i = 0; i < kEntries; ++i) {
+    logger.write(StandardEntry{
+        .id = 0,
+        .type = EntryType::MARK_PUSH,
+        .timestamp = 100,
+        .tid = 0,
+        .callid = 0,
+        .matchid = 0,
+        .extra = 0,
+    });
+  }
+  // The original definition is gone by now, but writers don't log it again.
+  auto cursor = buffer.ringBuffer().currentHead();
+  auto ref_id =
+      logger.writeString(EntryType::STRING_NAME, 11, bytes, strlen(name));
+
+  std::stringstream expected;
+  expected << ref_id << "|STRING_REF|0|0|83|11|";
+  EXPECT_EQ(printSince(buffer, cursor).find(expected.str()), 0);
+
+  cursor = buffer.ringBuffer().currentHead();
+  logger.refreshStrings();
+  ref_id = logger.writeString(EntryType::STRING_NAME, 12, bytes, strlen(name));
+
+  expected.str("");
+  expected << ref_id << "|STRING_NAME|12|layout\n";
+  EXPECT_EQ(printSince(buffer, cursor), expected.str());
+
+  // Nothing to do until the ring wraps around again.
+  auto write_count = buffer.ringBuffer().writeCount();
+  logger.refreshStrings();
+  EXPECT_EQ(buffer.ringBuffer().writeCount(), write_count);
+}
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,184 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+#include <zdict.h>
+#include <zstd.h>
+#include <zstr/zstr.hpp>
+
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <profilo/writer/TraceCompressor.h>
+#include <profilo/writer/ZstdCompressor.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+std::string compress(
+    const TraceCompressor& compressor,
+    const std::vector<std::string>& chunks) {
+  std::stringbuf sink;
+  {
+    auto buffer = compressor.wrap(&sink);
+    std::ostream output(buffer.get());
+    for (auto const& chunk : chunks) {
+      output << chunk;
+      output.flush();
+    }
+  }
+  return sink.str();
+}
+
+std::string zstdDecompress(
+    const std::string& compressed,
+    const std::string& dictionary = std::string()) {
+  auto context = ZSTD_createDCtx();
+  if (!dictionary.empty()) {
+    ZSTD_DCtx_loadDictionary(context, dictionary.data(), dictionary.size());
+  }
+  std::string result;
+  std::vector<char> output(ZSTD_DStreamOutSize());
+  ZSTD_inBuffer in{
+      .src = compressed.data(), .size = compressed.size(), .pos = 0};
+  while (in.pos < in.size) {
+    ZSTD_outBuffer out{.dst = output.data(), .size = output.size(), .pos = 0};
+    auto ret = ZSTD_decompressStream(context, &out, &in);
+    if (ZSTD_isError(ret)) {
+      ZSTD_freeDCtx(context);
+      throw std::runtime_error(ZSTD_getErrorName(ret));
+    }
+    result.append(output.data(), out.pos);
+  }
+  ZSTD_freeDCtx(context);
+  return result;
+}
+
+std::string traceLines(int first, int count) {
+  std::stringstream lines;
+  for (int i = first; i < first + count; ++i) {
+    lines << i << "|MARK_PUSH|" << (i * 37) % 1000 << "|0|" << i % 8
+          << "|0|0\n";
+    lines << i + 1 << "|TRACE_ANNOTATION|" << i * 3 << "|0|" << i % 8
+          << "|0|0\n";
+  }
+  return lines.str();
+}
+
+} // namespace
+
+TEST(TraceCompressorTest, testDescriptions) {
+  EXPECT_EQ(ZlibCompressor().description(), "zlib:3");
+  EXPECT_EQ(ZlibCompressor(9).description(), "zlib:9");
+  EXPECT_EQ(ZstdCompressor().description(), "zstd:3");
+  EXPECT_EQ(ZstdCompressor(19).description(), "zstd:19");
+}
+
+TEST(TraceCompressorTest, testZlibRoundTrip) {
+  auto input = traceLines(0, 1000);
+  auto compressed = compress(ZlibCompressor(), {input});
+  EXPECT_LT(compressed.size(), input.size());
+
+  std::stringbuf source(compressed);
+  zstr::istreambuf decompressing(&source);
+  std::stringstream output;
+  output << &decompressing;
+  EXPECT_EQ(output.str(), input);
+}
+
+TEST(TraceCompressorTest, testZstdRoundTrip) {
+  auto input = traceLines(0, 1000);
+  auto compressed = compress(ZstdCompressor(), {input});
+  EXPECT_LT(compressed.size(), input.size());
+  EXPECT_EQ(zstdDecompress(compressed), input);
+}
+
+TEST(TraceCompressorTest, testZstdSyncEndsFrame) {
+  auto first = traceLines(0, 100);
+  auto second = traceLines(100, 100);
+  auto compressed = compress(ZstdCompressor(), {first, second});
+
+  auto frame =
+      ZSTD_findFrameCompressedSize(compressed.data(), compressed.size());
+  ASSERT_FALSE(ZSTD_isError(frame));
+  EXPECT_LT(frame, compressed.size());
+  EXPECT_EQ(zstdDecompress(compressed), first + second);
+}
+
+TEST(TraceCompressorTest, testZstdWritesNothingWithoutInput) {
+  EXPECT_EQ(compress(ZstdCompressor(), {}), "");
+  EXPECT_EQ(compress(ZstdCompressor(), {"", ""}), "");
+}
+
+TEST(TraceCompressorTest, testZstdDictionary) {
+  std::string samples;
+  std::vector<size_t> sample_sizes;
+  for (int i = 0; i < 500; ++i) {
+    auto sample = traceLines(i * 20, 20);
+    samples += sample;
+    sample_sizes.push_back(sample.size());
+  }
+  std::vector<char> trained(16 * 1024);
+  auto size = ZDICT_trainFromBuffer(
+      trained.data(),
+      trained.size(),
+      samples.data(),
+      sample_sizes.data(),
+      sample_sizes.size());
+  ASSERT_FALSE(ZDICT_isError(size)) << ZDICT_getErrorName(size);
+  std::string dictionary(trained.data(), size);
+  auto id = ZDICT_getDictID(dictionary.data(), dictionary.size());
+
+  ZstdCompressor compressor(3, dictionary);
+  EXPECT_EQ(compressor.description(), "zstd:3:dict=" + std::to_string(id));
+
+  auto input = traceLines(50000, 20);
+  auto compressed = compress(compressor, {input});
+  EXPECT_EQ(ZSTD_getDictID_fromFrame(compressed.data(), compressed.size()), id);
+  EXPECT_LT(compressed.size(), compress(ZstdCompressor(), {input}).size());
+  EXPECT_EQ(zstdDecompress(compressed, dictionary), input);
+}
+
+TEST(TraceCompressorTest, testPipelinedRoundTrip) {
+  PipelinedCompressor compressor(std::make_shared<ZstdCompressor>());
+  EXPECT_EQ(compressor.description(), "zstd:3");
+
+  // Several blocks, and a sync in between.
+  auto first = traceLines(0, 20000);
+  auto second = traceLines(20000, 100);
+  ASSERT_GT(first.size(), 2 * PipelinedCompressor::kBlockSize);
+  auto compressed = compress(compressor, {first, second});
+  EXPECT_EQ(zstdDecompress(compressed), first + second);
+}
+
+TEST(TraceCompressorTest, testZstdMissingDictionaryFileThrows) {
+  EXPECT_THROW(
+      ZstdCompressor::fromDictionaryFile("/nonexistent/dictionary"),
+      std::system_error);
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -15,25 +15,38 @@
  */
 
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <sstream>
 #include <thread>
+#include <tuple>
+#include <vector>
 
 #include <folly/experimental/TestUtil.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include <zlib.h>
+#include <zstd.h>
 #include <zstr/zstr.hpp>
 
 #include <profilo/LogEntry.h>
+#include <profilo/MultiBufferLogger.h>
 #include <profilo/PacketLogger.h>
 #include <profilo/entries/Entry.h>
 #include <profilo/entries/EntryType.h>
 #include <profilo/mmapbuf/Buffer.h>
+#include <profilo/profiler/StackFramesWriter.h>
+#include <profilo/util/common.h>
 #include <profilo/writer/TraceCallbacks.h>
+#include <profilo/writer/TraceCompressor.h>
+#include <profilo/writer/TraceFileHelpers.h>
 #include <profilo/writer/TraceWriter.h>
+#include <profilo/writer/ZstdCompressor.h>
 
 using namespace facebook::profilo::logger;
 using namespace facebook::profilo::writer;
@@ -85,7 +98,7 @@ class TraceWriterTest : public ::testing::Test {
   std::shared_ptr<::testing::NiceMock<MockCallbacks>> callbacks_;
   TraceWriter writer_;
 
-  void writeTraceStart(int64_t trace_id = kTraceID) {
+  void writeTraceStart(int64_t trace_id = kTraceID, int32_t flags = 0) {
     char payload[sizeof(StandardEntry) + 1]{};
     StandardEntry start{
         .id = 1,
@@ -93,7 +106,7 @@ class TraceWriterTest : public ::testing::Test {
         .timestamp = 123,
         .tid = 0,
         .callid = 0,
-        .matchid = 0,
+        .matchid = flags,
         .extra = trace_id,
     };
     StandardEntry::pack(start, payload, sizeof(payload));
@@ -220,6 +233,27 @@ TEST_F(TraceWriterTest, testTraceFileCreatedSimple) {
       << "Filename " << filename << " does not contain pid";
 }
 
+TEST_F(TraceWriterTest, testPollingReaderWaitsForTraceEnd) {
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer_,
+      callbacks_,
+      generateHeaders(),
+      nullptr,
+      std::chrono::microseconds(100));
+  auto cursor = buffer_->ringBuffer().currentHead();
+  writeTraceStart();
+
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  auto thread = std::thread([&] { writer.processTrace(kTraceID, cursor); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  writeTraceEnd();
+  thread.join();
+
+  EXPECT_EQ(getFileCount(), 1) << "There should be only one real file.";
+}
+
 TEST_F(TraceWriterTest, testTraceFileCreatedForDump) {
   writeFillerEvent();
   writer_.dump(kTraceID);
@@ -315,6 +349,84 @@ TEST_F(TraceWriterTest, testHeadersPropagateToFile) {
   EXPECT_NE(trace.find("key2|value2"), std::string::npos);
 }
 
+TEST_F(TraceWriterTest, testCompressionIsRecordedInHeaders) {
+  writeTraceStart();
+  writeTraceEnd();
+
+  auto thread = std::thread([&] { writer_.loop(); });
+
+  writer_.submit(kTraceID);
+  thread.join();
+
+  auto trace = getOnlyTraceFileContents();
+  EXPECT_NE(trace.find("\ncompression|zlib:3\n"), std::string::npos);
+}
+
+TEST_F(TraceWriterTest, testZstdCompressorWritesZstdTrace) {
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer_,
+      callbacks_,
+      generateHeaders(),
+      nullptr,
+      std::chrono::microseconds::zero(),
+      std::make_shared<ZstdCompressor>(1));
+  writeTraceStart();
+  writeTraceEnd();
+
+  auto thread = std::thread([&] { writer.loop(); });
+
+  writer.submit(kTraceID);
+  thread.join();
+
+  std::ifstream file(getOnlyTraceFile().generic_string(), std::ios::binary);
+  std::string compressed(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  ASSERT_GE(compressed.size(), 4);
+  EXPECT_EQ(compressed.substr(0, 4), "\x28\xb5\x2f\xfd");
+
+  std::string trace;
+  auto context = ZSTD_createDCtx();
+  std::vector<char> output(ZSTD_DStreamOutSize());
+  ZSTD_inBuffer in{
+      .src = compressed.data(), .size = compressed.size(), .pos = 0};
+  while (in.pos < in.size) {
+    ZSTD_outBuffer out{.dst = output.data(), .size = output.size(), .pos = 0};
+    auto ret = ZSTD_decompressStream(context, &out, &in);
+    ASSERT_FALSE(ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    trace.append(output.data(), out.pos);
+  }
+  ZSTD_freeDCtx(context);
+
+  EXPECT_NE(trace.find("\ncompression|zstd:1\n"), std::string::npos);
+  EXPECT_NE(trace.find("key1|value1"), std::string::npos);
+  EXPECT_NE(trace.find("|TRACE_END|"), std::string::npos);
+}
+
+TEST_F(TraceWriterTest, testBinaryOutputFlagWritesBinaryTrace) {
+  writeTraceStart(kTraceID, TraceFileHelpers::kBinaryOutputFlag);
+  writeTraceEnd();
+
+  auto thread = std::thread([&] { writer_.loop(); });
+
+  writer_.submit(kTraceID);
+  thread.join();
+
+  auto trace = getOnlyTraceFileContents();
+  auto body = trace.find("\n\n");
+  ASSERT_NE(body, std::string::npos);
+  auto headers = trace.substr(0, body + 1);
+  EXPECT_NE(headers.find("\nbin|1\n"), std::string::npos);
+  EXPECT_NE(headers.find("key1|value1"), std::string::npos);
+
+  // Type names are only in the type tables of the blocks.
+  auto blocks = trace.substr(body + 2);
+  EXPECT_NE(blocks.find("TRACE_START"), std::string::npos);
+  EXPECT_NE(blocks.find("TRACE_END"), std::string::npos);
+  EXPECT_EQ(blocks.find("|TRACE_START|"), std::string::npos);
+}
+
 void TraceWriterTest::testCallbackCalls(std::function<void()> expectations) {
   ::testing::InSequence dummy_;
 
@@ -367,5 +479,578 @@ TEST_F(TraceWriterTest, testCallbacksMissedStart) {
   });
 }
 
+namespace {
+
+StandardEntry makeEntry(EntryType type, int64_t timestamp, int64_t extra = 0) {
+  return StandardEntry{
+      .id = 0,
+      .type = type,
+      .timestamp = timestamp,
+      .tid = 0,
+      .callid = 0,
+      .matchid = 0,
+      .extra = extra,
+  };
+}
+
+struct TraceLine {
+  std::string type;
+  int64_t timestamp;
+  int64_t callid;
+  int64_t extra;
+};
+
+// The StandardEntries in `trace`, in order, with the delta encoding undone.
+std::vector<TraceLine> traceLines(const std::string& trace) {
+  std::vector<TraceLine> result;
+  int64_t timestamp = 0;
+  int64_t callid = 0;
+  int64_t extra = 0;
+  std::istringstream lines(trace);
+  std::string line;
+  while (std::getline(lines, line)) {
+    if (std::count(line.begin(), line.end(), '|') != 6) {
+      continue; // header or non-standard entry
+    }
+    std::vector<std::string> fields;
+    std::istringstream fields_stream(line);
+    std::string field;
+    while (std::getline(fields_stream, field, '|')) {
+      fields.push_back(field);
+    }
+    timestamp += std::stoll(fields[2]);
+    callid += std::stoll(fields[4]);
+    extra += std::stoll(fields[6]);
+    result.push_back(TraceLine{fields[1], timestamp, callid, extra});
+  }
+  return result;
+}
+
+// Types of the StandardEntries in `trace`, in order.
+std::vector<std::string> entryTypes(const std::string& trace) {
+  std::vector<std::string> types;
+  for (auto& line : traceLines(trace)) {
+    types.push_back(line.type);
+  }
+  return types;
+}
+
+// Value of the TRACE_ANNOTATION with key `key`, or -1 if there is none.
+int64_t annotationValue(const std::string& trace, int32_t key) {
+  for (auto& line : traceLines(trace)) {
+    if (line.type == "TRACE_ANNOTATION" && line.callid == key) {
+      return line.extra;
+    }
+  }
+  return -1;
+}
+
+} // namespace
+
+TEST_F(TraceWriterTest, testTieredBufferMergesByTimestamp) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(16, false, false, 16);
+  auto& logger = buffer->logger();
+  ASSERT_TRUE(logger.tiered());
+
+  TraceBuffer::Cursor cursor = buffer->ringBuffer().currentHead();
+  logger.writeAndGetCursor(
+      makeEntry(EntryType::TRACE_START, 10, kTraceID), cursor);
+  logger.write(makeEntry(EntryType::COUNTER, 11));
+  logger.write(makeEntry(EntryType::COUNTER, 13));
+  logger.write(makeEntry(EntryType::MARK_PUSH, 12));
+  logger.write(makeEntry(EntryType::MARK_POP, 14));
+  logger.write(makeEntry(EntryType::COUNTER, 15));
+  logger.write(makeEntry(EntryType::TRACE_END, 16, kTraceID));
+
+  // Only the trace start, the spans and the trace end went to the high
+  // priority ring.
+  EXPECT_EQ(cursor.distanceTo(buffer->ringBuffer().currentHead()), 3);
+  auto priority_start = buffer->priorityRingBuffer()->currentTail();
+  EXPECT_EQ(
+      priority_start.distanceTo(buffer->priorityRingBuffer()->currentHead()),
+      4);
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_);
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  writer.processTrace(kTraceID, cursor);
+
+  auto types = entryTypes(getOnlyTraceFileContents());
+  std::vector<std::string> expected{
+      "TRACE_START",
+      "COUNTER",
+      "MARK_PUSH",
+      "COUNTER",
+      "MARK_POP",
+      "COUNTER",
+      // Loss counters
+      "TRACE_ANNOTATION",
+      "TRACE_ANNOTATION",
+      "TRACE_ANNOTATION",
+      "TRACE_ANNOTATION",
+      "TRACE_END",
+  };
+  EXPECT_EQ(types, expected);
+}
+
+TEST_F(TraceWriterTest, testShardedBufferMergesByTimestamp) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(
+      16,
+      false,
+      false,
+      0,
+      mmapbuf::ShardLayout(mmapbuf::header::ShardMode::PER_CPU, {0, 1}));
+  ASSERT_EQ(buffer->shardCount, 2);
+
+  // Stand-ins for writers running on each CPU.
+  Logger cpu0(
+      [&]() -> TraceBuffer& { return buffer->shardRingBuffer(0); },
+      Logger::getGlobalEntryID());
+  Logger cpu1(
+      [&]() -> TraceBuffer& { return buffer->shardRingBuffer(1); },
+      Logger::getGlobalEntryID());
+
+  cpu0.write(makeEntry(EntryType::MARK_PUSH, 9));
+  TraceBuffer::Cursor cursor = buffer->shardRingBuffer(1).currentHead();
+  cpu1.writeAndGetCursor(
+      makeEntry(EntryType::TRACE_START, 10, kTraceID), cursor);
+  cpu0.write(makeEntry(EntryType::COUNTER, 11));
+  cpu1.write(makeEntry(EntryType::MARK_PUSH, 12));
+  cpu1.write(makeEntry(EntryType::MARK_POP, 13));
+  cpu0.write(makeEntry(EntryType::COUNTER, 14));
+  cpu0.write(makeEntry(EntryType::TRACE_END, 15, kTraceID));
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_);
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  writer.processTrace(kTraceID, cursor);
+
+  auto types = entryTypes(getOnlyTraceFileContents());
+  std::vector<std::string> expected{
+      "TRACE_START",
+      "COUNTER",
+      "MARK_PUSH",
+      "MARK_POP",
+      "COUNTER",
+      // Loss counters
+      "TRACE_ANNOTATION",
+      "TRACE_ANNOTATION",
+      "TRACE_ANNOTATION",
+      "TRACE_ANNOTATION",
+      "TRACE_END",
+  };
+  EXPECT_EQ(types, expected);
+}
+
+TEST_F(TraceWriterTest, testShardedBufferDumpMergesByTimestamp) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(
+      16,
+      false,
+      false,
+      0,
+      mmapbuf::ShardLayout(mmapbuf::header::ShardMode::PER_CPU, {0, 1}));
+
+  Logger cpu0(
+      [&]() -> TraceBuffer& { return buffer->shardRingBuffer(0); },
+      Logger::getGlobalEntryID());
+  Logger cpu1(
+      [&]() -> TraceBuffer& { return buffer->shardRingBuffer(1); },
+      Logger::getGlobalEntryID());
+
+  cpu0.write(makeEntry(EntryType::MARK_PUSH, 9));
+  cpu1.write(makeEntry(EntryType::COUNTER, 10));
+  cpu0.write(makeEntry(EntryType::MARK_POP, 11));
+  cpu1.write(makeEntry(EntryType::MARK_PUSH, 12));
+  // The last write of each ring may be in progress, dump() skips it.
+  cpu0.write(makeEntry(EntryType::COUNTER, 13));
+  cpu1.write(makeEntry(EntryType::COUNTER, 14));
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_);
+  writer.dump(kTraceID);
+
+  // Newest first, like the dump of a single ring.
+  auto types = entryTypes(getOnlyTraceFileContents());
+  std::vector<std::string> expected{
+      "MARK_PUSH",
+      "MARK_POP",
+      "COUNTER",
+      "MARK_PUSH",
+  };
+  EXPECT_EQ(types, expected);
+}
+
+TEST_F(TraceWriterTest, testDumpSkipsWriteInProgressAtHead) {
+  writeFillerEvent();
+  auto& ring = buffer_->ringBuffer();
+  auto cursor = ring.reserve(1);
+  ring.beginWriteReserved(cursor);
+
+  writer_.dump(kTraceID);
+
+  auto types = entryTypes(getOnlyTraceFileContents());
+  std::vector<std::string> expected{"MARK_PUSH"};
+  EXPECT_EQ(types, expected);
+}
+
+TEST_F(TraceWriterTest, testDumpExpandsPrefixStacks) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(64);
+  MultiBufferLogger logger{};
+  logger.addBuffer(buffer);
+  profiler::StackFramesWriter frames_writer(logger);
+
+  // Leaf first, as unwound. All but the first are written against the
+  // previous sample, which dump() visits after them.
+  std::vector<std::vector<int64_t>> samples{
+      {30, 20, 10},
+      {40, 20, 10},
+      {50, 40, 20, 10},
+      {60, 10},
+  };
+  int64_t frames = 0;
+  int64_t timestamp = 1;
+  for (auto& sample : samples) {
+    frames_writer.write(FramesEntry{
+        .id = 0,
+        .type = EntryType::STACK_FRAME,
+        .timestamp = timestamp++,
+        .tid = 1,
+        .matchid = 0,
+        .frames =
+            {
+                .values = sample.data(),
+                .size = static_cast<uint16_t>(sample.size()),
+            },
+    });
+    frames += sample.size();
+  }
+  // The last write may be in progress, dump() skips it.
+  logger.write(makeEntry(EntryType::COUNTER, timestamp++));
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_);
+  writer.dump(kTraceID);
+
+  auto types = entryTypes(getOnlyTraceFileContents());
+  EXPECT_EQ(std::count(types.begin(), types.end(), "STACK_FRAME"), frames);
+}
+
+TEST_F(TraceWriterTest, testTieredBufferKeepsSpansUnderOverload) {
+  constexpr int kSpans = 4;
+  constexpr int kFillerPerSpan = 50;
+  auto buffer = std::make_shared<mmapbuf::Buffer>(16, false, false, 16);
+  auto& logger = buffer->logger();
+
+  TraceBuffer::Cursor cursor = buffer->ringBuffer().currentHead();
+  int64_t timestamp = 1;
+  logger.writeAndGetCursor(
+      makeEntry(EntryType::TRACE_START, timestamp++, kTraceID), cursor);
+  for (int span = 0; span < kSpans; ++span) {
+    logger.write(makeEntry(EntryType::MARK_PUSH, timestamp++));
+    // Overwrites the main ring several times over.
+    for (int i = 0; i < kFillerPerSpan; ++i) {
+      logger.write(makeEntry(EntryType::COUNTER, timestamp++));
+    }
+    logger.write(makeEntry(EntryType::MARK_POP, timestamp++));
+  }
+  logger.write(makeEntry(EntryType::TRACE_END, timestamp++, kTraceID));
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_);
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  EXPECT_CALL(*callbacks_, onTraceAbort(::testing::_, ::testing::_)).Times(0);
+  writer.processTrace(kTraceID, cursor);
+
+  auto trace = getOnlyTraceFileContents();
+  auto types = entryTypes(trace);
+  EXPECT_EQ(std::count(types.begin(), types.end(), "MARK_PUSH"), kSpans);
+  EXPECT_EQ(std::count(types.begin(), types.end(), "MARK_POP"), kSpans);
+  EXPECT_LE(std::count(types.begin(), types.end(), "COUNTER"), 16);
+  EXPECT_EQ(types.back(), "TRACE_END");
+
+  // Every packet the trace wrote is accounted for, either in the output or
+  // as overwritten.
+  auto written = annotationValue(
+      trace, QuickLogConstants::TRACE_BUFFER_PACKETS_WRITTEN);
+  auto overwritten = annotationValue(
+      trace, QuickLogConstants::TRACE_BUFFER_PACKETS_OVERWRITTEN);
+  EXPECT_EQ(written, 2 + kSpans * (kFillerPerSpan + 2));
+  EXPECT_GT(overwritten, 0);
+  EXPECT_EQ(
+      annotationValue(trace, QuickLogConstants::TRACE_BUFFER_TORN_READS), 0);
+  EXPECT_EQ(
+      annotationValue(trace, QuickLogConstants::TRACE_BUFFER_STREAMS_DROPPED),
+      0);
+}
+
+namespace {
+
+constexpr int kOverrunFiller = 50;
+constexpr int kOverrunAfterEnd = 3;
+
+// Starts a trace in a 16 slot ring and overruns the reader once it's past
+// TRACE_START, then keeps writing after the trace has ended.
+std::shared_ptr<mmapbuf::Buffer> overrunTrace(
+    MockCallbacks& callbacks,
+    TraceBuffer::Cursor& cursor) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(16);
+  auto& logger = buffer->logger();
+
+  cursor = buffer->ringBuffer().currentHead();
+  logger.writeAndGetCursor(
+      makeEntry(EntryType::TRACE_START, 1, kTraceID), cursor);
+
+  EXPECT_CALL(callbacks, onTraceStart(kTraceID, ::testing::_))
+      .WillOnce(::testing::InvokeWithoutArgs([&logger] {
+        int64_t timestamp = 2;
+        for (int i = 0; i < kOverrunFiller; ++i) {
+          logger.write(makeEntry(EntryType::COUNTER, timestamp++));
+        }
+        logger.write(makeEntry(EntryType::TRACE_END, timestamp++, kTraceID));
+        for (int i = 0; i < kOverrunAfterEnd; ++i) {
+          logger.write(makeEntry(EntryType::COUNTER, timestamp++));
+        }
+      }));
+  return buffer;
+}
+
+} // namespace
+
+TEST_F(TraceWriterTest, testOverrunSingleRingAbortsByDefault) {
+  TraceBuffer::Cursor cursor = buffer_->ringBuffer().currentHead();
+  auto buffer = overrunTrace(*callbacks_, cursor);
+  EXPECT_CALL(*callbacks_, onTraceEnd(::testing::_)).Times(0);
+  EXPECT_CALL(*callbacks_, onTraceAbort(kTraceID, AbortReason::MISSED_EVENT));
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_);
+  writer.processTrace(kTraceID, cursor);
+}
+
+TEST_F(TraceWriterTest, testOverrunSingleRingReportsLoss) {
+  constexpr int kFiller = kOverrunFiller;
+  TraceBuffer::Cursor cursor = buffer_->ringBuffer().currentHead();
+  auto buffer = overrunTrace(*callbacks_, cursor);
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  EXPECT_CALL(*callbacks_, onTraceAbort(::testing::_, ::testing::_)).Times(0);
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_,
+      {},
+      nullptr,
+      std::chrono::microseconds::zero(),
+      nullptr,
+      false,
+      true);
+  writer.processTrace(kTraceID, cursor);
+
+  auto trace = getOnlyTraceFileContents();
+  auto types = entryTypes(trace);
+  EXPECT_EQ(types.back(), "TRACE_END");
+  auto written = annotationValue(
+      trace, QuickLogConstants::TRACE_BUFFER_PACKETS_WRITTEN);
+  auto overwritten = annotationValue(
+      trace, QuickLogConstants::TRACE_BUFFER_PACKETS_OVERWRITTEN);
+  // Up to TRACE_END only.
+  EXPECT_EQ(written, kFiller + 2);
+  EXPECT_GT(overwritten, 0);
+  EXPECT_EQ(
+      std::count(types.begin(), types.end(), "COUNTER") + overwritten,
+      kFiller);
+}
+
+TEST_F(TraceWriterTest, testInternedStringsAreResolved) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(64);
+  auto& logger = buffer->logger();
+  const char name[] = "Choreographer#doFrame";
+  auto bytes = reinterpret_cast<const uint8_t*>(name);
+
+  TraceBuffer::Cursor cursor = buffer->ringBuffer().currentHead();
+  logger.writeAndGetCursor(
+      makeEntry(EntryType::TRACE_START, 10, kTraceID), cursor);
+  auto first = logger.write(makeEntry(EntryType::MARK_PUSH, 11));
+  logger.writeString(EntryType::STRING_NAME, first, bytes, strlen(name));
+  auto second = logger.write(makeEntry(EntryType::MARK_PUSH, 12));
+  logger.writeString(EntryType::STRING_NAME, second, bytes, strlen(name));
+  logger.write(makeEntry(EntryType::TRACE_END, 13, kTraceID));
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_);
+  writer.processTrace(kTraceID, cursor);
+
+  auto trace = getOnlyTraceFileContents();
+  EXPECT_EQ(trace.find("STRING_DEFINE"), trace.npos);
+  EXPECT_EQ(trace.find("STRING_REF"), trace.npos);
+  size_t names = 0;
+  for (auto pos = trace.find("|STRING_NAME|"); pos != trace.npos;
+       pos = trace.find("|STRING_NAME|", pos + 1)) {
+    EXPECT_EQ(trace.find(name, pos), trace.find('|', pos + 13) + 1);
+    ++names;
+  }
+  EXPECT_EQ(names, 2);
+}
+
+TEST_F(TraceWriterTest, testCounterTimestampsAreRescaled) {
+  // 1000 ticks per second, so a tick is a millisecond.
+  ClockCalibration calibration{
+      .tickBase = 100,
+      .nanosBase = 5000000000,
+      .ticksPerSecond = 1000,
+  };
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer_,
+      callbacks_,
+      {{TraceFileHelpers::kClockCalibrationHeader, calibration.toString()}});
+
+  auto cursor = buffer_->ringBuffer().currentHead();
+  writeTraceStart();
+  writeTraceEnd();
+  writer.processTrace(kTraceID, cursor);
+
+  auto trace = getOnlyTraceFileContents();
+  EXPECT_NE(trace.find("clock_calibration|100:5000000000:1000"), trace.npos);
+  auto lines = traceLines(trace);
+  ASSERT_EQ(lines.size(), 6);
+  // Microseconds, from ticks 123 and 124.
+  EXPECT_EQ(lines.front().type, "TRACE_START");
+  EXPECT_EQ(lines.front().timestamp, 5023000);
+  EXPECT_EQ(lines.back().type, "TRACE_END");
+  EXPECT_EQ(lines.back().timestamp, 5024000);
+}
+
+TEST_F(TraceWriterTest, testPipelinedWriterMatchesWriter) {
+  // Enough entries for several blocks of output.
+  const int kEntries = 30000;
+  auto buffer = std::make_shared<mmapbuf::Buffer>(kEntries * 2);
+  auto& logger = buffer->logger();
+  TraceBuffer::Cursor cursor = buffer->ringBuffer().currentHead();
+  logger.writeAndGetCursor(
+      makeEntry(EntryType::TRACE_START, 10, kTraceID), cursor);
+  for (int i = 0; i < kEntries; i++) {
+    auto type = i % 2 == 0 ? EntryType::MARK_PUSH : EntryType::MARK_POP;
+    logger.write(makeEntry(type, 11 + i));
+  }
+  logger.write(makeEntry(EntryType::TRACE_END, 11 + kEntries, kTraceID));
+
+  // The loss counters get new entry IDs every time, so leave IDs out.
+  std::vector<std::vector<std::tuple<std::string, int64_t, int64_t, int64_t>>>
+      traces;
+  size_t trace_size = 0;
+  for (bool pipelined : {false, true}) {
+    TraceWriter writer(
+        std::move(trace_dir_.path().generic_string()),
+        kTracePrefix,
+        buffer,
+        callbacks_,
+        generateHeaders(),
+        nullptr,
+        std::chrono::microseconds::zero(),
+        nullptr,
+        pipelined);
+    EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+    auto start = cursor;
+    writer.processTrace(kTraceID, start);
+
+    auto trace = getOnlyTraceFileContents();
+    trace_size = trace.size();
+    traces.emplace_back();
+    for (auto& line : traceLines(trace)) {
+      traces.back().emplace_back(
+          line.type, line.timestamp, line.callid, line.extra);
+    }
+    fs::remove(getOnlyTraceFile());
+  }
+  EXPECT_GT(trace_size, 2 * PipelinedCompressor::kBlockSize);
+  ASSERT_EQ(traces[0].size(), kEntries + 6);
+  EXPECT_TRUE(traces[1] == traces[0]);
+}
+
+TEST_F(TraceWriterTest, testPipelinedWriterMergesTieredBuffer) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(16, false, false, 16);
+  auto& logger = buffer->logger();
+  TraceBuffer::Cursor cursor = buffer->ringBuffer().currentHead();
+  logger.writeAndGetCursor(
+      makeEntry(EntryType::TRACE_START, 10, kTraceID), cursor);
+  logger.write(makeEntry(EntryType::COUNTER, 11));
+  logger.write(makeEntry(EntryType::MARK_PUSH, 12));
+  logger.write(makeEntry(EntryType::MARK_POP, 13));
+  logger.write(makeEntry(EntryType::TRACE_END, 14, kTraceID));
+
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer,
+      callbacks_,
+      generateHeaders(),
+      nullptr,
+      std::chrono::microseconds::zero(),
+      nullptr,
+      true);
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  writer.processTrace(kTraceID, cursor);
+
+  auto types = entryTypes(getOnlyTraceFileContents());
+  ASSERT_EQ(types.size(), 9);
+  EXPECT_EQ(types[0], "TRACE_START");
+  EXPECT_EQ(types[1], "COUNTER");
+  EXPECT_EQ(types[2], "MARK_PUSH");
+  EXPECT_EQ(types[3], "MARK_POP");
+  EXPECT_EQ(types[8], "TRACE_END");
+}
+
+TEST_F(TraceWriterTest, testPipelinedWriterWaitsForTraceEnd) {
+  TraceWriter writer(
+      std::move(trace_dir_.path().generic_string()),
+      kTracePrefix,
+      buffer_,
+      callbacks_,
+      generateHeaders(),
+      nullptr,
+      std::chrono::microseconds::zero(),
+      nullptr,
+      true);
+  auto cursor = buffer_->ringBuffer().currentHead();
+  writeTraceStart();
+
+  EXPECT_CALL(*callbacks_, onTraceStart(kTraceID, 0));
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  auto thread = std::thread([&] { writer.processTrace(kTraceID, cursor); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  writeFillerEvent();
+  writeTraceEnd();
+  thread.join();
+
+  auto types = entryTypes(getOnlyTraceFileContents());
+  ASSERT_GE(types.size(), 3);
+  EXPECT_EQ(types[1], "MARK_PUSH");
+  EXPECT_EQ(types.back(), "TRACE_END");
+}
+
 } // namespace profilo
 } // namespace facebook
@@ -0,0 +1,165 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/BinaryEntryVisitor.h>
+#include <profilo/writer/DeltaEncodingVisitor.h>
+#include <profilo/writer/PrintEntryVisitor.h>
+#include <profilo/writer/StackTraceInvertingVisitor.h>
+#include <profilo/writer/StringResolvingVisitor.h>
+#include <profilo/writer/TimestampTruncatingVisitor.h>
+#include <profilo/writer/VisitorChains.h>
+
+using namespace facebook::profilo::entries;
+using namespace facebook::profilo::writer;
+
+namespace facebook {
+namespace profilo {
+
+//
+// One entry of each kind, plus the ones individual stages act on: string
+// definitions and references, and stacks in the shared-prefix encoding.
+//
+void visitEntries(EntryVisitor& visitor) {
+  visitor.visit(StandardEntry{
+      .id = 10,
+      .type = EntryType::TRACE_START,
+      .timestamp = 1000123456,
+      .tid = 1,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 1});
+
+  const char name[] = "some_string";
+  visitor.visit(BytesEntry{
+      .id = 0,
+      .type = EntryType::STRING_DEFINE,
+      .matchid = 5,
+      .bytes = {
+          .values = reinterpret_cast<const uint8_t*>(name),
+          .size = sizeof(name) - 1}});
+  visitor.visit(StandardEntry{
+      .id = 11,
+      .type = EntryType::STRING_REF,
+      .timestamp = 0,
+      .tid = 0,
+      .callid = static_cast<int32_t>(EntryType::STRING_VALUE),
+      .matchid = 10,
+      .extra = 5});
+
+  for (int32_t i = 0; i < 3; ++i) {
+    int64_t frames[] = {300 + i, 200, 100};
+    visitor.visit(FramesEntry{
+        .id = 12 + 2 * i,
+        .type = EntryType::STACK_FRAME,
+        .timestamp = 1000234567 + i * 1499,
+        .tid = 2 + i,
+        .matchid = 0,
+        .frames = {.values = frames, .size = 3}});
+
+    int64_t prefix[] = {400 + i};
+    visitor.visitPrefix(
+        FramesEntry{
+            .id = 13 + 2 * i,
+            .type = EntryType::STACK_FRAME,
+            .timestamp = 1000345678 + i * 1501,
+            .tid = 2 + i,
+            .matchid = 0,
+            .frames = {.values = prefix, .size = 1}},
+        12 + 2 * i,
+        2);
+  }
+
+  KeyValue pairs[] = {KeyValue::ofInt("key", 42)};
+  uint8_t packed[KeyValue::calculateSize(pairs, 1)];
+  KeyValue::pack(pairs, 1, packed, sizeof(packed));
+  visitor.visit(AnnotationEntry{
+      .id = 20,
+      .type = EntryType::TRACE_ANNOTATION,
+      .timestamp = 1000456789,
+      .tid = 1,
+      .matchid = 0,
+      .pairs = {
+          .values = packed,
+          .size = static_cast<uint16_t>(sizeof(packed)),
+      }});
+
+  visitor.visit(StandardEntry{
+      .id = 21,
+      .type = EntryType::TRACE_END,
+      .timestamp = 1000567890,
+      .tid = 1,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 1});
+}
+
+TEST(VisitorChainsTest, testTextChainMatchesDynamicChain) {
+  std::stringstream expected;
+  {
+    PrintEntryVisitor print(expected);
+    DeltaEncodingVisitor delta(print);
+    TimestampTruncatingVisitor truncating(delta);
+    StackTraceInvertingVisitor inverting(truncating);
+    StringResolvingVisitor resolving(inverting);
+    visitEntries(resolving);
+  }
+
+  std::stringstream actual;
+  {
+    TextVisitorChain chain(actual, nullptr);
+    visitEntries(chain);
+  }
+
+  EXPECT_NE(expected.str().find("some_string"), std::string::npos);
+  // Three frames for each of the three stacks and their expanded prefixes.
+  auto text = expected.str();
+  size_t frames = 0;
+  for (auto pos = text.find("|STACK_FRAME|"); pos != std::string::npos;
+       pos = text.find("|STACK_FRAME|", pos + 1)) {
+    ++frames;
+  }
+  EXPECT_EQ(frames, 18);
+  EXPECT_EQ(actual.str(), expected.str());
+}
+
+TEST(VisitorChainsTest, testBinaryChainMatchesDynamicChain) {
+  std::stringstream expected;
+  {
+    BinaryEntryVisitor binary(expected);
+    TimestampTruncatingVisitor truncating(binary);
+    StackTraceInvertingVisitor inverting(truncating);
+    StringResolvingVisitor resolving(inverting);
+    visitEntries(resolving);
+  }
+
+  std::stringstream actual;
+  {
+    BinaryVisitorChain chain(actual, nullptr);
+    visitEntries(chain);
+  }
+
+  EXPECT_FALSE(expected.str().empty());
+  EXPECT_EQ(actual.str(), expected.str());
+}
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,159 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <profilo/MultiBufferLogger.h>
+#include <profilo/atrace/SystraceLogger.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/writer/PacketReassembler.h>
+
+namespace facebook {
+namespace profilo {
+namespace atrace {
+
+using logger::MultiBufferLogger;
+using mmapbuf::Buffer;
+using writer::PacketReassembler;
+
+namespace {
+
+// Types of the entries in the buffer, oldest first.
+class TypeVisitor : public EntryVisitor {
+ public:
+  std::vector<EntryType> types;
+
+  void visit(const StandardEntry& entry) override {
+    types.push_back(entry.type);
+  }
+  void visit(const FramesEntry& entry) override {
+    types.push_back(entry.type);
+  }
+  void visit(const BytesEntry& entry) override {
+    types.push_back(entry.type);
+  }
+  void visit(const AnnotationEntry& entry) override {
+    types.push_back(entry.type);
+  }
+};
+
+std::vector<EntryType> readTypes(Buffer& buffer) {
+  TypeVisitor visitor;
+  PacketReassembler reassembler([&visitor](const void* data, size_t size) {
+    EntryParser::parse(data, size, visitor);
+  });
+  auto& ring = buffer.ringBuffer();
+  auto cursor = ring.currentTail();
+  logger::Packet packet{};
+  while (ring.tryRead(packet, cursor)) {
+    reassembler.process(packet);
+    cursor.moveForward();
+  }
+  return visitor.types;
+}
+
+int32_t logMessage(MultiBufferLogger& logger, const std::string& msg) {
+  return logSystraceMessage(logger, msg.data(), msg.size());
+}
+
+} // namespace
+
+TEST(SystraceLoggerTest, testSectionNamesAreInterned) {
+  MultiBufferLogger logger{};
+  auto buffer = std::make_shared<Buffer>(64);
+  logger.addBuffer(buffer);
+
+  EXPECT_NE(logMessage(logger, "B|1234|Choreographer#doFrame"), 0);
+  EXPECT_NE(logMessage(logger, "E"), 0);
+  EXPECT_NE(logMessage(logger, "B|1234|Choreographer#doFrame"), 0);
+  EXPECT_NE(logMessage(logger, "E"), 0);
+
+  std::vector<EntryType> expected{
+      EntryType::MARK_PUSH,
+      EntryType::STRING_DEFINE,
+      EntryType::STRING_REF,
+      EntryType::MARK_POP,
+      EntryType::MARK_PUSH,
+      EntryType::STRING_REF,
+      EntryType::MARK_POP,
+  };
+  EXPECT_EQ(readTypes(*buffer), expected);
+}
+
+TEST(SystraceLoggerTest, testSpinBudgetDropsOnContendedSlot) {
+  constexpr size_t kBufferSize = 4;
+  MultiBufferLogger logger{};
+  auto buffer = std::make_shared<Buffer>(kBufferSize);
+  logger.addBuffer(buffer);
+
+  // A writer stalls in the middle of writing slot 0.
+  auto& ring = buffer->ringBuffer();
+  auto stalled = ring.reserve(1);
+  ring.beginWriteReserved(stalled);
+  for (size_t i = 1; i < kBufferSize; ++i) {
+    logger::Packet packet{};
+    ring.write(packet);
+  }
+
+  std::string msg = "B|1234|Choreographer#doFrame";
+  auto start = ring.currentHead();
+  EXPECT_EQ(logSystraceMessage(logger, msg.data(), msg.size(), 10), 0);
+  EXPECT_EQ(start.distanceTo(ring.currentHead()), 0);
+
+  ring.endWriteReserved(stalled);
+  EXPECT_NE(logSystraceMessage(logger, msg.data(), msg.size(), 10), 0);
+}
+
+TEST(SystraceLoggerTest, testOtherEventsAreIgnored) {
+  MultiBufferLogger logger{};
+  auto buffer = std::make_shared<Buffer>(64);
+  logger.addBuffer(buffer);
+
+  EXPECT_EQ(logMessage(logger, "S|1234|async|1"), 0);
+  EXPECT_EQ(logMessage(logger, "F|1234|async|1"), 0);
+  EXPECT_EQ(logMessage(logger, "C|1234|counter|5"), 0);
+  EXPECT_EQ(logMessage(logger, ""), 0);
+
+  EXPECT_TRUE(readTypes(*buffer).empty());
+}
+
+TEST(SystraceLoggerTest, testPushWithoutNameIsLogged) {
+  MultiBufferLogger logger{};
+  auto buffer = std::make_shared<Buffer>(64);
+  logger.addBuffer(buffer);
+
+  EXPECT_NE(logMessage(logger, "B"), 0);
+  EXPECT_NE(logMessage(logger, "B|1234"), 0);
+  EXPECT_NE(logMessage(logger, "B|1234|"), 0);
+
+  std::vector<EntryType> expected{
+      EntryType::MARK_PUSH,
+      EntryType::MARK_PUSH,
+      EntryType::MARK_PUSH,
+  };
+  EXPECT_EQ(readTypes(*buffer), expected);
+}
+
+} // namespace atrace
+} // namespace profilo
+} // namespace facebook
@@ -68,3 +68,89 @@ TEST_F(CommonTest, mkdirsTest) {
   facebook::profilo::mkdirs(createMe.c_str());
   EXPECT_EQ(dirCreated(createMe.c_str()), 0);
 }
+
+TEST(ClockCalibrationTest, testToNanos) {
+  facebook::profilo::ClockCalibration calibration{
+      .tickBase = 1000,
+      .nanosBase = 5000,
+      .ticksPerSecond = 19200000,
+  };
+  EXPECT_EQ(calibration.toNanos(1000), 5000);
+  EXPECT_EQ(calibration.toNanos(1000 + 19200000), 5000 + 1000000000);
+  EXPECT_EQ(calibration.toNanos(1000 + 192), 5000 + 10000);
+  EXPECT_EQ(calibration.toNanos(1000 - 192), 5000 - 10000);
+
+  // A day of ticks at 3GHz doesn't overflow.
+  constexpr int64_t kDaySeconds = 24 * 3600;
+  calibration.ticksPerSecond = 3000000000;
+  EXPECT_EQ(
+      calibration.toNanos(1000 + kDaySeconds * 3000000000 + 3),
+      5000 + kDaySeconds * 1000000000 + 1);
+}
+
+TEST(ClockCalibrationTest, testStringRoundTrip) {
+  using facebook::profilo::ClockCalibration;
+  ClockCalibration calibration{
+      .tickBase = -12,
+      .nanosBase = 34,
+      .ticksPerSecond = 56,
+  };
+  ClockCalibration parsed{};
+  ASSERT_TRUE(ClockCalibration::fromString(calibration.toString(), parsed));
+  EXPECT_EQ(parsed.tickBase, -12);
+  EXPECT_EQ(parsed.nanosBase, 34);
+  EXPECT_EQ(parsed.ticksPerSecond, 56);
+
+  EXPECT_FALSE(ClockCalibration::fromString("", parsed));
+  EXPECT_FALSE(ClockCalibration::fromString("1:2", parsed));
+  EXPECT_FALSE(ClockCalibration::fromString("1:2:3x", parsed));
+  EXPECT_FALSE(ClockCalibration::fromString("1:2:0", parsed));
+}
+
+TEST(ClockSourceTest, testSourcesAreMonotonic) {
+  using namespace facebook::profilo;
+  for (auto source : {ClockSource::VDSO,
+                      ClockSource::COARSE,
+                      ClockSource::COUNTER,
+                      ClockSource::SYSCALL}) {
+    if (!setClockSource(source)) {
+      EXPECT_EQ(source, ClockSource::COUNTER);
+      continue;
+    }
+    EXPECT_EQ(getClockSource(), source);
+    auto first = monotonicTime();
+    auto second = monotonicTime();
+    EXPECT_LE(first, second) << getClockSourceName(source);
+  }
+  EXPECT_EQ(getClockSource(), ClockSource::SYSCALL);
+}
+
+TEST(ClockSourceTest, testCounterIsRefusedWithExternalTimestamps) {
+  using namespace facebook::profilo;
+  ASSERT_TRUE(setExternalTimestamps(true));
+  EXPECT_FALSE(setClockSource(ClockSource::COUNTER));
+  EXPECT_EQ(getClockSource(), ClockSource::SYSCALL);
+  EXPECT_TRUE(setClockSource(ClockSource::VDSO));
+  ASSERT_TRUE(setExternalTimestamps(false));
+
+  if (setClockSource(ClockSource::COUNTER)) {
+    EXPECT_FALSE(setExternalTimestamps(true));
+  }
+  setClockSource(ClockSource::SYSCALL);
+}
+
+TEST(ClockSourceTest, testCounterCalibrationMatchesMonotonicClock) {
+  using namespace facebook::profilo;
+  if (!setClockSource(ClockSource::COUNTER)) {
+    return; // no counter on this platform
+  }
+  auto calibration = getClockCalibration();
+  auto ticks = monotonicTime();
+  setClockSource(ClockSource::SYSCALL);
+  auto nanos = monotonicTime();
+
+  // Within a millisecond of each other.
+  auto converted = calibration.toNanos(ticks);
+  EXPECT_LE(converted, nanos + 1000000);
+  EXPECT_GE(converted, nanos - 1000000);
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limits>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <profilo/Logger.h>
+#include <profilo/mmapbuf/Buffer.h>
+
+namespace facebook {
+namespace profilo {
+
+using EntryIDCounter = Logger::EntryIDCounter;
+
+TEST(EntryIDCounterTest, testBlockModeIdsAreUnique) {
+  constexpr int kThreads = 8;
+  constexpr int kIdsPerThread = 10000;
+
+  EntryIDCounter counter{1, 64};
+  std::vector<std::vector<int32_t>> ids(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&counter, &ids, t] {
+      for (int i = 0; i < kIdsPerThread; ++i) {
+        ids[t].push_back(counter.next());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::unordered_set<int32_t> seen;
+  for (auto& thread_ids : ids) {
+    for (size_t i = 0; i < thread_ids.size(); ++i) {
+      EXPECT_GT(thread_ids[i], 0);
+      EXPECT_TRUE(seen.insert(thread_ids[i]).second)
+          << "duplicate id " << thread_ids[i];
+      if (i > 0) {
+        EXPECT_LT(thread_ids[i - 1], thread_ids[i]);
+      }
+    }
+  }
+}
+
+TEST(EntryIDCounterTest, testBlockModeWrapsAround) {
+  EntryIDCounter counter{std::numeric_limits<int32_t>::max() - 10, 64};
+  EXPECT_EQ(counter.next(), 1);
+  EXPECT_EQ(counter.next(), 2);
+}
+
+TEST(EntryIDCounterTest, testSetBlockSize) {
+  EntryIDCounter counter{100};
+  EXPECT_EQ(counter.next(), 100);
+
+  counter.setBlockSize(16);
+  EXPECT_EQ(counter.next(), 101);
+  EXPECT_EQ(counter.next(), 102);
+
+  // Another thread gets its own block.
+  int32_t other = 0;
+  std::thread([&] { other = counter.next(); }).join();
+  EXPECT_EQ(other, 117);
+
+  counter.setBlockSize(1);
+  EXPECT_EQ(counter.next(), 133);
+}
+
+TEST(EntryIDCounterTest, testBlockModeKeepsMatchIdLinks) {
+  mmapbuf::Buffer buffer(10);
+  EntryIDCounter counter{1, 32};
+  Logger logger(
+      [&]() -> TraceBuffer& { return buffer.ringBuffer(); }, counter);
+
+  auto cursor = buffer.ringBuffer().currentHead();
+  auto id = logger.write(StandardEntry{
+      .id = 0,
+      .type = EntryType::JAVA_FRAME_NAME,
+      .timestamp = 1,
+      .tid = 1,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 0,
+  });
+  const char kName[] = "name";
+  auto value_id = logger.writeBytes(
+      EntryType::STRING_VALUE,
+      id,
+      reinterpret_cast<const uint8_t*>(kName),
+      sizeof(kName) - 1);
+  EXPECT_NE(id, value_id);
+
+  logger::Packet packet{};
+  ASSERT_TRUE(buffer.ringBuffer().tryRead(packet, cursor));
+  StandardEntry frame{};
+  StandardEntry::unpack(frame, packet.data, packet.size);
+  EXPECT_EQ(frame.id, id);
+
+  cursor.moveForward();
+  ASSERT_TRUE(buffer.ringBuffer().tryRead(packet, cursor));
+  BytesEntry value{};
+  BytesEntry::unpack(value, packet.data, packet.size);
+  EXPECT_EQ(value.id, value_id);
+  EXPECT_EQ(value.matchid, id);
+}
+
+} // namespace profilo
+} // namespace facebook
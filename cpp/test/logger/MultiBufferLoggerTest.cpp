@@ -14,14 +14,19 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <cstring>
 #include <limits>
 #include <memory>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include <gtest/gtest.h>
 #include <profilo/MultiBufferLogger.h>
 #include <profilo/mmapbuf/Buffer.h>
+#include <profilo/writer/PacketReassembler.h>
 
 namespace facebook {
 namespace profilo {
@@ -78,6 +83,260 @@ TEST(MultiBufferLoggerTest, testMultiBufferWrite) {
   EXPECT_EQ(entry.extra, result2.extra);
 }
 
+TEST(MultiBufferLoggerTest, testMixedEncodings) {
+  MultiBufferLogger logger{};
+
+  auto fixed = std::make_shared<Buffer>(10);
+  auto compact = std::make_shared<Buffer>(10, false, true);
+  logger.addBuffer(fixed);
+  logger.addBuffer(compact);
+
+  StandardEntry entry{
+      .id = 0,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = 100,
+      .tid = 1,
+      .callid = 200,
+      .matchid = 300,
+      .extra = 400,
+  };
+  logger.write(entry);
+
+  Packet packet{};
+  ASSERT_TRUE(compact->ringBuffer().tryRead(
+      packet, compact->ringBuffer().currentTail()));
+  EXPECT_EQ(packet.size, StandardEntry::calculateCompactSize(entry));
+
+  StandardEntry result1{}, result2{};
+  readOneEntry(result1, fixed->ringBuffer(), fixed->ringBuffer().currentTail());
+  readOneEntry(
+      result2, compact->ringBuffer(), compact->ringBuffer().currentTail());
+
+  EXPECT_EQ(entry.id, result1.id);
+  EXPECT_EQ(entry.id, result2.id);
+  EXPECT_EQ(entry.timestamp, result1.timestamp);
+  EXPECT_EQ(entry.timestamp, result2.timestamp);
+  EXPECT_EQ(entry.extra, result1.extra);
+  EXPECT_EQ(entry.extra, result2.extra);
+}
+
+TEST(MultiBufferLoggerTest, testHighPriorityEntriesAreNotCompacted) {
+  MultiBufferLogger logger{};
+
+  auto tiered = std::make_shared<Buffer>(10, false, true, 10);
+  logger.addBuffer(tiered);
+
+  StandardEntry entry{
+      .id = 0,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = 100,
+      .tid = 1,
+      .callid = 200,
+      .matchid = 300,
+      .extra = 400,
+  };
+  logger.write(entry);
+
+  auto& priority = *tiered->priorityRingBuffer();
+  Packet packet{};
+  ASSERT_TRUE(priority.tryRead(packet, priority.currentTail()));
+  EXPECT_EQ(packet.size, StandardEntry::calculateSize(entry));
+
+  // The rest still is.
+  entry.type = EntryType::COUNTER;
+  logger.write(entry);
+  auto& ring = tiered->ringBuffer();
+  ASSERT_TRUE(ring.tryRead(packet, ring.currentTail()));
+  EXPECT_EQ(packet.size, StandardEntry::calculateCompactSize(entry));
+}
+
+TEST(MultiBufferLoggerTest, testMultiPacketWriteToAllBuffers) {
+  MultiBufferLogger logger{};
+
+  auto buffer1 = std::make_shared<Buffer>(10);
+  auto buffer2 = std::make_shared<Buffer>(10);
+  logger.addBuffer(buffer1);
+  logger.addBuffer(buffer2);
+
+  std::vector<uint8_t> bytes(200);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = i;
+  }
+  auto id = logger.writeBytes(
+      EntryType::STRING_VALUE, 123, bytes.data(), bytes.size());
+
+  for (auto& buffer : {buffer1, buffer2}) {
+    size_t calls = 0;
+    writer::PacketReassembler reassembler(
+        [&](const void* data, size_t size) {
+          BytesEntry result{};
+          BytesEntry::unpack(result, data, size);
+          EXPECT_EQ(result.id, id);
+          EXPECT_EQ(result.matchid, 123);
+          ASSERT_EQ(result.bytes.size, bytes.size());
+          EXPECT_EQ(
+              0, memcmp(result.bytes.values, bytes.data(), bytes.size()));
+          ++calls;
+        });
+
+    auto cursor = buffer->ringBuffer().currentTail();
+    Packet packet{};
+    while (buffer->ringBuffer().tryRead(packet, cursor)) {
+      reassembler.process(packet);
+      cursor.moveForward();
+    }
+    EXPECT_EQ(calls, 1);
+  }
+}
+
+TEST(MultiBufferLoggerTest, testWriteAnnotation) {
+  MultiBufferLogger logger{};
+
+  auto buffer = std::make_shared<Buffer>(10);
+  logger.addBuffer(buffer);
+
+  auto id = logger.writeAnnotation(
+      EntryType::MAPPING,
+      100,
+      1,
+      0,
+      {
+          KeyValue::ofInt("start", 0x1000),
+          KeyValue::ofInt("end", 0x2000),
+          KeyValue::ofInt("offset", 0),
+          KeyValue::ofString("file", "/system/lib64/libc.so"),
+      });
+
+  size_t calls = 0;
+  writer::PacketReassembler reassembler([&](const void* data, size_t size) {
+    AnnotationEntry result{};
+    AnnotationEntry::unpack(result, data, size);
+    EXPECT_EQ(result.id, id);
+    EXPECT_EQ(result.type, EntryType::MAPPING);
+    EXPECT_EQ(result.timestamp, 100);
+    EXPECT_EQ(result.tid, 1);
+
+    KeyValueReader reader(result.pairs.values, result.pairs.size);
+    KeyValue pair;
+    size_t pairs = 0;
+    while (reader.next(pair)) {
+      ++pairs;
+    }
+    EXPECT_EQ(pairs, 4);
+    EXPECT_EQ(pair.kind, KeyValue::STRING);
+    EXPECT_EQ(
+        std::string(pair.stringValue.values, pair.stringValue.size),
+        "/system/lib64/libc.so");
+    ++calls;
+  });
+
+  auto cursor = buffer->ringBuffer().currentTail();
+  Packet packet{};
+  while (buffer->ringBuffer().tryRead(packet, cursor)) {
+    reassembler.process(packet);
+    cursor.moveForward();
+  }
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(MultiBufferLoggerTest, testTryWriteDropsPerBuffer) {
+  constexpr size_t kBufferSize = 4;
+  MultiBufferLogger logger{};
+  auto free_buffer = std::make_shared<Buffer>(kBufferSize);
+  auto busy_buffer = std::make_shared<Buffer>(kBufferSize);
+  logger.addBuffer(free_buffer);
+  logger.addBuffer(busy_buffer);
+
+  // A writer stalls in the middle of writing slot 0 of busy_buffer.
+  auto& busy_ring = busy_buffer->ringBuffer();
+  auto stalled = busy_ring.reserve(1);
+  busy_ring.beginWriteReserved(stalled);
+  for (size_t i = 1; i < kBufferSize; ++i) {
+    Packet packet{};
+    busy_ring.write(packet);
+  }
+
+  auto free_start = free_buffer->ringBuffer().currentHead();
+  auto busy_start = busy_ring.currentHead();
+  StandardEntry entry{
+      .id = 0,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = 100,
+      .tid = 1,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 0,
+  };
+  auto id = logger.tryWrite(entry, 10);
+  EXPECT_NE(id, 0);
+
+  StandardEntry result{};
+  readOneEntry(result, free_buffer->ringBuffer(), free_start);
+  EXPECT_EQ(result.id, id);
+  EXPECT_EQ(busy_start.distanceTo(busy_ring.currentHead()), 0);
+
+  logger.removeBuffer(free_buffer);
+  EXPECT_EQ(logger.tryWrite(entry, 10), 0);
+
+  busy_ring.endWriteReserved(stalled);
+}
+
+TEST(MultiBufferLoggerTest, testRemovedBufferIsNotWritten) {
+  MultiBufferLogger logger{};
+  auto buffer = std::make_shared<Buffer>(10);
+  logger.addBuffer(buffer);
+
+  StandardEntry entry{};
+  entry.type = EntryType::MARK_PUSH;
+  logger.write(entry);
+
+  logger.removeBuffer(buffer);
+  auto head = buffer->ringBuffer().currentHead();
+  logger.write(entry);
+  EXPECT_EQ(head.distanceTo(buffer->ringBuffer().currentHead()), 0);
+
+  // Removing it twice is a no-op.
+  logger.removeBuffer(buffer);
+}
+
+TEST(MultiBufferLoggerTest, testConcurrentWritesAndBufferChanges) {
+  constexpr int kWriters = 4;
+  constexpr int kIterations = 200;
+
+  MultiBufferLogger logger{};
+  auto persistent = std::make_shared<Buffer>(1000);
+  logger.addBuffer(persistent);
+
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kWriters; ++t) {
+    writers.emplace_back([&] {
+      while (!stop.load()) {
+        StandardEntry entry{};
+        entry.type = EntryType::MARK_PUSH;
+        logger.write(entry);
+      }
+    });
+  }
+
+  for (int i = 0; i < kIterations; ++i) {
+    auto buffer = std::make_shared<Buffer>(100);
+    logger.addBuffer(buffer);
+    std::this_thread::yield();
+    logger.removeBuffer(buffer);
+
+    // Once removeBuffer returns, nobody may write to the buffer anymore.
+    auto head = buffer->ringBuffer().currentHead();
+    std::this_thread::yield();
+    EXPECT_EQ(head.distanceTo(buffer->ringBuffer().currentHead()), 0);
+  }
+
+  stop.store(true);
+  for (auto& writer : writers) {
+    writer.join();
+  }
+}
+
 } // namespace logger
 } // namespace profilo
 } // namespace facebook
@@ -0,0 +1,191 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <atomic>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <profilo/StringTable.h>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+namespace {
+
+uint32_t intern(StringTable& table, const std::string& str, bool& inserted) {
+  return table.intern(str.data(), str.size(), inserted);
+}
+
+} // namespace
+
+TEST(StringTableTest, testInternReturnsSameID) {
+  StringTable table;
+  bool inserted = false;
+
+  auto id = intern(table, "onDraw", inserted);
+  ASSERT_NE(id, 0);
+  EXPECT_TRUE(inserted);
+  table.publish(id);
+
+  EXPECT_EQ(intern(table, "onDraw", inserted), id);
+  EXPECT_FALSE(inserted);
+
+  auto other = intern(table, "onMeasure", inserted);
+  EXPECT_NE(other, 0);
+  EXPECT_NE(other, id);
+  EXPECT_TRUE(inserted);
+}
+
+TEST(StringTableTest, testPendingStringIsNotShared) {
+  StringTable table;
+  bool inserted = false;
+
+  auto id = intern(table, "onDraw", inserted);
+  ASSERT_TRUE(inserted);
+  EXPECT_EQ(intern(table, "onDraw", inserted), 0);
+  EXPECT_FALSE(inserted);
+
+  const char* str = nullptr;
+  size_t size = 0;
+  EXPECT_FALSE(table.lookup(id, str, size));
+
+  table.publish(id);
+  EXPECT_EQ(intern(table, "onDraw", inserted), id);
+  ASSERT_TRUE(table.lookup(id, str, size));
+  EXPECT_EQ(std::string(str, size), "onDraw");
+}
+
+TEST(StringTableTest, testFullTable) {
+  StringTable table(2, 1024);
+  bool inserted = false;
+
+  EXPECT_NE(intern(table, "a", inserted), 0);
+  EXPECT_NE(intern(table, "b", inserted), 0);
+  EXPECT_EQ(intern(table, "c", inserted), 0);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(table.size(), 2);
+}
+
+TEST(StringTableTest, testFullArena) {
+  StringTable table(16, 8);
+  bool inserted = false;
+
+  EXPECT_NE(intern(table, "12345", inserted), 0);
+  EXPECT_EQ(intern(table, "67890", inserted), 0);
+  EXPECT_FALSE(inserted);
+  EXPECT_NE(intern(table, "ab", inserted), 0);
+}
+
+TEST(StringTableTest, testFullTableIsFull) {
+  StringTable table(1, 1024);
+  bool inserted = false;
+
+  EXPECT_NE(intern(table, "a", inserted), 0);
+  EXPECT_TRUE(table.full());
+
+  StringTable arena(16, 4);
+  EXPECT_EQ(intern(arena, "12345", inserted), 0);
+  EXPECT_TRUE(arena.full());
+  EXPECT_FALSE(StringTable().full());
+}
+
+TEST(StringTableTest, testIDsStartAtFirstID) {
+  StringTable table(4, 1024, 100);
+  bool inserted = false;
+
+  auto id = intern(table, "onDraw", inserted);
+  ASSERT_GE(id, table.firstID());
+  ASSERT_LE(id, table.lastID());
+  table.publish(id);
+
+  const char* str = nullptr;
+  size_t size = 0;
+  ASSERT_TRUE(table.lookup(id, str, size));
+  EXPECT_EQ(std::string(str, size), "onDraw");
+  EXPECT_FALSE(table.lookup(1, str, size));
+  EXPECT_FALSE(table.lookup(table.lastID() + 1, str, size));
+
+  table.forEach([&](uint32_t each, const char*, size_t) {
+    EXPECT_EQ(each, id);
+  });
+}
+
+TEST(StringTableTest, testForEachVisitsPublishedStrings) {
+  StringTable table;
+  bool inserted = false;
+
+  auto published = intern(table, "published", inserted);
+  table.publish(published);
+  intern(table, "pending", inserted);
+
+  std::vector<std::string> strings;
+  table.forEach([&](uint32_t id, const char* str, size_t size) {
+    EXPECT_EQ(id, published);
+    strings.emplace_back(str, size);
+  });
+  EXPECT_EQ(strings, std::vector<std::string>{"published"});
+}
+
+TEST(StringTableTest, testConcurrentIntern) {
+  constexpr int kThreads = 8;
+  constexpr int kStrings = 100;
+  StringTable table;
+
+  // Every thread interns the same strings; each must end up with one ID.
+  std::atomic<bool> go(false);
+  std::vector<std::vector<uint32_t>> ids(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < kStrings; ++i) {
+        auto str = "string" + std::to_string(i);
+        bool inserted = false;
+        uint32_t id = 0;
+        while ((id = intern(table, str, inserted)) == 0) {
+          std::this_thread::yield();
+        }
+        if (inserted) {
+          table.publish(id);
+        }
+        ids[t].push_back(id);
+      }
+    });
+  }
+  go.store(true);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::set<uint32_t> unique(ids[0].begin(), ids[0].end());
+  EXPECT_EQ(unique.size(), kStrings);
+  for (int t = 1; t < kThreads; ++t) {
+    EXPECT_EQ(ids[t], ids[0]);
+  }
+  EXPECT_EQ(table.size(), kStrings);
+}
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,449 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <profilo/Logger.h>
+#include <profilo/WriteCombiner.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/writer/PacketReassembler.h>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+using mmapbuf::Buffer;
+using writer::PacketReassembler;
+
+namespace {
+
+StandardEntry makeEntry(EntryType type, int32_t tid, int64_t extra) {
+  return StandardEntry{
+      .id = 0,
+      .type = type,
+      .timestamp = 0,
+      .tid = tid,
+      .callid = 0,
+      .matchid = 0,
+      .extra = extra,
+  };
+}
+
+bool readEntry(
+    StandardEntry& result,
+    TraceBuffer& buffer,
+    TraceBuffer::Cursor cursor) {
+  Packet packet{};
+  if (!buffer.tryRead(packet, cursor)) {
+    return false;
+  }
+  StandardEntry::unpack(result, packet.data, packet.size);
+  return true;
+}
+
+struct EntryCollector : public EntryVisitor {
+  explicit EntryCollector(std::vector<StandardEntry>& entries)
+      : entries(entries) {}
+
+  void visit(const StandardEntry& entry) override {
+    entries.push_back(entry);
+  }
+  void visit(const FramesEntry&) override {}
+  void visit(const BytesEntry&) override {}
+  void visit(const AnnotationEntry&) override {}
+
+  std::vector<StandardEntry>& entries;
+};
+
+} // namespace
+
+TEST(WriteCombinerTest, testStagedEntriesAreVisibleAfterFlush) {
+  Buffer buffer(100, true);
+  auto& logger = buffer.logger();
+  auto start = buffer.ringBuffer().currentHead();
+
+  for (int i = 0; i < 3; ++i) {
+    logger.write(makeEntry(EntryType::MARK_PUSH, 1, i));
+  }
+
+  StandardEntry result{};
+  EXPECT_FALSE(readEntry(result, buffer.ringBuffer(), start));
+
+  logger.flushStaged();
+
+  auto cursor = start;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), cursor));
+    EXPECT_EQ(result.extra, i);
+    cursor.moveForward();
+  }
+}
+
+TEST(WriteCombinerTest, testFullAreaIsPublished) {
+  Buffer buffer(100, true);
+  auto start = buffer.ringBuffer().currentHead();
+
+  for (uint32_t i = 0; i < WriteCombiner::kStagedPackets; ++i) {
+    buffer.logger().write(makeEntry(EntryType::MARK_PUSH, 1, i));
+  }
+
+  auto cursor = start;
+  for (uint32_t i = 0; i < WriteCombiner::kStagedPackets; ++i) {
+    StandardEntry result{};
+    ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), cursor));
+    EXPECT_EQ(result.extra, i);
+    cursor.moveForward();
+  }
+}
+
+TEST(WriteCombinerTest, testThreadExitPublishes) {
+  Buffer buffer(100, true);
+  auto start = buffer.ringBuffer().currentHead();
+
+  std::thread([&] {
+    buffer.logger().write(makeEntry(EntryType::MARK_PUSH, 1, 42));
+  }).join();
+
+  StandardEntry result{};
+  ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), start));
+  EXPECT_EQ(result.extra, 42);
+}
+
+TEST(WriteCombinerTest, testDirectWriteKeepsThreadOrder) {
+  Buffer buffer(100, true);
+  auto start = buffer.ringBuffer().currentHead();
+
+  buffer.logger().write(makeEntry(EntryType::MARK_PUSH, 1, 1));
+  TraceBuffer::Cursor cursor = start;
+  buffer.logger().writeAndGetCursor(
+      makeEntry(EntryType::MARK_POP, 1, 2), cursor);
+
+  StandardEntry result{};
+  ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), start));
+  EXPECT_EQ(result.extra, 1);
+
+  start.moveForward();
+  ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), start));
+  EXPECT_EQ(result.extra, 2);
+  ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), cursor));
+  EXPECT_EQ(result.extra, 2);
+}
+
+TEST(WriteCombinerTest, testTryWriteKeepsThreadOrder) {
+  Buffer buffer(100, true);
+  auto start = buffer.ringBuffer().currentHead();
+
+  buffer.logger().write(makeEntry(EntryType::MARK_PUSH, 1, 1));
+  EXPECT_NE(
+      buffer.logger().tryWrite(makeEntry(EntryType::MARK_POP, 1, 2), 10), 0);
+
+  StandardEntry result{};
+  ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), start));
+  EXPECT_EQ(result.extra, 1);
+  start.moveForward();
+  ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), start));
+  EXPECT_EQ(result.extra, 2);
+}
+
+TEST(WriteCombinerTest, testTryWriteDropsBehindUnpublishedStagedEntries) {
+  constexpr size_t kBufferSize = 4;
+  Buffer buffer(kBufferSize, true);
+  auto& ring = buffer.ringBuffer();
+
+  // Another writer stalls in the middle of writing slot 0, and the ring
+  // wraps around onto it.
+  auto stalled = ring.reserve(1);
+  ring.beginWriteReserved(stalled);
+  Packet filler{};
+  for (size_t i = 1; i < kBufferSize; ++i) {
+    ring.write(filler);
+  }
+  auto start = ring.currentHead();
+
+  buffer.logger().write(makeEntry(EntryType::MARK_PUSH, 1, 1));
+  // The staged entry can't be published without waiting, and this one
+  // can't go ahead of it.
+  EXPECT_EQ(
+      buffer.logger().tryWrite(makeEntry(EntryType::MARK_POP, 1, 2), 10), 0);
+  EXPECT_EQ(ring.writeCount(), kBufferSize);
+
+  ring.endWriteReserved(stalled);
+  EXPECT_NE(
+      buffer.logger().tryWrite(makeEntry(EntryType::MARK_POP, 1, 3), 10), 0);
+
+  StandardEntry result{};
+  ASSERT_TRUE(readEntry(result, ring, start));
+  EXPECT_EQ(result.extra, 1);
+  start.moveForward();
+  ASSERT_TRUE(readEntry(result, ring, start));
+  EXPECT_EQ(result.extra, 3);
+}
+
+TEST(WriteCombinerTest, testTraceControlEntryFlushesAllThreads) {
+  Buffer buffer(100, true);
+  auto start = buffer.ringBuffer().currentHead();
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool staged = false;
+  bool done = false;
+
+  std::thread other([&] {
+    buffer.logger().write(makeEntry(EntryType::MARK_PUSH, 2, 7));
+    std::unique_lock<std::mutex> lock(mutex);
+    staged = true;
+    cv.notify_all();
+    cv.wait(lock, [&] { return done; });
+  });
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return staged; });
+  }
+
+  buffer.logger().write(makeEntry(EntryType::TRACE_END, 1, 8));
+
+  StandardEntry result{};
+  ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), start));
+  EXPECT_EQ(result.type, EntryType::MARK_PUSH);
+  EXPECT_EQ(result.extra, 7);
+
+  start.moveForward();
+  ASSERT_TRUE(readEntry(result, buffer.ringBuffer(), start));
+  EXPECT_EQ(result.type, EntryType::TRACE_END);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  cv.notify_all();
+  other.join();
+}
+
+TEST(WriteCombinerTest, testCompactEntriesShareSlots) {
+  constexpr int kEntries = 10;
+  Buffer buffer(100, true, true);
+  auto start = buffer.ringBuffer().currentHead();
+
+  for (int i = 0; i < kEntries; ++i) {
+    buffer.logger().write(makeEntry(EntryType::MARK_PUSH, 1, i));
+  }
+  buffer.logger().flushStaged();
+
+  auto end = buffer.ringBuffer().currentHead();
+  auto slots = start.distanceTo(end);
+  EXPECT_GT(slots, 0);
+  EXPECT_LT(slots, kEntries);
+
+  std::vector<StandardEntry> entries;
+  EntryCollector collector(entries);
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    EntryParser::parse(data, size, collector);
+  });
+  for (auto cursor = start; cursor.distanceTo(end) > 0; cursor.moveForward()) {
+    Packet packet{};
+    ASSERT_TRUE(buffer.ringBuffer().tryRead(packet, cursor));
+    reassembler.process(packet);
+  }
+
+  ASSERT_EQ(entries.size(), kEntries);
+  for (int i = 0; i < kEntries; ++i) {
+    EXPECT_EQ(entries[i].type, EntryType::MARK_PUSH);
+    EXPECT_EQ(entries[i].extra, i);
+  }
+}
+
+TEST(WriteCombinerTest, testDirectWriteWaitsForFlushAll) {
+  Buffer buffer(100);
+  auto& ring = buffer.ringBuffer();
+  auto start = ring.currentHead();
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool flushing = false;
+  bool written = false;
+  static thread_local bool is_flusher = false;
+
+  PacketLogger logger(
+      [&]() -> TraceBuffer& {
+        if (is_flusher) {
+          // flushAll() holds the writer's area now. Keep holding it until
+          // the writer's direct write lands, or until it's clear that the
+          // direct write waits for us.
+          std::unique_lock<std::mutex> lock(mutex);
+          flushing = true;
+          cv.notify_all();
+          cv.wait_for(
+              lock, std::chrono::milliseconds(200), [&] { return written; });
+        }
+        return ring;
+      },
+      true);
+
+  int64_t staged = 1;
+  int64_t direct = 2;
+  logger.writeCombined(&staged, sizeof(staged));
+
+  std::thread flusher([&] {
+    is_flusher = true;
+    logger.flushAll();
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return flushing; });
+  }
+  logger.write(&direct, sizeof(direct));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    written = true;
+    cv.notify_all();
+  }
+  flusher.join();
+
+  for (int64_t expected : {staged, direct}) {
+    Packet packet{};
+    ASSERT_TRUE(ring.tryRead(packet, start));
+    int64_t value = 0;
+    std::memcpy(&value, packet.data, sizeof(value));
+    EXPECT_EQ(value, expected);
+    start.moveForward();
+  }
+}
+
+namespace {
+
+constexpr int kStressThreads = 8;
+constexpr int kStressWritesPerThread = 20000;
+
+// Returns the time taken for all threads to finish their writes.
+std::chrono::microseconds runStress(Buffer& buffer) {
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kStressThreads; ++t) {
+    threads.emplace_back([&buffer, &go, t] {
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < kStressWritesPerThread; ++i) {
+        buffer.logger().write(makeEntry(EntryType::MARK_PUSH, t + 1, i));
+      }
+    });
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  go.store(true);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  buffer.logger().flushStaged();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - begin);
+}
+
+void verifyPerThreadOrder(Buffer& buffer) {
+  std::unordered_map<int32_t, int64_t> next_extra;
+  int total = 0;
+  for (auto cursor = buffer.ringBuffer().currentTail();; cursor.moveForward()) {
+    StandardEntry result{};
+    if (!readEntry(result, buffer.ringBuffer(), cursor)) {
+      break;
+    }
+    EXPECT_EQ(result.extra, next_extra[result.tid]) << "tid " << result.tid;
+    next_extra[result.tid] = result.extra + 1;
+    ++total;
+  }
+  EXPECT_EQ(total, kStressThreads * kStressWritesPerThread);
+}
+
+} // namespace
+
+TEST(WriteCombinerTest, testDestroyWhileThreadsExit) {
+  constexpr int kRounds = 50;
+  constexpr int kThreads = 8;
+  Buffer buffer(kRounds * kThreads);
+  auto start = buffer.ringBuffer().currentHead();
+
+  for (int round = 0; round < kRounds; ++round) {
+    auto combiner = std::make_unique<WriteCombiner>(
+        [&]() -> TraceBuffer& { return buffer.ringBuffer(); });
+    std::atomic<int> staged{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+      threads.emplace_back([&, i] {
+        Packet packet{
+            .stream = Packet::kPacketIdNone,
+            .start = true,
+            .next = false,
+            .size = 0,
+            .data = {},
+        };
+        auto entry = makeEntry(EntryType::MARK_PUSH, i, round);
+        packet.size = StandardEntry::calculateSize(entry);
+        StandardEntry::pack(entry, packet.data, sizeof(packet.data));
+        ASSERT_TRUE(combiner->stage(packet));
+        ++staged;
+      });
+    }
+    // Threads exit while the combiner goes away, some publish their packet
+    // on exit, the destructor publishes the others.
+    while (staged.load() < kThreads) {
+      std::this_thread::yield();
+    }
+    combiner.reset();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  auto cursor = start;
+  int total = 0;
+  StandardEntry result{};
+  while (readEntry(result, buffer.ringBuffer(), cursor)) {
+    cursor.moveForward();
+    ++total;
+  }
+  EXPECT_EQ(total, kRounds * kThreads);
+}
+
+TEST(WriteCombinerTest, testContendedStress) {
+  constexpr size_t kEntries = kStressThreads * kStressWritesPerThread;
+
+  Buffer direct(kEntries);
+  auto direct_time = runStress(direct);
+  verifyPerThreadOrder(direct);
+
+  Buffer combined(kEntries, true);
+  auto combined_time = runStress(combined);
+  verifyPerThreadOrder(combined);
+
+  std::cout << kStressThreads << " threads x " << kStressWritesPerThread
+            << " writes: direct " << direct_time.count() << "us, combined "
+            << combined_time.count() << "us" << std::endl;
+}
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,78 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <iostream>
+
+#include <profilo/Logger.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/util/common.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::entries;
+
+namespace {
+
+constexpr int kIterations = 1000000;
+
+template <typename Fn>
+double nanosPerCall(Fn&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; i++) {
+    fn(i);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+      kIterations;
+}
+
+} // namespace
+
+int main() {
+  mmapbuf::Buffer buffer(4096);
+  auto& logger = buffer.logger();
+
+  // Keeps the clock reads from being optimized away.
+  volatile int64_t sink = 0;
+
+  std::cout << "source\tclock ns\tentry ns\n";
+  for (auto source : {ClockSource::SYSCALL,
+                      ClockSource::VDSO,
+                      ClockSource::COARSE,
+                      ClockSource::COUNTER}) {
+    if (!setClockSource(source)) {
+      std::cout << getClockSourceName(source) << "\tunsupported\n";
+      continue;
+    }
+
+    auto clock = nanosPerCall([&](int) { sink = monotonicTime(); });
+    auto entry = nanosPerCall([&](int i) {
+      logger.write(StandardEntry{
+          .id = 0,
+          .type = EntryType::COUNTER,
+          .timestamp = monotonicTime(),
+          .tid = 1,
+          .callid = 0,
+          .matchid = 0,
+          .extra = i,
+      });
+    });
+    std::cout << getClockSourceName(source) << '\t' << clock << '\t' << entry
+              << '\n';
+  }
+  setClockSource(ClockSource::SYSCALL);
+  return 0;
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <profilo/Logger.h>
+
+using namespace facebook::profilo;
+
+namespace {
+
+constexpr int kIdsPerThread = 1000000;
+
+// Returns the average wall time per ID, in nanoseconds.
+double run(int threadCount, int32_t blockSize) {
+  Logger::EntryIDCounter counter{1, blockSize};
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; t++) {
+    threads.emplace_back([&] {
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < kIdsPerThread; i++) {
+        auto id = counter.next();
+        (void)id;
+      }
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  go.store(true);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+      ((double)kIdsPerThread * threadCount);
+}
+
+} // namespace
+
+int main() {
+  std::cout << "threads\tshared ns/id\tblock(64) ns/id\n";
+  for (int threads = 1; threads <= 32; threads *= 2) {
+    std::cout << threads << '\t' << run(threads, 1) << '\t' << run(threads, 64)
+              << '\n';
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <profilo/MultiBufferLogger.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::logger;
+
+namespace {
+
+constexpr int kWrites = 1000000;
+constexpr size_t kBufferSize = 10000;
+
+// Returns the average time per write, in nanoseconds.
+template <class Fn>
+double run(int bufferCount, Fn&& writeOne) {
+  MultiBufferLogger logger{};
+  std::vector<std::shared_ptr<mmapbuf::Buffer>> buffers;
+  for (int i = 0; i < bufferCount; i++) {
+    buffers.push_back(std::make_shared<mmapbuf::Buffer>(kBufferSize));
+    logger.addBuffer(buffers.back());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kWrites; i++) {
+    writeOne(logger, i);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / kWrites;
+}
+
+} // namespace
+
+int main() {
+  const uint8_t kBytes[200] = {};
+
+  std::cout << "buffers\tstandard ns/write\tbytes(200) ns/write\n";
+  for (int buffers = 1; buffers <= 4; buffers *= 2) {
+    auto standard = run(buffers, [](MultiBufferLogger& logger, int i) {
+      logger.write(StandardEntry{
+          .id = 0,
+          .type = EntryType::MARK_PUSH,
+          .timestamp = i,
+          .tid = 1,
+          .callid = 2,
+          .matchid = 3,
+          .extra = 4,
+      });
+    });
+    auto bytes = run(buffers, [&kBytes](MultiBufferLogger& logger, int i) {
+      logger.writeBytes(EntryType::STRING_VALUE, i, kBytes, sizeof(kBytes));
+    });
+    std::cout << buffers << '\t' << standard << '\t' << bytes << '\n';
+  }
+  return 0;
+}
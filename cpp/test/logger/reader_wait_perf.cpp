@@ -0,0 +1,123 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <profilo/Logger.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/writer/TraceWriter.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::entries;
+
+namespace {
+
+constexpr int64_t kTraceID = 1;
+constexpr int kWrites = 50000;
+// Gap between writes, long enough for the writer to catch up and wait.
+constexpr auto kWriteInterval = std::chrono::microseconds(20);
+
+StandardEntry makeEntry(EntryType type, int64_t extra) {
+  return StandardEntry{
+      .id = 0,
+      .type = type,
+      .timestamp = 0,
+      .tid = 1,
+      .callid = 0,
+      .matchid = 0,
+      .extra = extra,
+  };
+}
+
+struct Result {
+  double p50;
+  double p99;
+  double p999;
+};
+
+// Producer write latencies, in nanoseconds, while a TraceWriter with the
+// given latency budget is reading the trace.
+Result run(const std::string& folder, std::chrono::microseconds budget) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(kWrites * 2);
+  writer::TraceWriter writer(
+      std::string(folder),
+      "perf",
+      buffer,
+      nullptr,
+      std::vector<std::pair<std::string, std::string>>(),
+      nullptr,
+      budget);
+
+  auto& logger = buffer->logger();
+  TraceBuffer::Cursor cursor = buffer->ringBuffer().currentHead();
+  logger.writeAndGetCursor(makeEntry(EntryType::TRACE_START, kTraceID), cursor);
+  std::thread reader([&] { writer.processTrace(kTraceID, cursor); });
+
+  std::vector<double> latencies;
+  latencies.reserve(kWrites);
+  for (int i = 0; i < kWrites; i++) {
+    auto next = std::chrono::steady_clock::now() + kWriteInterval;
+    while (std::chrono::steady_clock::now() < next) {
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    logger.write(makeEntry(EntryType::COUNTER, i));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    latencies.push_back(
+        std::chrono::duration<double, std::nano>(elapsed).count());
+  }
+  logger.write(makeEntry(EntryType::TRACE_END, kTraceID));
+  reader.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  return Result{
+      .p50 = percentile(0.5),
+      .p99 = percentile(0.99),
+      .p999 = percentile(0.999),
+  };
+}
+
+} // namespace
+
+int main() {
+  char folder[] = "/tmp/reader_wait_perf.XXXXXX";
+  if (mkdtemp(folder) == nullptr) {
+    std::cerr << "Could not create a trace folder\n";
+    return 1;
+  }
+
+  std::cout << "reader\tp50 ns\tp99 ns\tp99.9 ns\n";
+  for (auto budget : {0, 50, 200, 1000}) {
+    auto result = run(folder, std::chrono::microseconds(budget));
+    if (budget == 0) {
+      std::cout << "futex";
+    } else {
+      std::cout << "poll " << budget << "us";
+    }
+    std::cout << '\t' << result.p50 << '\t' << result.p99 << '\t'
+              << result.p999 << '\n';
+  }
+  return 0;
+}
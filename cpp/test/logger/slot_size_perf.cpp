@@ -0,0 +1,154 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <profilo/SlotWriter.h>
+#include <profilo/entries/Entry.h>
+#include <profilo/logger/buffer/TraceBuffer.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::entries;
+using namespace facebook::profilo::logger;
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+namespace lfrb {
+
+// Friend of LockFreeRingBuffer, lets us place buffers of any slot size
+// without going through mmapbuf::Buffer.
+class LockFreeRingBufferTestAccessor {
+ public:
+  template <class Buffer>
+  static Buffer* allocateAt(size_t count, void* ptr) {
+    return Buffer::allocateAt(count, ptr);
+  }
+
+  template <class Buffer>
+  static void destroy(Buffer* buffer) {
+    buffer->~Buffer();
+  }
+};
+
+} // namespace lfrb
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
+
+namespace {
+
+// Same memory for every slot size, so the number of samples retained is the
+// effective history length.
+constexpr size_t kBufferBytes = 16 * 1024 * 1024;
+constexpr int kSamples = 200000;
+constexpr int kEntriesPerSample = 4;
+
+template <class PacketT, class T>
+void write(lfrb::LockFreeRingBuffer<PacketT>& buffer, const T& entry) {
+  auto size = T::calculateSize(entry);
+  using Writer = BasicSlotWriter<PacketT>;
+  Writer writer(
+      buffer,
+      Writer::packetCount(size) > 1 ? 1 : PacketT::kPacketIdNone,
+      size);
+  T::pack(entry, writer);
+}
+
+struct Result {
+  double nsPerSample;
+  double slotsPerSample;
+  double samplesRetained;
+};
+
+// Each sample is a stack trace of `depth` frames plus a few standard entries,
+// roughly what a sampling profiler produces.
+template <size_t SlotSize>
+Result run(uint16_t depth) {
+  using Buffer = BasicTraceBuffer<SlotSize>;
+  size_t capacity = kBufferBytes / SlotSize;
+  std::unique_ptr<char[]> memory(
+      new char[Buffer::calculateAllocationSize(capacity)]);
+  auto buffer = lfrb::LockFreeRingBufferTestAccessor::allocateAt<Buffer>(
+      capacity, memory.get());
+
+  std::vector<int64_t> frames(depth);
+  for (size_t i = 0; i < frames.size(); i++) {
+    frames[i] = 0x7000000000 + i * 16;
+  }
+
+  auto begin = buffer->currentHead();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kSamples; i++) {
+    write(
+        *buffer,
+        FramesEntry{
+            .id = i,
+            .type = EntryType::STACK_FRAME,
+            .timestamp = i,
+            .tid = 1,
+            .frames = {.values = frames.data(), .size = depth},
+        });
+    for (int j = 0; j < kEntriesPerSample; j++) {
+      write(
+          *buffer,
+          StandardEntry{
+              .id = i,
+              .type = EntryType::MARK_PUSH,
+              .timestamp = i,
+              .tid = 1,
+              .callid = j,
+              .matchid = 0,
+              .extra = 0,
+          });
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  double slots = begin.distanceTo(buffer->currentHead());
+  Result result{
+      .nsPerSample =
+          std::chrono::duration<double, std::nano>(elapsed).count() / kSamples,
+      .slotsPerSample = slots / kSamples,
+      .samplesRetained = capacity / (slots / kSamples),
+  };
+  lfrb::LockFreeRingBufferTestAccessor::destroy(buffer);
+  return result;
+}
+
+template <size_t SlotSize>
+void report(uint16_t depth) {
+  auto result = run<SlotSize>(depth);
+  std::cout << SlotSize << '\t' << depth << '\t' << result.nsPerSample << '\t'
+            << result.slotsPerSample << '\t' << result.samplesRetained << '\n';
+}
+
+} // namespace
+
+int main() {
+  std::cout << "slot\tdepth\tns/sample\tslots/sample\tsamples retained ("
+            << kBufferBytes / (1024 * 1024) << "MB)\n";
+  for (uint16_t depth : {8, 64, 512}) {
+    report<64>(depth);
+    report<128>(depth);
+    report<256>(depth);
+  }
+  return 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <folly/experimental/TestUtil.h>
+#include <gtest/gtest.h>
+#include <profilo/Logger.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/mmapbuf/Buffer.h>
+
+namespace facebook {
+namespace profilo {
+namespace mmapbuf {
+
+namespace {
+
+StandardEntry makeEntry(EntryType type, int64_t extra) {
+  return StandardEntry{
+      .id = 0,
+      .type = type,
+      .timestamp = 0,
+      .tid = 1,
+      .callid = 0,
+      .matchid = 0,
+      .extra = extra,
+  };
+}
+
+bool readEntry(
+    StandardEntry& result,
+    TraceBuffer& buffer,
+    TraceBuffer::Cursor cursor) {
+  logger::Packet packet{};
+  if (!buffer.tryRead(packet, cursor)) {
+    return false;
+  }
+  StandardEntry::unpack(result, packet.data, packet.size);
+  return true;
+}
+
+struct EntryTypeVisitor : public entries::EntryVisitor {
+  EntryType type = EntryType::UNKNOWN_TYPE;
+
+  void visit(const StandardEntry& entry) override {
+    type = entry.type;
+  }
+  void visit(const entries::FramesEntry& entry) override {
+    type = entry.type;
+  }
+  void visit(const entries::BytesEntry& entry) override {
+    type = entry.type;
+  }
+  void visit(const entries::AnnotationEntry& entry) override {
+    type = entry.type;
+  }
+};
+
+EntryType readEntryType(TraceBuffer& buffer, TraceBuffer::Cursor cursor) {
+  logger::Packet packet{};
+  if (!buffer.tryRead(packet, cursor)) {
+    return EntryType::UNKNOWN_TYPE;
+  }
+  EntryTypeVisitor visitor;
+  entries::EntryParser::parse(packet.data, packet.size, visitor);
+  return visitor.type;
+}
+
+int32_t writeName(Logger& logger, const std::string& name) {
+  return logger.writeString(
+      EntryType::STRING_NAME,
+      1,
+      reinterpret_cast<const uint8_t*>(name.data()),
+      name.size());
+}
+
+// The string ID of the STRING_REF at `cursor`, or 0 if it's another entry.
+uint32_t readStringRef(TraceBuffer& buffer, TraceBuffer::Cursor cursor) {
+  StandardEntry result{};
+  if (readEntryType(buffer, cursor) != EntryType::STRING_REF ||
+      !readEntry(result, buffer, cursor)) {
+    return 0;
+  }
+  return static_cast<uint32_t>(result.extra);
+}
+
+} // namespace
+
+TEST(BufferTest, testFullStringTableIsReplacedAtTraceStart) {
+  Buffer buffer(64);
+  auto& logger = buffer.logger();
+  auto& ring = buffer.ringBuffer();
+
+  // Intern names until one gets logged in full.
+  std::vector<uint32_t> ids;
+  TraceBuffer::Cursor cursor = ring.currentHead();
+  for (int i = 0;; ++i) {
+    auto name = "name" + std::to_string(i);
+    writeName(logger, name);
+    cursor = ring.currentHead();
+    writeName(logger, name);
+    auto id = readStringRef(ring, cursor);
+    if (id == 0) {
+      break;
+    }
+    ids.push_back(id);
+    ASSERT_LT(i, 1024);
+  }
+  ASSERT_FALSE(ids.empty());
+
+  logger.write(makeEntry(EntryType::TRACE_START, 0));
+  const char* str = nullptr;
+  size_t size = 0;
+  EXPECT_FALSE(logger.lookupString(ids.front(), str, size));
+
+  writeName(logger, "late");
+  cursor = ring.currentHead();
+  writeName(logger, "late");
+  auto id = readStringRef(ring, cursor);
+  EXPECT_GT(id, *std::max_element(ids.begin(), ids.end()));
+  ASSERT_TRUE(logger.lookupString(id, str, size));
+  EXPECT_EQ(std::string(str, size), "late");
+}
+
+TEST(BufferTest, testMovedBufferKeepsStrings) {
+  Buffer original(100);
+  writeName(original.logger(), "name");
+
+  Buffer moved(std::move(original));
+  auto& ring = moved.ringBuffer();
+  auto cursor = ring.currentHead();
+  writeName(moved.logger(), "name");
+  auto id = readStringRef(ring, cursor);
+  ASSERT_NE(id, 0);
+
+  const char* str = nullptr;
+  size_t size = 0;
+  ASSERT_TRUE(moved.logger().lookupString(id, str, size));
+  EXPECT_EQ(std::string(str, size), "name");
+}
+
+TEST(BufferTest, testFileBackedBufferLogsStringsInFull) {
+  folly::test::TemporaryDirectory dir;
+  Buffer buffer((dir.path() / "buffer").string(), 100);
+  EXPECT_FALSE(buffer.logger().internStrings());
+
+  auto& ring = buffer.ringBuffer();
+  auto start = ring.currentHead();
+  static constexpr char kName[] = "name";
+  for (int i = 0; i < 2; ++i) {
+    buffer.logger().writeString(
+        EntryType::STRING_NAME,
+        1,
+        reinterpret_cast<const uint8_t*>(kName),
+        sizeof(kName) - 1);
+  }
+
+  // No STRING_DEFINE / STRING_REF, which couldn't be resolved after a crash.
+  ASSERT_EQ(start.distanceTo(ring.currentHead()), 2);
+  EXPECT_EQ(readEntryType(ring, start), EntryType::STRING_NAME);
+  start.moveForward();
+  EXPECT_EQ(readEntryType(ring, start), EntryType::STRING_NAME);
+
+  Buffer moved(std::move(buffer));
+  EXPECT_FALSE(moved.logger().internStrings());
+  EXPECT_TRUE(Buffer(100).logger().internStrings());
+}
+
+TEST(BufferTest, testMovedBufferKeepsLoggerOptions) {
+  Buffer original(100, true, true, 10);
+  Buffer moved(std::move(original));
+  Buffer assigned(10);
+  assigned = std::move(moved);
+
+  auto& logger = assigned.logger();
+  EXPECT_TRUE(logger.writeCombining());
+  EXPECT_TRUE(logger.compactEntries());
+  EXPECT_TRUE(logger.tiered());
+
+  auto& ring = assigned.ringBuffer();
+  auto start = ring.currentHead();
+  logger.write(makeEntry(EntryType::COUNTER, 5));
+  EXPECT_EQ(start.distanceTo(ring.currentHead()), 0);
+  logger.flushStaged();
+  EXPECT_EQ(start.distanceTo(ring.currentHead()), 1);
+
+  auto& priority = *assigned.priorityRingBuffer();
+  auto priority_start = priority.currentHead();
+  logger.write(makeEntry(EntryType::MARK_PUSH, 6));
+  EXPECT_EQ(priority_start.distanceTo(priority.currentHead()), 1);
+}
+
+TEST(BufferTest, testMovePublishesStagedEntries) {
+  Buffer original(100, true);
+  auto start = original.ringBuffer().currentHead();
+  original.logger().write(makeEntry(EntryType::COUNTER, 7));
+
+  Buffer moved(std::move(original));
+
+  StandardEntry result{};
+  ASSERT_TRUE(readEntry(result, moved.ringBuffer(), start));
+  EXPECT_EQ(result.type, EntryType::COUNTER);
+  EXPECT_EQ(result.extra, 7);
+}
+
+TEST(BufferTest, testMoveAssignmentPublishesStagedEntries) {
+  Buffer original(100, true);
+  auto start = original.ringBuffer().currentHead();
+  original.logger().write(makeEntry(EntryType::COUNTER, 8));
+
+  Buffer assigned(10);
+  assigned = std::move(original);
+
+  StandardEntry result{};
+  ASSERT_TRUE(readEntry(result, assigned.ringBuffer(), start));
+  EXPECT_EQ(result.type, EntryType::COUNTER);
+  EXPECT_EQ(result.extra, 8);
+}
+
+} // namespace mmapbuf
+} // namespace profilo
+} // namespace facebook
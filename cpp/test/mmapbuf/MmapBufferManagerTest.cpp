@@ -177,6 +177,95 @@ TEST(MmapBufferManagerTestBasics, testAllocateMultipleBuffers) {
   EXPECT_TRUE(second_weak.expired());
 }
 
+TEST(MmapBufferManagerTestBasics, testAllocateRoundsUpCapacity) {
+  MmapBufferManager manager{};
+
+  auto exact = manager.allocateBufferAnonymous(100);
+  ASSERT_NE(exact, nullptr);
+  EXPECT_EQ(exact->entryCount, 100);
+  EXPECT_EQ(exact->ringBuffer().capacity(), 100);
+
+  auto rounded = manager.allocateBufferAnonymous(100, false, false, true);
+  ASSERT_NE(rounded, nullptr);
+  EXPECT_EQ(rounded->entryCount, 128);
+  EXPECT_EQ(rounded->ringBuffer().capacity(), 128);
+  EXPECT_EQ(rounded->prefix->header.size, 128);
+
+  manager.deallocateBuffer(exact);
+  manager.deallocateBuffer(rounded);
+}
+
+TEST(MmapBufferManagerTestBasics, testAllocatePassesLoggerOptions) {
+  MmapBufferManager manager{};
+
+  auto plain = manager.allocateBufferAnonymous(100);
+  ASSERT_NE(plain, nullptr);
+  EXPECT_FALSE(plain->logger().writeCombining());
+  EXPECT_FALSE(plain->logger().compactEntries());
+
+  auto combined = manager.allocateBufferAnonymous(100, true, true);
+  ASSERT_NE(combined, nullptr);
+  EXPECT_TRUE(combined->logger().writeCombining());
+  EXPECT_TRUE(combined->logger().compactEntries());
+
+  manager.deallocateBuffer(plain);
+  manager.deallocateBuffer(combined);
+}
+
+TEST(MmapBufferManagerTestBasics, testAllocatePerCpuShards) {
+  MmapBufferManager manager{};
+  auto cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+  auto buffer = manager.allocateBufferAnonymous(
+      100 * cpus, false, false, false, 0, header::ShardMode::PER_CPU);
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_EQ(buffer->shardCount, cpus);
+  EXPECT_EQ(buffer->entryCount, 100);
+  for (int shard = 0; shard < cpus; ++shard) {
+    EXPECT_EQ(buffer->shardRingBuffer(shard).capacity(), 100);
+  }
+  EXPECT_EQ(buffer->prefix->header.size, 100);
+  EXPECT_EQ(buffer->prefix->header.shardCount, cpus);
+  EXPECT_EQ(buffer->prefix->header.shardMode, header::ShardMode::PER_CPU);
+
+  manager.deallocateBuffer(buffer);
+}
+
+TEST(MmapBufferManagerTestBasics, testAllocateUnevenPerCpuShardsRoundsUp) {
+  MmapBufferManager manager{};
+  auto cpus = sysconf(_SC_NPROCESSORS_CONF);
+  if (cpus < 2) {
+    return;
+  }
+
+  auto buffer = manager.allocateBufferAnonymous(
+      100 * cpus + 1, false, false, false, 0, header::ShardMode::PER_CPU);
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_EQ(buffer->shardCount, cpus);
+  EXPECT_EQ(buffer->entryCount, 101);
+
+  manager.deallocateBuffer(buffer);
+}
+
+TEST(MmapBufferManagerTestBasics, testAllocateUndersizedPerCpuShards) {
+  MmapBufferManager manager{};
+  auto cpus = sysconf(_SC_NPROCESSORS_CONF);
+  if (cpus < 2) {
+    return;
+  }
+
+  // Fewer slots than shards: a single ring instead of empty shards.
+  auto buffer = manager.allocateBufferAnonymous(
+      cpus - 1, false, false, false, 0, header::ShardMode::PER_CPU);
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_EQ(buffer->shardCount, 1);
+  EXPECT_EQ(buffer->entryCount, cpus - 1);
+  EXPECT_EQ(buffer->ringBuffer().capacity(), cpus - 1);
+  EXPECT_EQ(buffer->prefix->header.shardMode, header::ShardMode::NONE);
+
+  manager.deallocateBuffer(buffer);
+}
+
 } // namespace mmapbuf
 } // namespace profilo
 } // namespace facebook
@@ -6,6 +6,7 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <zlib.h>
 #include <zstr/zstr.hpp>
 #include <algorithm>
@@ -347,6 +348,82 @@ TEST_F(
   ASSERT_TRUE(caughtException);
 }
 
+TEST_F(MmapBufferTraceWriterTest, testShardsAreMergedByTimestamp) {
+  auto cpus = sysconf(_SC_NPROCESSORS_CONF);
+  auto buffer = manager_.allocateBufferFile(
+      100 * cpus,
+      dumpPath(),
+      false,
+      false,
+      false,
+      10,
+      header::ShardMode::PER_CPU);
+  ASSERT_NE(buffer, nullptr) << "Unable to allocate the buffer";
+  buffer->prefix->header.providers = 0;
+  buffer->prefix->header.longContext = kQplId;
+  buffer->prefix->header.traceId = kTraceId;
+
+  // {timestamp, order in the trace} per ring, the high priority one last.
+  using Writes = std::vector<std::pair<int64_t, int32_t>>;
+  std::vector<Writes> rings{
+      {{10, 1}, {40, 4}},
+      {{20, 2}, {50, 5}},
+      {{30, 3}},
+  };
+  if (buffer->shardCount < 2) {
+    rings[0].insert(rings[0].end(), rings[1].begin(), rings[1].end());
+    std::sort(rings[0].begin(), rings[0].end());
+    rings.erase(rings.begin() + 1);
+  }
+  Logger::EntryIDCounter counter{1};
+  for (size_t ring = 0; ring < rings.size(); ++ring) {
+    TraceBuffer& buf = ring + 1 == rings.size()
+        ? *buffer->priorityRingBuffer()
+        : buffer->shardRingBuffer(ring);
+    Logger logger([&buf]() -> TraceBuffer& { return buf; }, counter);
+    for (auto& write : rings[ring]) {
+      auto id = logger.write(StandardEntry{
+          .id = 0,
+          .type = EntryType::MARK_PUSH,
+          .timestamp = write.first,
+          .tid = 1,
+          .callid = 0,
+          .matchid = 0,
+          .extra = 0,
+      });
+      auto name = "merged-" + std::to_string(write.second);
+      logger.writeBytes(
+          EntryType::STRING_NAME,
+          id,
+          reinterpret_cast<const uint8_t*>(name.c_str()),
+          name.size());
+    }
+  }
+  ASSERT_EQ(msync(buffer->prefix, buffer->totalByteSize, MS_SYNC), 0);
+
+  auto mockCallbacks = std::make_shared<::testing::NiceMock<MockCallbacks>>();
+  MmapBufferTraceWriter traceWriter{};
+  traceWriter.nativeInitAndVerify(dumpPath());
+  traceWriter.writeTrace(
+      "test",
+      true,
+      traceFolderPath(),
+      kTracePrefix,
+      0,
+      mockCallbacks,
+      {},
+      kTraceRecollectionTimestamp);
+
+  auto traceContents = getOnlyTraceFileContents();
+  size_t last = 0;
+  for (int32_t order = 1; order <= 5; ++order) {
+    auto pos = traceContents.find("merged-" + std::to_string(order));
+    ASSERT_NE(pos, std::string::npos) << order;
+    EXPECT_GT(pos, last) << order;
+    last = pos;
+  }
+}
+
 } // namespace writer
 } // namespace mmapbuf
 } // namespace profilo
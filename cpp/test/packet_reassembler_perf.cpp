@@ -0,0 +1,133 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <profilo/writer/PacketReassembler.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::logger;
+using namespace facebook::profilo::writer;
+
+namespace {
+
+constexpr size_t kPayloads = 200000;
+constexpr int kRounds = 3;
+
+//
+// Builds the packets of kPayloads payloads written by `writers` threads at
+// once: each writer emits its payloads back to back, and the writers'
+// packets are interleaved at random. A quarter of the payloads fit in one
+// packet; the rest are stacks of 8 to 160 frames.
+//
+std::vector<Packet> makePackets(size_t writers) {
+  std::mt19937 random(writers);
+  std::vector<Packet> packets;
+  std::vector<size_t> remaining(writers, 0);
+  std::vector<StreamID> stream(writers, 0);
+  StreamID next_stream = 1;
+  size_t started = 0;
+  size_t active = 0;
+
+  while (started < kPayloads || active > 0) {
+    auto writer = random() % writers;
+    if (remaining[writer] == 0) {
+      if (started == kPayloads) {
+        continue;
+      }
+      ++started;
+      ++active;
+      remaining[writer] = random() % 4 == 0
+          ? sizeof(Packet::data) / 2
+          : 32 + 8 * (8 + random() % 153);
+      stream[writer] = next_stream++;
+      packets.emplace_back();
+      packets.back().start = true;
+    } else {
+      packets.emplace_back();
+      packets.back().start = false;
+    }
+    auto& packet = packets.back();
+    packet.stream = stream[writer];
+    packet.size = std::min(remaining[writer], sizeof(Packet::data));
+    remaining[writer] -= packet.size;
+    packet.next = remaining[writer] > 0;
+    std::memset(packet.data, static_cast<int>(packet.stream), packet.size);
+    if (!packet.next) {
+      --active;
+    }
+  }
+  return packets;
+}
+
+template <class Fn>
+double bestRate(size_t count, Fn&& fn) {
+  double best = 0;
+  for (int round = 0; round < kRounds; ++round) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::max(best, count / elapsed.count());
+  }
+  return best;
+}
+
+} // namespace
+
+int main() {
+  printf(
+      "%8s %10s %14s %14s\n",
+      "writers",
+      "packets",
+      "forward/s",
+      "backwards/s");
+  for (size_t writers : {1, 4, 16, 64, 256}) {
+    auto packets = makePackets(writers);
+    size_t payloads = 0;
+    PacketReassembler reassembler([&](const void*, size_t) {
+      ++payloads;
+    });
+
+    auto forward = bestRate(packets.size(), [&] {
+      for (auto& packet : packets) {
+        reassembler.process(packet);
+      }
+    });
+    auto backwards = bestRate(packets.size(), [&] {
+      for (auto it = packets.rbegin(); it != packets.rend(); ++it) {
+        reassembler.processBackwards(*it);
+      }
+    });
+
+    if (payloads != 2 * kRounds * kPayloads) {
+      fprintf(stderr, "lost payloads: %zu\n", payloads);
+      return 1;
+    }
+    printf(
+        "%8zu %10zu %14.0f %14.0f\n",
+        writers,
+        packets.size(),
+        forward,
+        backwards);
+  }
+  return 0;
+}
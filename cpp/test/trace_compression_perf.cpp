@@ -0,0 +1,265 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <zdict.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zstr/zstr.hpp>
+
+#include <profilo/Logger.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/writer/TraceCompressor.h>
+#include <profilo/writer/TraceFileHelpers.h>
+#include <profilo/writer/TraceWriter.h>
+#include <profilo/writer/ZstdCompressor.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::entries;
+using namespace facebook::profilo::writer;
+
+namespace {
+
+constexpr int64_t kTraceID = 1;
+// Entries in the large trace, and in each of the small ones.
+constexpr int kLargeEntries = 200000;
+constexpr int kSmallEntries = 100;
+// Small traces to train a dictionary on, and to measure.
+constexpr int kTrainingTraces = 200;
+constexpr int kSmallTraces = 50;
+constexpr size_t kDictionarySize = 64 * 1024;
+constexpr auto kMinDuration = std::chrono::milliseconds(200);
+
+//
+// Write a trace like the ones TraceWriterTest produces, with a mix of
+// blocks, stacks and strings from a handful of threads, and return its
+// uncompressed contents.
+//
+std::string
+makeTrace(const std::string& folder, int entries, int32_t flags, int seed) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(entries * 8);
+  TraceWriter writer(
+      std::string(folder),
+      "perf",
+      buffer,
+      nullptr,
+      std::vector<std::pair<std::string, std::string>>{{"key1", "value1"}});
+  auto& logger = buffer->logger();
+  std::mt19937 random(seed);
+  int64_t timestamp = 1000000000;
+
+  TraceBuffer::Cursor cursor = buffer->ringBuffer().currentHead();
+  logger.writeAndGetCursor(
+      StandardEntry{
+          .type = EntryType::TRACE_START,
+          .timestamp = timestamp,
+          .matchid = flags,
+          .extra = kTraceID,
+      },
+      cursor);
+
+  std::vector<int64_t> frames;
+  for (int i = 0; i < entries; i++) {
+    timestamp += random() % 20000;
+    int32_t tid = 1000 + random() % 8;
+    switch (random() % 4) {
+      case 0: {
+        frames.resize(5 + random() % 30);
+        for (size_t j = 0; j < frames.size(); j++) {
+          frames[j] = 0x70000000 + (j * 0x1000) + (random() % 4) * 0x40;
+        }
+        logger.write(FramesEntry{
+            .type = EntryType::STACK_FRAME,
+            .timestamp = timestamp,
+            .tid = tid,
+            .frames = {
+                .values = frames.data(),
+                .size = static_cast<uint16_t>(frames.size())}});
+        break;
+      }
+      case 1: {
+        auto id = logger.write(StandardEntry{
+            .type = EntryType::MARK_PUSH,
+            .timestamp = timestamp,
+            .tid = tid,
+        });
+        auto name = "Choreographer#doFrame " + std::to_string(random() % 50);
+        logger.writeBytes(
+            EntryType::STRING_NAME,
+            id,
+            reinterpret_cast<const uint8_t*>(name.data()),
+            name.size());
+        break;
+      }
+      case 2:
+        logger.write(StandardEntry{
+            .type = EntryType::MARK_POP,
+            .timestamp = timestamp,
+            .tid = tid,
+        });
+        break;
+      default:
+        logger.write(StandardEntry{
+            .type = EntryType::COUNTER,
+            .timestamp = timestamp,
+            .tid = tid,
+            .callid = 9000 + static_cast<int32_t>(random() % 5),
+            .extra = static_cast<int64_t>(random() % 100000),
+        });
+    }
+  }
+  logger.write(StandardEntry{
+      .type = EntryType::TRACE_END,
+      .timestamp = timestamp + 1,
+      .extra = kTraceID,
+  });
+  writer.processTrace(kTraceID, cursor);
+
+  // The writer leaves exactly one file behind, read and remove it.
+  std::string file;
+  auto dir = opendir(folder.c_str());
+  while (auto item = readdir(dir)) {
+    if (item->d_type == DT_REG) {
+      file = folder + "/" + item->d_name;
+    }
+  }
+  closedir(dir);
+
+  std::stringstream contents;
+  zstr::ifstream input(file);
+  contents << input.rdbuf();
+  remove(file.c_str());
+  return contents.str();
+}
+
+struct Result {
+  size_t input_bytes;
+  size_t output_bytes;
+  double seconds;
+};
+
+// Compress each of `inputs` in memory, as the writer would a trace file.
+Result compress(
+    const TraceCompressor& compressor,
+    const std::vector<std::string>& inputs) {
+  Result result{};
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::steady_clock::duration::zero();
+  int rounds = 0;
+  while (elapsed < kMinDuration) {
+    for (auto const& input : inputs) {
+      std::stringbuf sink;
+      {
+        auto buffer = compressor.wrap(&sink);
+        buffer->sputn(input.data(), input.size());
+      }
+      if (rounds == 0) {
+        result.input_bytes += input.size();
+        result.output_bytes += sink.str().size();
+      }
+    }
+    rounds++;
+    elapsed = std::chrono::steady_clock::now() - start;
+  }
+  result.seconds = std::chrono::duration<double>(elapsed).count() / rounds;
+  return result;
+}
+
+std::string trainDictionary(const std::string& folder) {
+  std::string samples;
+  std::vector<size_t> sizes;
+  for (int i = 0; i < kTrainingTraces; i++) {
+    auto trace = makeTrace(folder, kSmallEntries, 0, 1000 + i);
+    samples += trace;
+    sizes.push_back(trace.size());
+  }
+  std::string dictionary(kDictionarySize, '\0');
+  auto size = ZDICT_trainFromBuffer(
+      &dictionary[0],
+      dictionary.size(),
+      samples.data(),
+      sizes.data(),
+      sizes.size());
+  if (ZDICT_isError(size)) {
+    throw std::runtime_error(ZDICT_getErrorName(size));
+  }
+  dictionary.resize(size);
+  return dictionary;
+}
+
+void report(
+    const std::string& name,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::shared_ptr<TraceCompressor>>& compressors) {
+  for (auto const& compressor : compressors) {
+    auto result = compress(*compressor, inputs);
+    std::cout << name << '\t' << compressor->description() << '\t'
+              << result.input_bytes << '\t' << result.output_bytes << '\t'
+              << static_cast<double>(result.input_bytes) / result.output_bytes
+              << '\t' << result.input_bytes / result.seconds / (1 << 20)
+              << '\n';
+  }
+}
+
+} // namespace
+
+//
+// Usage: trace_compression_perf [dictionary]
+// Without a dictionary file, one is trained on generated small traces.
+//
+int main(int argc, char** argv) {
+  char folder[] = "/tmp/trace_compression_perf.XXXXXX";
+  if (mkdtemp(folder) == nullptr) {
+    std::cerr << "Could not create a trace folder\n";
+    return 1;
+  }
+
+  auto dictionary = argc > 1
+      ? ZstdCompressor::fromDictionaryFile(argv[1])
+      : std::make_shared<ZstdCompressor>(
+            ZstdCompressor::kDefaultLevel, trainDictionary(folder));
+  std::vector<std::shared_ptr<TraceCompressor>> compressors{
+      std::make_shared<ZlibCompressor>(),
+      std::make_shared<ZstdCompressor>(1),
+      std::make_shared<ZstdCompressor>(3),
+      std::make_shared<ZstdCompressor>(9),
+      dictionary,
+  };
+
+  std::vector<std::string> small;
+  for (int i = 0; i < kSmallTraces; i++) {
+    small.push_back(makeTrace(folder, kSmallEntries, 0, i));
+  }
+
+  std::cout << "trace\tcompressor\tbytes\tcompressed\tratio\tMB/s\n";
+  report("text", {makeTrace(folder, kLargeEntries, 0, 0)}, compressors);
+  auto binary = TraceFileHelpers::kBinaryOutputFlag;
+  report("binary", {makeTrace(folder, kLargeEntries, binary, 0)}, compressors);
+  report("small text", small, compressors);
+  rmdir(folder);
+  return 0;
+}
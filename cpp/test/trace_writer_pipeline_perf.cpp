@@ -0,0 +1,231 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <profilo/Logger.h>
+#include <profilo/mmapbuf/Buffer.h>
+#include <profilo/writer/TraceCompressor.h>
+#include <profilo/writer/TraceFileHelpers.h>
+#include <profilo/writer/TraceWriter.h>
+#include <profilo/writer/ZstdCompressor.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::entries;
+using namespace facebook::profilo::writer;
+
+namespace {
+
+constexpr int64_t kTraceID = 1;
+constexpr int kEntries = 300000;
+constexpr int kRuns = 3;
+
+//
+// Fill a buffer with a whole trace: blocks with names, stacks and counters
+// from a handful of threads.
+//
+std::shared_ptr<mmapbuf::Buffer> makeBuffer(
+    int32_t flags,
+    TraceBuffer::Cursor& start) {
+  auto buffer = std::make_shared<mmapbuf::Buffer>(kEntries * 8);
+  auto& logger = buffer->logger();
+  std::mt19937 random(0);
+  int64_t timestamp = 1000000000;
+
+  start = buffer->ringBuffer().currentHead();
+  logger.writeAndGetCursor(
+      StandardEntry{
+          .type = EntryType::TRACE_START,
+          .timestamp = timestamp,
+          .matchid = flags,
+          .extra = kTraceID,
+      },
+      start);
+
+  std::vector<int64_t> frames;
+  for (int i = 0; i < kEntries; i++) {
+    timestamp += random() % 20000;
+    int32_t tid = 1000 + random() % 8;
+    switch (random() % 4) {
+      case 0: {
+        frames.resize(5 + random() % 30);
+        for (size_t j = 0; j < frames.size(); j++) {
+          frames[j] = 0x70000000 + (j * 0x1000) + (random() % 4) * 0x40;
+        }
+        logger.write(FramesEntry{
+            .type = EntryType::STACK_FRAME,
+            .timestamp = timestamp,
+            .tid = tid,
+            .frames = {
+                .values = frames.data(),
+                .size = static_cast<uint16_t>(frames.size())}});
+        break;
+      }
+      case 1: {
+        auto id = logger.write(StandardEntry{
+            .type = EntryType::MARK_PUSH,
+            .timestamp = timestamp,
+            .tid = tid,
+        });
+        auto name = "Choreographer#doFrame " + std::to_string(random() % 50);
+        logger.writeBytes(
+            EntryType::STRING_NAME,
+            id,
+            reinterpret_cast<const uint8_t*>(name.data()),
+            name.size());
+        break;
+      }
+      case 2:
+        logger.write(StandardEntry{
+            .type = EntryType::MARK_POP,
+            .timestamp = timestamp,
+            .tid = tid,
+        });
+        break;
+      default:
+        logger.write(StandardEntry{
+            .type = EntryType::COUNTER,
+            .timestamp = timestamp,
+            .tid = tid,
+            .callid = 9000 + static_cast<int32_t>(random() % 5),
+            .extra = static_cast<int64_t>(random() % 100000),
+        });
+    }
+  }
+  logger.write(StandardEntry{
+      .type = EntryType::TRACE_END,
+      .timestamp = timestamp + 1,
+      .extra = kTraceID,
+  });
+  return buffer;
+}
+
+void removeTraces(const std::string& folder) {
+  auto dir = opendir(folder.c_str());
+  while (auto item = readdir(dir)) {
+    if (item->d_type == DT_REG) {
+      unlink((folder + "/" + item->d_name).c_str());
+    }
+  }
+  closedir(dir);
+}
+
+double cpuSeconds(clockid_t clock) {
+  timespec now{};
+  clock_gettime(clock, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+struct Result {
+  // Packets the reader drains per second.
+  double rate;
+  // The same, if the reader ran alone and the other stages on other CPUs
+  // kept up with it, and if they ran alone. With enough CPUs, a pipelined
+  // writer drains packets at the lower of the two.
+  double reader_rate;
+  double others_rate;
+};
+
+// Best of kRuns.
+Result run(
+    const std::string& folder,
+    std::shared_ptr<mmapbuf::Buffer> buffer,
+    TraceBuffer::Cursor start,
+    std::shared_ptr<TraceCompressor> compressor,
+    bool pipelined) {
+  auto packets = start.distanceTo(buffer->ringBuffer().currentHead());
+  Result best{};
+  for (int i = 0; i < kRuns; i++) {
+    TraceWriter writer(
+        std::string(folder),
+        "perf",
+        buffer,
+        nullptr,
+        std::vector<std::pair<std::string, std::string>>(),
+        nullptr,
+        std::chrono::microseconds::zero(),
+        compressor,
+        pipelined);
+    auto cursor = start;
+    auto begin = std::chrono::steady_clock::now();
+    auto thread_begin = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+    auto process_begin = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+    writer.processTrace(kTraceID, cursor);
+    auto reader = cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - thread_begin;
+    auto others = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - process_begin - reader;
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    removeTraces(folder);
+
+    auto rate = packets / std::chrono::duration<double>(elapsed).count();
+    if (rate > best.rate) {
+      best = Result{
+          .rate = rate,
+          .reader_rate = packets / reader,
+          .others_rate = packets / others,
+      };
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+//
+// Packets per second drained by a serial and a pipelined TraceWriter from a
+// buffer that holds a whole trace. The pipelined reader's own rate, and that
+// of the stages behind it, show what it gets out of spare CPUs.
+//
+int main() {
+  char folder[] = "/tmp/trace_writer_pipeline_perf.XXXXXX";
+  if (mkdtemp(folder) == nullptr) {
+    std::cerr << "Could not create a trace folder\n";
+    return 1;
+  }
+
+  std::vector<std::shared_ptr<TraceCompressor>> compressors{
+      std::make_shared<ZlibCompressor>(),
+      std::make_shared<ZstdCompressor>(1),
+  };
+
+  std::cout << "trace\tcompressor\tserial\tpipelined\treader\tothers\n";
+  for (auto binary : {false, true}) {
+    auto flags = binary ? TraceFileHelpers::kBinaryOutputFlag : 0;
+    TraceBuffer::Cursor start(0);
+    auto buffer = makeBuffer(flags, start);
+    for (auto& compressor : compressors) {
+      auto serial = run(folder, buffer, start, compressor, false);
+      auto pipelined = run(folder, buffer, start, compressor, true);
+      std::cout << (binary ? "binary" : "text") << '\t'
+                << compressor->description() << '\t' << serial.rate << '\t'
+                << pipelined.rate << '\t' << pipelined.reader_rate << '\t'
+                << pipelined.others_rate << '\n';
+    }
+  }
+  rmdir(folder);
+  return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <streambuf>
+#include <vector>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/BinaryEntryVisitor.h>
+#include <profilo/writer/DeltaEncodingVisitor.h>
+#include <profilo/writer/PrintEntryVisitor.h>
+#include <profilo/writer/StackTraceInvertingVisitor.h>
+#include <profilo/writer/StringResolvingVisitor.h>
+#include <profilo/writer/TimestampTruncatingVisitor.h>
+#include <profilo/writer/VisitorChains.h>
+
+using namespace facebook::profilo::entries;
+using namespace facebook::profilo::writer;
+
+namespace {
+
+constexpr int kSamples = 50000;
+constexpr int kThreads = 8;
+constexpr int kRounds = 5;
+
+// Discards its output, so only the visitors are measured.
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override {
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(const char*, std::streamsize n) override {
+    return n;
+  }
+};
+
+//
+// Stack samples of 16 to 80 frames from a handful of threads, with a block
+// entry between them, like a trace of the sampling profiler.
+//
+struct Trace {
+  std::vector<StandardEntry> blocks;
+  std::vector<FramesEntry> samples;
+  std::vector<std::vector<int64_t>> frames;
+
+  Trace() {
+    std::mt19937 random(1);
+    int32_t id = 1;
+    int64_t timestamp = 1000000000;
+    for (int i = 0; i < kSamples; ++i) {
+      timestamp += random() % 100000;
+      int32_t tid = 100 + random() % kThreads;
+      blocks.push_back(StandardEntry{
+          .id = id++,
+          .type = EntryType::MARK_PUSH,
+          .timestamp = timestamp,
+          .tid = tid,
+          .callid = 0,
+          .matchid = 0,
+          .extra = static_cast<int64_t>(random() % 1000)});
+
+      frames.emplace_back(16 + random() % 65);
+      for (auto& frame : frames.back()) {
+        frame = 0x7000000000 + random() % 100000;
+      }
+      samples.push_back(FramesEntry{
+          .id = id,
+          .type = EntryType::STACK_FRAME,
+          .timestamp = timestamp,
+          .tid = tid,
+          .matchid = 0,
+          .frames = {
+              .values = frames.back().data(),
+              .size = static_cast<uint16_t>(frames.back().size())}});
+      id += frames.back().size();
+    }
+  }
+
+  size_t entries() const {
+    return blocks.size() + samples.size();
+  }
+
+  void visit(EntryVisitor& visitor) const {
+    for (size_t i = 0; i < samples.size(); ++i) {
+      visitor.visit(blocks[i]);
+      visitor.visit(samples[i]);
+    }
+  }
+};
+
+//
+// The chain as TraceLifecycleVisitor used to build it for every trace.
+//
+std::deque<std::unique_ptr<EntryVisitor>> dynamicChain(
+    std::ostream& output,
+    bool binary) {
+  std::deque<std::unique_ptr<EntryVisitor>> chain;
+  if (binary) {
+    chain.emplace_back(new BinaryEntryVisitor(output));
+  } else {
+    chain.emplace_back(new PrintEntryVisitor(output));
+    chain.emplace_back(new DeltaEncodingVisitor(*chain.back()));
+  }
+  chain.emplace_back(new TimestampTruncatingVisitor(*chain.back()));
+  chain.emplace_back(new StackTraceInvertingVisitor(*chain.back()));
+  chain.emplace_back(new StringResolvingVisitor(*chain.back()));
+  return chain;
+}
+
+template <class Fn>
+double bestRate(size_t entries, Fn&& fn) {
+  double best = 0;
+  for (int round = 0; round < kRounds; ++round) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::max(best, entries / elapsed.count());
+  }
+  return best;
+}
+
+} // namespace
+
+int main() {
+  Trace trace;
+  NullBuffer null;
+  std::ostream output(&null);
+
+  auto text_dynamic = bestRate(trace.entries(), [&] {
+    auto chain = dynamicChain(output, false);
+    trace.visit(*chain.back());
+  });
+  auto text_fused = bestRate(trace.entries(), [&] {
+    TextVisitorChain chain(output, nullptr);
+    trace.visit(chain);
+  });
+
+  auto binary_dynamic = bestRate(trace.entries(), [&] {
+    auto chain = dynamicChain(output, true);
+    trace.visit(*chain.back());
+  });
+  auto binary_fused = bestRate(trace.entries(), [&] {
+    BinaryVisitorChain chain(output, nullptr);
+    trace.visit(chain);
+  });
+
+  printf("%8s %14s %14s\n", "format", "dynamic/s", "fused/s");
+  printf("%8s %14.0f %14.0f\n", "text", text_dynamic, text_fused);
+  printf("%8s %14.0f %14.0f\n", "binary", binary_dynamic, binary_fused);
+  return 0;
+}
@@ -23,6 +23,9 @@
 #include <time.h>
 #include <algorithm>
 #include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
 #include <sstream>
 #include <system_error>
 
@@ -30,24 +33,205 @@
 #include <sys/syscall.h> // __NR_gettid, __NR_clock_gettime
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc
+#endif
+
 namespace facebook {
 namespace profilo {
 
-#if defined(__linux__) || defined(ANDROID)
 static const int64_t kSecondNanos = 1000000000;
 
-int64_t monotonicTime() {
+static std::atomic<ClockSource> gClockSource{ClockSource::SYSCALL};
+// Guards the calibration, which readers copy while a new one may be
+// published, and the checks between sources and external timestamps.
+static std::mutex gClockMutex;
+static ClockCalibration gClockCalibration{};
+static bool gExternalTimestamps = false;
+
+#if defined(__linux__) || defined(ANDROID)
+static int64_t clockTime(clockid_t clock) {
   timespec ts{};
-  syscall(__NR_clock_gettime, CLOCK_MONOTONIC, &ts);
+  clock_gettime(clock, &ts);
   return static_cast<int64_t>(ts.tv_sec) * kSecondNanos + ts.tv_nsec;
 }
+
+#if defined(__aarch64__)
+#define PROFILO_HAS_COUNTER 1
+
+// No isb before the read. The read can be reordered by a few instructions,
+// which is way below what a trace can resolve.
+static inline int64_t counterTicks() {
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return static_cast<int64_t>(ticks);
+}
+
+static uint64_t counterFrequency() {
+  uint64_t frequency;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+  return frequency;
+}
+#elif defined(__x86_64__) || defined(__i386__)
+#define PROFILO_HAS_COUNTER 1
+
+static inline int64_t counterTicks() {
+  return static_cast<int64_t>(__rdtsc());
+}
+
+// The TSC frequency isn't exposed to userspace, measure it instead.
+static uint64_t counterFrequency() {
+  static constexpr int kCalibrationMicros = 10000;
+  auto start_nanos = clockTime(CLOCK_MONOTONIC);
+  auto start_ticks = counterTicks();
+  usleep(kCalibrationMicros);
+  auto nanos = clockTime(CLOCK_MONOTONIC) - start_nanos;
+  auto ticks = counterTicks() - start_ticks;
+  if (nanos <= 0 || ticks <= 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(ticks) * kSecondNanos / nanos;
+}
+#endif
+
+int64_t monotonicTime() {
+  switch (gClockSource.load(std::memory_order_relaxed)) {
+    case ClockSource::VDSO:
+      return clockTime(CLOCK_MONOTONIC);
+    case ClockSource::COARSE:
+      return clockTime(CLOCK_MONOTONIC_COARSE);
+#ifdef PROFILO_HAS_COUNTER
+    case ClockSource::COUNTER:
+      return counterTicks();
+#endif
+    default: {
+      timespec ts{};
+      syscall(__NR_clock_gettime, CLOCK_MONOTONIC, &ts);
+      return static_cast<int64_t>(ts.tv_sec) * kSecondNanos + ts.tv_nsec;
+    }
+  }
+}
+
+static bool isKnownClockSource(ClockSource source) {
+  switch (source) {
+    case ClockSource::SYSCALL:
+    case ClockSource::VDSO:
+    case ClockSource::COARSE:
+    case ClockSource::COUNTER:
+      return true;
+  }
+  return false;
+}
+
+bool setClockSource(ClockSource source) {
+  if (!isKnownClockSource(source)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(gClockMutex);
+  if (source == ClockSource::COUNTER) {
+#ifdef PROFILO_HAS_COUNTER
+    if (gExternalTimestamps) {
+      return false;
+    }
+    auto frequency = counterFrequency();
+    if (frequency == 0) {
+      return false;
+    }
+    // Pair the counter with the middle of two clock reads around it.
+    auto before = clockTime(CLOCK_MONOTONIC);
+    auto ticks = counterTicks();
+    auto after = clockTime(CLOCK_MONOTONIC);
+    gClockCalibration = ClockCalibration{
+        .tickBase = ticks,
+        .nanosBase = before + (after - before) / 2,
+        .ticksPerSecond = frequency,
+    };
+#else
+    return false;
+#endif
+  }
+  gClockSource.store(source, std::memory_order_release);
+  return true;
+}
 #else
 int64_t monotonicTime() {
   auto now = std::chrono::steady_clock::now().time_since_epoch();
   return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
 }
+
+bool setClockSource(ClockSource source) {
+  // steady_clock is the only clock here.
+  return source == ClockSource::SYSCALL;
+}
 #endif
 
+bool setExternalTimestamps(bool allowed) {
+  std::lock_guard<std::mutex> lock(gClockMutex);
+  if (allowed &&
+      gClockSource.load(std::memory_order_relaxed) == ClockSource::COUNTER) {
+    return false;
+  }
+  gExternalTimestamps = allowed;
+  return true;
+}
+
+ClockSource getClockSource() {
+  return gClockSource.load(std::memory_order_acquire);
+}
+
+const char* getClockSourceName(ClockSource source) {
+  switch (source) {
+    case ClockSource::SYSCALL:
+      return "syscall";
+    case ClockSource::VDSO:
+      return "vdso";
+    case ClockSource::COARSE:
+      return "coarse";
+    case ClockSource::COUNTER:
+      return "counter";
+  }
+  return "unknown";
+}
+
+ClockCalibration getClockCalibration() {
+  std::lock_guard<std::mutex> lock(gClockMutex);
+  return gClockCalibration;
+}
+
+int64_t ClockCalibration::toNanos(int64_t ticks) const {
+  // Split into whole seconds first, so that long traces don't overflow.
+  auto delta = ticks - tickBase;
+  auto frequency = static_cast<int64_t>(ticksPerSecond);
+  return nanosBase + delta / frequency * kSecondNanos +
+      delta % frequency * kSecondNanos / frequency;
+}
+
+std::string ClockCalibration::toString() const {
+  std::stringstream ss;
+  ss << tickBase << ':' << nanosBase << ':' << ticksPerSecond;
+  return ss.str();
+}
+
+bool ClockCalibration::fromString(
+    std::string const& value,
+    ClockCalibration& result) {
+  ClockCalibration parsed{};
+  int consumed = 0;
+  auto fields = sscanf(
+      value.c_str(),
+      "%" SCNd64 ":%" SCNd64 ":%" SCNu64 "%n",
+      &parsed.tickBase,
+      &parsed.nanosBase,
+      &parsed.ticksPerSecond,
+      &consumed);
+  if (fields != 3 || static_cast<size_t>(consumed) != value.size() ||
+      parsed.ticksPerSecond == 0) {
+    return false;
+  }
+  result = parsed;
+  return true;
+}
+
 #ifdef ANDROID
 typedef pid_t (*gettid_t)(pthread_t);
 // Returns any available bionic helper to get the tid from the
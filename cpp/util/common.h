@@ -25,8 +25,58 @@
 namespace facebook {
 namespace profilo {
 
+// Where monotonicTime() reads the time from.
+enum class ClockSource : int32_t {
+  // clock_gettime(CLOCK_MONOTONIC) as a raw syscall.
+  SYSCALL = 0,
+  // clock_gettime(CLOCK_MONOTONIC) through libc, which serves it from the
+  // vDSO without entering the kernel.
+  VDSO = 1,
+  // CLOCK_MONOTONIC_COARSE, also from the vDSO. Only advances once per
+  // jiffy, see cpuClockResolutionMicros().
+  COARSE = 2,
+  // The CPU's counter (cntvct_el0 on arm64, the TSC on x86) in ticks, not
+  // nanoseconds. Traces carry a ClockCalibration in their headers and
+  // TraceWriter converts the timestamps when writing them out. Entries
+  // must then take their timestamps from monotonicTime() only.
+  COUNTER = 3,
+};
+
+// Maps COUNTER ticks to CLOCK_MONOTONIC nanoseconds.
+struct ClockCalibration {
+  int64_t tickBase;
+  int64_t nanosBase;
+  uint64_t ticksPerSecond;
+
+  int64_t toNanos(int64_t ticks) const;
+
+  std::string toString() const;
+  // Returns false if `value` is not the result of toString().
+  static bool fromString(std::string const& value, ClockCalibration& result);
+};
+
+// Time for log entries, in nanoseconds unless the clock source is COUNTER.
 int64_t monotonicTime();
 
+// Returns false and keeps the current source if `source` is not supported
+// on this platform, or is COUNTER while external timestamps are allowed (see
+// setExternalTimestamps()). Switching to COUNTER calibrates it first.
+bool setClockSource(ClockSource source);
+
+// Declares whether entries may carry timestamps not taken from
+// monotonicTime(), such as the ones passed in from Java. Those are
+// CLOCK_MONOTONIC nanoseconds and can't be mixed with COUNTER ticks, so
+// setClockSource() refuses COUNTER while they're allowed. Returns false if
+// COUNTER is already the source.
+bool setExternalTimestamps(bool allowed);
+
+ClockSource getClockSource();
+
+const char* getClockSourceName(ClockSource source);
+
+// Only meaningful while the clock source is COUNTER.
+ClockCalibration getClockCalibration();
+
 int32_t threadID();
 
 // Returns 0 if value was not found, and 1 if value <= 1, actual value otherwise
@@ -0,0 +1,218 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/BinaryEntryVisitor.h>
+
+#include <cstring>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+static_assert(
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+    "Frames are written out as little-endian int64s");
+
+namespace {
+
+uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+      static_cast<uint64_t>(value >> 63);
+}
+
+bool endsTrace(EntryType type) {
+  return type == EntryType::TRACE_END || type == EntryType::TRACE_ABORT ||
+      type == EntryType::TRACE_TIMEOUT;
+}
+
+} // namespace
+
+constexpr size_t BinaryEntryVisitor::kBlockRows;
+
+void BinaryEntryVisitor::Column::add(uint64_t value) {
+  while (value >= 0x80) {
+    bytes.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  bytes.push_back(static_cast<uint8_t>(value));
+}
+
+void BinaryEntryVisitor::Column::addDelta(int64_t value) {
+  add(zigzag(static_cast<int64_t>(
+      static_cast<uint64_t>(value) - static_cast<uint64_t>(last))));
+  last = value;
+}
+
+BinaryEntryVisitor::BinaryEntryVisitor(std::ostream& stream, size_t block_rows)
+    : stream_(stream),
+      block_rows_(block_rows),
+      kinds_(),
+      standard_(),
+      frames_(),
+      bytes_(),
+      annotations_(),
+      types_(),
+      new_type_count_(0),
+      new_types_(),
+      strings_(),
+      new_string_count_(0),
+      new_strings_() {}
+
+void BinaryEntryVisitor::visit(const StandardEntry& data) {
+  standard_.id.addDelta(data.id);
+  addType(standard_.type, data.type);
+  standard_.timestamp.addDelta(data.timestamp);
+  standard_.tid.addDelta(data.tid);
+  standard_.callid.addDelta(data.callid);
+  standard_.matchid.addDelta(data.matchid);
+  standard_.extra.addDelta(data.extra);
+  addRow(STANDARD);
+
+  if (endsTrace(data.type)) {
+    flush();
+  }
+}
+
+void BinaryEntryVisitor::visit(const FramesEntry& data) {
+  frames_.id.addDelta(data.id);
+  addType(frames_.type, data.type);
+  frames_.timestamp.addDelta(data.timestamp);
+  frames_.tid.addDelta(data.tid);
+  frames_.matchid.addDelta(data.matchid);
+  frames_.count.add(data.frames.size);
+  auto values = reinterpret_cast<const uint8_t*>(data.frames.values);
+  frames_.frames.bytes.insert(
+      frames_.frames.bytes.end(),
+      values,
+      values + data.frames.size * sizeof(int64_t));
+  addRow(FRAMES);
+}
+
+void BinaryEntryVisitor::visit(const BytesEntry& data) {
+  bytes_.id.addDelta(data.id);
+  addType(bytes_.type, data.type);
+  bytes_.matchid.addDelta(data.matchid);
+
+  auto values = reinterpret_cast<const char*>(data.bytes.values);
+  auto string =
+      strings_.emplace(std::string(values, data.bytes.size), strings_.size());
+  if (string.second) {
+    new_strings_.add(data.bytes.size);
+    new_strings_.bytes.insert(
+        new_strings_.bytes.end(),
+        data.bytes.values,
+        data.bytes.values + data.bytes.size);
+    ++new_string_count_;
+  }
+  bytes_.string.add(string.first->second);
+  addRow(BYTES);
+}
+
+void BinaryEntryVisitor::visit(const AnnotationEntry& data) {
+  annotations_.id.addDelta(data.id);
+  addType(annotations_.type, data.type);
+  annotations_.timestamp.addDelta(data.timestamp);
+  annotations_.tid.addDelta(data.tid);
+  annotations_.matchid.addDelta(data.matchid);
+  annotations_.size.add(data.pairs.size);
+  annotations_.pairs.bytes.insert(
+      annotations_.pairs.bytes.end(),
+      data.pairs.values,
+      data.pairs.values + data.pairs.size);
+  addRow(ANNOTATION);
+}
+
+void BinaryEntryVisitor::flush() {
+  if (kinds_.empty()) {
+    return;
+  }
+
+  Column count{};
+  count.add(kinds_.size());
+  count.add(new_type_count_);
+  writeColumn(count);
+  writeColumn(new_types_);
+  new_type_count_ = 0;
+
+  count.add(new_string_count_);
+  writeColumn(count);
+  writeColumn(new_strings_);
+  new_string_count_ = 0;
+
+  stream_.write(reinterpret_cast<const char*>(kinds_.data()), kinds_.size());
+  kinds_.clear();
+
+  for (auto column :
+       {&standard_.id,
+        &standard_.type,
+        &standard_.timestamp,
+        &standard_.tid,
+        &standard_.callid,
+        &standard_.matchid,
+        &standard_.extra,
+        &frames_.id,
+        &frames_.type,
+        &frames_.timestamp,
+        &frames_.tid,
+        &frames_.matchid,
+        &frames_.count,
+        &frames_.frames,
+        &bytes_.id,
+        &bytes_.type,
+        &bytes_.matchid,
+        &bytes_.string,
+        &annotations_.id,
+        &annotations_.type,
+        &annotations_.timestamp,
+        &annotations_.tid,
+        &annotations_.matchid,
+        &annotations_.size,
+        &annotations_.pairs}) {
+    writeColumn(*column);
+  }
+}
+
+void BinaryEntryVisitor::addType(Column& column, EntryType type) {
+  auto value = static_cast<uint8_t>(type);
+  if (!types_.test(value)) {
+    auto name = to_string(type);
+    auto size = std::strlen(name);
+    new_types_.add(value);
+    new_types_.add(size);
+    new_types_.bytes.insert(new_types_.bytes.end(), name, name + size);
+    ++new_type_count_;
+    types_.set(value);
+  }
+  column.add(value);
+}
+
+void BinaryEntryVisitor::addRow(Kind kind) {
+  kinds_.push_back(kind);
+  if (kinds_.size() >= block_rows_) {
+    flush();
+  }
+}
+
+void BinaryEntryVisitor::writeColumn(Column& column) {
+  stream_.write(
+      reinterpret_cast<const char*>(column.bytes.data()), column.bytes.size());
+  column.bytes.clear();
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
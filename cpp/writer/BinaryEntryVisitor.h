@@ -0,0 +1,139 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <profilo/entries/EntryParser.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace entries;
+
+//
+// Writes entries in a binary, column oriented format. Stands in for
+// PrintEntryVisitor and DeltaEncodingVisitor in traces started with
+// TraceFileHelpers::kBinaryOutputFlag.
+//
+// Rows are buffered and written out in blocks of up to `block_rows`. A block
+// is, with every integer a varint unless noted otherwise:
+//
+//   rows
+//   new type count, then (type, name size, name) for each entry type first
+//     seen in this block
+//   new string count, then (size, bytes) for each string first seen in this
+//     block; strings are numbered from 0 in the order they're defined
+//   kind of each row as a byte: 0 standard, 1 frames, 2 bytes, 3 annotation
+//   standard columns: id, type, timestamp, tid, callid, matchid, extra
+//   frames columns: id, type, timestamp, tid, matchid, frame count, then all
+//     frames as raw little-endian int64s, top first
+//   bytes columns: id, type, matchid, string number
+//   annotation columns: id, type, timestamp, tid, matchid, pairs size, then
+//     all pairs as packed by KeyValue::pack()
+//
+// Each column only holds values of its own entry kind. Type, frame count,
+// string number and pairs size columns are plain varints, all others are
+// zigzag varints of the difference to the previous value in the column
+// (0 before the first one), carried over from block to block.
+//
+// The last block is written out with a TRACE_END, TRACE_ABORT or
+// TRACE_TIMEOUT entry, rows visited after those are only written out once
+// the block fills up.
+//
+class BinaryEntryVisitor final : public EntryVisitor {
+ public:
+  static constexpr size_t kBlockRows = 4096;
+
+  BinaryEntryVisitor() = delete;
+  BinaryEntryVisitor(const BinaryEntryVisitor&) = delete;
+
+  virtual ~BinaryEntryVisitor() = default;
+
+  explicit BinaryEntryVisitor(
+      std::ostream& stream,
+      size_t block_rows = kBlockRows);
+
+  virtual void visit(const StandardEntry& data) override;
+  virtual void visit(const FramesEntry& data) override;
+  virtual void visit(const BytesEntry& data) override;
+  virtual void visit(const AnnotationEntry& data) override;
+
+  // Write out the buffered rows as a block.
+  void flush();
+
+ private:
+  enum Kind : uint8_t {
+    STANDARD = 0,
+    FRAMES = 1,
+    BYTES = 2,
+    ANNOTATION = 3,
+  };
+
+  struct Column {
+    std::vector<uint8_t> bytes;
+    int64_t last;
+
+    void add(uint64_t value);
+    void addDelta(int64_t value);
+  };
+
+  struct StandardColumns {
+    Column id, type, timestamp, tid, callid, matchid, extra;
+  };
+  struct FramesColumns {
+    Column id, type, timestamp, tid, matchid, count, frames;
+  };
+  struct BytesColumns {
+    Column id, type, matchid, string;
+  };
+  struct AnnotationColumns {
+    Column id, type, timestamp, tid, matchid, size, pairs;
+  };
+
+  std::ostream& stream_;
+  const size_t block_rows_;
+
+  std::vector<uint8_t> kinds_;
+  StandardColumns standard_;
+  FramesColumns frames_;
+  BytesColumns bytes_;
+  AnnotationColumns annotations_;
+
+  std::bitset<256> types_;
+  uint32_t new_type_count_;
+  Column new_types_;
+  std::unordered_map<std::string, uint32_t> strings_;
+  uint32_t new_string_count_;
+  Column new_strings_;
+
+  void addType(Column& column, EntryType type);
+  void addRow(Kind kind);
+  // Write out the bytes of `column` and clear them.
+  void writeColumn(Column& column);
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,153 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/BlockPipeline.h>
+
+#include <stdexcept>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+BlockPipeline::BlockPipeline(
+    Consumer consumer,
+    size_t block_size,
+    size_t block_count)
+    : consumer_(std::move(consumer)),
+      block_size_(block_size),
+      blocks_(),
+      mutex_(),
+      full_cv_(),
+      free_cv_(),
+      full_(),
+      free_(),
+      stopping_(false),
+      error_(nullptr),
+      current_(nullptr),
+      thread_() {
+  if (block_count < 2) {
+    throw std::invalid_argument("Need at least two blocks to pipeline");
+  }
+  blocks_.reserve(block_count);
+  for (size_t i = 0; i < block_count; ++i) {
+    blocks_.push_back(Block{
+        .data = std::unique_ptr<char[]>(new char[block_size]),
+        .size = 0,
+    });
+    free_.push_back(&blocks_.back());
+  }
+  current_ = free_.front();
+  free_.pop_front();
+  thread_ = std::thread([this] { run(); });
+}
+
+BlockPipeline::~BlockPipeline() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (current_->size > 0) {
+      full_.push_back(current_);
+    }
+    stopping_ = true;
+  }
+  full_cv_.notify_one();
+  thread_.join();
+}
+
+char* BlockPipeline::reserve(size_t size) {
+  if (size > block_size_) {
+    throw std::invalid_argument("Larger than a block");
+  }
+  if (current_->size + size > block_size_) {
+    flush();
+  }
+  auto start = current_->data.get() + current_->size;
+  current_->size += size;
+  return start;
+}
+
+void BlockPipeline::flush() {
+  if (current_->size == 0) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  swapBlock(lock);
+}
+
+void BlockPipeline::drain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (current_->size > 0) {
+    swapBlock(lock);
+  }
+  // All blocks but the current one are back once the consumer is idle.
+  free_cv_.wait(lock, [this] { return free_.size() == blocks_.size() - 1; });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+void BlockPipeline::swapBlock(std::unique_lock<std::mutex>& lock) {
+  full_.push_back(current_);
+  current_ = nullptr;
+  full_cv_.notify_one();
+
+  free_cv_.wait(lock, [this] { return !free_.empty(); });
+  current_ = free_.front();
+  free_.pop_front();
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+void BlockPipeline::run() {
+  while (true) {
+    Block* block = nullptr;
+    bool failed = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      full_cv_.wait(lock, [this] { return !full_.empty() || stopping_; });
+      if (full_.empty()) {
+        return;
+      }
+      block = full_.front();
+      full_.pop_front();
+      failed = error_ != nullptr;
+    }
+
+    std::exception_ptr error = nullptr;
+    if (!failed) {
+      try {
+        consumer_(block->data.get(), block->size);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    block->size = 0;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (error) {
+        error_ = error;
+      }
+      free_.push_back(block);
+    }
+    free_cv_.notify_one();
+  }
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,103 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Hands blocks of bytes from the thread writing them to a consumer running
+// on a thread of its own, so that filling block N+1 overlaps with consuming
+// block N.
+//
+// Blocks cycle through two bounded single-producer, single-consumer queues:
+// full ones to the consumer and consumed ones back. Once all `block_count`
+// blocks are in flight, the producer waits for the consumer.
+//
+// An exception thrown by the consumer is rethrown to the producer by
+// drain() and every later hand-over of a block. Blocks handed over after it
+// are dropped.
+//
+class BlockPipeline {
+ public:
+  using Consumer = std::function<void(const char* data, size_t size)>;
+
+  BlockPipeline(Consumer consumer, size_t block_size, size_t block_count);
+  // Consumes the blocks written so far and stops the thread. Errors are
+  // ignored.
+  ~BlockPipeline();
+
+  BlockPipeline(const BlockPipeline&) = delete;
+  BlockPipeline& operator=(const BlockPipeline&) = delete;
+
+  //
+  // Space for `size` bytes, at most the block size, at the end of the
+  // current block. Hands the block over first if they don't fit, so the
+  // space is never split across blocks.
+  //
+  char* reserve(size_t size);
+
+  // Hand the current block over to the consumer, if it has anything.
+  void flush();
+
+  // flush() and wait until the consumer is done with everything.
+  void drain();
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  const Consumer consumer_;
+  const size_t block_size_;
+  std::vector<Block> blocks_;
+
+  std::mutex mutex_;
+  std::condition_variable full_cv_;
+  std::condition_variable free_cv_;
+  std::deque<Block*> full_;
+  std::deque<Block*> free_;
+  bool stopping_;
+  std::exception_ptr error_;
+
+  // Only touched by the producer.
+  Block* current_;
+
+  std::thread thread_;
+
+  // Hand over the current block and take a free one, or rethrow the
+  // consumer's error.
+  void swapBlock(std::unique_lock<std::mutex>& lock);
+  void run();
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
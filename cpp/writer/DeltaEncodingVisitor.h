@@ -24,16 +24,93 @@ namespace writer {
 
 using namespace entries;
 
-class DeltaEncodingVisitor : public EntryVisitor {
+template <class Delegate>
+class BasicDeltaEncodingVisitor final : public EntryVisitor {
  public:
-  explicit DeltaEncodingVisitor(EntryVisitor& delegate);
+  explicit BasicDeltaEncodingVisitor(Delegate& delegate)
+      : delegate_(delegate), last_values_() {}
 
-  virtual void visit(const StandardEntry& entry) override;
-  virtual void visit(const FramesEntry& entry) override;
-  virtual void visit(const BytesEntry& entry) override;
+  virtual void visit(const StandardEntry& entry) override {
+    StandardEntry encoded{
+        .id = entry.id - last_values_.id,
+        .type = entry.type,
+        .timestamp = entry.timestamp - last_values_.timestamp,
+        .tid = entry.tid - last_values_.tid,
+        .callid = entry.callid - last_values_.callid,
+        .matchid = entry.matchid - last_values_.matchid,
+        .extra = entry.extra - last_values_.extra,
+    };
+
+    last_values_ = {
+        .id = entry.id,
+        .timestamp = entry.timestamp,
+        .tid = entry.tid,
+        .callid = entry.callid,
+        .matchid = entry.matchid,
+        .extra = entry.extra,
+    };
+
+    delegate_.visit(encoded);
+  }
+
+  virtual void visit(const FramesEntry& entry) override {
+    for (int32_t idx = 0; idx < entry.frames.size; ++idx) {
+      int64_t current_frame = entry.frames.values[idx];
+
+      int64_t frames[1] = {current_frame - last_values_.extra};
+
+      FramesEntry encoded{
+          .id = entry.id - last_values_.id + idx,
+          .type = entry.type,
+          .timestamp = entry.timestamp - last_values_.timestamp,
+          .tid = entry.tid - last_values_.tid,
+          .matchid = entry.matchid - last_values_.matchid,
+          .frames = {.values = frames, .size = 1}};
+
+      last_values_ = {
+          .id = entry.id + idx,
+          .timestamp = entry.timestamp,
+          .tid = entry.tid,
+
+          // FramesEntries don't use callid, it's okay
+          // to preserve it to whatever they were before this entry.
+          .callid = last_values_.callid,
+          .matchid = entry.matchid,
+
+          .extra = current_frame,
+      };
+      delegate_.visit(encoded);
+    }
+  }
+
+  virtual void visit(const BytesEntry& entry) override {
+    // BytesEntry is not delta-encoded
+    delegate_.visit(entry);
+  }
+
+  virtual void visit(const AnnotationEntry& entry) override {
+    // The pairs are not delta-encoded
+    AnnotationEntry encoded = entry;
+    encoded.id = entry.id - last_values_.id;
+    encoded.timestamp = entry.timestamp - last_values_.timestamp;
+    encoded.tid = entry.tid - last_values_.tid;
+    encoded.matchid = entry.matchid - last_values_.matchid;
+
+    last_values_ = {
+        .id = entry.id,
+        .timestamp = entry.timestamp,
+        .tid = entry.tid,
+        // AnnotationEntries don't have callid and extra, keep them.
+        .callid = last_values_.callid,
+        .matchid = entry.matchid,
+        .extra = last_values_.extra,
+    };
+
+    delegate_.visit(encoded);
+  }
 
  private:
-  EntryVisitor& delegate_;
+  Delegate& delegate_;
 
   struct {
     int32_t id;
@@ -45,6 +122,10 @@ class DeltaEncodingVisitor : public EntryVisitor {
   } last_values_;
 };
 
+using DeltaEncodingVisitor = BasicDeltaEncodingVisitor<EntryVisitor>;
+
+extern template class BasicDeltaEncodingVisitor<EntryVisitor>;
+
 } // namespace writer
 } // namespace profilo
 } // namespace facebook
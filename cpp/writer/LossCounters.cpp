@@ -0,0 +1,93 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "LossCounters.h"
+
+#include <utility>
+
+#include <profilo/LogEntry.h>
+#include <profilo/Logger.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+void LossCounters::addRing(TraceBuffer& ring, TraceBuffer::Cursor start) {
+  rings_.push_back(Ring{
+      .ring = &ring,
+      .start = start,
+      .end = start,
+      .ended = false,
+  });
+}
+
+void LossCounters::endRing(const TraceBuffer& ring, TraceBuffer::Cursor end) {
+  for (auto& counted : rings_) {
+    if (counted.ring == &ring) {
+      counted.end = end;
+      counted.ended = true;
+    }
+  }
+}
+
+void LossCounters::addReassembler(const PacketReassembler& reassembler) {
+  reassemblers_.push_back(&reassembler);
+}
+
+uint64_t LossCounters::written() const {
+  uint64_t count = 0;
+  for (auto& ring : rings_) {
+    // Producers keep writing after TRACE_END, don't count that.
+    auto end = ring.ended ? ring.end : ring.ring->currentHead();
+    count += ring.start.distanceTo(end);
+  }
+  return count;
+}
+
+uint64_t LossCounters::droppedStreams() const {
+  // Streams that are still incomplete when the trace ends won't make it in
+  // either.
+  uint64_t count = 0;
+  for (auto reassembler : reassemblers_) {
+    count += reassembler->droppedStreams() + reassembler->activeStreams();
+  }
+  return count;
+}
+
+void LossCounters::write(
+    entries::EntryVisitor& visitor,
+    const entries::StandardEntry& trace_end) const {
+  const std::pair<int32_t, uint64_t> counters[] = {
+      {QuickLogConstants::TRACE_BUFFER_PACKETS_WRITTEN, written()},
+      {QuickLogConstants::TRACE_BUFFER_PACKETS_OVERWRITTEN, overwritten()},
+      {QuickLogConstants::TRACE_BUFFER_TORN_READS, tornReads()},
+      {QuickLogConstants::TRACE_BUFFER_STREAMS_DROPPED, droppedStreams()},
+  };
+  for (auto& counter : counters) {
+    visitor.visit(StandardEntry{
+        .id = Logger::getGlobalEntryID().next(),
+        .type = EntryType::TRACE_ANNOTATION,
+        .timestamp = trace_end.timestamp,
+        .tid = trace_end.tid,
+        .callid = counter.first,
+        .matchid = 0,
+        .extra = static_cast<int64_t>(counter.second),
+    });
+  }
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,104 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <profilo/entries/Entry.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/logger/buffer/TraceBuffer.h>
+#include <profilo/writer/PacketReassembler.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Tracks how much of a trace was lost between the loggers and the reader,
+// so that buffer sizes can be chosen from data:
+//
+//  - packets written to the rings between the trace start and TRACE_END,
+//  - packets the reader skipped because they had been overwritten,
+//  - reads that failed because the slot was overwritten mid-copy,
+//  - multi-packet entries that couldn't be reassembled.
+//
+// write() emits them as TRACE_ANNOTATION entries.
+//
+class LossCounters {
+ public:
+  //
+  // Count writes to `ring` from `start` on.
+  //
+  void addRing(TraceBuffer& ring, TraceBuffer::Cursor start);
+
+  //
+  // Count writes to `ring` only up to, not including, `end`: where the
+  // reader was when it got to TRACE_END. Until then, written() counts up to
+  // the current head.
+  //
+  void endRing(const TraceBuffer& ring, TraceBuffer::Cursor end);
+
+  //
+  // Count the streams `reassembler` drops. It must outlive this object.
+  //
+  void addReassembler(const PacketReassembler& reassembler);
+
+  void addOverwritten(uint64_t count) {
+    overwritten_ += count;
+  }
+
+  uint64_t written() const;
+  uint64_t overwritten() const {
+    return overwritten_;
+  }
+  uint64_t tornReads() const {
+    return torn_reads_;
+  }
+  uint64_t droppedStreams() const;
+
+  //
+  // For the TraceBuffer read functions to count torn reads into.
+  //
+  uint64_t* tornReadCounter() {
+    return &torn_reads_;
+  }
+
+  //
+  // Write the counters to `visitor`, with the timestamp and thread of
+  // `trace_end`.
+  //
+  void write(
+      entries::EntryVisitor& visitor,
+      const entries::StandardEntry& trace_end) const;
+
+ private:
+  struct Ring {
+    TraceBuffer* ring;
+    TraceBuffer::Cursor start;
+    TraceBuffer::Cursor end;
+    bool ended;
+  };
+
+  std::vector<Ring> rings_;
+  std::vector<const PacketReassembler*> reassemblers_;
+  uint64_t overwritten_ = 0;
+  uint64_t torn_reads_ = 0;
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
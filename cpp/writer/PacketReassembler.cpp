@@ -17,6 +17,7 @@
 #include "PacketReassembler.h"
 
 #include <algorithm>
+#include <cstring>
 
 namespace facebook {
 namespace profilo {
@@ -24,140 +25,224 @@ namespace writer {
 
 using detail::PacketStream;
 
+constexpr size_t PacketReassembler::kMaxSlabFrames;
+constexpr size_t PacketReassembler::kEntryHeaderSize;
+constexpr size_t PacketReassembler::kSlabBufferSize;
+constexpr size_t PacketReassembler::kSlabBuffers;
+constexpr size_t PacketReassembler::kInitialTableSize;
+constexpr size_t PacketReassembler::kSpillPoolSize;
+constexpr int32_t PacketStream::kNoSlab;
+
 PacketReassembler::PacketReassembler(
     PacketReassembler::PayloadCallback callback)
-    : active_streams_(),
-      pooled_streams_(kStreamPoolSize),
-      callback_(std::move(callback)) {}
-
-namespace {
+    : streams_(kInitialTableSize),
+      active_streams_(0),
+      slab_(new char[kSlabBuffers * kSlabBufferSize]),
+      free_slabs_(),
+      spill_pool_(),
+      callback_(std::move(callback)),
+      dropped_streams_(0) {
+  free_slabs_.reserve(kSlabBuffers);
+  for (int32_t i = kSlabBuffers - 1; i >= 0; --i) {
+    free_slabs_.push_back(i);
+  }
+}
 
-inline void appendToStream(PacketStream& stream, Packet const& packet) {
-  auto prev_size = stream.data.size();
-  auto next_size = prev_size + packet.size;
-  stream.data.resize(next_size);
+size_t PacketReassembler::home(StreamID stream) const {
+  // Stream IDs are handed out sequentially, Fibonacci hashing spreads them
+  // over the table.
+  return (static_cast<uint32_t>(stream) * 2654435769u) &
+      (streams_.size() - 1);
+}
 
-  char* data = static_cast<char*>(stream.data.data());
-  std::memcpy(data + prev_size, packet.data, packet.size);
+PacketStream* PacketReassembler::findStream(StreamID stream) {
+  auto mask = streams_.size() - 1;
+  for (auto i = home(stream);; i = (i + 1) & mask) {
+    auto& slot = streams_[i];
+    if (!slot.active) {
+      return nullptr;
+    }
+    if (slot.stream == stream) {
+      return &slot;
+    }
+  }
 }
 
-inline void appendToStreamReverse(PacketStream& stream, Packet const& packet) {
-  auto prev_size = stream.data.size();
-  auto next_size = prev_size + packet.size;
-  stream.data.resize(next_size);
+PacketStream& PacketReassembler::startStream(StreamID stream) {
+  if (2 * (active_streams_ + 1) > streams_.size()) {
+    grow();
+  }
+  auto mask = streams_.size() - 1;
+  auto i = home(stream);
+  while (streams_[i].active) {
+    i = (i + 1) & mask;
+  }
 
-  char* data = static_cast<char*>(stream.data.data());
-  std::memcpy(data + prev_size, packet.data, packet.size);
-  std::reverse(data + prev_size, data + prev_size + packet.size);
+  auto& slot = streams_[i];
+  slot.stream = stream;
+  slot.active = true;
+  slot.size = 0;
+  if (!free_slabs_.empty()) {
+    slot.slab = free_slabs_.back();
+    free_slabs_.pop_back();
+  } else if (!spill_pool_.empty()) {
+    slot.spill = std::move(spill_pool_.back());
+    spill_pool_.pop_back();
+  }
+  ++active_streams_;
+  return slot;
 }
 
-} // anonymous namespace
+char* PacketReassembler::streamData(PacketStream& stream) {
+  if (stream.slab != PacketStream::kNoSlab) {
+    return slab_.get() + stream.slab * kSlabBufferSize;
+  }
+  return stream.spill.data();
+}
+
+char* PacketReassembler::append(PacketStream& stream, size_t size) {
+  auto prev_size = stream.size;
+  auto next_size = prev_size + size;
+  if (stream.slab != PacketStream::kNoSlab && next_size > kSlabBufferSize) {
+    // Outgrew the slab buffer, move to the heap.
+    if (stream.spill.empty() && !spill_pool_.empty()) {
+      stream.spill = std::move(spill_pool_.back());
+      spill_pool_.pop_back();
+    }
+    stream.spill.resize(next_size);
+    std::memcpy(stream.spill.data(), streamData(stream), prev_size);
+    free_slabs_.push_back(stream.slab);
+    stream.slab = PacketStream::kNoSlab;
+  } else if (stream.slab == PacketStream::kNoSlab) {
+    stream.spill.resize(next_size);
+  }
+  stream.size = next_size;
+  return streamData(stream) + prev_size;
+}
 
-PacketStream PacketReassembler::newStream() {
-  if (!pooled_streams_.empty()) {
-    // Take a pooled stream and remove the moved-from instance.
-    PacketStream stream = std::move(*pooled_streams_.begin());
-    pooled_streams_.pop_front();
-    return stream;
-  } else {
-    // No pooled stream to use, make a new one.
-    return PacketStream{};
+void PacketReassembler::finishStream(PacketStream& stream, bool reverse) {
+  char* data = streamData(stream);
+  if (reverse) {
+    std::reverse(data, data + stream.size);
   }
+  callback_(data, stream.size);
+  eraseStream(stream);
 }
 
-void PacketReassembler::recycleStream(PacketStream stream) {
-  // Return to pool, if necessary. Otherwise, release via RAII.
-  if (pooled_streams_.size() < kStreamPoolSize) {
+void PacketReassembler::eraseStream(PacketStream& stream) {
+  if (stream.slab != PacketStream::kNoSlab) {
+    free_slabs_.push_back(stream.slab);
+    stream.slab = PacketStream::kNoSlab;
+  }
+  if (stream.spill.capacity() > 0 && spill_pool_.size() < kSpillPoolSize) {
     // Changes the `size` to 0 but the `capacity` will not be affected.
-    stream.data.resize(0);
-    pooled_streams_.push_back(std::move(stream));
+    stream.spill.resize(0);
+    spill_pool_.push_back(std::move(stream.spill));
+  }
+  stream.spill = std::vector<char>();
+  stream.active = false;
+  --active_streams_;
+
+  // Backward-shift deletion: move later entries of the probe sequence into
+  // the hole, so lookups never need tombstones.
+  auto mask = streams_.size() - 1;
+  auto hole = static_cast<size_t>(&stream - streams_.data());
+  for (auto i = (hole + 1) & mask; streams_[i].active; i = (i + 1) & mask) {
+    auto want = home(streams_[i].stream);
+    // Can streams_[i] move to `hole`, i.e. is `hole` cyclically within
+    // [want, i)?
+    if (((i - want) & mask) >= ((i - hole) & mask)) {
+      streams_[hole] = std::move(streams_[i]);
+      streams_[i] = PacketStream();
+      hole = i;
+    }
+  }
+}
+
+void PacketReassembler::grow() {
+  std::vector<PacketStream> old(streams_.size() * 2);
+  std::swap(old, streams_);
+  auto mask = streams_.size() - 1;
+  for (auto& stream : old) {
+    if (!stream.active) {
+      continue;
+    }
+    auto i = home(stream.stream);
+    while (streams_[i].active) {
+      i = (i + 1) & mask;
+    }
+    streams_[i] = std::move(stream);
   }
 }
 
 void PacketReassembler::process(Packet const& packet) {
   //
-  // Collect packets into active_streams_, inside PacketStream objects.
+  // Collect packets into streams_, keyed by stream ID.
   //
-  // Last packet within the stream flushes to the callback.
-  // The PacketStream object can then be moved to pooled_stream_ for reuse.
+  // Last packet within the stream flushes to the callback and frees the
+  // stream's buffer for reuse.
   //
 
-  // Is this part of an existing stream?
-  if (active_streams_.size() > 0) {
-    for (auto it = active_streams_.begin(), end = active_streams_.end();
-         it != end;
-         ++it) {
-      auto& stream = *it;
-
-      if (stream.stream == packet.stream) {
-        appendToStream(stream, packet);
-
-        if (!packet.next) {
-          // Flush the stream
-          callback_(stream.data.data(), stream.data.size());
-
-          PacketStream temp_stream = std::move(*it);
-          active_streams_.erase(it); // remove moved-from instance
+  // Single-packet streams don't carry a meaningful stream ID and are
+  // complete as-is; hand them over without copying.
+  if (packet.start && !packet.next) {
+    callback_(packet.data, packet.size);
+    return;
+  }
 
-          recycleStream(std::move(temp_stream));
-        }
-        return; // packet is handled
+  // Is this part of an existing stream?
+  auto stream = active_streams_ > 0 ? findStream(packet.stream) : nullptr;
+  if (stream == nullptr) {
+    if (!packet.start) {
+      // Ignore if we only started from the middle of the stream. Count the
+      // stream once, at its last packet.
+      if (!packet.next) {
+        ++dropped_streams_;
       }
+      return;
     }
+    stream = &startStream(packet.stream);
   }
 
-  if (packet.start && !packet.next) {
-    callback_(packet.data, packet.size);
-  } else if (packet.start) { // Ignore if we only started from the middle of the
-                             // packet
-    PacketStream stream = newStream();
-    stream.stream = packet.stream;
-    appendToStream(stream, packet);
-    active_streams_.push_front(std::move(stream));
+  std::memcpy(append(*stream, packet.size), packet.data, packet.size);
+  if (!packet.next) {
+    finishStream(*stream, false);
   }
 }
 
 void PacketReassembler::processBackwards(Packet const& packet) {
   //
-  // Collect packets into active_streams_, inside PacketStream objects.
-  //
-  // Last packet within the stream flushes to the callback.
-  // The PacketStream object can then be moved to pooled_stream_ for reuse.
+  // Collect packets into streams_, keyed by stream ID. Packets arrive last
+  // to first, so each one is appended reversed and the whole payload is
+  // reversed back once complete.
   //
 
+  // Single-packet streams don't carry a meaningful stream ID and are
+  // complete as-is; hand them over without copying.
+  if (packet.start && !packet.next) {
+    callback_(packet.data, packet.size);
+    return;
+  }
+
   // Is this part of an existing stream?
-  if (active_streams_.size() > 0) {
-    for (auto it = active_streams_.begin(), end = active_streams_.end();
-         it != end;
-         ++it) {
-      auto& stream = *it;
-
-      if (stream.stream == packet.stream) {
-        appendToStreamReverse(stream, packet);
-
-        if (packet.start) {
-          // Flush the stream
-          std::reverse(stream.data.begin(), stream.data.end());
-          callback_(stream.data.data(), stream.data.size());
-
-          PacketStream temp_stream = std::move(*it);
-          active_streams_.erase(it); // remove moved-from instance
-
-          recycleStream(std::move(temp_stream));
-        }
-        return; // packet is handled
+  auto stream = active_streams_ > 0 ? findStream(packet.stream) : nullptr;
+  if (stream == nullptr) {
+    if (packet.next) {
+      // Ignore if we only started from the middle of the stream. Count the
+      // stream once, at its first packet.
+      if (packet.start) {
+        ++dropped_streams_;
       }
+      return;
     }
+    stream = &startStream(packet.stream);
   }
 
-  if (packet.start && !packet.next) {
-    callback_(packet.data, packet.size);
-  } else if (!packet.next) { // Ignore if we only started from the middle of the
-                             // packet
-    PacketStream stream = newStream();
-    stream.stream = packet.stream;
-    appendToStreamReverse(stream, packet);
-    active_streams_.push_front(std::move(stream));
+  char* data = append(*stream, packet.size);
+  std::memcpy(data, packet.data, packet.size);
+  std::reverse(data, data + packet.size);
+  if (packet.start) {
+    finishStream(*stream, true);
   }
 }
 
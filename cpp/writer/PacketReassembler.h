@@ -16,10 +16,12 @@
 
 #pragma once
 
+#include <profilo/Logger.h>
 #include <profilo/logger/buffer/Packet.h>
 
+#include <algorithm>
 #include <functional>
-#include <list>
+#include <memory>
 #include <vector>
 
 namespace facebook {
@@ -30,9 +32,18 @@ using namespace logger;
 namespace writer {
 namespace detail {
 
+//
+// A slot in PacketReassembler's stream table. The payload lives in a slab
+// buffer while it fits, and in `spill` otherwise.
+//
 struct PacketStream {
-  StreamID stream;
-  std::vector<char> data;
+  static constexpr int32_t kNoSlab = -1;
+
+  StreamID stream = 0;
+  bool active = false;
+  int32_t slab = kNoSlab;
+  size_t size = 0;
+  std::vector<char> spill;
 
   PacketStream() = default;
   PacketStream(PacketStream&& other) = default;
@@ -51,16 +62,57 @@ class PacketReassembler {
   void process(Packet const& packet);
   void processBackwards(Packet const& packet);
 
+  //
+  // Number of multi-packet streams dropped because their first packet
+  // (last, when processing backwards) was never seen.
+  //
+  size_t droppedStreams() const {
+    return dropped_streams_;
+  }
+
+  //
+  // Number of streams started but not yet complete.
+  //
+  size_t activeStreams() const {
+    return active_streams_;
+  }
+
+  //
+  // Reassembly buffers are carved out of one slab, sized for the largest
+  // payload the loggers produce: a variable-length entry, or a stack of up
+  // to kMaxSlabFrames frames (MAX_STACK_DEPTH in profiler/Constants.h) plus
+  // the entry's fixed fields. Larger payloads, and streams beyond
+  // kSlabBuffers concurrent ones, spill to the heap.
+  //
+  static constexpr size_t kMaxSlabFrames = 512;
+  static constexpr size_t kEntryHeaderSize = 64;
+  static constexpr size_t kSlabBufferSize =
+      std::max(Logger::kMaxVariableLengthEntry, kMaxSlabFrames * 8) +
+      kEntryHeaderSize;
+  static constexpr size_t kSlabBuffers = 16;
+
  private:
-  static constexpr auto kStreamPoolSize = 8;
+  static constexpr size_t kInitialTableSize = 2 * kSlabBuffers;
+  static constexpr size_t kSpillPoolSize = 8;
 
-  std::list<detail::PacketStream> active_streams_;
-  std::list<detail::PacketStream> pooled_streams_;
+  // Open-addressed by stream ID, with linear probing. Kept at most half
+  // full.
+  std::vector<detail::PacketStream> streams_;
+  size_t active_streams_;
+  std::unique_ptr<char[]> slab_;
+  std::vector<int32_t> free_slabs_;
+  std::vector<std::vector<char>> spill_pool_;
   PayloadCallback callback_;
+  size_t dropped_streams_;
 
-  detail::PacketStream newStream();
-  void startNewStream(Packet& packet);
-  void recycleStream(detail::PacketStream stream);
+  size_t home(StreamID stream) const;
+  detail::PacketStream* findStream(StreamID stream);
+  detail::PacketStream& startStream(StreamID stream);
+  char* streamData(detail::PacketStream& stream);
+  char* append(detail::PacketStream& stream, size_t size);
+  void finishStream(detail::PacketStream& stream, bool reverse);
+  void eraseStream(detail::PacketStream& stream);
+  void grow();
 };
 
 } // namespace writer
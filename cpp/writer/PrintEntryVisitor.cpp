@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <cstring>
+
 #include <fmt/format.h>
 #include <profilo/writer/PrintEntryVisitor.h>
 
@@ -23,37 +25,96 @@ namespace writer {
 
 PrintEntryVisitor::PrintEntryVisitor(std::ostream& stream) : stream_(stream) {}
 
+namespace {
+
+//
+// Collects a line and writes it to the stream in one go, rather than field
+// by field. Most of the lines in a trace are standard entries and the
+// individual frames of stacks.
+//
+class LineWriter {
+ public:
+  explicit LineWriter(std::ostream& stream) : stream_(stream), size_(0) {}
+
+  ~LineWriter() {
+    flush();
+  }
+
+  template <class Integer>
+  LineWriter& operator<<(Integer value) {
+    fmt::format_int formatted{value};
+    append(formatted.data(), formatted.size());
+    return *this;
+  }
+
+  LineWriter& operator<<(const char* str) {
+    append(str, std::strlen(str));
+    return *this;
+  }
+
+  LineWriter& operator<<(char c) {
+    append(&c, 1);
+    return *this;
+  }
+
+  void flush() {
+    stream_.write(buffer_, size_);
+    size_ = 0;
+  }
+
+ private:
+  std::ostream& stream_;
+  char buffer_[256];
+  size_t size_;
+
+  void append(const char* data, size_t size) {
+    if (size_ + size > sizeof(buffer_)) {
+      flush();
+      if (size > sizeof(buffer_)) {
+        stream_.write(data, size);
+        return;
+      }
+    }
+    std::memcpy(buffer_ + size_, data, size);
+    size_ += size;
+  }
+};
+
+} // namespace
+
 void PrintEntryVisitor::visit(const StandardEntry& data) {
-  stream_ << fmt::format_int{data.id}.c_str();
-  stream_ << '|';
-  stream_ << entries::to_string((EntryType)data.type);
-  stream_ << '|';
-  stream_ << fmt::format_int{data.timestamp}.c_str();
-  stream_ << '|';
-  stream_ << fmt::format_int{data.tid}.c_str();
-  stream_ << '|';
-  stream_ << fmt::format_int{data.callid}.c_str();
-  stream_ << '|';
-  stream_ << fmt::format_int{data.matchid}.c_str();
-  stream_ << '|';
-  stream_ << fmt::format_int{data.extra}.c_str();
-  stream_ << '\n';
+  LineWriter line(stream_);
+  line << data.id;
+  line << '|';
+  line << entries::to_string((EntryType)data.type);
+  line << '|';
+  line << data.timestamp;
+  line << '|';
+  line << data.tid;
+  line << '|';
+  line << data.callid;
+  line << '|';
+  line << data.matchid;
+  line << '|';
+  line << data.extra;
+  line << '\n';
 }
 
 void PrintEntryVisitor::visit(const FramesEntry& data) {
+  LineWriter line(stream_);
   for (size_t idx = 0; idx < data.frames.size; ++idx) {
-    stream_ << fmt::format_int{data.id}.c_str();
-    stream_ << '|';
-    stream_ << entries::to_string((EntryType)data.type);
-    stream_ << '|';
-    stream_ << fmt::format_int{data.timestamp}.c_str();
-    stream_ << '|';
-    stream_ << fmt::format_int{data.tid}.c_str();
-    stream_ << "|0|";
-    stream_ << fmt::format_int{data.matchid}.c_str();
-    stream_ << '|';
-    stream_ << fmt::format_int{data.frames.values[idx]}.c_str();
-    stream_ << '\n';
+    line << data.id;
+    line << '|';
+    line << entries::to_string((EntryType)data.type);
+    line << '|';
+    line << data.timestamp;
+    line << '|';
+    line << data.tid;
+    line << "|0|";
+    line << data.matchid;
+    line << '|';
+    line << data.frames.values[idx];
+    line << '\n';
   }
 }
 
@@ -73,6 +134,50 @@ void PrintEntryVisitor::visit(const BytesEntry& data) {
   stream_ << '\n';
 }
 
+void PrintEntryVisitor::visit(const AnnotationEntry& data) {
+  stream_ << fmt::format_int{data.id}.c_str();
+  stream_ << '|';
+  stream_ << entries::to_string((EntryType)data.type);
+  stream_ << '|';
+  stream_ << fmt::format_int{data.timestamp}.c_str();
+  stream_ << '|';
+  stream_ << fmt::format_int{data.tid}.c_str();
+  stream_ << '|';
+  stream_ << fmt::format_int{data.matchid}.c_str();
+
+  // Each pair as |<kind>:<key>=<value>, with kind one of i, d or s.
+  KeyValueReader reader(data.pairs.values, data.pairs.size);
+  KeyValue pair;
+  while (reader.next(pair)) {
+    stream_ << '|';
+    switch (pair.kind) {
+      case KeyValue::INT:
+        stream_ << "i:";
+        break;
+      case KeyValue::DOUBLE:
+        stream_ << "d:";
+        break;
+      case KeyValue::STRING:
+        stream_ << "s:";
+        break;
+    }
+    stream_.write(pair.key, pair.keySize);
+    stream_ << '=';
+    switch (pair.kind) {
+      case KeyValue::INT:
+        stream_ << fmt::format_int{pair.intValue}.c_str();
+        break;
+      case KeyValue::DOUBLE:
+        stream_ << fmt::format("{}", pair.doubleValue);
+        break;
+      case KeyValue::STRING:
+        stream_.write(pair.stringValue.values, pair.stringValue.size);
+        break;
+    }
+  }
+  stream_ << '\n';
+}
+
 } // namespace writer
 } // namespace profilo
 } // namespace facebook
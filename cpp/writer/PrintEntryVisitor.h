@@ -24,7 +24,7 @@ namespace writer {
 
 using namespace entries;
 
-class PrintEntryVisitor : public EntryVisitor {
+class PrintEntryVisitor final : public EntryVisitor {
  public:
   PrintEntryVisitor() = delete;
   PrintEntryVisitor(const PrintEntryVisitor&) = delete;
@@ -36,6 +36,7 @@ class PrintEntryVisitor : public EntryVisitor {
   virtual void visit(const StandardEntry& data);
   virtual void visit(const FramesEntry& data);
   virtual void visit(const BytesEntry& data);
+  virtual void visit(const AnnotationEntry& data);
 
  private:
   std::ostream& stream_;
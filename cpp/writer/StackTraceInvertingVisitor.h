@@ -16,7 +16,14 @@
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Needed for MAX_STACK_DEPTH
+#include <profilo/profiler/Constants.h>
 
 #include <profilo/entries/EntryParser.h>
 
@@ -31,20 +38,178 @@ using namespace entries;
  * of frames in a FramesEntry.
  * The profiler gives us frames in bottom-first format (since that's natural
  * for an unwinder). The file format however expects top-first.
+ *
+ * Also expands FramesEntries in their shared-prefix encoding, see
+ * profiler::StackFramesWriter. When reading backwards, e.g. in dumps and
+ * backwards traces, a sample comes before the one it's based on. It's held
+ * back until its base is visited, then expanded and visited after it.
+ * Samples whose base is never visited (e.g. it was overwritten) are dropped.
  */
-class StackTraceInvertingVisitor : public EntryVisitor {
+template <class Delegate>
+class BasicStackTraceInvertingVisitor final : public EntryVisitor {
  public:
-  explicit StackTraceInvertingVisitor(EntryVisitor& delegate);
+  // Samples held back per thread. Chains are as long as the keyframe
+  // interval of profiler::StackFramesWriter, this is well above it.
+  static constexpr size_t kMaxPendingSamples = 64;
+
+  explicit BasicStackTraceInvertingVisitor(Delegate& delegate)
+      : delegate_(delegate),
+        stack_(std::make_unique<int64_t[]>(MAX_STACK_DEPTH)),
+        samples_(),
+        pending_(),
+        expanded_() {}
+
+  virtual void visit(const StandardEntry& entry) override {
+    delegate_.visit(entry);
+  }
+
+  virtual void visit(const FramesEntry& entry) override {
+    auto& sample = samples_[entry.tid];
+    sample.id = entry.id;
+    sample.frames.assign(
+        entry.frames.values, entry.frames.values + entry.frames.size);
+    invert(entry);
+    visitPending(entry);
+  }
 
-  virtual void visit(const StandardEntry& entry) override;
-  virtual void visit(const FramesEntry& entry) override;
-  virtual void visit(const BytesEntry& entry) override;
+  virtual void visit(const BytesEntry& entry) override {
+    delegate_.visit(entry);
+  }
+
+  virtual void visit(const AnnotationEntry& entry) override {
+    delegate_.visit(entry);
+  }
+
+  virtual void visitPrefix(
+      const FramesEntry& entry,
+      int32_t base,
+      uint16_t shared) override {
+    auto it = samples_.find(entry.tid);
+    if (it != samples_.end() && it->second.id == base) {
+      expand(it->second, entry, shared);
+      return;
+    }
+
+    // The base may still come, if this is read backwards. Samples held back
+    // form a chain, each one based on the one after it.
+    auto& pending = pending_[entry.tid];
+    if (!pending.empty() &&
+        (pending.back().base != entry.id ||
+         pending.size() == kMaxPendingSamples)) {
+      pending.clear();
+    }
+    pending.push_back(PendingSample{
+        .entry = entry,
+        .base = base,
+        .shared = shared,
+        .frames = std::vector<int64_t>(
+            entry.frames.values, entry.frames.values + entry.frames.size),
+    });
+  }
 
  private:
-  EntryVisitor& delegate_;
+  struct Sample {
+    int32_t id;
+    // Bottom-first, as logged.
+    std::vector<int64_t> frames;
+  };
+
+  struct PendingSample {
+    FramesEntry entry;
+    int32_t base;
+    uint16_t shared;
+    // The sample's own frames, `entry` doesn't own them.
+    std::vector<int64_t> frames;
+  };
+
+  Delegate& delegate_;
   std::unique_ptr<int64_t[]> stack_;
+  // The last sample of each thread, which the next one may be based on.
+  std::unordered_map<int32_t, Sample> samples_;
+  // Samples of each thread waiting for their base, newest first.
+  std::unordered_map<int32_t, std::vector<PendingSample>> pending_;
+  std::vector<int64_t> expanded_;
+
+  // Expand `entry`, based on `sample`, and make it the thread's last sample.
+  bool expand(Sample& sample, const FramesEntry& entry, uint16_t shared) {
+    if (shared > sample.frames.size()) {
+      return false;
+    }
+
+    // The frames of this sample, followed by the `shared` root frames of the
+    // base.
+    expanded_.assign(
+        entry.frames.values, entry.frames.values + entry.frames.size);
+    expanded_.insert(
+        expanded_.end(), sample.frames.end() - shared, sample.frames.end());
+    sample.id = entry.id;
+    sample.frames.swap(expanded_);
+
+    if (sample.frames.size() > MAX_STACK_DEPTH) {
+      throw std::invalid_argument("entry.frames.size > MAX_STACK_DEPTH");
+    }
+    auto expanded = entry;
+    expanded.frames.values = sample.frames.data();
+    expanded.frames.size = static_cast<uint16_t>(sample.frames.size());
+    invert(expanded);
+    return true;
+  }
+
+  // Visit the samples held back for `base`'s thread, if they lead to it.
+  void visitPending(const FramesEntry& base) {
+    auto it = pending_.find(base.tid);
+    if (it == pending_.end()) {
+      return;
+    }
+    auto pending = std::move(it->second);
+    pending_.erase(it);
+    if (pending.empty() || pending.back().base != base.id) {
+      return;
+    }
+
+    // Oldest first, each one is the base of the next.
+    auto& sample = samples_[base.tid];
+    for (auto held = pending.rbegin(); held != pending.rend(); ++held) {
+      auto entry = held->entry;
+      entry.frames.values = held->frames.data();
+      entry.frames.size = static_cast<uint16_t>(held->frames.size());
+      if (!expand(sample, entry, held->shared)) {
+        return;
+      }
+    }
+  }
+
+  void invert(const FramesEntry& entry) {
+    if (entry.frames.size > MAX_STACK_DEPTH) {
+      throw std::invalid_argument("entry.frames.size > MAX_STACK_DEPTH");
+    }
+
+    std::reverse_copy(
+        entry.frames.values,
+        entry.frames.values + entry.frames.size,
+        stack_.get());
+
+    FramesEntry inverted{
+        .id = entry.id,
+        .type = entry.type,
+        .timestamp = entry.timestamp,
+        .tid = entry.tid,
+        .matchid = entry.matchid,
+        .frames =
+            {
+                .values = stack_.get(),
+                .size = entry.frames.size,
+            },
+    };
+    delegate_.visit(inverted);
+  }
 };
 
+using StackTraceInvertingVisitor =
+    BasicStackTraceInvertingVisitor<EntryVisitor>;
+
+extern template class BasicStackTraceInvertingVisitor<EntryVisitor>;
+
 } // namespace writer
 } // namespace profilo
 } // namespace facebook
@@ -0,0 +1,112 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include <profilo/Logger.h>
+#include <profilo/entries/EntryParser.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace entries;
+
+//
+// Turns the STRING_REF entries logged by Logger::writeString() back into
+// the BytesEntries they stand for, and drops STRING_DEFINEs.
+//
+// References are resolved against the STRING_DEFINEs seen so far and,
+// failing that, against the dictionary of `logger`, if given. References
+// that can't be resolved are passed through as-is.
+//
+template <class Delegate>
+class BasicStringResolvingVisitor final : public EntryVisitor {
+ public:
+  explicit BasicStringResolvingVisitor(
+      Delegate& delegate,
+      const Logger* logger = nullptr)
+      : delegate_(delegate), logger_(logger), strings_() {}
+
+  virtual void visit(const StandardEntry& entry) override {
+    if (entry.type != EntryType::STRING_REF) {
+      delegate_.visit(entry);
+      return;
+    }
+
+    const char* str = nullptr;
+    size_t size = 0;
+    auto it = strings_.find(static_cast<int32_t>(entry.extra));
+    if (it != strings_.end()) {
+      str = it->second.data();
+      size = it->second.size();
+    } else if (
+        logger_ == nullptr ||
+        !logger_->lookupString(
+            static_cast<uint32_t>(entry.extra), str, size)) {
+      delegate_.visit(entry);
+      return;
+    }
+
+    delegate_.visit(BytesEntry{
+        .id = entry.id,
+        .type = static_cast<EntryType>(entry.callid),
+        .matchid = entry.matchid,
+        .bytes = {
+            .values = reinterpret_cast<const uint8_t*>(str),
+            .size = static_cast<uint16_t>(size)}});
+  }
+
+  virtual void visit(const FramesEntry& entry) override {
+    delegate_.visit(entry);
+  }
+
+  virtual void visit(const BytesEntry& entry) override {
+    if (entry.type != EntryType::STRING_DEFINE) {
+      delegate_.visit(entry);
+      return;
+    }
+    strings_[entry.matchid].assign(
+        reinterpret_cast<const char*>(entry.bytes.values), entry.bytes.size);
+  }
+
+  virtual void visit(const AnnotationEntry& entry) override {
+    delegate_.visit(entry);
+  }
+
+  virtual void visitPrefix(
+      const FramesEntry& entry,
+      int32_t base,
+      uint16_t shared) override {
+    delegate_.visitPrefix(entry, base, shared);
+  }
+
+ private:
+  Delegate& delegate_;
+  const Logger* logger_;
+  std::unordered_map<int32_t, std::string> strings_;
+};
+
+using StringResolvingVisitor = BasicStringResolvingVisitor<EntryVisitor>;
+
+extern template class BasicStringResolvingVisitor<EntryVisitor>;
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,52 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <profilo/writer/TimestampRescalingVisitor.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+TimestampRescalingVisitor::TimestampRescalingVisitor(
+    EntryVisitor& delegate,
+    ClockCalibration const& calibration)
+    : delegate_(delegate), calibration_(calibration) {}
+
+void TimestampRescalingVisitor::visit(const StandardEntry& entry) {
+  auto copied = entry;
+  copied.timestamp = calibration_.toNanos(entry.timestamp);
+  delegate_.visit(copied);
+}
+
+void TimestampRescalingVisitor::visit(const FramesEntry& entry) {
+  auto copied = entry;
+  copied.timestamp = calibration_.toNanos(entry.timestamp);
+  delegate_.visit(copied);
+}
+
+void TimestampRescalingVisitor::visit(const BytesEntry& entry) {
+  delegate_.visit(entry);
+}
+
+void TimestampRescalingVisitor::visit(const AnnotationEntry& entry) {
+  auto copied = entry;
+  copied.timestamp = calibration_.toNanos(entry.timestamp);
+  delegate_.visit(copied);
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
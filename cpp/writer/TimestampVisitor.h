@@ -0,0 +1,63 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <profilo/entries/EntryParser.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace entries;
+
+//
+// Finds the timestamp of a parsed entry, for merging the entries of several
+// rings. Entries without one, e.g. the bytes following a StandardEntry, leave
+// `found` false; callers give them the timestamp of the entry before them.
+//
+struct TimestampVisitor : public EntryVisitor {
+  bool found = false;
+  int64_t timestamp = 0;
+
+  void visit(const StandardEntry& entry) override {
+    // Stands in for a BytesEntry, see Logger::writeString().
+    if (entry.type == EntryType::STRING_REF) {
+      return;
+    }
+    found = true;
+    timestamp = entry.timestamp;
+  }
+  void visit(const FramesEntry& entry) override {
+    found = true;
+    timestamp = entry.timestamp;
+  }
+  void visit(const BytesEntry&) override {}
+  void visit(const AnnotationEntry& entry) override {
+    found = true;
+    timestamp = entry.timestamp;
+  }
+  void visitPrefix(const FramesEntry& entry, int32_t, uint16_t) override {
+    found = true;
+    timestamp = entry.timestamp;
+  }
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
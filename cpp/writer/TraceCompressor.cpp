@@ -0,0 +1,139 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <profilo/writer/TraceCompressor.h>
+
+#include <cstring>
+#include <ios>
+#include <vector>
+
+#include <profilo/writer/BlockPipeline.h>
+#include <zstr/zstr.hpp>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+class PipelinedStreamBuffer : public std::streambuf {
+ public:
+  explicit PipelinedStreamBuffer(std::unique_ptr<std::streambuf> buffer)
+      : buffer_(std::move(buffer)),
+        put_area_(PipelinedCompressor::kBlockSize),
+        pipeline_(
+            [this](const char* data, size_t size) {
+              auto written = buffer_->sputn(data, size);
+              if (written != static_cast<std::streamsize>(size)) {
+                throw std::ios_base::failure("Could not compress trace");
+              }
+            },
+            PipelinedCompressor::kBlockSize,
+            PipelinedCompressor::kBlockCount) {
+    setp(put_area_.data(), put_area_.data() + put_area_.size());
+  }
+
+  virtual ~PipelinedStreamBuffer() {
+    // Destroying `buffer_` ends the compressed stream, errors are ignored.
+    if (handOver() == 0) {
+      try {
+        pipeline_.drain();
+      } catch (...) {
+      }
+    }
+  }
+
+ protected:
+  virtual int_type overflow(int_type c) override {
+    if (handOver() != 0) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  virtual int sync() override {
+    if (handOver() != 0) {
+      return -1;
+    }
+    try {
+      pipeline_.drain();
+    } catch (...) {
+      return -1;
+    }
+    return buffer_->pubsync();
+  }
+
+ private:
+  std::unique_ptr<std::streambuf> buffer_;
+  std::vector<char> put_area_;
+  // Uses `buffer_`, so it goes first.
+  BlockPipeline pipeline_;
+
+  // Copy the put area into the pipeline. Returns 0 on success, -1 otherwise.
+  int handOver() {
+    size_t size = pptr() - pbase();
+    if (size > 0) {
+      try {
+        std::memcpy(pipeline_.reserve(size), pbase(), size);
+        pipeline_.flush();
+      } catch (...) {
+        return -1;
+      }
+    }
+    setp(put_area_.data(), put_area_.data() + put_area_.size());
+    return 0;
+  }
+};
+
+} // namespace
+
+constexpr int ZlibCompressor::kDefaultLevel;
+constexpr size_t ZlibCompressor::kBufferSize;
+
+ZlibCompressor::ZlibCompressor(int level) : level_(level) {}
+
+std::string ZlibCompressor::description() const {
+  return "zlib:" + std::to_string(level_);
+}
+
+std::unique_ptr<std::streambuf> ZlibCompressor::wrap(
+    std::streambuf* sink) const {
+  return std::make_unique<zstr::ostreambuf>(sink, kBufferSize, level_);
+}
+
+constexpr size_t PipelinedCompressor::kBlockSize;
+constexpr size_t PipelinedCompressor::kBlockCount;
+
+PipelinedCompressor::PipelinedCompressor(
+    std::shared_ptr<TraceCompressor> compressor)
+    : compressor_(std::move(compressor)) {}
+
+std::string PipelinedCompressor::description() const {
+  return compressor_->description();
+}
+
+std::unique_ptr<std::streambuf> PipelinedCompressor::wrap(
+    std::streambuf* sink) const {
+  return std::make_unique<PipelinedStreamBuffer>(compressor_->wrap(sink));
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,87 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <memory>
+#include <streambuf>
+#include <string>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Compresses trace files as they're written. Traces record the compressor's
+// description() in their TraceFileHelpers::kCompressionHeader header.
+//
+class TraceCompressor {
+ public:
+  virtual ~TraceCompressor() = default;
+
+  // Name of the compressor and its settings, e.g. "zlib:3".
+  virtual std::string description() const = 0;
+
+  //
+  // A buffer that compresses everything written to it into `sink`, which
+  // must outlive it. sync() ends the compressed stream, anything written
+  // after that starts a new one. Destroying the buffer ends the stream too.
+  //
+  virtual std::unique_ptr<std::streambuf> wrap(std::streambuf* sink) const = 0;
+};
+
+//
+// gzip, through zstr.
+//
+class ZlibCompressor : public TraceCompressor {
+ public:
+  static constexpr int kDefaultLevel = 3;
+  static constexpr size_t kBufferSize = 512 * 1024;
+
+  explicit ZlibCompressor(int level = kDefaultLevel);
+
+  virtual std::string description() const override;
+  virtual std::unique_ptr<std::streambuf> wrap(
+      std::streambuf* sink) const override;
+
+ private:
+  const int level_;
+};
+
+//
+// Runs another compressor, and the writes to its sink, on a thread of its
+// own (see BlockPipeline), so the trace writer can format the next block of
+// the trace while the last one is being compressed. The output is the same.
+//
+class PipelinedCompressor : public TraceCompressor {
+ public:
+  static constexpr size_t kBlockSize = 256 * 1024;
+  static constexpr size_t kBlockCount = 4;
+
+  explicit PipelinedCompressor(std::shared_ptr<TraceCompressor> compressor);
+
+  virtual std::string description() const override;
+  virtual std::unique_ptr<std::streambuf> wrap(
+      std::streambuf* sink) const override;
+
+ private:
+  const std::shared_ptr<TraceCompressor> compressor_;
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -21,8 +21,7 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <zlib.h>
-#include <zstr/zstr.hpp>
+#include <fstream>
 #include <sstream>
 #include <system_error>
 
@@ -93,16 +92,60 @@ std::string sanitize(std::string input) {
   }
   return sanitized_input.str();
 }
+
+//
+// A file stream that writes through, and owns, a compressing buffer.
+//
+class CompressedFileStream : public std::ofstream {
+ public:
+  CompressedFileStream(
+      const std::string& path,
+      const TraceCompressor& compressor)
+      : std::ofstream(path, std::ofstream::out | std::ofstream::binary),
+        compressed_buf_(nullptr) {
+    // Disable ofstream buffering
+    std::ofstream::rdbuf()->pubsetbuf(nullptr, 0);
+    // Replace ofstream buffer with the compressed one
+    compressed_buf_ = compressor.wrap(std::ofstream::rdbuf());
+    basic_ios<char>::rdbuf(compressed_buf_.get());
+  }
+
+  virtual ~CompressedFileStream() {
+    // Finish the compressed stream while the file is still open.
+    basic_ios<char>::rdbuf(std::ofstream::rdbuf());
+    compressed_buf_ = nullptr;
+  }
+
+ private:
+  std::unique_ptr<std::streambuf> compressed_buf_;
+};
 } // namespace
 
+constexpr char TraceFileHelpers::kClockCalibrationHeader[];
+constexpr char TraceFileHelpers::kBinaryFormatHeader[];
+constexpr char TraceFileHelpers::kCompressionHeader[];
+
+std::shared_ptr<TraceCompressor> TraceFileHelpers::defaultCompressor() {
+  static auto compressor = std::make_shared<ZlibCompressor>();
+  return compressor;
+}
+
 void TraceFileHelpers::writeHeaders(
     std::ostream& output,
     int64_t trace_id,
-    std::vector<std::pair<std::string, std::string>> const& trace_headers) {
+    std::vector<std::pair<std::string, std::string>> const& trace_headers,
+    bool binary,
+    const TraceCompressor* compressor) {
   output << "dt\n"
          << "ver|" << kTraceFormatVersion << "\n"
          << "id|" << getTraceIDAsString(trace_id) << "\n"
          << "prec|" << kTimestampPrecision << "\n";
+  if (binary) {
+    output << kBinaryFormatHeader << '|' << kBinaryFormatVersion << '\n';
+  }
+  if (compressor != nullptr) {
+    output << kCompressionHeader << '|' << compressor->description() << '\n';
+  }
 
   for (auto const& header : trace_headers) {
     output << header.first << '|' << header.second << '\n';
@@ -138,27 +181,16 @@ void TraceFileHelpers::ensureFolder(const std::string& folder) {
 std::unique_ptr<std::ofstream> TraceFileHelpers::openCompressedStream(
     int64_t trace_id,
     std::string const& trace_folder,
-    std::string const& trace_prefix) {
+    std::string const& trace_prefix,
+    const TraceCompressor& compressor) {
   ensureFolder(trace_folder.c_str());
 
   std::string trace_file =
       TraceFileHelpers::getTraceFilePath(trace_id, trace_prefix, trace_folder);
 
-  auto output = std::make_unique<std::ofstream>(
-      trace_file, std::ofstream::out | std::ofstream::binary);
+  std::unique_ptr<std::ofstream> output =
+      std::make_unique<CompressedFileStream>(trace_file, compressor);
   output->exceptions(std::ofstream::badbit | std::ofstream::failbit);
-
-  zstr::ostreambuf* output_buf = new zstr::ostreambuf(
-      output->rdbuf(), // wrap the ofstream buffer
-      512 * 1024, // input and output buffers
-      3 // compression level
-  );
-
-  // Disable ofstream buffering
-  output->rdbuf()->pubsetbuf(nullptr, 0);
-  // Replace ofstream buffer with the compressed one
-  output->basic_ios<char>::rdbuf(output_buf);
-
   return output;
 }
 
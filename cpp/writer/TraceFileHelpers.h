@@ -21,6 +21,8 @@
 #include <utility>
 #include <vector>
 
+#include <profilo/writer/TraceCompressor.h>
+
 namespace facebook {
 namespace profilo {
 namespace writer {
@@ -30,15 +32,33 @@ class TraceFileHelpers {
   // Timestamp precision is microsec by default.
   static constexpr size_t kTimestampPrecision = 6;
   static constexpr size_t kTraceFormatVersion = 3;
+  // Header with the ClockCalibration of traces that use the COUNTER clock
+  // source. Their timestamps are converted to nanoseconds on write.
+  static constexpr char kClockCalibrationHeader[] = "clock_calibration";
+  // TRACE_START flag (Trace.FLAG_BINARY_OUTPUT) to write the trace with
+  // BinaryEntryVisitor instead of as text.
+  static constexpr int32_t kBinaryOutputFlag = 1 << 2;
+  // Version of the BinaryEntryVisitor format, in the kBinaryFormatHeader
+  // header of binary traces.
+  static constexpr size_t kBinaryFormatVersion = 1;
+  static constexpr char kBinaryFormatHeader[] = "bin";
+  // Header with the TraceCompressor::description() of the trace file.
+  static constexpr char kCompressionHeader[] = "compression";
+
+  // The compressor used when none is given, zlib at level 3.
+  static std::shared_ptr<TraceCompressor> defaultCompressor();
 
   static void writeHeaders(
       std::ostream& output,
       int64_t id,
-      std::vector<std::pair<std::string, std::string>> const& trace_headers);
+      std::vector<std::pair<std::string, std::string>> const& trace_headers,
+      bool binary = false,
+      const TraceCompressor* compressor = nullptr);
   static std::unique_ptr<std::ofstream> openCompressedStream(
       int64_t trace_id,
       std::string const& trace_folder,
-      std::string const& trace_prefix);
+      std::string const& trace_prefix,
+      const TraceCompressor& compressor = *defaultCompressor());
 
  private:
   static std::string getTraceFilePath(
@@ -19,11 +19,15 @@
 
 #include <system_error>
 
+#include <profilo/writer/BinaryEntryVisitor.h>
 #include <profilo/writer/DeltaEncodingVisitor.h>
 #include <profilo/writer/PrintEntryVisitor.h>
 #include <profilo/writer/StackTraceInvertingVisitor.h>
+#include <profilo/writer/StringResolvingVisitor.h>
+#include <profilo/writer/TimestampRescalingVisitor.h>
 #include <profilo/writer/TimestampTruncatingVisitor.h>
 #include <profilo/writer/TraceLifecycleVisitor.h>
+#include <profilo/writer/VisitorChains.h>
 
 namespace facebook {
 namespace profilo {
@@ -37,7 +41,11 @@ TraceLifecycleVisitor::TraceLifecycleVisitor(
     std::shared_ptr<TraceCallbacks> callbacks,
     const std::vector<std::pair<std::string, std::string>>& headers,
     int64_t trace_id,
-    std::function<void(TraceLifecycleVisitor& visitor)> trace_backward_callback)
+    std::function<void(TraceLifecycleVisitor& visitor)> trace_backward_callback,
+    std::function<void(EntryVisitor& output, const StandardEntry& end)>
+        trace_end_callback,
+    const Logger* strings_logger,
+    std::shared_ptr<TraceCompressor> compressor)
     :
 
       trace_folder_(trace_folder),
@@ -49,7 +57,12 @@ TraceLifecycleVisitor::TraceLifecycleVisitor(
       callbacks_(callbacks),
       started_(false),
       done_(false),
-      trace_backward_callback_(std::move(trace_backward_callback)) {}
+      trace_backward_callback_(std::move(trace_backward_callback)),
+      trace_end_callback_(std::move(trace_end_callback)),
+      strings_logger_(strings_logger),
+      compressor_(
+          compressor != nullptr ? std::move(compressor)
+                                : TraceFileHelpers::defaultCompressor()) {}
 
 void TraceLifecycleVisitor::visit(const StandardEntry& entry) {
   auto type = static_cast<EntryType>(entry.type);
@@ -61,6 +74,9 @@ void TraceLifecycleVisitor::visit(const StandardEntry& entry) {
       }
       // write before we clean up state
       if (hasDelegate()) {
+        if (trace_end_callback_) {
+          trace_end_callback_(*delegates_.back(), entry);
+        }
         delegates_.back()->visit(entry);
       }
       onTraceEnd(trace_id);
@@ -128,6 +144,21 @@ void TraceLifecycleVisitor::visit(const BytesEntry& entry) {
   }
 }
 
+void TraceLifecycleVisitor::visit(const AnnotationEntry& entry) {
+  if (hasDelegate()) {
+    delegates_.back()->visit(entry);
+  }
+}
+
+void TraceLifecycleVisitor::visitPrefix(
+    const FramesEntry& entry,
+    int32_t base,
+    uint16_t shared) {
+  if (hasDelegate()) {
+    delegates_.back()->visitPrefix(entry, base, shared);
+  }
+}
+
 void TraceLifecycleVisitor::abort(AbortReason reason) {
   onTraceAbort(expected_trace_, reason);
 }
@@ -140,15 +171,49 @@ void TraceLifecycleVisitor::onTraceStart(int64_t trace_id, int32_t flags) {
   }
 
   output_ = TraceFileHelpers::openCompressedStream(
-      trace_id, trace_folder_, trace_prefix_);
-  TraceFileHelpers::writeHeaders(*output_, trace_id, trace_headers_);
-
-  // outputTime = truncate(current) - truncate(prev)
-  delegates_.emplace_back(new PrintEntryVisitor(*output_));
-  delegates_.emplace_back(new DeltaEncodingVisitor(*delegates_.back()));
-  delegates_.emplace_back(new TimestampTruncatingVisitor(
-      *delegates_.back(), TraceFileHelpers::kTimestampPrecision));
-  delegates_.emplace_back(new StackTraceInvertingVisitor(*delegates_.back()));
+      trace_id, trace_folder_, trace_prefix_, *compressor_);
+  bool binary = (flags & TraceFileHelpers::kBinaryOutputFlag) != 0;
+  TraceFileHelpers::writeHeaders(
+      *output_, trace_id, trace_headers_, binary, compressor_.get());
+
+  // Parsed once, it picks the chain and configures its rescaling.
+  ClockCalibration calibration{};
+  bool calibrated = false;
+  for (auto const& header : trace_headers_) {
+    if (header.first == TraceFileHelpers::kClockCalibrationHeader &&
+        ClockCalibration::fromString(header.second, calibration)) {
+      calibrated = true;
+      break;
+    }
+  }
+
+  if (!calibrated) {
+    // The standard configuration, composed statically. Same output as the
+    // chain below without TimestampRescalingVisitors.
+    if (binary) {
+      delegates_.emplace_back(
+          new BinaryVisitorChain(*output_, strings_logger_));
+    } else {
+      delegates_.emplace_back(new TextVisitorChain(*output_, strings_logger_));
+    }
+  } else {
+    // outputTime = truncate(current) - truncate(prev)
+    if (binary) {
+      // Delta encodes on its own, per column.
+      delegates_.emplace_back(new BinaryEntryVisitor(*output_));
+    } else {
+      delegates_.emplace_back(new PrintEntryVisitor(*output_));
+      delegates_.emplace_back(new DeltaEncodingVisitor(*delegates_.back()));
+    }
+    delegates_.emplace_back(new TimestampTruncatingVisitor(
+        *delegates_.back(), TraceFileHelpers::kTimestampPrecision));
+    delegates_.emplace_back(
+        new TimestampRescalingVisitor(*delegates_.back(), calibration));
+    delegates_.emplace_back(
+        new StackTraceInvertingVisitor(*delegates_.back()));
+    delegates_.emplace_back(
+        new StringResolvingVisitor(*delegates_.back(), strings_logger_));
+  }
 
   if (callbacks_.get() != nullptr) {
     callbacks_->onTraceStart(trace_id, flags);
@@ -23,11 +23,13 @@
 #include <utility>
 #include <vector>
 
+#include <profilo/Logger.h>
 #include <profilo/entries/Entry.h>
 #include <profilo/entries/EntryParser.h>
 #include <profilo/writer/AbortReason.h>
 #include <profilo/writer/ScopedThreadPriority.h>
 #include <profilo/writer/TraceCallbacks.h>
+#include <profilo/writer/TraceCompressor.h>
 #include <profilo/writer/TraceFileHelpers.h>
 
 #include <zstr/zstr.hpp>
@@ -47,11 +49,20 @@ class TraceLifecycleVisitor : public EntryVisitor {
       const std::vector<std::pair<std::string, std::string>>& headers,
       int64_t trace_id,
       std::function<void(TraceLifecycleVisitor& visitor)>
-          trace_backward_callback = nullptr);
+          trace_backward_callback = nullptr,
+      std::function<void(EntryVisitor& output, const StandardEntry& end)>
+          trace_end_callback = nullptr,
+      const Logger* strings_logger = nullptr,
+      std::shared_ptr<TraceCompressor> compressor = nullptr);
 
   virtual void visit(const StandardEntry& entry) override;
   virtual void visit(const FramesEntry& entry) override;
   virtual void visit(const BytesEntry& entry) override;
+  virtual void visit(const AnnotationEntry& entry) override;
+  virtual void visitPrefix(
+      const FramesEntry& entry,
+      int32_t base,
+      uint16_t shared) override;
 
   void abort(AbortReason reason);
 
@@ -59,6 +70,10 @@ class TraceLifecycleVisitor : public EntryVisitor {
     return done_;
   }
 
+  inline bool started() const {
+    return started_;
+  }
+
   inline int64_t getTraceID() const {
     return expected_trace_;
   }
@@ -77,6 +92,16 @@ class TraceLifecycleVisitor : public EntryVisitor {
   bool done_;
   std::unique_ptr<ScopedThreadPriority> thread_priority_;
   std::function<void(TraceLifecycleVisitor& visitor)> trace_backward_callback_;
+  // Called with the output and the TRACE_END entry right before the latter
+  // is written out.
+  std::function<void(EntryVisitor& output, const StandardEntry& end)>
+      trace_end_callback_;
+  // Resolves interned strings the trace doesn't define, see
+  // StringResolvingVisitor.
+  const Logger* strings_logger_;
+  // Compresses the trace file, TraceFileHelpers::defaultCompressor() if none
+  // is given.
+  std::shared_ptr<TraceCompressor> compressor_;
 
   inline bool hasDelegate() {
     return !delegates_.empty();
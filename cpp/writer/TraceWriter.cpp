@@ -17,22 +17,29 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <ctime>
+#include <deque>
 #include <memory>
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
 #include <system_error>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include <profilo/entries/EntryParser.h>
-#include <profilo/writer/DeltaEncodingVisitor.h>
+#include <profilo/writer/BlockPipeline.h>
+#include <profilo/writer/LossCounters.h>
 #include <profilo/writer/PacketReassembler.h>
-#include <profilo/writer/PrintEntryVisitor.h>
-#include <profilo/writer/StackTraceInvertingVisitor.h>
-#include <profilo/writer/TimestampTruncatingVisitor.h>
+#include <profilo/writer/ScopedThreadPriority.h>
 #include <profilo/writer/TraceLifecycleVisitor.h>
+#include <profilo/writer/TimestampVisitor.h>
 #include <profilo/writer/TraceWriter.h>
+#include <profilo/writer/VisitorChains.h>
 #include <profilo/writer/trace_backwards.h>
 
 #include <profilo/LogEntry.h>
@@ -41,13 +48,394 @@ namespace facebook {
 namespace profilo {
 namespace writer {
 
+namespace {
+
+// How long processMergedTrace() waits on the main ring when none of the
+// rings of a tiered or sharded buffer has anything to read, before checking
+// the others again. There's no way to block on several rings at once.
+constexpr auto kMergePollInterval = std::chrono::milliseconds(5);
+
+// Polls before the first sleep when waiting with a latency budget.
+constexpr uint32_t kReaderPollSpins = 1000;
+
+// Blocks of reassembled entries between the reader and the thread running
+// the visitors, when pipelined.
+constexpr size_t kEntryBlockSize = 256 * 1024;
+constexpr size_t kEntryBlockCount = 4;
+// Entries are 8-byte aligned in the blocks, after their size.
+constexpr size_t kEntryAlignment = 8;
+
+//
+// Looks for the entries the reader has to act on itself when pipelined.
+//
+struct ControlVisitor : public EntryVisitor {
+  bool control = false;
+  bool priority = false;
+  int32_t priority_value = 0;
+  int64_t trace_id = 0;
+
+  void visit(const StandardEntry& entry) override {
+    switch (entry.type) {
+      case EntryType::TRACE_START:
+      case EntryType::TRACE_BACKWARDS:
+      case EntryType::TRACE_END:
+      case EntryType::TRACE_ABORT:
+      case EntryType::TRACE_TIMEOUT:
+        control = true;
+        break;
+      case EntryType::LOGGER_PRIORITY:
+        priority = true;
+        priority_value = entry.callid;
+        trace_id = entry.extra;
+        break;
+      default:
+        break;
+    }
+  }
+  void visit(const FramesEntry&) override {}
+  void visit(const BytesEntry&) override {}
+  void visit(const AnnotationEntry&) override {}
+  void visitPrefix(const FramesEntry&, int32_t, uint16_t) override {}
+};
+
+//
+// Looks for the TRACE_END of a trace.
+//
+struct TraceEndVisitor : public EntryVisitor {
+  explicit TraceEndVisitor(int64_t trace_id) : trace_id(trace_id) {}
+
+  int64_t trace_id;
+  bool found = false;
+
+  void visit(const StandardEntry& entry) override {
+    if (entry.type == EntryType::TRACE_END && entry.extra == trace_id) {
+      found = true;
+    }
+  }
+  void visit(const FramesEntry&) override {}
+  void visit(const BytesEntry&) override {}
+  void visit(const AnnotationEntry&) override {}
+  void visitPrefix(const FramesEntry&, int32_t, uint16_t) override {}
+};
+
+//
+// True if the reassembled entry at `data` is the TRACE_END of `trace_id`.
+// The reader notes where it found it, so that LossCounters doesn't count
+// what was written after the trace ended.
+//
+bool isTraceEnd(const void* data, size_t size, int64_t trace_id) {
+  auto type = peek_type(data, size);
+  if (type != StandardEntry::kSerializationType &&
+      type != StandardEntry::kCompactSerializationType) {
+    return false;
+  }
+  TraceEndVisitor trace_end(trace_id);
+  EntryParser::parse(data, size, trace_end);
+  return trace_end.found;
+}
+
+//
+// Where the reader puts reassembled entries: straight into the visitor, or,
+// when pipelined, into blocks that a thread of their own parses into it.
+//
+// The pipelined reader only waits for the visitor at trace control entries:
+// that's when the trace may end, and when TRACE_BACKWARDS walks the buffer
+// back from the reader's cursor. LOGGER_PRIORITY applies to both threads.
+//
+class EntrySink {
+ public:
+  EntrySink(TraceLifecycleVisitor& visitor, bool pipelined)
+      : visitor_(visitor),
+        started_(false),
+        done_(false),
+        pipeline_(),
+        thread_priority_() {
+    if (pipelined) {
+      pipeline_ = std::make_unique<BlockPipeline>(
+          [this](const char* data, size_t size) { parse(data, size); },
+          kEntryBlockSize,
+          kEntryBlockCount);
+    }
+  }
+
+  void write(const void* data, size_t size) {
+    if (pipeline_ == nullptr) {
+      EntryParser::parse(data, size, visitor_);
+      return;
+    }
+
+    auto block = pipeline_->reserve(kEntryAlignment + align(size));
+    *reinterpret_cast<uint32_t*>(block) = size;
+    std::memcpy(block + kEntryAlignment, data, size);
+
+    ControlVisitor control;
+    EntryParser::parse(data, size, control);
+    if (control.priority && control.trace_id == visitor_.getTraceID()) {
+      thread_priority_ =
+          std::make_unique<ScopedThreadPriority>(control.priority_value);
+    }
+    if (control.control) {
+      pipeline_->drain();
+      started_ = visitor_.started();
+      done_ = visitor_.done();
+    }
+  }
+
+  // Let the visitor catch up while the reader waits for more entries.
+  void flush() {
+    if (pipeline_ != nullptr) {
+      pipeline_->flush();
+    }
+  }
+
+  bool started() const {
+    return pipeline_ == nullptr ? visitor_.started() : started_;
+  }
+
+  bool done() const {
+    return pipeline_ == nullptr ? visitor_.done() : done_;
+  }
+
+  void abort(AbortReason reason) {
+    if (pipeline_ != nullptr) {
+      pipeline_->drain();
+    }
+    visitor_.abort(reason);
+    done_ = true;
+  }
+
+ private:
+  TraceLifecycleVisitor& visitor_;
+  // visitor_.started() and done() as of the last control entry.
+  bool started_;
+  bool done_;
+  std::unique_ptr<BlockPipeline> pipeline_;
+  std::unique_ptr<ScopedThreadPriority> thread_priority_;
+
+  static size_t align(size_t size) {
+    return (size + kEntryAlignment - 1) & ~(kEntryAlignment - 1);
+  }
+
+  void parse(const char* data, size_t size) {
+    auto end = data + size;
+    while (data < end) {
+      auto entry_size = *reinterpret_cast<const uint32_t*>(data);
+      EntryParser::parse(data + kEntryAlignment, entry_size, visitor_);
+      data += kEntryAlignment + align(entry_size);
+    }
+  }
+};
+
+//
+// Reads one ring of a tiered or sharded buffer, holding on to reassembled
+// entries until the merge in processMergedTrace() hands them to the visitor.
+//
+class RingReader {
+ public:
+  // lossy: on overrun, skip ahead to the oldest readable packet instead of
+  // stopping. Skipped packets are counted in `losses`.
+  RingReader(
+      TraceBuffer& ring,
+      TraceBuffer::Cursor cursor,
+      bool lossy,
+      LossCounters& losses,
+      int64_t trace_id)
+      : ring_(ring),
+        cursor_(cursor),
+        lossy_(lossy),
+        losses_(losses),
+        trace_id_(trace_id),
+        last_timestamp_(0),
+        pending_(),
+        reassembler_([this](const void* data, size_t size) {
+          onPayload(data, size);
+        }) {
+    losses_.addReassembler(reassembler_);
+  }
+
+  //
+  // Read until an entry is ready. Returns false if the ring has nothing more
+  // to read right now.
+  //
+  bool fill() {
+    while (pending_.empty()) {
+      alignas(4) Packet packet;
+      if (!ring_.tryRead(packet, cursor_, losses_.tornReadCounter())) {
+        if (!lossy_ || !overrun()) {
+          return false;
+        }
+        auto tail = ring_.currentTail();
+        losses_.addOverwritten(cursor_.distanceTo(tail));
+        cursor_ = tail;
+        continue;
+      }
+      reassembler_.process(packet);
+      cursor_.moveForward();
+    }
+    return true;
+  }
+
+  //
+  // Block until the ring has a packet to read, or until `deadline`. Returns
+  // false on timeout.
+  //
+  bool wait(std::chrono::steady_clock::time_point deadline) {
+    alignas(4) Packet packet;
+    if (!ring_.waitAndTryRead(
+            packet, cursor_, deadline, losses_.tornReadCounter())) {
+      return false;
+    }
+    reassembler_.process(packet);
+    cursor_.moveForward();
+    return true;
+  }
+
+  bool overrun() {
+    return cursor_.distanceTo(ring_.currentTail()) > 0;
+  }
+
+  bool empty() const {
+    return pending_.empty();
+  }
+
+  int64_t timestamp() const {
+    return pending_.front().timestamp;
+  }
+
+  bool traceEnd() const {
+    return pending_.front().trace_end;
+  }
+
+  //
+  // Where the merge is in this ring: right after the next entry to be
+  // emitted if `next`, up to its last packet otherwise.
+  //
+  TraceBuffer::Cursor mergeCursor(bool next) const {
+    if (!next) {
+      return backwardsCursor(false);
+    }
+    auto cursor = pending_.front().cursor;
+    cursor.moveForward();
+    return cursor;
+  }
+
+  void emit(EntrySink& sink) {
+    // The visitor may call backwardsCursor() while we're still in here.
+    emitting_ = std::move(pending_.front());
+    pending_.pop_front();
+    sink.write(emitting_.data.data(), emitting_.data.size());
+  }
+
+  //
+  // Where to start a backwards walk that should cover everything up to, but
+  // not including, the entry being emitted or the next one to be emitted.
+  //
+  TraceBuffer::Cursor backwardsCursor(bool emitting) const {
+    if (emitting) {
+      return emitting_.cursor;
+    }
+    return pending_.empty() ? cursor_ : pending_.front().cursor;
+  }
+
+  TraceBuffer& ring() {
+    return ring_;
+  }
+
+  TraceBuffer::Cursor cursor() const {
+    return cursor_;
+  }
+
+ private:
+  struct PendingEntry {
+    int64_t timestamp;
+    // The last packet of the entry.
+    TraceBuffer::Cursor cursor;
+    std::vector<char> data;
+    bool trace_end;
+  };
+
+  TraceBuffer& ring_;
+  TraceBuffer::Cursor cursor_;
+  bool lossy_;
+  LossCounters& losses_;
+  int64_t trace_id_;
+  int64_t last_timestamp_;
+  std::deque<PendingEntry> pending_;
+  PendingEntry emitting_{0, cursor_, {}, false};
+  PacketReassembler reassembler_;
+
+  void onPayload(const void* data, size_t size) {
+    // Entries without a timestamp keep the one of the entry before them.
+    TimestampVisitor timestamp;
+    EntryParser::parse(data, size, timestamp);
+    if (timestamp.found) {
+      last_timestamp_ = timestamp.timestamp;
+    }
+    auto bytes = static_cast<const char*>(data);
+    pending_.push_back(PendingEntry{
+        .timestamp = last_timestamp_,
+        .cursor = cursor_,
+        .data = std::vector<char>(bytes, bytes + size),
+        .trace_end = isTraceEnd(data, size, trace_id_),
+    });
+  }
+};
+
+//
+// The entries of one ring, newest first, for a merged dump().
+//
+struct DumpedEntry {
+  int64_t timestamp;
+  std::vector<char> data;
+};
+
+std::vector<DumpedEntry> dumpRing(TraceBuffer& ring) {
+  std::vector<DumpedEntry> entries;
+  std::vector<bool> timestamped;
+  // Skip the last write that has started, like dump() does for a single
+  // ring.
+  TraceBuffer::Cursor cursor = ring.currentHead();
+  cursor.moveBackward();
+  traceBackwards(
+      [&](const void* data, size_t size) {
+        TimestampVisitor timestamp;
+        EntryParser::parse(data, size, timestamp);
+        auto bytes = static_cast<const char*>(data);
+        entries.push_back(DumpedEntry{
+            .timestamp = timestamp.timestamp,
+            .data = std::vector<char>(bytes, bytes + size),
+        });
+        timestamped.push_back(timestamp.found);
+      },
+      ring,
+      cursor);
+
+  // Entries without a timestamp keep the one of the entry before them, as
+  // in RingReader.
+  int64_t last_timestamp = 0;
+  for (size_t i = entries.size(); i-- > 0;) {
+    if (timestamped[i]) {
+      last_timestamp = entries[i].timestamp;
+    } else {
+      entries[i].timestamp = last_timestamp;
+    }
+  }
+  return entries;
+}
+
+} // namespace
+
 TraceWriter::TraceWriter(
     const std::string&& folder,
     const std::string&& trace_prefix,
     std::shared_ptr<Buffer> buffer,
     std::shared_ptr<TraceCallbacks> callbacks,
     std::vector<std::pair<std::string, std::string>>&& headers,
-    TraceBackwardsCallback trace_backwards_callback)
+    TraceBackwardsCallback trace_backwards_callback,
+    std::chrono::microseconds reader_latency_budget,
+    std::shared_ptr<TraceCompressor> compressor,
+    bool pipelined,
+    bool skip_overruns)
     : wakeup_mutex_(),
       wakeup_cv_(),
       wakeup_trace_id_(nullptr),
@@ -57,11 +445,28 @@ TraceWriter::TraceWriter(
       buffer_(std::move(buffer)),
       trace_headers_(std::move(headers)),
       callbacks_(callbacks),
-      trace_backwards_callback_(trace_backwards_callback) {}
+      trace_backwards_callback_(trace_backwards_callback),
+      reader_latency_budget_(reader_latency_budget),
+      compressor_(
+          compressor != nullptr ? std::move(compressor)
+                                : TraceFileHelpers::defaultCompressor()),
+      pipelined_(pipelined),
+      skip_overruns_(skip_overruns) {
+  if (pipelined_) {
+    compressor_ = std::make_shared<PipelinedCompressor>(compressor_);
+  }
+}
 
 int64_t TraceWriter::processTrace(
     int64_t trace_id,
     TraceBuffer::Cursor& cursor) {
+  if (buffer_->priorityRingBuffer() != nullptr || buffer_->shardCount > 1) {
+    return processMergedTrace(trace_id, cursor);
+  }
+
+  LossCounters losses;
+  losses.addRing(buffer_->ringBuffer(), cursor);
+
   TraceLifecycleVisitor visitor(
       trace_folder_,
       trace_prefix_,
@@ -73,18 +478,66 @@ int64_t TraceWriter::processTrace(
           return;
         }
         trace_backwards_callback_(visitor, buffer_->ringBuffer(), cursor);
-      });
+      },
+      [&losses](EntryVisitor& output, const StandardEntry& end) {
+        losses.write(output, end);
+      },
+      &buffer_->logger(),
+      compressor_);
 
-  PacketReassembler reassembler([&visitor](const void* data, size_t size) {
-    EntryParser::parse(data, size, visitor);
-  });
+  EntrySink sink(visitor, pipelined_);
+  PacketReassembler reassembler(
+      [this, &sink, &losses, &cursor, trace_id](const void* data, size_t size) {
+        // The visitor writes the loss counters when it gets to TRACE_END,
+        // which may be on another thread, well after we read it.
+        if (isTraceEnd(data, size, trace_id)) {
+          auto end = cursor;
+          end.moveForward();
+          losses.endRing(buffer_->ringBuffer(), end);
+        }
+        sink.write(data, size);
+      });
+  losses.addReassembler(reassembler);
 
-  while (!visitor.done()) {
+  while (!sink.done()) {
     alignas(4) Packet packet;
-    if (!buffer_->ringBuffer().waitAndTryRead(packet, cursor)) {
-      // Missed event, abort.
-      visitor.abort(AbortReason::MISSED_EVENT);
-      break;
+    bool read = buffer_->ringBuffer().tryRead(
+        packet, cursor, losses.tornReadCounter());
+    if (!read) {
+      // We're about to wait for new data, make sure none of it is sitting
+      // in a writer's staging area. Writers leave re-logging the string
+      // dictionary to us, too.
+      buffer_->logger().flushStaged();
+      buffer_->logger().refreshStrings();
+      sink.flush();
+      if (reader_latency_budget_.count() > 0) {
+        read = buffer_->ringBuffer().pollAndTryRead(
+            packet,
+            cursor,
+            logger::lfrb::PollBackoff{
+                .spins = kReaderPollSpins,
+                .latencyBudget = reader_latency_budget_,
+            },
+            losses.tornReadCounter());
+      } else {
+        read = buffer_->ringBuffer().waitAndTryRead(
+            packet, cursor, losses.tornReadCounter());
+      }
+    }
+    if (!read) {
+      auto tail = buffer_->ringBuffer().currentTail();
+      if (!skip_overruns_ || !sink.started() ||
+          cursor.distanceTo(tail) == 0) {
+        // Missed event, abort.
+        sink.abort(AbortReason::MISSED_EVENT);
+        break;
+      }
+      // Overrun once the trace has started: skip what was overwritten, like
+      // RingReader does. The reassembler drops the entries that lost
+      // packets.
+      losses.addOverwritten(cursor.distanceTo(tail));
+      cursor = tail;
+      continue;
     }
     reassembler.process(packet);
     cursor.moveForward();
@@ -93,6 +546,117 @@ int64_t TraceWriter::processTrace(
   return visitor.getTraceID();
 }
 
+int64_t TraceWriter::processMergedTrace(
+    int64_t trace_id,
+    TraceBuffer::Cursor& cursor) {
+  // Entries in the main rings are only lost to overruns, so don't give up on
+  // those. The shards of a sharded buffer are read from their tail, as the
+  // trace may have started in any of them, and so is the small high priority
+  // ring. Entries from before the trace start are ignored by the visitor.
+  LossCounters losses;
+  std::vector<std::unique_ptr<RingReader>> readers;
+  auto addReader = [&](TraceBuffer& ring,
+                       TraceBuffer::Cursor start,
+                       bool lossy) {
+    losses.addRing(ring, start);
+    readers.push_back(
+        std::make_unique<RingReader>(ring, start, lossy, losses, trace_id));
+  };
+
+  if (buffer_->shardCount > 1) {
+    for (size_t shard = 0; shard < buffer_->shardCount; ++shard) {
+      auto& ring = buffer_->shardRingBuffer(shard);
+      addReader(ring, ring.currentTail(), true);
+    }
+  } else {
+    addReader(buffer_->ringBuffer(), cursor, true);
+  }
+
+  RingReader* priority = nullptr;
+  auto priority_ring = buffer_->priorityRingBuffer();
+  if (priority_ring != nullptr) {
+    addReader(*priority_ring, priority_ring->currentTail(), false);
+    priority = readers.back().get();
+  }
+  RingReader* current = nullptr;
+
+  TraceLifecycleVisitor visitor(
+      trace_folder_,
+      trace_prefix_,
+      callbacks_,
+      trace_headers_,
+      trace_id,
+      [this, &readers, &current](TraceLifecycleVisitor& visitor) {
+        if (trace_backwards_callback_ == nullptr) {
+          return;
+        }
+        for (auto& reader : readers) {
+          auto start = reader->backwardsCursor(reader.get() == current);
+          trace_backwards_callback_(visitor, reader->ring(), start);
+        }
+      },
+      [&losses](EntryVisitor& output, const StandardEntry& end) {
+        losses.write(output, end);
+      },
+      &buffer_->logger(),
+      compressor_);
+
+  EntrySink sink(visitor, pipelined_);
+
+  // Merge the rings by timestamp, ties go to the main rings. This is best
+  // effort: an entry only waits for another ring if that ring has something
+  // to read.
+  while (!sink.done()) {
+    current = nullptr;
+    for (auto& reader : readers) {
+      reader->fill();
+      if (!reader->empty() &&
+          (current == nullptr || reader->timestamp() < current->timestamp())) {
+        current = reader.get();
+      }
+    }
+
+    if (current == nullptr) {
+      if (priority != nullptr && priority->overrun()) {
+        // Missed event, abort.
+        sink.abort(AbortReason::MISSED_EVENT);
+        break;
+      }
+      buffer_->logger().flushStaged();
+      buffer_->logger().refreshStrings();
+      sink.flush();
+      bool filled = false;
+      for (auto& reader : readers) {
+        filled = reader->fill() || filled;
+      }
+      if (!filled) {
+        if (reader_latency_budget_.count() > 0) {
+          // Writers must never have to wake us up.
+          std::this_thread::sleep_for(std::min<std::chrono::microseconds>(
+              reader_latency_budget_, kMergePollInterval));
+        } else {
+          // Nearly all entries go to the main ring, block on its next turn.
+          readers.front()->wait(
+              std::chrono::steady_clock::now() + kMergePollInterval);
+        }
+      }
+      continue;
+    }
+
+    if (current->traceEnd()) {
+      // See processTrace().
+      for (auto& reader : readers) {
+        losses.endRing(
+            reader->ring(), reader->mergeCursor(reader.get() == current));
+      }
+    }
+    current->emit(sink);
+  }
+
+  cursor = readers.front()->cursor();
+  return visitor.getTraceID();
+}
+
 void TraceWriter::loop() {
   int64_t trace_id = 0;
   // dummy call, no default constructor
@@ -120,23 +684,51 @@ void TraceWriter::loop() {
 
 void TraceWriter::dump(int64_t trace_id) {
   auto output = TraceFileHelpers::openCompressedStream(
-      trace_id, trace_folder_, trace_prefix_);
-  TraceFileHelpers::writeHeaders(*output, trace_id, trace_headers_);
-
-  auto printVisitor = std::make_unique<PrintEntryVisitor>(*output);
-  auto deltaVisitor = std::make_unique<DeltaEncodingVisitor>(*printVisitor);
-  auto timestampVisitor = std::make_unique<TimestampTruncatingVisitor>(
-      *deltaVisitor, TraceFileHelpers::kTimestampPrecision);
-  auto stacktraceVisitor =
-      std::make_unique<StackTraceInvertingVisitor>(*timestampVisitor);
-
-  // First write that hasn't happened yet...
-  TraceBuffer::Cursor cursor = buffer_->ringBuffer().currentHead();
-  // ... minus one, i.e. last write that has happened.
-  // Also equivalent to .currentTail(1.0) but that's way less readable.
-  cursor.moveBackward();
+      trace_id, trace_folder_, trace_prefix_, *compressor_);
+  TraceFileHelpers::writeHeaders(
+      *output, trace_id, trace_headers_, false, compressor_.get());
 
-  traceBackwards(*stacktraceVisitor, buffer_->ringBuffer(), cursor);
+  TextVisitorChain visitor(*output, &buffer_->logger());
+
+  auto priority_ring = buffer_->priorityRingBuffer();
+  if (buffer_->shardCount == 1 && priority_ring == nullptr) {
+    // First write that hasn't happened yet...
+    TraceBuffer::Cursor cursor = buffer_->ringBuffer().currentHead();
+    // ... minus one, i.e. the last write that has started. It may still be
+    // in progress, and traceBackwards() stops at the first slot it can't
+    // read, so it starts right before it.
+    cursor.moveBackward();
+    traceBackwards(visitor, buffer_->ringBuffer(), cursor);
+  } else {
+    std::vector<std::vector<DumpedEntry>> rings;
+    for (size_t shard = 0; shard < buffer_->shardCount; ++shard) {
+      rings.push_back(dumpRing(buffer_->shardRingBuffer(shard)));
+    }
+    if (priority_ring != nullptr) {
+      rings.push_back(dumpRing(*priority_ring));
+    }
+
+    // Merge newest first, like a single ring is dumped. Ties go to the high
+    // priority ring, so that walking the dump backwards, like
+    // processMergedTrace() does forwards, they go to the main rings.
+    std::vector<size_t> next(rings.size(), 0);
+    for (;;) {
+      auto newest = rings.size();
+      for (size_t ring = 0; ring < rings.size(); ++ring) {
+        if (next[ring] < rings[ring].size() &&
+            (newest == rings.size() ||
+             rings[ring][next[ring]].timestamp >=
+                 rings[newest][next[newest]].timestamp)) {
+          newest = ring;
+        }
+      }
+      if (newest == rings.size()) {
+        break;
+      }
+      auto& entry = rings[newest][next[newest]++];
+      EntryParser::parse(entry.data.data(), entry.data.size(), visitor);
+    }
+  }
 
   output->flush();
   output->close();
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <unistd.h>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -30,6 +31,7 @@
 #include <profilo/mmapbuf/Buffer.h>
 #include <profilo/writer/PacketReassembler.h>
 #include <profilo/writer/TraceCallbacks.h>
+#include <profilo/writer/TraceCompressor.h>
 
 namespace facebook {
 namespace profilo {
@@ -50,6 +52,22 @@ class TraceWriter {
   // buffer: the ring buffer instance to use.
   // headers: a list of key-value headers to output at
   //          the beginning of the trace
+  // reader_latency_budget: if non-zero, wait for new entries by polling the
+  //          buffer, noticing them at most about this long after they're
+  //          written, instead of blocking on a futex. Loggers then never
+  //          make a syscall to wake up the writer.
+  // compressor: compresses trace files, zlib (see
+  //          TraceFileHelpers::defaultCompressor()) if null.
+  // pipelined: split processTrace() into three threads: reading the buffer,
+  //          running the visitors and compressing. The reader only waits
+  //          for the others when they fall behind by a few blocks of
+  //          output, or at trace control entries.
+  // skip_overruns: when the reader of a single ring buffer is overrun after
+  //          the trace has started, skip to the oldest packet left and count
+  //          the rest as overwritten (TRACE_BUFFER_PACKETS_OVERWRITTEN)
+  //          instead of aborting the trace with MISSED_EVENT. The trace then
+  //          ends normally, with holes. The main rings of tiered and sharded
+  //          buffers are always read this way.
   //
   TraceWriter(
       const std::string&& folder,
@@ -58,7 +76,12 @@ class TraceWriter {
       std::shared_ptr<TraceCallbacks> callbacks = nullptr,
       std::vector<std::pair<std::string, std::string>>&& headers =
           std::vector<std::pair<std::string, std::string>>(),
-      TraceBackwardsCallback trace_backwards_callback = nullptr);
+      TraceBackwardsCallback trace_backwards_callback = nullptr,
+      std::chrono::microseconds reader_latency_budget =
+          std::chrono::microseconds::zero(),
+      std::shared_ptr<TraceCompressor> compressor = nullptr,
+      bool pipelined = false,
+      bool skip_overruns = false);
 
   //
   // Wait until a submit() call and then process a submitted trace ID.
@@ -96,6 +119,13 @@ class TraceWriter {
   void submit(int64_t trace_id);
 
  private:
+  //
+  // processTrace() for buffers with a high priority ring or several shards:
+  // all rings are read and merged by timestamp. `cursor` is only used for an
+  // unsharded main ring, it's shard 0's cursor on return.
+  //
+  int64_t processMergedTrace(int64_t trace_id, TraceBuffer::Cursor& cursor);
+
   std::mutex wakeup_mutex_;
   std::condition_variable wakeup_cv_;
   std::unique_ptr<std::pair<TraceBuffer::Cursor, int64_t>> wakeup_trace_id_;
@@ -108,6 +138,10 @@ class TraceWriter {
 
   std::shared_ptr<TraceCallbacks> callbacks_;
   TraceBackwardsCallback trace_backwards_callback_;
+  std::chrono::microseconds reader_latency_budget_;
+  std::shared_ptr<TraceCompressor> compressor_;
+  const bool pipelined_;
+  const bool skip_overruns_;
 };
 
 } // namespace writer
@@ -0,0 +1,89 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <profilo/writer/TraceFileHelpers.h>
+#include <profilo/writer/VisitorChains.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+TextVisitorChain::TextVisitorChain(
+    std::ostream& stream,
+    const Logger* strings_logger)
+    : print_(stream),
+      delta_(print_),
+      truncating_(delta_, TraceFileHelpers::kTimestampPrecision),
+      inverting_(truncating_),
+      resolving_(inverting_, strings_logger) {}
+
+void TextVisitorChain::visit(const StandardEntry& entry) {
+  resolving_.visit(entry);
+}
+
+void TextVisitorChain::visit(const FramesEntry& entry) {
+  resolving_.visit(entry);
+}
+
+void TextVisitorChain::visit(const BytesEntry& entry) {
+  resolving_.visit(entry);
+}
+
+void TextVisitorChain::visit(const AnnotationEntry& entry) {
+  resolving_.visit(entry);
+}
+
+void TextVisitorChain::visitPrefix(
+    const FramesEntry& entry,
+    int32_t base,
+    uint16_t shared) {
+  resolving_.visitPrefix(entry, base, shared);
+}
+
+BinaryVisitorChain::BinaryVisitorChain(
+    std::ostream& stream,
+    const Logger* strings_logger)
+    : binary_(stream),
+      truncating_(binary_, TraceFileHelpers::kTimestampPrecision),
+      inverting_(truncating_),
+      resolving_(inverting_, strings_logger) {}
+
+void BinaryVisitorChain::visit(const StandardEntry& entry) {
+  resolving_.visit(entry);
+}
+
+void BinaryVisitorChain::visit(const FramesEntry& entry) {
+  resolving_.visit(entry);
+}
+
+void BinaryVisitorChain::visit(const BytesEntry& entry) {
+  resolving_.visit(entry);
+}
+
+void BinaryVisitorChain::visit(const AnnotationEntry& entry) {
+  resolving_.visit(entry);
+}
+
+void BinaryVisitorChain::visitPrefix(
+    const FramesEntry& entry,
+    int32_t base,
+    uint16_t shared) {
+  resolving_.visitPrefix(entry, base, shared);
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,107 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <ostream>
+
+#include <profilo/Logger.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/BinaryEntryVisitor.h>
+#include <profilo/writer/DeltaEncodingVisitor.h>
+#include <profilo/writer/PrintEntryVisitor.h>
+#include <profilo/writer/StackTraceInvertingVisitor.h>
+#include <profilo/writer/StringResolvingVisitor.h>
+#include <profilo/writer/TimestampTruncatingVisitor.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace entries;
+
+//
+// The visitor chains for traces without clock calibration, composed from
+// the concrete visitor types rather than linked through EntryVisitor&.
+// Entries go through one virtual call into the chain, every stage after
+// that calls the next one directly and can be inlined into it.
+//
+// Each chain writes exactly what the equivalent dynamic chain would.
+// Chains with other stages (e.g. TimestampRescalingVisitor) are still put
+// together from individual visitors.
+//
+
+//
+// StringResolvingVisitor -> StackTraceInvertingVisitor ->
+// TimestampTruncatingVisitor -> DeltaEncodingVisitor -> PrintEntryVisitor
+//
+class TextVisitorChain final : public EntryVisitor {
+ public:
+  TextVisitorChain(std::ostream& stream, const Logger* strings_logger);
+
+  virtual void visit(const StandardEntry& entry) override;
+  virtual void visit(const FramesEntry& entry) override;
+  virtual void visit(const BytesEntry& entry) override;
+  virtual void visit(const AnnotationEntry& entry) override;
+  virtual void visitPrefix(
+      const FramesEntry& entry,
+      int32_t base,
+      uint16_t shared) override;
+
+ private:
+  using Delta = BasicDeltaEncodingVisitor<PrintEntryVisitor>;
+  using Truncating = BasicTimestampTruncatingVisitor<Delta>;
+  using Inverting = BasicStackTraceInvertingVisitor<Truncating>;
+  using Resolving = BasicStringResolvingVisitor<Inverting>;
+
+  PrintEntryVisitor print_;
+  Delta delta_;
+  Truncating truncating_;
+  Inverting inverting_;
+  Resolving resolving_;
+};
+
+//
+// StringResolvingVisitor -> StackTraceInvertingVisitor ->
+// TimestampTruncatingVisitor -> BinaryEntryVisitor
+//
+class BinaryVisitorChain final : public EntryVisitor {
+ public:
+  BinaryVisitorChain(std::ostream& stream, const Logger* strings_logger);
+
+  virtual void visit(const StandardEntry& entry) override;
+  virtual void visit(const FramesEntry& entry) override;
+  virtual void visit(const BytesEntry& entry) override;
+  virtual void visit(const AnnotationEntry& entry) override;
+  virtual void visitPrefix(
+      const FramesEntry& entry,
+      int32_t base,
+      uint16_t shared) override;
+
+ private:
+  using Truncating = BasicTimestampTruncatingVisitor<BinaryEntryVisitor>;
+  using Inverting = BasicStackTraceInvertingVisitor<Truncating>;
+  using Resolving = BasicStringResolvingVisitor<Inverting>;
+
+  BinaryEntryVisitor binary_;
+  Truncating truncating_;
+  Inverting inverting_;
+  Resolving resolving_;
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
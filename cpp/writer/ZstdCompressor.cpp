@@ -0,0 +1,184 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/ZstdCompressor.h>
+
+#include <errno.h>
+#include <zstd.h>
+
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+class ZstdStreamBuffer : public std::streambuf {
+ public:
+  ZstdStreamBuffer(
+      std::streambuf* sink,
+      int level,
+      const ZSTD_CDict* dictionary)
+      : sink_(sink),
+        context_(ZSTD_createCCtx()),
+        input_(ZSTD_CStreamInSize()),
+        output_(ZSTD_CStreamOutSize()),
+        pending_(false) {
+    if (context_ == nullptr) {
+      throw std::bad_alloc();
+    }
+    check(ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, level));
+    if (dictionary != nullptr) {
+      check(ZSTD_CCtx_refCDict(context_, dictionary));
+    }
+    setp(input_.data(), input_.data() + input_.size());
+  }
+
+  ZstdStreamBuffer(const ZstdStreamBuffer&) = delete;
+  ZstdStreamBuffer& operator=(const ZstdStreamBuffer&) = delete;
+
+  virtual ~ZstdStreamBuffer() {
+    // Errors are ignored, like in zstr::ostreambuf and std::filebuf.
+    sync();
+    ZSTD_freeCCtx(context_);
+  }
+
+ protected:
+  virtual int_type overflow(int_type c) override {
+    if (compress(ZSTD_e_continue) != 0) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  virtual int sync() override {
+    if (!pending_ && pptr() == pbase()) {
+      // Don't write out empty frames.
+      return 0;
+    }
+    return compress(ZSTD_e_end);
+  }
+
+ private:
+  std::streambuf* sink_;
+  ZSTD_CCtx* context_;
+  std::vector<char> input_;
+  std::vector<char> output_;
+  // Whether the current frame has any input.
+  bool pending_;
+
+  static void check(size_t result) {
+    if (ZSTD_isError(result)) {
+      throw std::runtime_error(ZSTD_getErrorName(result));
+    }
+  }
+
+  // Feed the buffered input to the compressor and write out what it
+  // produces. Returns 0 on success, -1 otherwise.
+  int compress(ZSTD_EndDirective mode) {
+    ZSTD_inBuffer input{
+        .src = pbase(),
+        .size = static_cast<size_t>(pptr() - pbase()),
+        .pos = 0};
+    pending_ = pending_ || input.size > 0;
+
+    bool done = false;
+    while (!done) {
+      ZSTD_outBuffer output{
+          .dst = output_.data(), .size = output_.size(), .pos = 0};
+      size_t remaining =
+          ZSTD_compressStream2(context_, &output, &input, mode);
+      if (ZSTD_isError(remaining)) {
+        return -1;
+      }
+      auto written = sink_->sputn(output_.data(), output.pos);
+      if (written != static_cast<std::streamsize>(output.pos)) {
+        return -1;
+      }
+      done = mode == ZSTD_e_end ? remaining == 0 : input.pos == input.size;
+    }
+
+    setp(input_.data(), input_.data() + input_.size());
+    if (mode == ZSTD_e_end) {
+      pending_ = false;
+    }
+    return 0;
+  }
+};
+
+} // namespace
+
+constexpr int ZstdCompressor::kDefaultLevel;
+
+void ZstdCompressor::DictionaryDeleter::operator()(
+    ZSTD_CDict_s* dictionary) const {
+  ZSTD_freeCDict(dictionary);
+}
+
+ZstdCompressor::ZstdCompressor(int level, const std::string& dictionary)
+    : level_(level), dictionary_(nullptr), dictionary_id_(0) {
+  if (dictionary.empty()) {
+    return;
+  }
+  dictionary_.reset(
+      ZSTD_createCDict(dictionary.data(), dictionary.size(), level));
+  if (dictionary_ == nullptr) {
+    throw std::invalid_argument("Could not load zstd dictionary");
+  }
+  dictionary_id_ =
+      ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+}
+
+std::shared_ptr<ZstdCompressor> ZstdCompressor::fromDictionaryFile(
+    const std::string& path,
+    int level) {
+  std::ifstream file(path, std::ifstream::in | std::ifstream::binary);
+  if (!file) {
+    std::string error = std::string("Could not open dictionary ") + path;
+    throw std::system_error(errno, std::system_category(), error);
+  }
+  std::string dictionary(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return std::make_shared<ZstdCompressor>(level, dictionary);
+}
+
+std::string ZstdCompressor::description() const {
+  auto description = "zstd:" + std::to_string(level_);
+  if (dictionary_ != nullptr) {
+    description += ":dict=" + std::to_string(dictionary_id_);
+  }
+  return description;
+}
+
+std::unique_ptr<std::streambuf> ZstdCompressor::wrap(
+    std::streambuf* sink) const {
+  return std::make_unique<ZstdStreamBuffer>(sink, level_, dictionary_.get());
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
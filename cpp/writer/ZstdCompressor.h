@@ -0,0 +1,71 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <profilo/writer/TraceCompressor.h>
+
+struct ZSTD_CDict_s;
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Zstandard, optionally with a dictionary trained on trace files (e.g. with
+// `zstd --train`). Traces share a lot of vocabulary, like entry type names
+// and framework frames, which a dictionary saves every trace from having to
+// spell out again.
+//
+// Readers need the same dictionary. Its ID is part of the description and
+// of every zstd frame header.
+//
+class ZstdCompressor : public TraceCompressor {
+ public:
+  static constexpr int kDefaultLevel = 3;
+
+  // `dictionary`: contents of a trained dictionary, none if empty.
+  explicit ZstdCompressor(
+      int level = kDefaultLevel,
+      const std::string& dictionary = std::string());
+
+  // Throws std::system_error if the dictionary file can't be read.
+  static std::shared_ptr<ZstdCompressor> fromDictionaryFile(
+      const std::string& path,
+      int level = kDefaultLevel);
+
+  virtual std::string description() const override;
+  virtual std::unique_ptr<std::streambuf> wrap(
+      std::streambuf* sink) const override;
+
+ private:
+  struct DictionaryDeleter {
+    void operator()(ZSTD_CDict_s* dictionary) const;
+  };
+
+  const int level_;
+  // Digested once, shared by the streams of every trace.
+  std::unique_ptr<ZSTD_CDict_s, DictionaryDeleter> dictionary_;
+  uint32_t dictionary_id_;
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -16,6 +16,8 @@
 
 #include "trace_backwards.h"
 
+#include <vector>
+
 #include <profilo/entries/EntryParser.h>
 #include <profilo/writer/PacketReassembler.h>
 
@@ -27,19 +29,43 @@ void traceBackwards(
     entries::EntryVisitor& visitor,
     TraceBuffer& buffer,
     TraceBuffer::Cursor& cursor) {
-  PacketReassembler reassembler([&visitor](const void* data, size_t size) {
-    entries::EntryParser::parse(data, size, visitor);
-  });
+  traceBackwards(
+      [&visitor](const void* data, size_t size) {
+        entries::EntryParser::parse(data, size, visitor);
+      },
+      buffer,
+      cursor);
+}
+
+void traceBackwards(
+    const std::function<void(const void*, size_t)>& onPayload,
+    TraceBuffer& buffer,
+    TraceBuffer::Cursor& cursor) {
+  PacketReassembler reassembler(onPayload);
 
-  TraceBuffer::Cursor backCursor{cursor};
-  backCursor.moveBackward(); // Move back before trace start
+  constexpr size_t kChunkSize = 1024;
+  std::vector<Packet> packets(kChunkSize);
+  std::vector<uint64_t> valid(TraceBuffer::snapshotBitmapWords(kChunkSize));
 
-  alignas(4) Packet packet;
-  while (buffer.tryRead(packet, backCursor)) {
-    reassembler.processBackwards(packet);
-    if (!backCursor.moveBackward()) {
+  // Copy the buffer in chunks, starting right before the trace start, and
+  // walk each chunk from its end.
+  TraceBuffer::Cursor chunkEnd{cursor};
+  for (;;) {
+    TraceBuffer::Cursor chunkStart{chunkEnd};
+    chunkStart.moveBackward(kChunkSize);
+    size_t count = chunkStart.distanceTo(chunkEnd);
+    if (count == 0) {
       break; // done
     }
+
+    buffer.snapshot(chunkStart, count, packets.data(), valid.data());
+    for (size_t i = count; i-- > 0;) {
+      if ((valid[i / 64] & (uint64_t{1} << (i % 64))) == 0) {
+        return; // overwritten or not written yet
+      }
+      reassembler.processBackwards(packets[i]);
+    }
+    chunkEnd = chunkStart;
   }
 }
 
@@ -16,6 +16,7 @@
 
 #include <profilo/entries/EntryParser.h>
 #include <profilo/logger/buffer/TraceBuffer.h>
+#include <functional>
 
 namespace facebook {
 namespace profilo {
@@ -26,6 +27,12 @@ void traceBackwards(
     TraceBuffer& buffer,
     TraceBuffer::Cursor& cursor);
 
+// Same, but hands each reassembled entry to `onPayload` unparsed.
+void traceBackwards(
+    const std::function<void(const void*, size_t)>& onPayload,
+    TraceBuffer& buffer,
+    TraceBuffer::Cursor& cursor);
+
 } // namespace writer
 } // namespace profilo
 } // namespace facebook
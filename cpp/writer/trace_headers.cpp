@@ -24,6 +24,7 @@
 #include <vector>
 
 #include <profilo/util/common.h>
+#include <profilo/writer/TraceFileHelpers.h>
 
 namespace facebook {
 namespace profilo {
@@ -31,7 +32,7 @@ namespace writer {
 
 std::vector<std::pair<std::string, std::string>> calculateHeaders(pid_t pid) {
   auto result = std::vector<std::pair<std::string, std::string>>();
-  result.reserve(4);
+  result.reserve(6);
 
   {
     std::stringstream ss;
@@ -59,6 +60,18 @@ std::vector<std::pair<std::string, std::string>> calculateHeaders(pid_t pid) {
       result.push_back(std::make_pair("os", ss.str()));
     }
   }
+  {
+    auto source = getClockSource();
+    if (source != ClockSource::SYSCALL) {
+      result.push_back(
+          std::make_pair("clock_source", getClockSourceName(source)));
+    }
+    if (source == ClockSource::COUNTER) {
+      result.push_back(std::make_pair(
+          TraceFileHelpers::kClockCalibrationHeader,
+          getClockCalibration().toString()));
+    }
+  }
   {
     static constexpr int kBackTracingWindowMicroSeconds =
         10000000; // 10 seconds
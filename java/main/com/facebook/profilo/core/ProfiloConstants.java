@@ -41,6 +41,7 @@ public final class ProfiloConstants {
   public static final String SYSTEM_CONFIG_TIMED_OUT_UPLOAD_SAMPLE_RATE =
       "system_config.timed_out_upload_sample_rate";
   public static final String TIME_SOURCE_PARAM = "provider.stack_trace.time_source";
+  public static final String SYSTEM_CONFIG_CLOCK_SOURCE = "system_config.clock_source";
   public static final String TRACE_CONFIG_COINFLIP_SAMPLE_RATE =
       "trace_config.coinflip_sample_rate";
   public static final String TRACE_CONFIG_TRACE_CONFIG_ID_SWITCH =
@@ -84,6 +85,16 @@ public final class ProfiloConstants {
   public static final String TRACE_CONFIG_PARAM_TRACE_TIMEOUT_MS = "trace_config.trace_timeout_ms";
   public static final String TRACE_CONFIG_PARAM_LOGGER_PRIORITY = "trace_config.logger_priority";
   public static final int TRACE_CONFIG_PARAM_LOGGER_PRIORITY_DEFAULT = 5;
+  public static final String TRACE_CONFIG_PARAM_WRITER_LATENCY_BUDGET_US =
+      "trace_config.writer_latency_budget_us";
+  public static final int TRACE_CONFIG_PARAM_WRITER_LATENCY_BUDGET_US_DEFAULT = 0;
+  public static final String TRACE_CONFIG_PARAM_WRITER_PIPELINED = "trace_config.writer_pipelined";
+  public static final String TRACE_CONFIG_PARAM_WRITER_COMPRESSION =
+      "trace_config.writer_compression";
+  public static final String TRACE_CONFIG_PARAM_WRITER_COMPRESSION_LEVEL =
+      "trace_config.writer_compression_level";
+  public static final String TRACE_CONFIG_PARAM_WRITER_COMPRESSION_DICTIONARY =
+      "trace_config.writer_compression_dictionary";
   public static final String TRACE_CONFIG_PARAM_POST_TRACE_EXTENSION_MSEC =
       "trace_config.post_trace_extension_ms";
   public static final int TRACE_CONFIG_PARAM_POST_TRACE_EXTENSION_MSEC_DEFAULT = 0;
@@ -102,6 +113,7 @@ public final class ProfiloConstants {
   public static final int PROVIDER_PARAM_NATIVE_STACK_TRACE_UNWINDER_QUEUE_SIZE_DEFAULT = 256;
   public static final String PROVIDER_PARAM_NATIVE_STACK_TRACE_LOG_PARTIAL_STACKS =
       "provider.native_stack_trace.log_partial_stacks";
+  public static final String PROVIDER_PARAM_ATRACE_SPIN_BUDGET = "provider.atrace.spin_budget";
 
   // Keys to query conditions in a config
   public static final String TRACE_CONFIG_DURATION_CONDITION = "trace_config.duration_condition";
@@ -399,13 +399,26 @@ public final class TraceControl {
         config.optSystemConfigParamInt("system_config.buffer_size", DEFAULT_RING_BUFFER_SIZE);
     boolean filebacked = traceConfigExtras.getBoolParam("trace_config.mmap_buffer", false);
     int[] bufferSizes = traceConfigExtras.getIntArrayParam("trace_config.buffer_sizes");
+    boolean writeCombining = traceConfigExtras.getBoolParam("trace_config.write_combining", false);
+    boolean compactEntries = traceConfigExtras.getBoolParam("trace_config.compact_entries", false);
+    boolean roundUpCapacity =
+        traceConfigExtras.getBoolParam("trace_config.round_up_buffer_capacity", false);
+    int prioritySize = traceConfigExtras.getIntParam("trace_config.priority_buffer_size", 0);
+    int shardMode =
+        traceConfigExtras.getIntParam(
+            "trace_config.buffer_shard_mode", MmapBufferManager.SHARD_MODE_NONE);
 
     Buffer[] buffers = new Buffer[bufferCount];
     for (int idx = 0; idx < bufferCount; idx++) {
       buffers[idx] =
           mBufferManager.allocateBuffer(
               bufferSizes != null && idx < bufferSizes.length ? bufferSizes[idx] : systemBufferSize,
-              filebacked);
+              filebacked,
+              writeCombining,
+              compactEntries,
+              roundUpCapacity,
+              prioritySize,
+              shardMode);
     }
     return buffers;
   }
@@ -326,7 +326,18 @@ public class TraceControlHandler extends Handler {
                 public void onTraceWriteException(long traceId, Throwable t) {
                   mCallbacks.onTraceWriteException(context, t);
                 }
-              });
+              },
+              context.mTraceConfigExtras.getIntParam(
+                  ProfiloConstants.TRACE_CONFIG_PARAM_WRITER_LATENCY_BUDGET_US,
+                  ProfiloConstants.TRACE_CONFIG_PARAM_WRITER_LATENCY_BUDGET_US_DEFAULT),
+              context.mTraceConfigExtras.getBoolParam(
+                  ProfiloConstants.TRACE_CONFIG_PARAM_WRITER_PIPELINED, false),
+              context.mTraceConfigExtras.getStringParam(
+                  ProfiloConstants.TRACE_CONFIG_PARAM_WRITER_COMPRESSION, null),
+              context.mTraceConfigExtras.getIntParam(
+                  ProfiloConstants.TRACE_CONFIG_PARAM_WRITER_COMPRESSION_LEVEL, 0),
+              context.mTraceConfigExtras.getStringParam(
+                  ProfiloConstants.TRACE_CONFIG_PARAM_WRITER_COMPRESSION_DICTIONARY, null));
     } catch (IOException e) {
       throw new IllegalArgumentException(
           "Could not get canonical path of trace directory " + context.folder, e);
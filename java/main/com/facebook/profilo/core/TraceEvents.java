@@ -23,6 +23,12 @@ public final class TraceEvents {
     SoLoader.loadLibrary("profilo");
   }
 
+  // Values of ClockSource in util/common.h. The CPU counter isn't listed: entries logged from Java
+  // carry CLOCK_MONOTONIC timestamps, so the native side refuses it.
+  public static final int CLOCK_SOURCE_SYSCALL = 0;
+  public static final int CLOCK_SOURCE_VDSO = 1;
+  public static final int CLOCK_SOURCE_COARSE = 2;
+
   private static int sLastNameRefreshProvidersState;
   private static volatile int sProviders = 0;
 
@@ -70,6 +76,14 @@ public final class TraceEvents {
     nativeRefreshProviderNames(providerIds, providerNames);
   }
 
+  /**
+   * Selects where native code reads timestamps from, one of the CLOCK_SOURCE_* values. Returns
+   * false and keeps the current source if it's not supported.
+   */
+  public static synchronized boolean setClockSource(int clockSource) {
+    return nativeSetClockSource(clockSource);
+  }
+
   static native int nativeEnableProviders(int providers);
 
   static native int nativeDisableProviders(int providers);
@@ -77,4 +91,6 @@ public final class TraceEvents {
   static native void nativeClearAllProviders();
 
   static native void nativeRefreshProviderNames(int[] providerIds, String[] providerNames);
+
+  static native boolean nativeSetClockSource(int clockSource);
 }
@@ -304,6 +304,13 @@ public final class TraceOrchestrator
 
     mConfig = newConfig;
 
+    int clockSource =
+        newConfig.optSystemConfigParamInt(
+            ProfiloConstants.SYSTEM_CONFIG_CLOCK_SOURCE, TraceEvents.CLOCK_SOURCE_SYSCALL);
+    if (!TraceEvents.setClockSource(clockSource)) {
+      Log.e(TAG, "Unsupported clock source: " + clockSource);
+    }
+
     TraceControl traceControl = TraceControl.get();
     if (traceControl == null) {
       throw new IllegalStateException(
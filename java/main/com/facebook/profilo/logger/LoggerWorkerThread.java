@@ -18,6 +18,7 @@ import com.facebook.profilo.core.ProfiloConstants;
 import com.facebook.profilo.mmapbuf.core.Buffer;
 import com.facebook.profilo.writer.NativeTraceWriter;
 import com.facebook.profilo.writer.NativeTraceWriterCallbacks;
+import javax.annotation.Nullable;
 
 public class LoggerWorkerThread extends Thread {
 
@@ -33,7 +34,12 @@ public class LoggerWorkerThread extends Thread {
       String folder,
       String prefix,
       Buffer[] buffers,
-      NativeTraceWriterCallbacks callbacks) {
+      NativeTraceWriterCallbacks callbacks,
+      int readerLatencyBudgetUs,
+      boolean pipelined,
+      @Nullable String compression,
+      int compressionLevel,
+      @Nullable String compressionDictionary) {
     super("Prflo:Logger");
     mTraceId = traceId;
     mFolder = folder;
@@ -41,7 +47,17 @@ public class LoggerWorkerThread extends Thread {
     mBuffers = buffers;
     boolean needsCachedCallbacks = buffers.length > 1;
     mCallbacks = new CachingNativeTraceWriterCallbacks(needsCachedCallbacks, callbacks);
-    mMainTraceWriter = new NativeTraceWriter(buffers[0], folder, prefix + "-0", mCallbacks);
+    mMainTraceWriter =
+        new NativeTraceWriter(
+            buffers[0],
+            folder,
+            prefix + "-0",
+            mCallbacks,
+            readerLatencyBudgetUs,
+            pipelined,
+            compression,
+            compressionLevel,
+            compressionDictionary);
   }
 
   public NativeTraceWriter getTraceWriter() {
@@ -17,4 +17,6 @@ public abstract class Trace {
   // Configuration flags
   public static final int FLAG_MANUAL = 1;
   public static final int FLAG_MEMORY_ONLY = 1 << 1;
+  // Write the trace file in the binary format instead of as text
+  public static final int FLAG_BINARY_OUTPUT = 1 << 2;
 }
@@ -25,6 +25,11 @@ public class MmapBufferManager {
 
   private static final String LOG_TAG = "Profilo/MmapBufferMngr";
 
+  // Values of shardMode in allocateBuffer(), see mmapbuf::header::ShardMode.
+  public static final int SHARD_MODE_NONE = 0;
+  public static final int SHARD_MODE_PER_CPU = 1;
+  public static final int SHARD_MODE_PER_CLUSTER = 2;
+
   static {
     SoLoader.loadLibrary("profilo_mmapbuf");
   }
@@ -42,15 +47,51 @@ public class MmapBufferManager {
 
   @Nullable
   public Buffer allocateBuffer(int size, boolean filebacked) {
+    return allocateBuffer(size, filebacked, false, false);
+  }
+
+  @Nullable
+  public Buffer allocateBuffer(
+      int size, boolean filebacked, boolean writeCombining, boolean compactEntries) {
+    return allocateBuffer(
+        size, filebacked, writeCombining, compactEntries, false, 0, SHARD_MODE_NONE);
+  }
+
+  /**
+   * @param writeCombining stage small entries in per-thread areas before they reach the buffer. A
+   *     crash loses each thread's most recent staged entries, which never reached the buffer.
+   * @param compactEntries write entries in their compact encoding, so the buffer holds more history
+   * @param roundUpCapacity round the buffer's capacity up to the next power of two
+   * @param prioritySize size of a second ring holding only high priority entries, 0 for none
+   * @param shardMode one of the SHARD_MODE_* constants. Splits {@code size} over one ring per CPU
+   *     or per CPU cluster.
+   */
+  @Nullable
+  public Buffer allocateBuffer(
+      int size,
+      boolean filebacked,
+      boolean writeCombining,
+      boolean compactEntries,
+      boolean roundUpCapacity,
+      int prioritySize,
+      int shardMode) {
     if (filebacked) {
       String fileName = MmapBufferFileHelper.getBufferFilename(UUID.randomUUID().toString());
       String mmapBufferPath = mFileHelper.ensureFilePath(fileName);
       if (mmapBufferPath == null) {
         return null;
       }
-      return nativeAllocateBuffer(size, mmapBufferPath);
+      return nativeAllocateBuffer(
+          size,
+          mmapBufferPath,
+          writeCombining,
+          compactEntries,
+          roundUpCapacity,
+          prioritySize,
+          shardMode);
     } else {
-      return nativeAllocateBuffer(size);
+      return nativeAllocateBuffer(
+          size, writeCombining, compactEntries, roundUpCapacity, prioritySize, shardMode);
     }
   }
 
@@ -60,11 +101,24 @@ public class MmapBufferManager {
 
   @DoNotStrip
   @Nullable
-  private native Buffer nativeAllocateBuffer(int size);
+  private native Buffer nativeAllocateBuffer(
+      int size,
+      boolean writeCombining,
+      boolean compactEntries,
+      boolean roundUpCapacity,
+      int prioritySize,
+      int shardMode);
 
   @DoNotStrip
   @Nullable
-  private native Buffer nativeAllocateBuffer(int size, String path);
+  private native Buffer nativeAllocateBuffer(
+      int size,
+      String path,
+      boolean writeCombining,
+      boolean compactEntries,
+      boolean roundUpCapacity,
+      int prioritySize,
+      int shardMode);
 
   @DoNotStrip
   private native boolean nativeDeallocateBuffer(Buffer buffer);
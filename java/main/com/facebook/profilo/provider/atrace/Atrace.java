@@ -36,12 +36,16 @@ public final class Atrace {
     return sHasHook;
   }
 
-  public static void enableSystrace(MultiBufferLogger logger) {
+  /**
+   * @param spinBudget how many times hooked atrace writes may retry a contended ring slot before
+   *     dropping the entry; 0 waits for the slot instead.
+   */
+  public static void enableSystrace(MultiBufferLogger logger, int spinBudget) {
     if (!hasHacks(logger)) {
       return;
     }
 
-    enableSystraceNative();
+    enableSystraceNative(spinBudget);
 
     SystraceReflector.updateSystraceTags();
   }
@@ -58,7 +62,7 @@ public final class Atrace {
 
   private static native boolean installSystraceHook(MultiBufferLogger logger, int mask);
 
-  private static native void enableSystraceNative();
+  private static native void enableSystraceNative(int spinBudget);
 
   private static native void restoreSystraceNative();
 
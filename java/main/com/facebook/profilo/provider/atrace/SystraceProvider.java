@@ -14,7 +14,9 @@
 package com.facebook.profilo.provider.atrace;
 
 import com.facebook.profilo.core.BaseTraceProvider;
+import com.facebook.profilo.core.ProfiloConstants;
 import com.facebook.profilo.core.ProvidersRegistry;
+import com.facebook.profilo.ipc.TraceContext;
 
 public final class SystraceProvider extends BaseTraceProvider {
 
@@ -26,7 +28,13 @@ public final class SystraceProvider extends BaseTraceProvider {
 
   @Override
   protected void enable() {
-    Atrace.enableSystrace(getLogger());
+    TraceContext context = getEnablingTraceContext();
+    int spinBudget =
+        context == null
+            ? 0
+            : context.mTraceConfigExtras.getIntParam(
+                ProfiloConstants.PROVIDER_PARAM_ATRACE_SPIN_BUDGET, 0);
+    Atrace.enableSystrace(getLogger(), spinBudget);
   }
 
   @Override
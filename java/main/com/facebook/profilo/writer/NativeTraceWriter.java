@@ -32,14 +32,72 @@ public final class NativeTraceWriter {
       String traceFolder,
       String tracePrefix,
       @Nullable NativeTraceWriterCallbacks callbacks) {
-    mHybridData = initHybrid(buffer, traceFolder, tracePrefix, callbacks);
+    this(buffer, traceFolder, tracePrefix, callbacks, 0, false);
+  }
+
+  /**
+   * @param readerLatencyBudgetUs if non-zero, poll the buffer for new entries, noticing them at
+   *     most about this many microseconds after they're written, instead of having loggers wake
+   *     up the writer.
+   * @param pipelined read the buffer, format entries and compress the trace on separate threads.
+   */
+  public NativeTraceWriter(
+      Buffer buffer,
+      String traceFolder,
+      String tracePrefix,
+      @Nullable NativeTraceWriterCallbacks callbacks,
+      int readerLatencyBudgetUs,
+      boolean pipelined) {
+    this(
+        buffer,
+        traceFolder,
+        tracePrefix,
+        callbacks,
+        readerLatencyBudgetUs,
+        pipelined,
+        null,
+        0,
+        null);
+  }
+
+  /**
+   * @param compression "zlib" or "zstd", zlib if null.
+   * @param compressionLevel compression level, the compressor's default if 0.
+   * @param compressionDictionary path of a trained zstd dictionary, none if null.
+   */
+  public NativeTraceWriter(
+      Buffer buffer,
+      String traceFolder,
+      String tracePrefix,
+      @Nullable NativeTraceWriterCallbacks callbacks,
+      int readerLatencyBudgetUs,
+      boolean pipelined,
+      @Nullable String compression,
+      int compressionLevel,
+      @Nullable String compressionDictionary) {
+    mHybridData =
+        initHybrid(
+            buffer,
+            traceFolder,
+            tracePrefix,
+            callbacks,
+            readerLatencyBudgetUs,
+            pipelined,
+            compression != null ? compression : "",
+            compressionLevel,
+            compressionDictionary != null ? compressionDictionary : "");
   }
 
   private static native HybridData initHybrid(
       Buffer buffer,
       String traceFolder,
       String tracePrefix,
-      @Nullable NativeTraceWriterCallbacks callbacks);
+      @Nullable NativeTraceWriterCallbacks callbacks,
+      int readerLatencyBudgetUs,
+      boolean pipelined,
+      String compression,
+      int compressionLevel,
+      String compressionDictionary);
 
   public native void loop();
 
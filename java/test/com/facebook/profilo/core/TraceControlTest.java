@@ -120,7 +120,9 @@ public class TraceControlTest {
     mTraceContext.mTraceConfigExtras = new TraceConfigExtras(mConfig, 0);
 
     MmapBufferManager manager = mock(MmapBufferManager.class);
-    when(manager.allocateBuffer(anyInt(), anyBoolean())).thenReturn(mTraceContext.mainBuffer);
+    when(manager.allocateBuffer(
+            anyInt(), anyBoolean(), anyBoolean(), anyBoolean(), anyBoolean(), anyInt(), anyInt()))
+        .thenReturn(mTraceContext.mainBuffer);
     mTraceControl =
         new TraceControl(
             mControllers,
@@ -87,4 +87,8 @@ ANNOTATION_NAMES = {
     8126491: "PROF_ERR_SIG_CRASHES",
     8126492: "PROF_ERR_SLOT_MISSES",
     8126493: "PROF_ERR_STACK_OVERFLOWS",
+    8126554: "TRACE_BUFFER_PACKETS_WRITTEN",
+    8126555: "TRACE_BUFFER_PACKETS_OVERWRITTEN",
+    8126556: "TRACE_BUFFER_TORN_READS",
+    8126557: "TRACE_BUFFER_STREAMS_DROPPED",
 }
@@ -15,9 +15,18 @@ limitations under the License.
 """
 
 
+import gzip
+import io
+import struct
 from collections import namedtuple
 
 
+# Magic bytes at the start of trace files, by compressor (see
+# TraceCompressor and the "compression" trace header).
+GZIP_MAGIC = b"\x1f\x8b"
+ZSTD_MAGIC = b"\x28\xb5\x2f\xfd"
+
+
 class TraceEntry(object):
     @staticmethod
     def construct(line):
@@ -29,6 +38,25 @@ class TraceEntry(object):
                 arg1=int(line[2]),
                 data=line[3],
             )
+        elif len(line) == 5 or line[5][1:2] == ":":
+            # Annotation pairs are printed as <kind>:<key>=<value>.
+            pairs = {}
+            for pair in line[5:]:
+                kind, pair = pair.split(":", 1)
+                key, value = pair.split("=", 1)
+                if kind == "i":
+                    value = int(value)
+                elif kind == "d":
+                    value = float(value)
+                pairs[key] = value
+            return AnnotationEntry(
+                id=int(line[0]),
+                type=line[1],
+                timestamp=int(line[2]),
+                tid=int(line[3]),
+                arg2=int(line[4]),
+                pairs=pairs,
+            )
         else:
             return StandardEntry(
                 id=int(line[0]),
@@ -61,6 +89,232 @@ class BytesEntry(
     pass
 
 
+class AnnotationEntry(
+    TraceEntry,
+    namedtuple(
+        "AnnotationEntry",
+        ["id", "type", "timestamp", "tid", "arg2", "pairs"],
+    ),
+):
+    pass
+
+
+class BinaryTraceReader(object):
+    """
+    Reads the entries of a binary trace, written by BinaryEntryVisitor.
+    """
+
+    VERSION = 1
+
+    STANDARD, FRAMES, BYTES, ANNOTATION = range(4)
+
+    # Columns of each kind of entry, in order. Columns marked True hold
+    # deltas to the previous value in the column.
+    COLUMNS = {
+        STANDARD: [
+            ("id", True),
+            ("type", False),
+            ("timestamp", True),
+            ("tid", True),
+            ("callid", True),
+            ("matchid", True),
+            ("extra", True),
+        ],
+        FRAMES: [
+            ("id", True),
+            ("type", False),
+            ("timestamp", True),
+            ("tid", True),
+            ("matchid", True),
+            ("count", False),
+        ],
+        BYTES: [
+            ("id", True),
+            ("type", False),
+            ("matchid", True),
+            ("string", False),
+        ],
+        ANNOTATION: [
+            ("id", True),
+            ("type", False),
+            ("timestamp", True),
+            ("tid", True),
+            ("matchid", True),
+            ("size", False),
+        ],
+    }
+
+    PAIR_INT, PAIR_DOUBLE, PAIR_STRING = range(3)
+
+    def __init__(self, data, timestamp_multiplier):
+        super(BinaryTraceReader, self).__init__()
+        self.data = data
+        self.offset = 0
+        self.timestamp_multiplier = timestamp_multiplier
+        self.types = {}
+        self.strings = []
+        # Last value of each delta encoded column, by (kind, column).
+        self.last = {}
+
+    def entries(self):
+        while self.offset < len(self.data):
+            for entry in self.__read_block():
+                yield entry
+
+    def __read_varint(self):
+        value = 0
+        shift = 0
+        while True:
+            byte = self.data[self.offset]
+            self.offset += 1
+            value |= (byte & 0x7F) << shift
+            if byte & 0x80 == 0:
+                return value
+            shift += 7
+
+    def __read_bytes(self, size):
+        value = self.data[self.offset : self.offset + size]
+        if len(value) != size:
+            raise ValueError("Truncated binary trace")
+        self.offset += size
+        return value
+
+    def __read_column(self, kind, name, delta, count):
+        values = []
+        last = self.last.get((kind, name), 0)
+        for _ in range(count):
+            value = self.__read_varint()
+            if delta:
+                # Zigzag, then 64 bit wrapping addition.
+                value = (value >> 1) ^ -(value & 1)
+                last = (last + value + 0x8000000000000000) % (
+                    2 * 0x8000000000000000
+                ) - 0x8000000000000000
+                value = last
+            values.append(value)
+        if delta:
+            self.last[(kind, name)] = last
+        return values
+
+    def __read_columns(self, kind, count):
+        return {
+            name: self.__read_column(kind, name, delta, count)
+            for name, delta in self.COLUMNS[kind]
+        }
+
+    def __read_pairs(self, data):
+        pairs = {}
+        offset = 0
+        while offset < len(data):
+            kind, key_size = struct.unpack_from("<BH", data, offset)
+            offset += 3
+            key = data[offset : offset + key_size].decode("utf-8")
+            offset += key_size
+            if kind == self.PAIR_INT:
+                (value,) = struct.unpack_from("<q", data, offset)
+                offset += 8
+            elif kind == self.PAIR_DOUBLE:
+                (value,) = struct.unpack_from("<d", data, offset)
+                offset += 8
+            else:
+                (size,) = struct.unpack_from("<H", data, offset)
+                offset += 2
+                value = data[offset : offset + size].decode("utf-8")
+                offset += size
+            pairs[key] = value
+        return pairs
+
+    def __read_block(self):
+        rows = self.__read_varint()
+        for _ in range(self.__read_varint()):
+            type = self.__read_varint()
+            self.types[type] = self.__read_bytes(self.__read_varint()).decode(
+                "utf-8"
+            )
+        for _ in range(self.__read_varint()):
+            string = self.__read_bytes(self.__read_varint())
+            self.strings.append(string.decode("utf-8", "replace"))
+        kinds = self.__read_bytes(rows)
+
+        standard = self.__read_columns(self.STANDARD, kinds.count(self.STANDARD))
+        frames = self.__read_columns(self.FRAMES, kinds.count(self.FRAMES))
+        frame_count = sum(frames["count"])
+        frame_values = struct.unpack(
+            "<%dq" % frame_count, self.__read_bytes(8 * frame_count)
+        )
+        byte_entries = self.__read_columns(self.BYTES, kinds.count(self.BYTES))
+        annotations = self.__read_columns(
+            self.ANNOTATION, kinds.count(self.ANNOTATION)
+        )
+        pairs = self.__read_bytes(sum(annotations["size"]))
+
+        entries = []
+        index = {kind: 0 for kind in self.COLUMNS}
+        frame_offset = 0
+        pairs_offset = 0
+        for kind in kinds:
+            idx = index[kind]
+            index[kind] += 1
+            if kind == self.STANDARD:
+                entries.append(
+                    StandardEntry(
+                        id=standard["id"][idx],
+                        type=self.types[standard["type"][idx]],
+                        timestamp=standard["timestamp"][idx]
+                        * self.timestamp_multiplier,
+                        tid=standard["tid"][idx],
+                        arg1=standard["callid"][idx],
+                        arg2=standard["matchid"][idx],
+                        arg3=standard["extra"][idx],
+                    )
+                )
+            elif kind == self.FRAMES:
+                # One entry per frame, like in text traces.
+                count = frames["count"][idx]
+                for frame in range(count):
+                    entries.append(
+                        StandardEntry(
+                            id=frames["id"][idx] + frame,
+                            type=self.types[frames["type"][idx]],
+                            timestamp=frames["timestamp"][idx]
+                            * self.timestamp_multiplier,
+                            tid=frames["tid"][idx],
+                            arg1=0,
+                            arg2=frames["matchid"][idx],
+                            arg3=frame_values[frame_offset + frame],
+                        )
+                    )
+                frame_offset += count
+            elif kind == self.BYTES:
+                entries.append(
+                    BytesEntry(
+                        id=byte_entries["id"][idx],
+                        type=self.types[byte_entries["type"][idx]],
+                        arg1=byte_entries["matchid"][idx],
+                        data=self.strings[byte_entries["string"][idx]],
+                    )
+                )
+            elif kind == self.ANNOTATION:
+                size = annotations["size"][idx]
+                entries.append(
+                    AnnotationEntry(
+                        id=annotations["id"][idx],
+                        type=self.types[annotations["type"][idx]],
+                        timestamp=annotations["timestamp"][idx]
+                        * self.timestamp_multiplier,
+                        tid=annotations["tid"][idx],
+                        arg2=annotations["matchid"][idx],
+                        pairs=self.__read_pairs(
+                            pairs[pairs_offset : pairs_offset + size]
+                        ),
+                    )
+                )
+                pairs_offset += size
+            else:
+                raise ValueError("Unknown entry kind {}".format(kind))
+        return entries
+
+
 class TraceFile(object):
     def __init__(self, headers={}, entries=[]):
         super(TraceFile, self).__init__()
@@ -84,16 +338,62 @@ class TraceFile(object):
         return val
 
     @staticmethod
-    def __delta_decode_entries(headers, delta_encoded):
+    def __timestamp_multiplier(headers):
         # Timestamp precision for all standard entry timestamps is in the
         # headers. Maximum precision is 9 for 10^-9, i.e. nanoseconds.
         precision = int(headers.get("prec", 0))
         # Figure out the multiplication factor from the precision to nanos.
-        timestamp_multiplier = pow(10, (9 - precision))
+        return pow(10, (9 - precision))
+
+    @staticmethod
+    def __parse_headers(data):
+        # Headers have a `key|value` format.
+        headers = [x.split("|") for x in data.split("\n")]
+        return {x[0]: x[1] for x in headers if len(x) >= 2}
+
+    @staticmethod
+    def __delta_decode_entries(headers, delta_encoded):
+        timestamp_multiplier = TraceFile.__timestamp_multiplier(headers)
 
         entries = []
         last_entry = None
         for entry in delta_encoded:
+            if isinstance(entry, AnnotationEntry):
+                # Shares the delta state of standard entries, minus arg1/arg3.
+                if last_entry:
+                    entry = AnnotationEntry(
+                        id=TraceFile.__do32bitAddition(last_entry.id, entry.id),
+                        type=entry.type,
+                        timestamp=TraceFile.__do64bitAddition(
+                            last_entry.timestamp,
+                            (entry.timestamp * timestamp_multiplier),
+                        ),
+                        tid=TraceFile.__do32bitAddition(last_entry.tid, entry.tid),
+                        arg2=TraceFile.__do32bitAddition(last_entry.arg2, entry.arg2),
+                        pairs=entry.pairs,
+                    )
+                    last_entry = last_entry._replace(
+                        id=entry.id,
+                        timestamp=entry.timestamp,
+                        tid=entry.tid,
+                        arg2=entry.arg2,
+                    )
+                else:
+                    entry = entry._replace(
+                        timestamp=(entry.timestamp * timestamp_multiplier)
+                    )
+                    last_entry = StandardEntry(
+                        id=entry.id,
+                        type=entry.type,
+                        timestamp=entry.timestamp,
+                        tid=entry.tid,
+                        arg1=0,
+                        arg2=entry.arg2,
+                        arg3=0,
+                    )
+                entries.append(entry)
+                continue
+
             if not isinstance(entry, StandardEntry):
                 entries.append(entry)
                 continue
@@ -136,9 +436,7 @@ class TraceFile(object):
         # Headers are separated from actual data by '\n\n'.
         data = data.split("\n\n", 1)
 
-        # Headers have a `key|value` format.
-        headers = [x.split("|") for x in data[0].split("\n")]
-        headers = {x[0]: x[1] for x in headers if len(x) >= 2}
+        headers = TraceFile.__parse_headers(data[0])
         data = data[1]
 
         # Don't materialize the full list of delta-encoded entries,
@@ -152,18 +450,67 @@ class TraceFile(object):
 
         return TraceFile(headers=headers, entries=entries)
 
+    @staticmethod
+    def from_bytes(data):
+        # Binary traces have a text header too, see TraceFileHelpers.
+        header_data, body = data.split(b"\n\n", 1)
+        headers = TraceFile.__parse_headers(header_data.decode("utf-8"))
+        if "bin" not in headers:
+            return TraceFile.from_string(data.decode("utf-8"))
+
+        version = int(headers["bin"])
+        if version != BinaryTraceReader.VERSION:
+            raise ValueError("Unsupported binary trace version {}".format(version))
+        reader = BinaryTraceReader(
+            body, TraceFile.__timestamp_multiplier(headers)
+        )
+        return TraceFile(headers=headers, entries=list(reader.entries()))
+
     @staticmethod
     def from_file(fd):
         with fd:
-            data = fd.read().decode("utf-8")
-            return TraceFile.from_string(data)
+            return TraceFile.from_bytes(fd.read())
+
+    @staticmethod
+    def decompress(data, dictionary=None):
+        """
+        Decompress the contents of a trace file written with any of the
+        TraceCompressors, telling them apart by their magic bytes.
+        Uncompressed data is returned as is.
+
+        dictionary: contents of the zstd dictionary the trace was written
+        with, if any.
+        """
+        if data.startswith(GZIP_MAGIC):
+            return gzip.decompress(data)
+        if data.startswith(ZSTD_MAGIC):
+            try:
+                import zstandard
+            except ImportError:
+                raise ImportError("zstd compressed traces need `zstandard`")
+            dict_data = None
+            if dictionary is not None:
+                dict_data = zstandard.ZstdCompressionDict(dictionary)
+            decompressor = zstandard.ZstdDecompressor(dict_data=dict_data)
+            # The writer may end a frame on every flush.
+            reader = decompressor.stream_reader(
+                io.BytesIO(data), read_across_frames=True
+            )
+            return reader.read()
+        return data
+
+    @staticmethod
+    def from_compressed_file(fd, dictionary=None):
+        with fd:
+            return TraceFile.from_bytes(
+                TraceFile.decompress(fd.read(), dictionary)
+            )
 
 
 if __name__ == "__main__":
-    import gzip
     import sys
 
-    with gzip.open(sys.argv[1]) as f:
-        trace = TraceFile.from_file(f)
+    with open(sys.argv[1], "rb") as f:
+        trace = TraceFile.from_compressed_file(f)
         for entry in trace.entries:
             print(entry)
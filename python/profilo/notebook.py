@@ -15,19 +15,21 @@ limitations under the License.
 """
 
 
-import gzip
 import os.path
 
 from .importer.interpreter import TraceFileInterpreter
 from .importer.trace_file import TraceFile
 
 
-def open_trace(filepath):
+def open_trace(filepath, dictionary_path=None):
     filepath = os.path.expanduser(filepath)
-    if filepath.endswith("gz"):
-        fd = gzip.open(filepath, mode="rb")
-    else:
-        fd = open(filepath, mode="rb")
-
-    interpreter = TraceFileInterpreter(TraceFile.from_file(fd))
+    dictionary = None
+    if dictionary_path is not None:
+        with open(os.path.expanduser(dictionary_path), mode="rb") as fd:
+            dictionary = fd.read()
+
+    fd = open(filepath, mode="rb")
+    interpreter = TraceFileInterpreter(
+        TraceFile.from_compressed_file(fd, dictionary)
+    )
     return interpreter.interpret()